@@ -20,7 +20,7 @@ define(`dump_backend',dnl
       compatible = "ibm,fake-fsi";
       system-path = "/proc$1/fsi";
       reg = <0x0 0x0>;
-      index = <0x$1>;
+      index = <$1>;
 
       CONCAT(pib@,pib_addr) {
         #address-cells = <0x1>;
@@ -28,9 +28,11 @@ define(`dump_backend',dnl
         compatible = "ibm,fake-pib";
         system-path = "/proc$1/pib";
         reg = <CONCAT(0x,pib_addr) 0x0>;
-        index = <0x$1>;
+        index = <$1>;
 	ATTR1 = <0xc0ffee>;
+ifdef(`FAKE_PIB_UNITS', `FAKE_PIB_UNITS($1)')dnl
       };
+ifdef(`FAKE_FSI_UNITS', `FAKE_FSI_UNITS($1)')dnl
     };
 
 ')dnl
@@ -48,5 +50,5 @@ divert`'dnl
 / {
 	#address-cells = <0x1>;
 	#size-cells = <0x1>;
-dump_system(8, 4, 2)
+dump_system(ifdef(`NR_PROCS', `NR_PROCS', 8), 4, 2)
 };
@@ -0,0 +1,27 @@
+dnl
+dnl The fake backend with a POWER9 ADU on each pib. The fake pib simulates
+dnl the ADU registers, so this gives every processor a /mem target backed
+dnl by the simulated memory. Every processor also has an SBE FIFO to run
+dnl chip-ops on.
+dnl
+define(`FAKE_PIB_UNITS',
+`
+        adu@90000 {
+          compatible = "ibm,power9-adu";
+          reg = <0x90000 0x50>;
+          system-path = "/mem$1";
+        };
+')dnl
+define(`FAKE_FSI_UNITS',
+`
+      sbefifo {
+        compatible = "ibm,fake-sbefifo";
+        index = <$1>;
+
+        chipop {
+          compatible = "ibm,sbefifo-chipop";
+          index = <$1>;
+        };
+      };
+')dnl
+include(`fake-backend.dts.m4')dnl
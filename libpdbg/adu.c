@@ -21,8 +21,10 @@
 
 #include "operations.h"
 #include "bitutils.h"
+#include "regfield.h"
 #include "debug.h"
 #include "hwunit.h"
+#include "poll.h"
 
 /* P8 ADU SCOM Register Definitions */
 #define P8_ALTD_CONTROL_REG	0x0
@@ -40,23 +42,23 @@
 #define FBC_ALTD_START_OP	PPC_BIT(2)
 #define FBC_ALTD_CLEAR_STATUS	PPC_BIT(3)
 #define FBC_ALTD_RESET_AD_PCB	PPC_BIT(4)
-#define FBC_ALTD_SCOPE		PPC_BITMASK(16, 18)
+#define FBC_ALTD_SCOPE		REG_FIELD(16, 18)
 #define FBC_ALTD_AUTO_INC	PPC_BIT(19)
-#define FBC_ALTD_DROP_PRIORITY	PPC_BITMASK(20, 21)
+#define FBC_ALTD_DROP_PRIORITY	REG_FIELD(20, 21)
 #define FBC_LOCKED		PPC_BIT(11)
 
 /* P9_ALTD_CMD_REG fields */
 #define P9_TTYPE_TREAD 	       		PPC_BIT(5)
 #define P9_TTYPE_TWRITE 		0
-#define P9_FBC_ALTD_TTYPE		PPC_BITMASK(25, 31)
+#define P9_FBC_ALTD_TTYPE		REG_FIELD(25, 31)
 
 #define P9_TTYPE_CI_PARTIAL_WRITE	0b110111
 #define P9_TTYPE_CI_PARTIAL_OOO_WRITE	0b110110
 #define P9_TTYPE_CI_PARTIAL_READ 	0b110100
 #define P9_TTYPE_DMA_PARTIAL_READ	0b000110
 #define P9_TTYPE_DMA_PARTIAL_WRITE	0b100110
-#define P9_FBC_ALTD_TSIZE		PPC_BITMASK(32, 39)
-#define P9_FBC_ALTD_ADDRESS		PPC_BITMASK(8, 63)
+#define P9_FBC_ALTD_TSIZE		REG_FIELD(32, 39)
+#define P9_FBC_ALTD_ADDRESS		REG_FIELD(8, 63)
 
 #define DROP_PRIORITY_LOW	0ULL
 #define DROP_PRIORITY_MEDIUM	1ULL
@@ -68,11 +70,11 @@
 #define SCOPE_REMOTE		3
 
 /* P8_ALTD_CONTROL_REG fields */
-#define P8_FBC_ALTD_TTYPE	PPC_BITMASK(0, 5)
+#define P8_FBC_ALTD_TTYPE	REG_FIELD(0, 5)
 #define P8_TTYPE_TREAD		PPC_BIT(6)
 #define P8_TTYPE_TWRITE		0
-#define P8_FBC_ALTD_TSIZE	PPC_BITMASK(7, 13)
-#define P8_FBC_ALTD_ADDRESS	PPC_BITMASK(14, 63)
+#define P8_FBC_ALTD_TSIZE	REG_FIELD(7, 13)
+#define P8_FBC_ALTD_ADDRESS	REG_FIELD(14, 63)
 
 #define P8_TTYPE_CI_PARTIAL_WRITE	0b110111
 #define P8_TTYPE_CI_PARTIAL_OOO_WRITE	0b110110
@@ -136,6 +138,12 @@ static int adu_read(struct mem *adu, uint64_t start_addr, uint8_t *output,
 	for (addr = addr0; addr < start_addr + size; addr += block_size) {
 		uint64_t data;
 
+		/* The ADU lock is only held within getmem() */
+		if (pdbg_cancelled()) {
+			PR_NOTICE("Memory read cancelled at 0x%016" PRIx64 "\n", addr);
+			return -1;
+		}
+
 		if (adu->getmem(adu, addr, &data, ci, block_size))
 			return -1;
 
@@ -172,7 +180,7 @@ int adu_getmem(struct pdbg_target *adu_target, uint64_t start_addr,
 {
 	struct mem *adu;
 
-	assert(pdbg_target_is_class(adu_target, "mem"));
+	assert(target_is_class(adu_target, TARGET_CLASS("mem")));
 
 	if (pdbg_target_status(adu_target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -187,7 +195,7 @@ int adu_getmem_ci(struct pdbg_target *adu_target, uint64_t start_addr,
 {
 	struct mem *adu;
 
-	assert(pdbg_target_is_class(adu_target, "mem"));
+	assert(target_is_class(adu_target, TARGET_CLASS("mem")));
 
 	if (pdbg_target_status(adu_target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -202,7 +210,7 @@ int adu_getmem_io(struct pdbg_target *adu_target, uint64_t start_addr,
 {
 	struct mem *adu;
 
-	assert(pdbg_target_is_class(adu_target, "mem"));
+	assert(target_is_class(adu_target, TARGET_CLASS("mem")));
 
 	if (pdbg_target_status(adu_target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -219,7 +227,7 @@ int __adu_getmem(struct pdbg_target *adu_target, uint64_t start_addr,
 {
 	struct mem *adu;
 
-	assert(pdbg_target_is_class(adu_target, "mem"));
+	assert(target_is_class(adu_target, TARGET_CLASS("mem")));
 
 	if (pdbg_target_status(adu_target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -245,6 +253,11 @@ static int adu_write(struct mem *adu, uint64_t start_addr, uint8_t *input,
 
 	end_addr = start_addr + size;
 	for (addr = start_addr; addr < end_addr; addr += tsize, input += tsize) {
+		if (pdbg_cancelled()) {
+			PR_NOTICE("Memory write cancelled at 0x%016" PRIx64 "\n", addr);
+			return -1;
+		}
+
 		if ((addr % block_size) || (addr + block_size > end_addr)) {
 			/* If the address is not aligned to block_size
 			 * we copy the data in one byte at a time
@@ -277,12 +290,13 @@ int adu_putmem(struct pdbg_target *adu_target, uint64_t start_addr,
 {
 	struct mem *adu;
 
-	assert(pdbg_target_is_class(adu_target, "mem"));
+	assert(target_is_class(adu_target, TARGET_CLASS("mem")));
 
 	if (pdbg_target_status(adu_target) != PDBG_TARGET_ENABLED)
 		return -1;
 
 	adu = target_to_mem(adu_target);
+	mem_cache_invalidate_range(start_addr, size);
 
 	return adu_write(adu, start_addr, input, size, 8, false);
 }
@@ -292,12 +306,13 @@ int adu_putmem_ci(struct pdbg_target *adu_target, uint64_t start_addr,
 {
 	struct mem *adu;
 
-	assert(pdbg_target_is_class(adu_target, "mem"));
+	assert(target_is_class(adu_target, TARGET_CLASS("mem")));
 
 	if (pdbg_target_status(adu_target) != PDBG_TARGET_ENABLED)
 		return -1;
 
 	adu = target_to_mem(adu_target);
+	mem_cache_invalidate_range(start_addr, size);
 
 	return adu_write(adu, start_addr, input, size, 8, true);
 }
@@ -307,12 +322,13 @@ int adu_putmem_io(struct pdbg_target *adu_target, uint64_t start_addr,
 {
 	struct mem *adu;
 
-	assert(pdbg_target_is_class(adu_target, "mem"));
+	assert(target_is_class(adu_target, TARGET_CLASS("mem")));
 
 	if (pdbg_target_status(adu_target) != PDBG_TARGET_ENABLED)
 		return -1;
 
 	adu = target_to_mem(adu_target);
+	mem_cache_invalidate_range(start_addr, size);
 
 	return adu_write(adu, start_addr, input, size, block_size, true);
 }
@@ -322,12 +338,13 @@ int __adu_putmem(struct pdbg_target *adu_target, uint64_t start_addr,
 {
 	struct mem *adu;
 
-	assert(pdbg_target_is_class(adu_target, "mem"));
+	assert(target_is_class(adu_target, TARGET_CLASS("mem")));
 
 	if (pdbg_target_status(adu_target) != PDBG_TARGET_ENABLED)
 		return -1;
 
 	adu = target_to_mem(adu_target);
+	mem_cache_invalidate_range(start_addr, size);
 
 	return adu_write(adu, start_addr, input, size, 8, ci);
 }
@@ -375,6 +392,45 @@ static int adu_reset(struct mem *adu)
 	return 0;
 }
 
+/* The ADU normally completes within a few status reads */
+#define ADU_STATUS_TIMEOUT_US	1000000
+
+struct adu_status_poll {
+	struct mem *adu;
+	uint64_t status_reg;
+	uint64_t *val;
+};
+
+static int adu_status_done(void *priv)
+{
+	struct adu_status_poll *p = priv;
+
+	if (pib_read(&p->adu->target, p->status_reg, p->val))
+		return -1;
+
+	return *p->val != 0;
+}
+
+/* Wait for the ADU to post a non-zero status */
+static int adu_wait_status(struct mem *adu, uint64_t status_reg, uint64_t *val)
+{
+	struct adu_status_poll poll = {
+		.adu = adu,
+		.status_reg = status_reg,
+		.val = val,
+	};
+	int rc;
+
+	rc = poll_until(adu_status_done, &poll, ADU_STATUS_TIMEOUT_US, &poll_backoff_fast);
+	if (rc == POLL_TIMEOUT) {
+		PR_ERROR("Timeout waiting for ADU status on %s\n",
+			 pdbg_target_path(&adu->target));
+		return -1;
+	}
+
+	return rc;
+}
+
 static int p8_adu_getmem(struct mem *adu, uint64_t addr, uint64_t *data,
 			 int ci, uint8_t block_size)
 {
@@ -386,34 +442,32 @@ static int p8_adu_getmem(struct mem *adu, uint64_t addr, uint64_t *data,
 	ctrl_reg = P8_TTYPE_TREAD;
 	if (ci) {
 		/* Do cache inhibited access */
-		ctrl_reg = SETFIELD(P8_FBC_ALTD_TTYPE, ctrl_reg, P8_TTYPE_CI_PARTIAL_READ);
+		ctrl_reg = field_set(P8_FBC_ALTD_TTYPE, ctrl_reg, P8_TTYPE_CI_PARTIAL_READ);
 		block_size = (blog2(block_size) + 1);
 	} else {
-		ctrl_reg = SETFIELD(P8_FBC_ALTD_TTYPE, ctrl_reg, P8_TTYPE_DMA_PARTIAL_READ);
+		ctrl_reg = field_set(P8_FBC_ALTD_TTYPE, ctrl_reg, P8_TTYPE_DMA_PARTIAL_READ);
 		block_size = 0;
 	}
-	ctrl_reg = SETFIELD(P8_FBC_ALTD_TSIZE, ctrl_reg, block_size);
+	ctrl_reg = field_set(P8_FBC_ALTD_TSIZE, ctrl_reg, block_size);
 
 	CHECK_ERR_GOTO(out, rc = pib_read(&adu->target, P8_ALTD_CMD_REG, &cmd_reg));
 	cmd_reg |= FBC_ALTD_START_OP;
-	cmd_reg = SETFIELD(FBC_ALTD_SCOPE, cmd_reg, SCOPE_SYSTEM);
-	cmd_reg = SETFIELD(FBC_ALTD_DROP_PRIORITY, cmd_reg, DROP_PRIORITY_MEDIUM);
+	cmd_reg = field_set(FBC_ALTD_SCOPE, cmd_reg, SCOPE_SYSTEM);
+	cmd_reg = field_set(FBC_ALTD_DROP_PRIORITY, cmd_reg, DROP_PRIORITY_MEDIUM);
 
 retry:
 	/* Clear status bits */
 	CHECK_ERR_GOTO(out, rc = adu_reset(adu));
 
 	/* Set the address */
-	ctrl_reg = SETFIELD(P8_FBC_ALTD_ADDRESS, ctrl_reg, addr);
+	ctrl_reg = field_set(P8_FBC_ALTD_ADDRESS, ctrl_reg, addr);
 	CHECK_ERR_GOTO(out, rc = pib_write(&adu->target, P8_ALTD_CONTROL_REG, ctrl_reg));
 
 	/* Start the command */
 	CHECK_ERR_GOTO(out, rc = pib_write(&adu->target, P8_ALTD_CMD_REG, cmd_reg));
 
 	/* Wait for completion */
-	do {
-		CHECK_ERR_GOTO(out, rc = pib_read(&adu->target, P8_ALTD_STATUS_REG, &val));
-	} while (!val);
+	CHECK_ERR_GOTO(out, rc = adu_wait_status(adu, P8_ALTD_STATUS_REG, &val));
 
 	if( !(val & FBC_ALTD_ADDR_DONE) ||
 	    !(val & FBC_ALTD_DATA_DONE)) {
@@ -447,23 +501,23 @@ int p8_adu_putmem(struct mem *adu, uint64_t addr, uint64_t data, int size,
 	ctrl_reg = P8_TTYPE_TWRITE;
 	if (ci) {
 		/* Do cache inhibited access */
-		ctrl_reg = SETFIELD(P8_FBC_ALTD_TTYPE, ctrl_reg, P8_TTYPE_CI_PARTIAL_WRITE);
+		ctrl_reg = field_set(P8_FBC_ALTD_TTYPE, ctrl_reg, P8_TTYPE_CI_PARTIAL_WRITE);
 		block_size = (blog2(block_size) + 1);
 	} else {
-		ctrl_reg = SETFIELD(P8_FBC_ALTD_TTYPE, ctrl_reg, P8_TTYPE_DMA_PARTIAL_WRITE);
+		ctrl_reg = field_set(P8_FBC_ALTD_TTYPE, ctrl_reg, P8_TTYPE_DMA_PARTIAL_WRITE);
 	}
-	ctrl_reg = SETFIELD(P8_FBC_ALTD_TSIZE, ctrl_reg, block_size);
+	ctrl_reg = field_set(P8_FBC_ALTD_TSIZE, ctrl_reg, block_size);
 
 	CHECK_ERR_GOTO(out, rc = pib_read(&adu->target, P8_ALTD_CMD_REG, &cmd_reg));
 	cmd_reg |= FBC_ALTD_START_OP;
-	cmd_reg = SETFIELD(FBC_ALTD_SCOPE, cmd_reg, SCOPE_SYSTEM);
-	cmd_reg = SETFIELD(FBC_ALTD_DROP_PRIORITY, cmd_reg, DROP_PRIORITY_MEDIUM);
+	cmd_reg = field_set(FBC_ALTD_SCOPE, cmd_reg, SCOPE_SYSTEM);
+	cmd_reg = field_set(FBC_ALTD_DROP_PRIORITY, cmd_reg, DROP_PRIORITY_MEDIUM);
 
 	/* Clear status bits */
 	CHECK_ERR_GOTO(out, rc = adu_reset(adu));
 
 	/* Set the address */
-	ctrl_reg = SETFIELD(P8_FBC_ALTD_ADDRESS, ctrl_reg, addr);
+	ctrl_reg = field_set(P8_FBC_ALTD_ADDRESS, ctrl_reg, addr);
 
 retry:
 	CHECK_ERR_GOTO(out, rc = pib_write(&adu->target, P8_ALTD_CONTROL_REG, ctrl_reg));
@@ -475,9 +529,7 @@ retry:
 	CHECK_ERR_GOTO(out, rc = pib_write(&adu->target, P8_ALTD_CMD_REG, cmd_reg));
 
 	/* Wait for completion */
-	do {
-		CHECK_ERR_GOTO(out, rc = pib_read(&adu->target, P8_ALTD_STATUS_REG, &val));
-	} while (!val);
+	CHECK_ERR_GOTO(out, rc = adu_wait_status(adu, P8_ALTD_STATUS_REG, &val));
 
 	if( !(val & FBC_ALTD_ADDR_DONE) ||
 	    !(val & FBC_ALTD_DATA_DONE)) {
@@ -505,36 +557,34 @@ static int p9_adu_getmem(struct mem *adu, uint64_t addr, uint64_t *data,
 	cmd_reg = P9_TTYPE_TREAD;
 	if (ci) {
 		/* Do cache inhibited access */
-		cmd_reg = SETFIELD(P9_FBC_ALTD_TTYPE, cmd_reg, P9_TTYPE_CI_PARTIAL_READ);
+		cmd_reg = field_set(P9_FBC_ALTD_TTYPE, cmd_reg, P9_TTYPE_CI_PARTIAL_READ);
 		block_size = (blog2(block_size) + 1) << 1;
 	} else {
-		cmd_reg = SETFIELD(P9_FBC_ALTD_TTYPE, cmd_reg, P9_TTYPE_DMA_PARTIAL_READ);
+		cmd_reg = field_set(P9_FBC_ALTD_TTYPE, cmd_reg, P9_TTYPE_DMA_PARTIAL_READ);
 
 		/* For normal reads the size is ignored as HW always
 		 * returns a cache line */
 		block_size = 0;
 	}
 
-	cmd_reg = SETFIELD(P9_FBC_ALTD_TSIZE, cmd_reg, block_size);
+	cmd_reg = field_set(P9_FBC_ALTD_TSIZE, cmd_reg, block_size);
  	cmd_reg |= FBC_ALTD_START_OP;
-	cmd_reg = SETFIELD(FBC_ALTD_SCOPE, cmd_reg, SCOPE_REMOTE);
-	cmd_reg = SETFIELD(FBC_ALTD_DROP_PRIORITY, cmd_reg, DROP_PRIORITY_LOW);
+	cmd_reg = field_set(FBC_ALTD_SCOPE, cmd_reg, SCOPE_REMOTE);
+	cmd_reg = field_set(FBC_ALTD_DROP_PRIORITY, cmd_reg, DROP_PRIORITY_LOW);
 
 retry:
 	/* Clear status bits */
 	CHECK_ERR(adu_reset(adu));
 
 	/* Set the address */
-	ctrl_reg = SETFIELD(P9_FBC_ALTD_ADDRESS, 0ULL, addr);
+	ctrl_reg = field_prep(P9_FBC_ALTD_ADDRESS, addr);
 	CHECK_ERR(pib_write(&adu->target, P9_ALTD_CONTROL_REG, ctrl_reg));
 
 	/* Start the command */
 	CHECK_ERR(pib_write(&adu->target, P9_ALTD_CMD_REG, cmd_reg));
 
 	/* Wait for completion */
-	do {
-		CHECK_ERR(pib_read(&adu->target, P9_ALTD_STATUS_REG, &val));
-	} while (!val);
+	CHECK_ERR(adu_wait_status(adu, P9_ALTD_STATUS_REG, &val));
 
 	if( !(val & FBC_ALTD_ADDR_DONE) ||
 	    !(val & FBC_ALTD_DATA_DONE)) {
@@ -566,22 +616,22 @@ static int p9_adu_putmem(struct mem *adu, uint64_t addr, uint64_t data, int size
 	cmd_reg = P9_TTYPE_TWRITE;
 	if (ci) {
 		/* Do cache inhibited access */
-		cmd_reg = SETFIELD(P9_FBC_ALTD_TTYPE, cmd_reg, P9_TTYPE_CI_PARTIAL_WRITE);
+		cmd_reg = field_set(P9_FBC_ALTD_TTYPE, cmd_reg, P9_TTYPE_CI_PARTIAL_WRITE);
 		block_size = (blog2(block_size) + 1) << 1;
 	} else {
-		cmd_reg = SETFIELD(P9_FBC_ALTD_TTYPE, cmd_reg, P9_TTYPE_DMA_PARTIAL_WRITE);
+		cmd_reg = field_set(P9_FBC_ALTD_TTYPE, cmd_reg, P9_TTYPE_DMA_PARTIAL_WRITE);
 		block_size <<= 1;
 	}
-	cmd_reg = SETFIELD(P9_FBC_ALTD_TSIZE, cmd_reg, block_size);
+	cmd_reg = field_set(P9_FBC_ALTD_TSIZE, cmd_reg, block_size);
  	cmd_reg |= FBC_ALTD_START_OP;
-	cmd_reg = SETFIELD(FBC_ALTD_SCOPE, cmd_reg, SCOPE_REMOTE);
-	cmd_reg = SETFIELD(FBC_ALTD_DROP_PRIORITY, cmd_reg, DROP_PRIORITY_LOW);
+	cmd_reg = field_set(FBC_ALTD_SCOPE, cmd_reg, SCOPE_REMOTE);
+	cmd_reg = field_set(FBC_ALTD_DROP_PRIORITY, cmd_reg, DROP_PRIORITY_LOW);
 
 	/* Clear status bits */
 	CHECK_ERR(adu_reset(adu));
 
 	/* Set the address */
-	ctrl_reg = SETFIELD(P9_FBC_ALTD_ADDRESS, 0ULL, addr);
+	ctrl_reg = field_prep(P9_FBC_ALTD_ADDRESS, addr);
 retry:
 	CHECK_ERR(pib_write(&adu->target, P9_ALTD_CONTROL_REG, ctrl_reg));
 
@@ -592,9 +642,7 @@ retry:
 	CHECK_ERR(pib_write(&adu->target, P9_ALTD_CMD_REG, cmd_reg));
 
 	/* Wait for completion */
-	do {
-		CHECK_ERR(pib_read(&adu->target, P9_ALTD_STATUS_REG, &val));
-	} while (!val);
+	CHECK_ERR(adu_wait_status(adu, P9_ALTD_STATUS_REG, &val));
 
 	if( !(val & FBC_ALTD_ADDR_DONE) ||
 	    !(val & FBC_ALTD_DATA_DONE)) {
@@ -634,6 +682,7 @@ static struct mem p9_adu = {
 	.putmem = p9_adu_putmem,
 	.read = adu_read,
 	.write = adu_write,
+	.mmio_base = P9_MMIO_BASE,
 };
 DECLARE_HW_UNIT(p9_adu);
 
@@ -0,0 +1,180 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "arena.h"
+
+#define ARENA_CHUNK_SIZE	(64 * 1024)
+#define ARENA_ALIGN		16
+
+struct arena_chunk {
+	struct list_node link;
+	size_t size;
+	size_t used;
+	char data[] __attribute__((aligned(ARENA_ALIGN)));
+};
+
+void arena_init(struct arena *arena)
+{
+	list_head_init(&arena->chunks);
+}
+
+static struct arena_chunk *arena_new_chunk(struct arena *arena, size_t size)
+{
+	struct arena_chunk *chunk;
+
+	if (size < ARENA_CHUNK_SIZE)
+		size = ARENA_CHUNK_SIZE;
+
+	chunk = malloc(sizeof(*chunk) + size);
+	if (!chunk)
+		return NULL;
+
+	chunk->size = size;
+	chunk->used = 0;
+
+	/* Oversized allocations get a chunk of their own which is put at
+	 * the back so the current chunk keeps being filled up */
+	if (size > ARENA_CHUNK_SIZE)
+		list_add_tail(&arena->chunks, &chunk->link);
+	else
+		list_add(&arena->chunks, &chunk->link);
+
+	return chunk;
+}
+
+void *arena_zalloc(struct arena *arena, size_t size)
+{
+	struct arena_chunk *chunk;
+	void *p;
+
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+	chunk = list_top(&arena->chunks, struct arena_chunk, link);
+	if (!chunk || chunk->size - chunk->used < size) {
+		chunk = arena_new_chunk(arena, size);
+		if (!chunk)
+			return NULL;
+	}
+
+	p = chunk->data + chunk->used;
+	chunk->used += size;
+	memset(p, 0, size);
+
+	return p;
+}
+
+char *arena_strdup(struct arena *arena, const char *str)
+{
+	size_t len = strlen(str) + 1;
+	char *p;
+
+	p = arena_zalloc(arena, len);
+	if (p)
+		memcpy(p, str, len);
+
+	return p;
+}
+
+void arena_free(struct arena *arena)
+{
+	struct arena_chunk *chunk, *next;
+
+	list_for_each_safe(&arena->chunks, chunk, next, link) {
+		list_del(&chunk->link);
+		free(chunk);
+	}
+}
+
+static uint32_t arena_hash(const char *str)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*str) {
+		hash ^= (unsigned char)*str++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+void arena_strtab_init(struct arena_strtab *strtab, struct arena *arena)
+{
+	strtab->arena = arena;
+	strtab->slots = NULL;
+	strtab->size = 0;
+	strtab->count = 0;
+}
+
+static int arena_strtab_grow(struct arena_strtab *strtab)
+{
+	const char **slots;
+	size_t size, i, j;
+
+	size = strtab->size ? strtab->size * 2 : 256;
+	slots = calloc(size, sizeof(*slots));
+	if (!slots)
+		return -1;
+
+	for (i = 0; i < strtab->size; i++) {
+		if (!strtab->slots[i])
+			continue;
+
+		j = arena_hash(strtab->slots[i]) & (size - 1);
+		while (slots[j])
+			j = (j + 1) & (size - 1);
+		slots[j] = strtab->slots[i];
+	}
+
+	free(strtab->slots);
+	strtab->slots = slots;
+	strtab->size = size;
+	return 0;
+}
+
+/* Returns the single arena copy of the given string */
+const char *arena_intern(struct arena_strtab *strtab, const char *str)
+{
+	const char *p;
+	size_t i;
+
+	/* Keep the load factor below 1/2 */
+	if (2 * (strtab->count + 1) > strtab->size && arena_strtab_grow(strtab))
+		return NULL;
+
+	i = arena_hash(str) & (strtab->size - 1);
+	while ((p = strtab->slots[i])) {
+		if (!strcmp(p, str))
+			return p;
+		i = (i + 1) & (strtab->size - 1);
+	}
+
+	p = arena_strdup(strtab->arena, str);
+	if (!p)
+		return NULL;
+
+	strtab->slots[i] = p;
+	strtab->count++;
+	return p;
+}
+
+void arena_strtab_free(struct arena_strtab *strtab)
+{
+	free(strtab->slots);
+	arena_strtab_init(strtab, strtab->arena);
+}
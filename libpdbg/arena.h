@@ -0,0 +1,49 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBPDBG_ARENA_H
+#define __LIBPDBG_ARENA_H
+
+#include <stddef.h>
+#include <ccan/list/list.h>
+
+/*
+ * Simple bump allocator. Memory is handed out from large chunks and
+ * can only be returned all at once with arena_free(), which makes it
+ * a good fit for data structures such as the target tree that are
+ * built up once and torn down as a whole.
+ */
+struct arena {
+	struct list_head chunks;
+};
+
+/* Set of unique strings stored in an arena */
+struct arena_strtab {
+	struct arena *arena;
+	const char **slots;
+	size_t size;
+	size_t count;
+};
+
+void arena_init(struct arena *arena);
+void *arena_zalloc(struct arena *arena, size_t size);
+char *arena_strdup(struct arena *arena, const char *str);
+void arena_free(struct arena *arena);
+
+void arena_strtab_init(struct arena_strtab *strtab, struct arena *arena);
+const char *arena_intern(struct arena_strtab *strtab, const char *str);
+void arena_strtab_free(struct arena_strtab *strtab);
+
+#endif
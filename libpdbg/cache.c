@@ -0,0 +1,230 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "target.h"
+#include "debug.h"
+
+/*
+ * Optional on-disk cache of backend detection results.
+ *
+ * Setting PDBG_CACHE_DIR enables the cache. One file is kept per
+ * requested backend/backend option combination and records the outcome
+ * of backend detection (backend, processor type and which built-in
+ * device trees were selected), so that subsequent invocations do not
+ * need to poke sysfs/procfs again.
+ *
+ * Detection results are only trusted for the kernel boot they were
+ * recorded on. Removing the cache directory drops all cached state,
+ * which should be done if the hardware configuration changes without a
+ * reboot.
+ *
+ * Nothing else is cached. Whether a target exists depends on the state
+ * of the host (powered off, IPLed, chiplets deconfigured), which can
+ * change any time during a BMC boot without changing the boot id, so
+ * cached probe results would go stale. The expanded tree can't be
+ * stored either, as targets hold driver state and function pointers.
+ * Instead pdbg_targets_init_lazy() avoids expanding the parts of the
+ * tree which aren't used.
+ */
+
+#define DTB_CACHE_MAGIC		0x50444243	/* "PDBC" */
+#define DTB_CACHE_VERSION	2
+#define DTB_CACHE_BOOT_ID	"/proc/sys/kernel/random/boot_id"
+
+struct dtb_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	char boot_id[40];
+	struct dtb_cache_detect detect;
+};
+
+static struct {
+	char *path;
+	struct dtb_cache_header hdr;
+	bool detect_valid;
+	bool dirty;
+} dtb_cache;
+
+static void dtb_cache_reset(void)
+{
+	free(dtb_cache.path);
+	memset(&dtb_cache, 0, sizeof(dtb_cache));
+}
+
+static void dtb_cache_boot_id(char *boot_id, size_t len)
+{
+	ssize_t n;
+	int fd;
+
+	memset(boot_id, 0, len);
+
+	fd = open(DTB_CACHE_BOOT_ID, O_RDONLY);
+	if (fd < 0)
+		return;
+
+	n = read(fd, boot_id, len - 1);
+	close(fd);
+	if (n < 0)
+		n = 0;
+
+	while (n > 0 && isspace((unsigned char)boot_id[n-1]))
+		n--;
+	boot_id[n] = '\0';
+}
+
+static char *dtb_cache_path(const char *dir, enum pdbg_backend backend, const char *option)
+{
+	const char *driver = NULL;
+	char *path, *p;
+	int rc;
+
+	/* The default backend may be forced from the environment */
+	if (backend == PDBG_DEFAULT_BACKEND)
+		driver = getenv("PDBG_BACKEND_DRIVER");
+
+	rc = asprintf(&path, "%s/pdbg-%u-%s-%s.cache", dir, backend,
+		      driver ? driver : "", option ? option : "");
+	if (rc < 0)
+		return NULL;
+
+	/* Backend options may contain path separators, host names, etc. */
+	for (p = path + strlen(dir) + 1; *p; p++) {
+		if (!isalnum((unsigned char)*p) && *p != '-' && *p != '.')
+			*p = '_';
+	}
+
+	return path;
+}
+
+void dtb_cache_load(enum pdbg_backend backend, const char *option)
+{
+	const char *dir;
+	char boot_id[40];
+	ssize_t n;
+	int fd;
+
+	dtb_cache_reset();
+
+	dir = getenv("PDBG_CACHE_DIR");
+	if (!dir || !*dir)
+		return;
+
+	dtb_cache.path = dtb_cache_path(dir, backend, option);
+	if (!dtb_cache.path)
+		return;
+
+	fd = open(dtb_cache.path, O_RDONLY);
+	if (fd < 0) {
+		PR_DEBUG("No cache at %s\n", dtb_cache.path);
+		return;
+	}
+
+	n = read(fd, &dtb_cache.hdr, sizeof(dtb_cache.hdr));
+	close(fd);
+	if (n != sizeof(dtb_cache.hdr) ||
+	    dtb_cache.hdr.magic != DTB_CACHE_MAGIC ||
+	    dtb_cache.hdr.version != DTB_CACHE_VERSION) {
+		PR_DEBUG("Ignoring invalid cache %s\n", dtb_cache.path);
+		memset(&dtb_cache.hdr, 0, sizeof(dtb_cache.hdr));
+		return;
+	}
+
+	dtb_cache_boot_id(boot_id, sizeof(boot_id));
+	if (!strncmp(boot_id, dtb_cache.hdr.boot_id, sizeof(boot_id)))
+		dtb_cache.detect_valid = true;
+	else
+		PR_DEBUG("Cache %s is from a different boot\n", dtb_cache.path);
+}
+
+bool dtb_cache_get_detect(struct dtb_cache_detect *detect)
+{
+	if (!dtb_cache.detect_valid)
+		return false;
+
+	*detect = dtb_cache.hdr.detect;
+	return true;
+}
+
+void dtb_cache_set_detect(const struct dtb_cache_detect *detect)
+{
+	if (!dtb_cache.path)
+		return;
+
+	if (dtb_cache.detect_valid &&
+	    !memcmp(&dtb_cache.hdr.detect, detect, sizeof(*detect)))
+		return;
+
+	dtb_cache.hdr.detect = *detect;
+	dtb_cache_boot_id(dtb_cache.hdr.boot_id, sizeof(dtb_cache.hdr.boot_id));
+	dtb_cache.detect_valid = true;
+	dtb_cache.dirty = true;
+}
+
+static int dtb_cache_write(void)
+{
+	char *tmp;
+	int fd, rc;
+
+	rc = asprintf(&tmp, "%s.XXXXXX", dtb_cache.path);
+	if (rc < 0)
+		return -1;
+
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		PR_DEBUG("Unable to create %s: %s\n", tmp, strerror(errno));
+		free(tmp);
+		return -1;
+	}
+
+	dtb_cache.hdr.magic = DTB_CACHE_MAGIC;
+	dtb_cache.hdr.version = DTB_CACHE_VERSION;
+
+	rc = 0;
+	if (write(fd, &dtb_cache.hdr, sizeof(dtb_cache.hdr)) != sizeof(dtb_cache.hdr))
+		rc = -1;
+	close(fd);
+
+	/* Replace the old cache atomically so concurrent readers never
+	 * see a partially written file */
+	if (!rc)
+		rc = rename(tmp, dtb_cache.path);
+
+	if (rc) {
+		PR_DEBUG("Unable to write cache %s\n", dtb_cache.path);
+		unlink(tmp);
+	}
+
+	free(tmp);
+	return rc;
+}
+
+void dtb_cache_save(void)
+{
+	if (!dtb_cache.path)
+		return;
+
+	if (dtb_cache.dirty && !dtb_cache_write())
+		dtb_cache.dirty = false;
+}
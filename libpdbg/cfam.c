@@ -24,6 +24,7 @@
 #include "bitutils.h"
 #include "operations.h"
 #include "debug.h"
+#include "poll.h"
 
 #define FSI_DATA0_REG	0x0
 #define FSI_DATA1_REG	0x1
@@ -76,8 +77,12 @@
 #define OPB_ERR_TIMEOUT_ERR	-1;
 #define OPB_ERR_BAD_OPB_ADDR	-1;
 
-/* We try up to 1.2ms for an OPB access */
-#define MFSI_OPB_MAX_TRIES	1200
+/*
+ * OPB accesses used to be polled 1200 times with a usleep(1) in
+ * between, which sleeps for at least the 50us timer slack, so they
+ * were given up on after somewhere around 100ms.
+ */
+#define MFSI_OPB_TIMEOUT_US	100000
 
 static int fsi2pib_getscom(struct pib *pib, uint64_t addr, uint64_t *value)
 {
@@ -129,37 +134,48 @@ static struct pib fsi_pib = {
 };
 DECLARE_HW_UNIT(fsi_pib);
 
+struct opb_stat_poll {
+	struct opb *opb;
+	uint64_t sval;
+};
+
+static int opb_stat_done(void *priv)
+{
+	struct opb_stat_poll *p = priv;
+	int64_t rc;
+
+	/* Read OPB status register */
+	rc = pib_read(&p->opb->target, PIB2OPB_REG_STAT, &p->sval);
+	if (rc) {
+		/* Do something here ? */
+		PR_ERROR("XSCOM error %" PRId64 " read OPB STAT\n", rc);
+		return -1;
+	}
+	PR_DEBUG("  STAT=0x%16" PRIx64 "...\n", p->sval);
+
+	/* Complete */
+	return !((p->sval >> 32) & OPB_STAT_BUSY);
+}
+
 static uint64_t opb_poll(struct opb *opb, uint32_t *read_data)
 {
-	unsigned long retries = MFSI_OPB_MAX_TRIES;
+	struct opb_stat_poll poll = { .opb = opb };
 	uint64_t sval;
 	uint32_t stat;
 	int64_t rc;
 
-	/* We try again every 10us for a bit more than 1ms */
-	for (;;) {
-		/* Read OPB status register */
-		rc = pib_read(&opb->target, PIB2OPB_REG_STAT, &sval);
-		if (rc) {
-			/* Do something here ? */
-			PR_ERROR("XSCOM error %" PRId64 " read OPB STAT\n", rc);
-			return -1;
-		}
-		PR_DEBUG("  STAT=0x%16" PRIx64 "...\n", sval);
-
-		stat = sval >> 32;
-
-		/* Complete */
-		if (!(stat & OPB_STAT_BUSY))
-			break;
-		if (retries-- == 0) {
-			/* This isn't supposed to happen (HW timeout) */
-			PR_ERROR("OPB POLL timeout !\n");
-			return -1;
-		}
-		usleep(1);
+	rc = poll_until(opb_stat_done, &poll, MFSI_OPB_TIMEOUT_US, &poll_backoff_fast);
+	if (rc == POLL_TIMEOUT) {
+		/* This isn't supposed to happen (HW timeout) */
+		PR_ERROR("OPB POLL timeout !\n");
+		return -1;
+	} else if (rc) {
+		return -1;
 	}
 
+	sval = poll.sval;
+	stat = sval >> 32;
+
 	/*
 	 * TODO: Add the full error analysis that skiboot has. For now
 	 * we just reset things so we can continue. Also need to
@@ -297,7 +313,7 @@ DECLARE_HW_UNIT(p8_opb_hmfsi);
 
 static int cfam_hmfsi_read(struct fsi *fsi, uint32_t addr, uint32_t *data)
 {
-	struct pdbg_target *parent_fsi = require_target_parent("fsi", &fsi->target, false);
+	struct pdbg_target *parent_fsi = require_target_class_parent(TARGET_CLASS("fsi"), &fsi->target, false);
 
 	addr += pdbg_target_address(&fsi->target, NULL);
 
@@ -306,7 +322,7 @@ static int cfam_hmfsi_read(struct fsi *fsi, uint32_t addr, uint32_t *data)
 
 static int cfam_hmfsi_write(struct fsi *fsi, uint32_t addr, uint32_t data)
 {
-	struct pdbg_target *parent_fsi = require_target_parent("fsi", &fsi->target, false);
+	struct pdbg_target *parent_fsi = require_target_class_parent(TARGET_CLASS("fsi"), &fsi->target, false);
 
 	addr += pdbg_target_address(&fsi->target, NULL);
 
@@ -27,6 +27,7 @@
 #include "debug.h"
 #include "sprs.h"
 #include "chip.h"
+#include "stats.h"
 
 uint64_t mfspr(uint64_t reg, uint64_t spr)
 {
@@ -120,7 +121,8 @@ int ram_instructions(struct thread *thread, uint64_t *opcodes,
 			    uint64_t *results, int len, unsigned int lpar)
 {
 	uint64_t opcode = 0, r0 = 0, r1 = 0, scratch = 0;
-	int i;
+	uint64_t start;
+	int i, rc;
 	int exception = 0;
 	bool did_setup = false;
 
@@ -129,8 +131,19 @@ int ram_instructions(struct thread *thread, uint64_t *opcodes,
 		did_setup = true;
 	}
 
+	/* Rammed instructions may store to memory */
+	mem_cache_invalidate(NULL);
+
 	/* RAM instructions */
 	for (i = -2; i < len + 2; i++) {
+		if (i >= 0 && i < len && pdbg_cancelled()) {
+			PR_NOTICE("Instruction ramming cancelled\n");
+			/* skip the rest but still restore r0 and r1 */
+			exception = 1;
+			i = len - 1;
+			continue;
+		}
+
 		if (i == -2)
 			/* Save r1 (assumes opcodes don't touch other registers) */
 			opcode = mtspr(277, 1);
@@ -150,7 +163,10 @@ int ram_instructions(struct thread *thread, uint64_t *opcodes,
 			opcode = mfspr(1, 277);
 		}
 
-		if (thread->ram_instruction(thread, opcode, &scratch)) {
+		start = stats_start();
+		rc = thread->ram_instruction(thread, opcode, &scratch);
+		stats_record(PDBG_STATS_RAM_INSN, &thread->target, start, 8, rc);
+		if (rc) {
 			PR_DEBUG("%s: %d, %016" PRIx64 "\n", __FUNCTION__, __LINE__, opcode);
 			exception = 1;
 			if (i >= 0 && i < len)
@@ -313,7 +329,7 @@ int getring(struct pdbg_target *target, uint64_t ring_addr, uint64_t ring_len, u
 {
 	struct chiplet *chiplet;
 
-	assert(pdbg_target_is_class(target, "chiplet"));
+	assert(target_is_class(target, TARGET_CLASS("chiplet")));
 	chiplet = target_to_chiplet(target);
 	return chiplet->getring(chiplet, ring_addr, ring_len, result);
 }
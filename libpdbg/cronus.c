@@ -25,6 +25,8 @@
 
 #include "hwunit.h"
 #include "debug.h"
+#include "stats.h"
+#include "trace.h"
 
 static struct cronus_context *cctx;
 static int cctx_refcount;
@@ -181,6 +183,9 @@ static int cronus_sbefifo_probe(struct pdbg_target *target)
 		return rc;
 	}
 
+	stats_sbefifo_attach(sf->sf_ctx, target);
+	trace_sbefifo_attach(sf->sf_ctx, target);
+
 	return 0;
 }
 
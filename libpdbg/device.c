@@ -17,6 +17,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
 #include "target.h"
 #include <libfdt.h>
 #include <ccan/list/list.h>
@@ -27,9 +28,10 @@
 #include "debug.h"
 #include "compiler.h"
 #include "hwunit.h"
+#include "arena.h"
+#include "trace.h"
 
 #define prerror printf
-#define is_rodata(p) false
 
 #define dt_for_each_child(parent, node) \
 	list_for_each(&parent->children, node, list)
@@ -39,69 +41,118 @@ static uint32_t last_phandle = 0;
 
 static struct pdbg_target *pdbg_dt_root;
 
+/* Nodes without a class, node names and paths live here. Targets with
+ * a class are allocated from the arena of their class so that all
+ * targets of a class are next to each other. */
+static struct arena dt_arena = { LIST_HEAD_INIT(dt_arena.chunks) };
+static struct arena_strtab dt_names = { .arena = &dt_arena };
+
+/*
+ * Lazy expansion, see pdbg_targets_init_lazy()
+ *
+ * Each device tree is scanned once into a table of its nodes in the
+ * order they appear in the blob, which is pre-order. The table records
+ * the parent, the extent of the subtree and the class of every node,
+ * which is all that is needed to create the targets later. The nodes
+ * of each class are chained together so the targets of a class can be
+ * created without looking at any other node.
+ */
+struct dt_lazy_node {
+	int offset;
+	int parent;		/* -1 for the root node */
+	int last;		/* last node within the subtree */
+	int next_in_class;	/* -1 for the last node of a class */
+	const struct hw_unit_info *hw_info;
+	struct pdbg_target_class *target_class;
+	struct pdbg_target *target;
+	bool dropped;		/* duplicate of a node in the other tree */
+	bool system_path;
+};
+
+struct dt_lazy_class {
+	struct pdbg_target_class *target_class;
+	int first, last;
+};
+
+struct dt_lazy_tree {
+	void *fdt;
+	struct dt_lazy_node *nodes;
+	int nr_nodes;
+	struct dt_lazy_class *classes;
+	int nr_classes;
+};
+
+#define DT_LAZY_MAX_DEPTH	64
+#define DT_LAZY_TREES		2
+
+/* Backend [0] and system [1] device tree, in the order they are expanded */
+static struct dt_lazy_tree dt_lazy_trees[DT_LAZY_TREES];
+static bool dt_lazy;
+
 static const char *take_name(const char *name)
 {
-	if (!is_rodata(name) && !(name = strdup(name))) {
+	if (!(name = arena_intern(&dt_names, name))) {
 		prerror("Failed to allocate copy of name");
 		abort();
 	}
 	return name;
 }
 
-/* Adds information representing an actual target */
-static struct pdbg_target *dt_pdbg_target_new(const void *fdt, int node_offset)
+/* Finds the hardware unit implementing a node, if any */
+static const struct hw_unit_info *dt_find_hw_unit(const void *fdt, int node_offset)
 {
-	struct pdbg_target *target;
-	struct pdbg_target_class *target_class;
-	const struct hw_unit_info *hw_info = NULL;
 	const struct fdt_property *prop;
-	size_t size;
 
 	prop = fdt_get_property(fdt, node_offset, "compatible", NULL);
-	if (prop) {
-		uint32_t prop_len = fdt32_to_cpu(prop->len);
-
-		/*
-		 * If I understand correctly, the property we have
-		 * here can be a stringlist with a few compatible
-		 * strings
-		 */
-		hw_info = pdbg_hwunit_find_compatible(prop->data, prop_len);
-		if (hw_info)
-			size = hw_info->size;
-	}
-
-	if (!hw_info)
-		/* Couldn't find anything implementing this target */
+	if (!prop)
 		return NULL;
 
-	target = calloc(1, size);
-	if (!target) {
-		prerror("Failed to allocate node\n");
-		abort();
-	}
+	/*
+	 * If I understand correctly, the property we have
+	 * here can be a stringlist with a few compatible
+	 * strings
+	 */
+	return pdbg_hwunit_find_compatible(prop->data, fdt32_to_cpu(prop->len));
+}
+
+/* Adds information representing an actual target */
+static struct pdbg_target *dt_pdbg_target_new(const struct hw_unit_info *hw_info)
+{
+	struct pdbg_target *target;
+	struct pdbg_target_class *target_class;
+	size_t size = hw_info->size;
 
 	/* hw_info->hw_unit points to a per-target struct type. This
 	 * works because the first member in the per-target struct is
 	 * guaranteed to be the struct pdbg_target (see the comment
 	 * above DECLARE_HW_UNIT). */
+	target_class = get_target_class((struct pdbg_target *)hw_info->hw_unit);
+
+	target = arena_zalloc(&target_class->arena, size);
+	if (!target) {
+		prerror("Failed to allocate node\n");
+		abort();
+	}
+
 	memcpy(target, hw_info->hw_unit, size);
-	target_class = get_target_class(target);
+	target->target_class = target_class;
+	target->class = (char *)target_class->name;
 	list_add_tail(&target_class->targets, &target->class_link);
 
 	return target;
 }
 
-static struct pdbg_target *dt_new_node(const char *name, void *fdt, int node_offset)
+static struct pdbg_target *dt_new_target(const char *name, void *fdt, int node_offset,
+					 const struct hw_unit_info *hw_info)
 {
 	struct pdbg_target *node = NULL;
 	size_t size = sizeof(*node);
 
-	if (fdt)
-		node = dt_pdbg_target_new(fdt, node_offset);
+	if (hw_info)
+		node = dt_pdbg_target_new(hw_info);
 
 	if (!node)
-		node = calloc(1, size);
+		node = arena_zalloc(&dt_arena, size);
 
 	if (!node) {
 		prerror("Failed to allocate node\n");
@@ -110,6 +161,7 @@ static struct pdbg_target *dt_new_node(const char *name, void *fdt, int node_off
 
 	node->fdt = fdt;
 	node->fdt_offset = fdt ? node_offset : -1;
+	node->expanded = !dt_lazy || !fdt;
 
 	node->dn_name = take_name(name);
 	node->parent = NULL;
@@ -120,6 +172,12 @@ static struct pdbg_target *dt_new_node(const char *name, void *fdt, int node_off
 	return node;
 }
 
+static struct pdbg_target *dt_new_node(const char *name, void *fdt, int node_offset)
+{
+	return dt_new_target(name, fdt, node_offset,
+			     fdt ? dt_find_hw_unit(fdt, node_offset) : NULL);
+}
+
 static const char *get_unitname(const struct pdbg_target *node)
 {
 	const char *c = strchr(node->dn_name, '@');
@@ -162,6 +220,7 @@ static bool dt_attach_node(struct pdbg_target *parent, struct pdbg_target *child
 	if (list_empty(&parent->children)) {
 		list_add(&parent->children, &child->list);
 		child->parent = parent;
+		tree_index_invalidate();
 
 		return true;
 	}
@@ -184,6 +243,7 @@ static bool dt_attach_node(struct pdbg_target *parent, struct pdbg_target *child
 
 	list_add_before(&parent->children, &child->list, &node->list);
 	child->parent = parent;
+	tree_index_invalidate();
 
 	return true;
 }
@@ -196,7 +256,7 @@ static char *dt_get_path(struct pdbg_target *node)
 
 	/* Dealing with NULL is for test/debug purposes */
 	if (!node)
-		return strdup("<NULL>");
+		return arena_strdup(&dt_arena, "<NULL>");
 
 	for (n = node; n; n = n->parent) {
 		n = target_to_virtual(n, false);
@@ -204,7 +264,7 @@ static char *dt_get_path(struct pdbg_target *node)
 		if (n->parent || n == node)
 			len++;
 	}
-	path = calloc(1, len + 1);
+	path = arena_zalloc(&dt_arena, len + 1);
 	assert(path);
 	p = path + len;
 	for (n = node; n; n = n->parent) {
@@ -269,6 +329,8 @@ static struct pdbg_target *dt_find_by_path(struct pdbg_target *root, const char
 		vnode = false;
 
 again:
+		target_expand(root);
+
 		/* Compare with each child node */
 		match = false;
 		list_for_each(&root->children, n, list) {
@@ -386,8 +448,10 @@ static struct pdbg_target *dt_first(const struct pdbg_target *root)
 
 /* Return next node, or NULL. */
 static struct pdbg_target *dt_next(const struct pdbg_target *root,
-			const struct pdbg_target *prev)
+			struct pdbg_target *prev)
 {
+	target_expand(prev);
+
 	/* Children? */
 	if (!list_empty(&prev->children))
 		return dt_first(prev);
@@ -569,6 +633,348 @@ static void dt_expand(struct pdbg_target *root, void *fdt)
 		abort();
 }
 
+static struct dt_lazy_class *dt_lazy_find_class(struct dt_lazy_tree *tree,
+					       struct pdbg_target_class *target_class)
+{
+	int i;
+
+	for (i = 0; i < tree->nr_classes; i++) {
+		if (tree->classes[i].target_class == target_class)
+			return &tree->classes[i];
+	}
+
+	return NULL;
+}
+
+static void dt_lazy_add_class(struct dt_lazy_tree *tree, int node)
+{
+	struct pdbg_target_class *target_class = tree->nodes[node].target_class;
+	struct dt_lazy_class *c;
+
+	c = dt_lazy_find_class(tree, target_class);
+	if (c) {
+		tree->nodes[c->last].next_in_class = node;
+		c->last = node;
+		return;
+	}
+
+	tree->classes = realloc(tree->classes, (tree->nr_classes + 1) * sizeof(*tree->classes));
+	assert(tree->classes);
+
+	c = &tree->classes[tree->nr_classes++];
+	c->target_class = target_class;
+	c->first = node;
+	c->last = node;
+}
+
+/*
+ * Record every node of a device tree without creating any targets. This
+ * is a single pass over the structure block, like dt_expand_node(), as
+ * looking up properties through libfdt walks them once per lookup.
+ */
+static int dt_lazy_scan(struct dt_lazy_tree *tree, void *fdt)
+{
+	/* Nodes whose subtree hasn't ended yet, one per depth */
+	int open[DT_LAZY_MAX_DEPTH];
+	const struct fdt_property *prop;
+	const struct hw_unit_info *hw_info;
+	struct dt_lazy_node *node;
+	int offset = 0, nextoffset, depth = -1, size = 0, err;
+	const char *name;
+	uint32_t tag;
+
+	if ((err = fdt_check_header(fdt)) != 0) {
+		prerror("FDT: Error %d parsing fdt @%p\n", err, fdt);
+		return -1;
+	}
+
+	tree->fdt = fdt;
+
+	do {
+		tag = fdt_next_tag(fdt, offset, &nextoffset);
+		switch (tag) {
+		case FDT_BEGIN_NODE:
+			if (++depth >= DT_LAZY_MAX_DEPTH) {
+				prerror("FDT: Node 0x%x nested too deep\n", offset);
+				return -1;
+			}
+
+			if (tree->nr_nodes == size) {
+				size = size ? size * 2 : 256;
+				tree->nodes = realloc(tree->nodes, size * sizeof(*tree->nodes));
+				assert(tree->nodes);
+			}
+
+			node = &tree->nodes[tree->nr_nodes];
+			memset(node, 0, sizeof(*node));
+			node->offset = offset;
+			node->parent = depth ? open[depth - 1] : -1;
+			node->next_in_class = -1;
+			open[depth] = tree->nr_nodes++;
+			break;
+
+		case FDT_END_NODE:
+			if (depth < 0)
+				goto fail;
+
+			tree->nodes[open[depth--]].last = tree->nr_nodes - 1;
+			break;
+
+		case FDT_PROP:
+			if (depth < 0)
+				goto fail;
+
+			node = &tree->nodes[open[depth]];
+			prop = fdt_offset_ptr(fdt, offset, sizeof(*prop));
+			name = fdt_string(fdt, fdt32_to_cpu(prop->nameoff));
+
+			if (!strcmp(name, "compatible")) {
+				hw_info = pdbg_hwunit_find_compatible(prop->data,
+								      fdt32_to_cpu(prop->len));
+				if (hw_info) {
+					node->hw_info = hw_info;
+					node->target_class = get_target_class((struct pdbg_target *)hw_info->hw_unit);
+					dt_lazy_add_class(tree, open[depth]);
+				}
+			} else if (!strcmp(name, "system-path")) {
+				node->system_path = true;
+			}
+			break;
+
+		case FDT_NOP:
+			break;
+
+		default:
+			goto fail;
+		}
+
+		offset = nextoffset;
+	} while (depth >= 0 && offset >= 0);
+
+	if (depth < 0 && tree->nr_nodes)
+		return 0;
+
+fail:
+	prerror("FDT: Error parsing node 0x%x\n", offset);
+	return -1;
+}
+
+/* The properties the eager expansion picks up while walking the tree */
+static void dt_lazy_node_props(struct pdbg_target *node, const void *fdt, int offset)
+{
+	const char *name;
+	const void *p;
+	uint32_t data;
+	int prop, len;
+
+	fdt_for_each_property_offset(prop, fdt, offset) {
+		p = fdt_getprop_by_offset(fdt, prop, &name, &len);
+		if (!p)
+			continue;
+
+		if (strcmp("index", name) == 0) {
+			memcpy(&data, p, sizeof(data));
+			node->index = fdt32_to_cpu(data);
+		}
+
+		if (strcmp("status", name) == 0)
+			node->status = str_to_status(p);
+
+		dt_add_phandle(node, name, p, len);
+	}
+}
+
+static struct pdbg_target *dt_lazy_create(struct dt_lazy_tree *tree, int i,
+					  struct pdbg_target *parent)
+{
+	struct dt_lazy_node *n = &tree->nodes[i];
+	struct pdbg_target *child;
+
+	child = dt_new_target(fdt_get_name(tree->fdt, n->offset, NULL), tree->fdt,
+			      n->offset, n->hw_info);
+	assert(child);
+	dt_lazy_node_props(child, tree->fdt, n->offset);
+
+	/* Unlike the eager expansion, a duplicate isn't left in its class
+	 * list as it can't be reached through the tree */
+	if (!dt_attach_node(parent, child)) {
+		if (child->target_class)
+			list_del_from(&child->target_class->targets, &child->class_link);
+		n->dropped = true;
+		return NULL;
+	}
+
+	n->target = child;
+	return child;
+}
+
+/* Create the target of a node and of all its parents */
+static struct pdbg_target *dt_lazy_materialize(struct dt_lazy_tree *tree, int i)
+{
+	struct dt_lazy_node *n = &tree->nodes[i];
+	struct pdbg_target *parent;
+
+	if (n->target || n->dropped)
+		return n->target;
+
+	parent = dt_lazy_materialize(tree, n->parent);
+	if (!parent) {
+		n->dropped = true;
+		return NULL;
+	}
+
+	return dt_lazy_create(tree, i, parent);
+}
+
+static void dt_lazy_expand(struct dt_lazy_tree *tree, int i)
+{
+	struct dt_lazy_node *n = &tree->nodes[i];
+	int child;
+
+	for (child = i + 1; child <= n->last; child = tree->nodes[child].last + 1) {
+		if (!tree->nodes[child].target && !tree->nodes[child].dropped)
+			dt_lazy_create(tree, child, n->target);
+	}
+}
+
+static int dt_lazy_lookup(struct dt_lazy_tree *tree, int offset)
+{
+	int lo = 0, hi = tree->nr_nodes;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (tree->nodes[mid].offset < offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo < tree->nr_nodes && tree->nodes[lo].offset == offset)
+		return lo;
+
+	return -1;
+}
+
+void dt_expand_children(struct pdbg_target *target)
+{
+	struct dt_lazy_tree *tree;
+	int i;
+
+	target->expanded = true;
+	if (!dt_lazy)
+		return;
+
+	/* The root node is shared by both trees */
+	if (target == pdbg_dt_root) {
+		for (i = 0; i < DT_LAZY_TREES; i++) {
+			if (dt_lazy_trees[i].fdt)
+				dt_lazy_expand(&dt_lazy_trees[i], 0);
+		}
+		return;
+	}
+
+	for (i = 0; i < DT_LAZY_TREES; i++) {
+		tree = &dt_lazy_trees[i];
+		if (tree->fdt && tree->fdt == target->fdt)
+			break;
+	}
+	if (i == DT_LAZY_TREES)
+		return;
+
+	i = dt_lazy_lookup(tree, target->fdt_offset);
+	if (i >= 0 && tree->nodes[i].target == target)
+		dt_lazy_expand(tree, i);
+}
+
+/* Position of a target in the order the eager expansion creates them */
+static uint64_t dt_lazy_key(const struct pdbg_target *target)
+{
+	/* The root node is created first */
+	if (target == pdbg_dt_root)
+		return 0;
+
+	return ((uint64_t)(target->fdt == dt_lazy_trees[1].fdt) << 32) |
+		(uint32_t)target->fdt_offset;
+}
+
+static int dt_lazy_cmp(const void *a, const void *b)
+{
+	uint64_t key_a = dt_lazy_key(*(const struct pdbg_target **)a);
+	uint64_t key_b = dt_lazy_key(*(const struct pdbg_target **)b);
+
+	return (key_a > key_b) - (key_a < key_b);
+}
+
+/*
+ * Targets are added to the end of their class list in whatever order
+ * they are created, which is sorted out once all of them exist. The
+ * class list isn't iterated over before that.
+ */
+static void dt_lazy_class_sort(struct pdbg_target_class *target_class)
+{
+	struct pdbg_target **targets, *target;
+	int i, count = 0;
+
+	list_for_each(&target_class->targets, target, class_link)
+		count++;
+
+	if (count < 2)
+		return;
+
+	targets = malloc(count * sizeof(*targets));
+	assert(targets);
+
+	i = 0;
+	list_for_each(&target_class->targets, target, class_link)
+		targets[i++] = target;
+
+	qsort(targets, count, sizeof(*targets), dt_lazy_cmp);
+
+	list_head_init(&target_class->targets);
+	for (i = 0; i < count; i++)
+		list_add_tail(&target_class->targets, &targets[i]->class_link);
+
+	free(targets);
+	tree_index_invalidate();
+}
+
+void dt_expand_class(struct pdbg_target_class *target_class)
+{
+	struct dt_lazy_class *c;
+	int i, node;
+
+	target_class->expanded = true;
+	if (!dt_lazy)
+		return;
+
+	for (i = 0; i < DT_LAZY_TREES; i++) {
+		struct dt_lazy_tree *tree = &dt_lazy_trees[i];
+
+		c = dt_lazy_find_class(tree, target_class);
+		if (!c)
+			continue;
+
+		for (node = c->first; node != -1; node = tree->nodes[node].next_in_class)
+			dt_lazy_materialize(tree, node);
+	}
+
+	dt_lazy_class_sort(target_class);
+}
+
+static void dt_lazy_free(void)
+{
+	int i;
+
+	for (i = 0; i < DT_LAZY_TREES; i++) {
+		free(dt_lazy_trees[i].nodes);
+		free(dt_lazy_trees[i].classes);
+		memset(&dt_lazy_trees[i], 0, sizeof(dt_lazy_trees[i]));
+	}
+
+	dt_lazy = false;
+}
+
 static u64 dt_get_number(const void *pdata, unsigned int cells)
 {
 	const u32 *p = pdata;
@@ -642,10 +1048,9 @@ static struct pdbg_target *dt_new_virtual(struct pdbg_target *root, const char *
 
 	free(parent_path);
 
-	if (!dt_attach_node(parent, vnode)) {
-		free(vnode);
+	/* On failure the node is simply left in the arena */
+	if (!dt_attach_node(parent, vnode))
 		return NULL;
-	}
 
 	PR_DEBUG("Created virtual node %s\n", system_path);
 	return vnode;
@@ -655,21 +1060,18 @@ static void dt_link_virtual(struct pdbg_target *node, struct pdbg_target *vnode)
 {
 	node->vnode = vnode;
 	vnode->vnode = node;
+	tree_index_invalidate();
 }
 
-static void pdbg_targets_init_virtual(struct pdbg_target *node, struct pdbg_target *root)
+static void dt_link_system_path(struct pdbg_target *node, struct pdbg_target *root)
 {
-	struct pdbg_target *vnode, *child = NULL;
+	struct pdbg_target *vnode;
 	const char *system_path;
 	size_t len;
 
-	/* Skip virtual nodes */
-	if (target_is_virtual(node))
-		goto skip;
-
 	system_path = (const char *)pdbg_target_property(node, "system-path", &len);
 	if (!system_path)
-		goto skip;
+		return;
 
 	assert(!target_is_virtual(node));
 
@@ -683,7 +1085,7 @@ static void pdbg_targets_init_virtual(struct pdbg_target *node, struct pdbg_targ
 
 	/* If virtual node does not exist, or cannot be created, skip */
 	if (!vnode)
-		goto skip;
+		return;
 
 	/*
 	 * If the virtual node is linked, dt_find_by_path will return the
@@ -694,74 +1096,68 @@ static void pdbg_targets_init_virtual(struct pdbg_target *node, struct pdbg_targ
 		assert(!vnode->vnode);
 		dt_link_virtual(node, vnode);
 	}
+}
+
+static void pdbg_targets_init_virtual(struct pdbg_target *node, struct pdbg_target *root)
+{
+	struct pdbg_target *child = NULL;
+
+	/* Skip virtual nodes */
+	if (!target_is_virtual(node))
+		dt_link_system_path(node, root);
 
-skip:
 	list_for_each(&node->children, child, list) {
 		pdbg_targets_init_virtual(child, root);
 	}
 }
 
-/**
- * @brief It releases/deletes a target from its target_class list.
- *  Each pdbg_target object (except the virtuals one) has an
- *  associated target class linked via it's class_link. This
- *  function deletes/removes a target form the list of associated
- *  pdbg_target_class object. For internal use only.
- * 
- * @param target The pdbg_target object which will be removed from it's associated
- *  pdbg_target_class list
- * 
- * @see pdbg_release_target for more details
- */
-static void pdbg_del_target_from_target_class_list(struct pdbg_target* target)
-{
-    if (!target)
-        return;
-
-    struct pdbg_target_class* target_class = get_target_class(target);
-    if (target_class)
-        list_del_from(&target_class->targets, &target->class_link);
-}
-
-/**
- * @brief A function to delete/release an existing pdbg_target object along
- * 	with its children from the node list/dev tree. Recursive in nature.
- * 	For internal use only.
- * 
- * @param target The target node for which the children and then the node itself
- * 	will be released/freed. Also remove the target from its parent's
- * 	children's list if it is having one
- * 
- * @see pdbg_release_dt_root for more details
- */
-static void pdbg_release_target(struct pdbg_target* target)
+/* Only the nodes with a system-path property and the nodes they are
+ * linked to are created up front */
+static void pdbg_targets_init_lazy_virtual(struct pdbg_target *root)
 {
-    if (!target)
-        return;
+	struct pdbg_target *node;
+	int i, j;
 
-    struct pdbg_target *childTarget, *next = NULL;
-    list_for_each_safe(&target->children, childTarget, next, list)
-        pdbg_release_target(childTarget);
-		
-    if (target->class)
-        pdbg_del_target_from_target_class_list(target);
+	for (i = 0; i < DT_LAZY_TREES; i++) {
+		struct dt_lazy_tree *tree = &dt_lazy_trees[i];
+
+		for (j = 0; j < tree->nr_nodes; j++) {
+			if (!tree->nodes[j].system_path)
+				continue;
+
+			node = dt_lazy_materialize(tree, j);
+			if (node && !target_is_virtual(node))
+				dt_link_system_path(node, root);
+		}
+	}
+}
+
+static bool pdbg_targets_init_lazy_trees(struct pdbg_dtb *dtb)
+{
+	dt_lazy = true;
 
-    struct pdbg_target* parentTarget = target->parent;
-    if (parentTarget)
-        list_del_from(&parentTarget->children, &target->list);
+	if (dtb->backend.fdt && dt_lazy_scan(&dt_lazy_trees[0], dtb->backend.fdt))
+		return false;
 
-    if (target)
-        free(target);
-    target = NULL;
+	if (dt_lazy_scan(&dt_lazy_trees[1], dtb->system.fdt))
+		return false;
+
+	return true;
 }
 
 void pdbg_release_dt_root()
 {
     if (pdbg_dt_root)
     {	
-        pdbg_release_target(pdbg_dt_root);
-        if (pdbg_dt_root)
-            pdbg_dt_root = NULL;
+        dtb_cache_save();
+        trace_stop();
+        dt_lazy_free();
+
+        /* All nodes, names and paths are in arenas so there is no
+         * need to walk the tree */
+        arena_strtab_free(&dt_names);
+        arena_free(&dt_arena);
+        pdbg_dt_root = NULL;
 		
         //Reset the phandle count to zero
         last_phandle = 0;
@@ -770,9 +1166,10 @@ void pdbg_release_dt_root()
     }
 }
 
-bool pdbg_targets_init(void *fdt)
+static bool targets_init(void *fdt, bool lazy)
 {
 	struct pdbg_dtb *dtb;
+	int i;
 
 	if (pdbg_dt_root) {
 		PR_WARNING("pdbg_targets_init() must be called only once\n");
@@ -791,6 +1188,9 @@ bool pdbg_targets_init(void *fdt)
 		return false;
 	}
 
+	if (lazy && !pdbg_targets_init_lazy_trees(dtb))
+		abort();
+
 	/* Root node needs to be valid when this function returns */
 	pdbg_dt_root = dt_new_node("", dtb->system.fdt, 0);
 	if (!pdbg_dt_root) {
@@ -798,12 +1198,26 @@ bool pdbg_targets_init(void *fdt)
 		return false;
 	}
 
-	if (dtb->backend.fdt)
-		dt_expand(pdbg_dt_root, dtb->backend.fdt);
+	if (lazy) {
+		for (i = 0; i < DT_LAZY_TREES; i++) {
+			if (!dt_lazy_trees[i].fdt)
+				continue;
 
-	dt_expand(pdbg_dt_root, dtb->system.fdt);
+			dt_lazy_trees[i].nodes[0].target = pdbg_dt_root;
+			dt_lazy_node_props(pdbg_dt_root, dt_lazy_trees[i].fdt, 0);
+		}
+
+		pdbg_targets_init_lazy_virtual(pdbg_dt_root);
+	} else {
+		if (dtb->backend.fdt)
+			dt_expand(pdbg_dt_root, dtb->backend.fdt);
+
+		dt_expand(pdbg_dt_root, dtb->system.fdt);
+
+		pdbg_targets_init_virtual(pdbg_dt_root, pdbg_dt_root);
+	}
 
-	pdbg_targets_init_virtual(pdbg_dt_root, pdbg_dt_root);
+	trace_start(dtb);
 
 	//Close any FDs which might be still opened
 	close(dtb->system.fd);
@@ -814,6 +1228,16 @@ bool pdbg_targets_init(void *fdt)
 	return true;
 }
 
+bool pdbg_targets_init(void *fdt)
+{
+	return targets_init(fdt, false);
+}
+
+bool pdbg_targets_init_lazy(void *fdt)
+{
+	return targets_init(fdt, true);
+}
+
 const char *pdbg_target_path(struct pdbg_target *target)
 {
 	if (!target->path)
@@ -835,46 +1259,121 @@ struct pdbg_target *pdbg_target_root(void)
 	return pdbg_dt_root;
 }
 
-bool pdbg_target_set_attribute(struct pdbg_target *target, const char *name, uint32_t size, uint32_t count, const void *val)
+/*
+ * Bulk conversion of arrays between big endian and host byte order,
+ * which is the same operation in both directions. Elements don't have
+ * to be aligned. Eight bytes are converted at a time, swapping several
+ * smaller integers within a 64 bit word at once.
+ */
+static inline uint64_t load64(const uint8_t *p)
 {
-	void *buf;
-	size_t total_size = count * size;
-	uint32_t i;
-	bool ok;
+	uint64_t v;
 
-	buf = malloc(total_size);
-	if (!buf)
-		return false;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
 
-	if (size == 1) {
-		memcpy(buf, val, total_size);
+static inline void store64(uint8_t *p, uint64_t v)
+{
+	memcpy(p, &v, sizeof(v));
+}
 
-	} else if (size == 2) {
-		uint16_t *b = (uint16_t *)buf;
-		uint16_t *v = (uint16_t *)val;
+static void be16_convert(void *dst, const void *src, size_t count)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	uint16_t v;
+	size_t i = 0;
 
-		for (i = 0; i < count; i++)
-			b[i] = htobe16(v[i]);
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	for (; i + 4 <= count; i += 4) {
+		uint64_t x = load64(s + i * 2);
 
-	} else if (size == 4) {
-		uint32_t *b = (uint32_t *)buf;
-		uint32_t *v = (uint32_t *)val;
+		x = ((x & 0x00ff00ff00ff00ffULL) << 8) | ((x >> 8) & 0x00ff00ff00ff00ffULL);
+		store64(d + i * 2, x);
+	}
+#endif
 
-		for (i = 0; i < count; i++)
-			b[i] = htobe32(v[i]);
+	for (; i < count; i++) {
+		memcpy(&v, s + i * 2, sizeof(v));
+		v = be16toh(v);
+		memcpy(d + i * 2, &v, sizeof(v));
+	}
+}
 
-	} else if (size == 8) {
-		uint64_t *b = (uint64_t *)buf;
-		uint64_t *v = (uint64_t *)val;
+static void be32_convert(void *dst, const void *src, size_t count)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	uint32_t v;
+	size_t i = 0;
 
-		for (i = 0; i < count; i++)
-			b[i] = htobe64(v[i]);
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	for (; i + 2 <= count; i += 2) {
+		uint64_t x = __builtin_bswap64(load64(s + i * 4));
 
-	} else {
-		free(buf);
+		store64(d + i * 4, (x >> 32) | (x << 32));
+	}
+#endif
+
+	for (; i < count; i++) {
+		memcpy(&v, s + i * 4, sizeof(v));
+		v = be32toh(v);
+		memcpy(d + i * 4, &v, sizeof(v));
+	}
+}
+
+static void be64_convert(void *dst, const void *src, size_t count)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	size_t i;
+
+	for (i = 0; i < count; i++)
+		store64(d + i * 8, be64toh(load64(s + i * 8)));
+}
+
+static bool be_convert(void *dst, const void *src, uint32_t size, size_t count)
+{
+	switch (size) {
+	case 1:
+		memmove(dst, src, count);
+		break;
+
+	case 2:
+		be16_convert(dst, src, count);
+		break;
+
+	case 4:
+		be32_convert(dst, src, count);
+		break;
+
+	case 8:
+		be64_convert(dst, src, count);
+		break;
+
+	default:
 		return false;
 	}
 
+	return true;
+}
+
+bool pdbg_target_set_attribute(struct pdbg_target *target, const char *name, uint32_t size, uint32_t count, const void *val)
+{
+	void *buf;
+	size_t total_size = count * size;
+	bool ok;
+
+	if (size != 1 && size != 2 && size != 4 && size != 8)
+		return false;
+
+	buf = malloc(total_size);
+	if (!buf)
+		return false;
+
+	be_convert(buf, val, size, count);
+
 	ok = pdbg_target_set_property(target, name, buf, total_size);
 	free(buf);
 
@@ -885,7 +1384,6 @@ bool pdbg_target_get_attribute(struct pdbg_target *target, const char *name, uin
 {
 	const void *buf;
 	size_t total_size;
-	uint32_t i;
 
 	buf = pdbg_target_property(target, name, &total_size);
 	if (!buf)
@@ -894,119 +1392,142 @@ bool pdbg_target_get_attribute(struct pdbg_target *target, const char *name, uin
 	if (total_size != count * size)
 		return false;
 
-	if (size == 1) {
-		memcpy(val, buf, total_size);
+	return be_convert(val, buf, size, count);
+}
 
-	} else if (size == 2) {
-		uint16_t *b = (uint16_t *)buf;
-		uint16_t *v = (uint16_t *)val;
+int pdbg_target_class_get_attribute(const char *klass, const char *name, uint32_t size, uint32_t count, void *val, uint32_t max_targets)
+{
+	struct pdbg_target_class *target_class;
+	struct pdbg_target *target;
+	size_t len = (size_t)size * count;
+	uint32_t n = 0;
 
-		for (i = 0; i < count; i++)
-			v[i] = be16toh(b[i]);
+	if (size != 1 && size != 2 && size != 4 && size != 8)
+		return -1;
 
-	} else if (size == 4) {
-		uint32_t *b = (uint32_t *)buf;
-		uint32_t *v = (uint32_t *)val;
+	target_class = find_target_class(klass);
+	if (!target_class)
+		return 0;
 
-		for (i = 0; i < count; i++)
-			v[i] = be32toh(b[i]);
+	target_class_expand(target_class);
+	list_for_each(&target_class->targets, target, class_link) {
+		const void *buf;
+		size_t total_size;
 
-	} else if (size == 8) {
-		uint64_t *b = (uint64_t *)buf;
-		uint64_t *v = (uint64_t *)val;
+		if (n == max_targets)
+			return -1;
 
-		for (i = 0; i < count; i++)
-			v[i] = be64toh(b[i]);
+		buf = pdbg_target_property(target, name, &total_size);
+		if (!buf || total_size != len)
+			return -1;
 
-	} else {
-		return false;
+		be_convert((uint8_t *)val + n * len, buf, size, count);
+		n++;
 	}
 
-	return true;
+	return n;
 }
 
-static size_t spec_size(const char *spec)
-{
-	size_t size = 0, i;
-
-	for (i = 0; i < strlen(spec); i++) {
-		char ch = spec[i];
-
-		if (ch == '1')
-			size += 1;
-		else if (ch == '2')
-			size += 2;
-		else if (ch == '4')
-			size += 4;
-		else if (ch == '8')
-			size += 8;
-		else
-			return -1;
-	}
+/*
+ * A compiled specification is a list of runs of integers of the same
+ * size, so "44442" becomes two runs, four 4 byte integers followed by a
+ * 2 byte integer. Each run is converted in bulk.
+ */
+struct attr_run {
+	uint32_t size;
+	uint32_t count;
+};
 
-	return size;
-}
+struct pdbg_attr_spec {
+	/* Size of one repetition of the specification */
+	size_t size;
+	int nr_runs;
+	struct attr_run runs[];
+};
 
-bool pdbg_target_set_attribute_packed(struct pdbg_target *target, const char *name, const char *spec, uint32_t count, const void *val)
+struct pdbg_attr_spec *pdbg_attr_spec_compile(const char *spec)
 {
-	void *buf;
-	size_t size, pos, i, j;
-	bool ok;
+	struct pdbg_attr_spec *aspec;
+	size_t len, i;
 
 	if (!spec || spec[0] == '\0')
-		return false;
-
-	if (count == 0)
-		return false;
-
-	size = spec_size(spec);
-	if (size <= 0)
-		return false;
+		return NULL;
 
-	size = size * count;
-	buf = malloc(size);
-	if (!buf)
-		return false;
+	len = strlen(spec);
+	aspec = malloc(sizeof(*aspec) + len * sizeof(aspec->runs[0]));
+	if (!aspec)
+		return NULL;
 
-	pos = 0;
-	for (j=0; j<count; j++) {
-		for (i=0; i<strlen(spec); i++) {
-			char ch = spec[i];
+	aspec->size = 0;
+	aspec->nr_runs = 0;
+	for (i = 0; i < len; i++) {
+		uint32_t size;
 
-			if (ch == '1') {
-				uint8_t *b = (uint8_t *)buf + pos;
-				uint8_t *v = (uint8_t *)val + pos;
+		if (spec[i] == '1' || spec[i] == '2' || spec[i] == '4' || spec[i] == '8') {
+			size = spec[i] - '0';
+		} else {
+			free(aspec);
+			return NULL;
+		}
 
-				*b = *v;
-				pos += 1;
+		if (aspec->nr_runs && aspec->runs[aspec->nr_runs - 1].size == size) {
+			aspec->runs[aspec->nr_runs - 1].count++;
+		} else {
+			aspec->runs[aspec->nr_runs].size = size;
+			aspec->runs[aspec->nr_runs].count = 1;
+			aspec->nr_runs++;
+		}
 
-			} else if (ch == '2') {
-				uint16_t *b = (uint16_t *)((uint8_t *)buf + pos);
-				uint16_t *v = (uint16_t *)((uint8_t *)val + pos);
+		aspec->size += size;
+	}
 
-				*b = htobe16(*v);
-				pos += 2;
+	return aspec;
+}
 
-			} else if (ch == '4') {
-				uint32_t *b = (uint32_t *)((uint8_t *)buf + pos);
-				uint32_t *v = (uint32_t *)((uint8_t *)val + pos);
+void pdbg_attr_spec_free(struct pdbg_attr_spec *spec)
+{
+	free(spec);
+}
 
-				*b = htobe32(*v);
-				pos += 4;
+static void attr_spec_convert(void *dst, const void *src, const struct pdbg_attr_spec *spec, uint32_t count)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	size_t pos = 0;
+	uint32_t i;
+	int j;
 
-			} else if (ch == '8') {
-				uint64_t *b = (uint64_t *)((uint8_t *)buf + pos);
-				uint64_t *v = (uint64_t *)((uint8_t *)val + pos);
+	/* A single run covers all repetitions */
+	if (spec->nr_runs == 1) {
+		be_convert(d, s, spec->runs[0].size, (size_t)spec->runs[0].count * count);
+		return;
+	}
 
-				*b = htobe64(*v);
-				pos += 8;
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < spec->nr_runs; j++) {
+			const struct attr_run *run = &spec->runs[j];
 
-			} else {
-				free(buf);
-				return false;
-			}
+			be_convert(d + pos, s + pos, run->size, run->count);
+			pos += run->size * run->count;
 		}
 	}
+}
+
+bool pdbg_target_set_attribute_spec(struct pdbg_target *target, const char *name, const struct pdbg_attr_spec *spec, uint32_t count, const void *val)
+{
+	void *buf;
+	size_t size;
+	bool ok;
+
+	if (!spec || count == 0)
+		return false;
+
+	size = spec->size * count;
+	buf = malloc(size);
+	if (!buf)
+		return false;
+
+	attr_spec_convert(buf, val, spec, count);
 
 	ok = pdbg_target_set_property(target, name, buf, size);
 	free(buf);
@@ -1014,62 +1535,52 @@ bool pdbg_target_set_attribute_packed(struct pdbg_target *target, const char *na
 	return ok;
 }
 
-bool pdbg_target_get_attribute_packed(struct pdbg_target *target, const char *name, const char *spec, uint32_t count, void *val)
+bool pdbg_target_get_attribute_spec(struct pdbg_target *target, const char *name, const struct pdbg_attr_spec *spec, uint32_t count, void *val)
 {
 	const void *buf;
-	size_t size, total_size, pos, i, j;
-
-	if (!spec || spec[0] == '\0')
-		return false;
+	size_t total_size;
 
-	if (count == 0)
+	if (!spec || count == 0)
 		return false;
 
 	buf = pdbg_target_property(target, name, &total_size);
 	if (!buf)
 		return false;
 
-	size = spec_size(spec);
-	size = size * count;
-	if (total_size != size)
+	if (total_size != spec->size * count)
 		return false;
 
-	pos = 0;
-	for (j=0; j<count; j++) {
-		for (i=0; i<strlen(spec); i++) {
-			char ch = spec[i];
+	attr_spec_convert(val, buf, spec, count);
 
-			if (ch == '1') {
-				uint8_t *b = (uint8_t *)buf + pos;
-				uint8_t *v = (uint8_t *)val + pos;
-
-				*v = *b;
-				pos += 1;
+	return true;
+}
 
-			} else if (ch == '2') {
-				uint16_t *b = (uint16_t *)((uint8_t *)buf + pos);
-				uint16_t *v = (uint16_t *)((uint8_t *)val + pos);
+bool pdbg_target_set_attribute_packed(struct pdbg_target *target, const char *name, const char *spec, uint32_t count, const void *val)
+{
+	struct pdbg_attr_spec *aspec;
+	bool ok;
 
-				*v = be16toh(*b);
-				pos += 2;
+	aspec = pdbg_attr_spec_compile(spec);
+	if (!aspec)
+		return false;
 
-			} else if (ch == '4') {
-				uint32_t *b = (uint32_t *)((uint8_t *)buf + pos);
-				uint32_t *v = (uint32_t *)((uint8_t *)val + pos);
+	ok = pdbg_target_set_attribute_spec(target, name, aspec, count, val);
+	pdbg_attr_spec_free(aspec);
 
-				*v = be32toh(*b);
-				pos += 4;
+	return ok;
+}
 
-			} else if (ch == '8') {
-				uint64_t *b = (uint64_t *)((uint8_t *)buf + pos);
-				uint64_t *v = (uint64_t *)((uint8_t *)val + pos);
+bool pdbg_target_get_attribute_packed(struct pdbg_target *target, const char *name, const char *spec, uint32_t count, void *val)
+{
+	struct pdbg_attr_spec *aspec;
+	bool ok;
 
-				*v = be64toh(*b);
-				pos += 8;
+	aspec = pdbg_attr_spec_compile(spec);
+	if (!aspec)
+		return false;
 
-			}
-		}
-	}
+	ok = pdbg_target_get_attribute_spec(target, name, aspec, count, val);
+	pdbg_attr_spec_free(aspec);
 
-	return true;
+	return ok;
 }
@@ -27,8 +27,11 @@
 #include <inttypes.h>
 #include <errno.h>
 
+#include <ccan/array_size/array_size.h>
+
 #include "libpdbg.h"
 #include "target.h"
+#include "trace.h"
 
 #include "fake.dt.h"
 #include "fake-backend.dt.h"
@@ -61,6 +64,7 @@
 
 static enum pdbg_proc pdbg_proc = PDBG_PROC_UNKNOWN;
 static enum pdbg_backend pdbg_backend = PDBG_DEFAULT_BACKEND;
+static enum pdbg_backend pdbg_replay_backend = PDBG_DEFAULT_BACKEND;
 static const char *pdbg_backend_option;
 
 static const uint16_t ODYSSEY_CHIP_ID = 0x60C0;
@@ -84,6 +88,35 @@ static struct pdbg_dtb pdbg_dtb = {
 	},
 };
 
+/* Built-in device trees. The position in this table is recorded in the
+ * on-disk cache, so only ever append to it. */
+static void *builtin_dtbs[] = {
+	&_binary_fake_dtb_o_start,
+	&_binary_fake_backend_dtb_o_start,
+	&_binary_p8_i2c_dtb_o_start,
+	&_binary_p8_fsi_dtb_o_start,
+	&_binary_p8_kernel_dtb_o_start,
+	&_binary_p9w_fsi_dtb_o_start,
+	&_binary_p9r_fsi_dtb_o_start,
+	&_binary_p9z_fsi_dtb_o_start,
+	&_binary_bmc_kernel_dtb_o_start,
+	&_binary_bmc_kernel_rainier_dtb_o_start,
+	&_binary_bmc_kernel_balcones_dtb_o_start,
+	&_binary_bmc_kernel_everest_dtb_o_start,
+	&_binary_p8_host_dtb_o_start,
+	&_binary_p9_host_dtb_o_start,
+	&_binary_p10_host_dtb_o_start,
+	&_binary_p8_cronus_dtb_o_start,
+	&_binary_cronus_dtb_o_start,
+	&_binary_bmc_sbefifo_dtb_o_start,
+	&_binary_bmc_sbefifo_rainier_dtb_o_start,
+	&_binary_bmc_sbefifo_balcones_dtb_o_start,
+	&_binary_bmc_sbefifo_everest_dtb_o_start,
+	&_binary_p8_dtb_o_start,
+	&_binary_p9_dtb_o_start,
+	&_binary_p10_dtb_o_start,
+};
+
 static bool get_chipid(uint32_t *chip_id)
 {
 	FILE *cfam_id_file;
@@ -576,6 +609,10 @@ bool pdbg_set_backend(enum pdbg_backend backend, const char *backend_option)
 
 enum pdbg_backend pdbg_get_backend(void)
 {
+	/* Behave exactly like the backend the trace was recorded with */
+	if (pdbg_backend == PDBG_BACKEND_REPLAY && trace_replaying())
+		return pdbg_replay_backend;
+
 	return pdbg_backend;
 }
 
@@ -604,19 +641,89 @@ static void set_pdbg_proc(void)
 		pdbg_proc = PDBG_PROC_P9;
 }
 
+static int32_t builtin_dtb_index(void *fdt)
+{
+	int32_t i;
+
+	for (i = 0; i < (int32_t)ARRAY_SIZE(builtin_dtbs); i++) {
+		if (builtin_dtbs[i] == fdt)
+			return i;
+	}
+
+	return -1;
+}
+
+/* Use the backend detection results from a previous invocation if
+ * they are available */
+static bool cached_dtb(struct pdbg_dtb *dtb)
+{
+	struct dtb_cache_detect detect;
+	void *backend_fdt, *system_fdt;
+
+	if (!dtb_cache_get_detect(&detect) || detect.backend != pdbg_backend)
+		return false;
+
+	backend_fdt = dtb->backend.fdt;
+	if (!backend_fdt) {
+		if (detect.backend_dtb < 0 || detect.backend_dtb >= (int32_t)ARRAY_SIZE(builtin_dtbs))
+			return false;
+		backend_fdt = builtin_dtbs[detect.backend_dtb];
+	}
+
+	system_fdt = dtb->system.fdt;
+	if (!system_fdt) {
+		if (detect.system_dtb < 0 || detect.system_dtb >= (int32_t)ARRAY_SIZE(builtin_dtbs))
+			return false;
+		system_fdt = builtin_dtbs[detect.system_dtb];
+	}
+
+	pdbg_log(PDBG_DEBUG, "Using cached backend detection results\n");
+	pdbg_proc = detect.proc;
+	dtb->backend.fdt = backend_fdt;
+	dtb->system.fdt = system_fdt;
+	return true;
+}
+
+static void cache_dtb(struct pdbg_dtb *dtb)
+{
+	struct dtb_cache_detect detect = {
+		.backend = pdbg_backend,
+		.proc = pdbg_proc,
+		.backend_dtb = builtin_dtb_index(dtb->backend.fdt),
+		.system_dtb = builtin_dtb_index(dtb->system.fdt),
+	};
+
+	if (dtb->backend.fdt && dtb->system.fdt)
+		dtb_cache_set_detect(&detect);
+}
+
 /* Determines what platform we are running on and returns a pointer to
  * the fdt that is most likely to work on the system. */
 struct pdbg_dtb *pdbg_default_dtb(void *system_fdt)
 {
 	struct pdbg_dtb *dtb = &pdbg_dtb;
+	struct dtb_cache_detect detect;
 	const char *fdt;
 
 	dtb->backend.fdt = NULL;
 	dtb->system.fdt = system_fdt;
 
+	dtb_cache_load(pdbg_backend, pdbg_backend_option);
+
+	if (!pdbg_backend && dtb_cache_get_detect(&detect))
+		pdbg_backend = detect.backend;
+
 	if (!pdbg_backend)
 		pdbg_backend = default_backend();
 
+	/* The trace has the device trees it was recorded with */
+	if (pdbg_backend == PDBG_BACKEND_REPLAY) {
+		if (!trace_replay_load(pdbg_backend_option, dtb, &pdbg_replay_backend, &pdbg_proc))
+			return NULL;
+
+		return dtb;
+	}
+
 	fdt = getenv("PDBG_BACKEND_DTB");
 	if (fdt)
 		mmap_dtb(fdt, false, &dtb->backend);
@@ -630,6 +737,9 @@ struct pdbg_dtb *pdbg_default_dtb(void *system_fdt)
 		goto done;
 	}
 
+	if (cached_dtb(dtb))
+		goto done;
+
 	switch(pdbg_backend) {
 	case PDBG_BACKEND_HOST:
 		ppc_target(dtb);
@@ -734,6 +844,8 @@ struct pdbg_dtb *pdbg_default_dtb(void *system_fdt)
 		break;
 	}
 
+	cache_dtb(dtb);
+
 done:
 	return dtb;
 }
@@ -777,7 +889,7 @@ bool is_child_of_ody_chip(struct pdbg_target *target)
 	struct pdbg_target *ocmb = NULL;
 	assert(target);
 
-	ocmb = pdbg_target_parent("ocmb", target);
+	ocmb = target_class_parent(TARGET_CLASS("ocmb"), target, true);
 	/*If it has a parent and the parent is of odyssey ocmb chip
 	return true */
 	if( (ocmb) && (is_ody_ocmb_chip(ocmb)) )
@@ -789,6 +901,7 @@ bool is_child_of_ody_chip(struct pdbg_target *target)
 __attribute__((destructor))
 static void pdbg_close_targets(void)
 {
+	dtb_cache_save();
 	close_dtb(&pdbg_dtb.backend);
 	close_dtb(&pdbg_dtb.system);
 }
@@ -14,11 +14,700 @@
  * limitations under the license.
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
+#include <errno.h>
+#include <endian.h>
+#include <time.h>
+
+#include <libsbefifo/libsbefifo.h>
 
 #include "libpdbg.h"
 #include "operations.h"
 #include "hwunit.h"
+#include "bitutils.h"
+#include "debug.h"
+#include "sprs.h"
+#include "chip.h"
+#include "poll.h"
+#include "stats.h"
+#include "trace.h"
+
+/*
+ * The fake backend simulates just enough of a system to run the common
+ * code paths without any hardware:
+ *
+ *  - Each pib has a sparse SCOM register file. Registers which were
+ *    never written read as 0xdeadbeef, CFAM registers as 0xfeed0cfa.
+ *    Accessing SCOM register 0xbad0000 always fails.
+ *
+ *  - The POWER9 ADU registers are backed by a sparse memory shared by
+ *    all processors, so the normal ADU code works with backend trees
+ *    which have ADU nodes (see fake-sim-backend.dts.m4). Accessing the
+ *    doubleword at 0xbad0040 always fails.
+ *
+ *  - Each core has per thread control, status, RAM and scratch
+ *    registers which model stopping, starting, stepping, sreset and
+ *    RAMing a small set of instructions.
+ *
+ *  - Each processor may have an SBE FIFO which runs isteps. The istep
+ *    given as <major>.<minor> in PDBG_FAKE_ISTEP_FAIL fails with FFDC.
+ *
+ *  - The FSI of the processors listed (by index, comma separated) in
+ *    PDBG_FAKE_OFFLINE fails to probe, as if the chip was powered off,
+ *    so everything below it is nonexistent.
+ *
+ * PDBG_FAKE_LATENCY adds a latency model as a comma separated list of
+ * <op>=<microseconds>, e.g. PDBG_FAKE_LATENCY=pib=5,adu=20. fsi, pib and
+ * istep delay every access. adu, ram, stop and start delay the point at
+ * which the status registers report the operation as complete.
+ */
+
+#define FAKE_PIB_DEFAULT	0xdeadbeef
+#define FAKE_PIB_ERROR		0xbad0000
+#define FAKE_MEM_ERROR		0xbad0040
+#define FAKE_FSI_DEFAULT	0xfeed0cfa
+
+/* Core registers, relative to the core address */
+#define FAKE_CORE_BASE		0x10000
+#define FAKE_CORE_END		0x20000
+#define FAKE_CORE_REG_MASK	0xf
+#define FAKE_MAX_THREADS	4
+#define FAKE_THREAD_CTRL	0x0	/* + thread id */
+#define FAKE_THREAD_STATUS	0x4	/* + thread id */
+#define FAKE_THREAD_RAM		0x8	/* + thread id */
+#define FAKE_THREAD_SCR0	0xc	/* + thread id */
+
+#define  FAKE_CTRL_STOP		PPC_BIT(0)
+#define  FAKE_CTRL_START	PPC_BIT(1)
+#define  FAKE_CTRL_STEP		PPC_BIT(2)
+#define  FAKE_CTRL_SRESET	PPC_BIT(3)
+#define  FAKE_CTRL_RAM_ENTER	PPC_BIT(4)
+#define  FAKE_CTRL_RAM_EXIT	PPC_BIT(5)
+
+#define  FAKE_STATUS_QUIESCED	PPC_BIT(0)
+#define  FAKE_STATUS_ACTIVE	PPC_BIT(1)
+#define  FAKE_STATUS_RAM_MODE	PPC_BIT(2)
+
+/* Writing FAKE_THREAD_RAM rams an opcode, reading it returns the
+ * status which is zero until the instruction completes */
+#define  FAKE_RAM_DONE		PPC_BIT(0)
+#define  FAKE_RAM_EXCEPTION	PPC_BIT(1)
+#define  FAKE_RAM_ERROR		PPC_BIT(2)
+
+#define FAKE_RESET_NIA		0x100
+#define FAKE_RESET_MSR		0x9000000000000001ULL
+#define FAKE_SPR_SCRATCH	277
+#define FAKE_NR_SPRS		1024
+
+#define FAKE_THREAD_TIMEOUT_US	1000000
+#define FAKE_RAM_TIMEOUT_US	1000000
+
+/* POWER9 ADU registers */
+#define FAKE_ADU_BASE		0x90000
+#define FAKE_ADU_CONTROL	0x0
+#define FAKE_ADU_CMD		0x1
+#define FAKE_ADU_STATUS		0x3
+#define FAKE_ADU_DATA		0x4
+
+#define  FAKE_ADU_START_OP	PPC_BIT(2)
+#define  FAKE_ADU_CLEAR_STATUS	PPC_BIT(3)
+#define  FAKE_ADU_RESET		PPC_BIT(4)
+#define  FAKE_ADU_TREAD		PPC_BIT(5)
+#define  FAKE_ADU_TTYPE		PPC_BITMASK(25, 31)
+#define  FAKE_ADU_TSIZE		PPC_BITMASK(32, 39)
+#define  FAKE_ADU_ADDRESS	PPC_BITMASK(8, 63)
+#define  FAKE_ADU_ADDR_DONE	PPC_BIT(2)
+#define  FAKE_ADU_DATA_DONE	PPC_BIT(3)
+#define  FAKE_ADU_CI_WRITE	0b110111
+
+/* SBE chip-ops */
+#define FAKE_SBE_CMD_ISTEP	0xa101
+#define FAKE_SBE_MAX_REPLY	8
+
+/* All latencies in nanoseconds */
+struct fake_latency {
+	uint64_t fsi;
+	uint64_t pib;
+	uint64_t adu;
+	uint64_t ram;
+	uint64_t stop;
+	uint64_t start;
+	uint64_t istep;
+};
+
+struct fake_map_entry {
+	uint64_t key;
+	uint64_t value;
+	bool used;
+};
+
+/* Sparse map of 64-bit values, used for registers and memory */
+struct fake_map {
+	struct fake_map_entry *entry;
+	size_t size;
+	size_t count;
+};
+
+struct fake_cpu {
+	uint64_t base;
+	int id;
+
+	/* quiesced changes to next_quiesced at ready_ns */
+	bool quiesced;
+	bool next_quiesced;
+	uint64_t ready_ns;
+	bool ram_mode;
+
+	uint64_t ram_status;
+	uint64_t ram_ready_ns;
+
+	uint64_t scratch;
+	uint64_t gpr[32];
+	uint64_t spr[FAKE_NR_SPRS];
+	uint64_t msr;
+	uint64_t nia;
+	uint64_t cr;
+};
+
+struct fake_adu {
+	uint64_t control;
+	uint64_t cmd;
+	uint64_t status;
+	uint64_t data;
+	uint64_t ready_ns;
+};
+
+struct fake_chip {
+	struct fake_map regs;
+	struct fake_adu adu;
+	struct fake_cpu **cpu;
+	int nr_cpus;
+};
+
+static struct fake_latency fake_latency;
+static bool fake_latency_parsed;
+
+/* CFAM registers of all processors, keyed by index and address */
+static struct fake_map fake_cfam;
+
+/* System memory as big-endian doublewords, keyed by address */
+static struct fake_map fake_memory;
+
+/* Probed FSIs and PIBs, the maps above go when the last one does */
+static int fake_users;
+
+static uint64_t fake_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void fake_parse_latency(void)
+{
+	const char *env = getenv("PDBG_FAKE_LATENCY");
+	char *str, *tok, *value, *save = NULL;
+	uint64_t *latency;
+
+	fake_latency_parsed = true;
+	if (!env)
+		return;
+
+	str = strdup(env);
+	if (!str)
+		return;
+
+	for (tok = strtok_r(str, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		value = strchr(tok, '=');
+		if (!value) {
+			PR_ERROR("Invalid fake latency '%s'\n", tok);
+			continue;
+		}
+		*value++ = '\0';
+
+		if (!strcmp(tok, "fsi"))
+			latency = &fake_latency.fsi;
+		else if (!strcmp(tok, "pib"))
+			latency = &fake_latency.pib;
+		else if (!strcmp(tok, "adu"))
+			latency = &fake_latency.adu;
+		else if (!strcmp(tok, "ram"))
+			latency = &fake_latency.ram;
+		else if (!strcmp(tok, "stop"))
+			latency = &fake_latency.stop;
+		else if (!strcmp(tok, "start"))
+			latency = &fake_latency.start;
+		else if (!strcmp(tok, "istep"))
+			latency = &fake_latency.istep;
+		else {
+			PR_ERROR("Unknown fake latency '%s'\n", tok);
+			continue;
+		}
+
+		*latency = strtoull(value, NULL, 0) * 1000;
+	}
+
+	free(str);
+}
+
+static const struct fake_latency *fake_get_latency(void)
+{
+	if (!fake_latency_parsed)
+		fake_parse_latency();
+
+	return &fake_latency;
+}
+
+static void fake_delay(uint64_t ns)
+{
+	struct timespec ts;
+	uint64_t end;
+
+	if (!ns)
+		return;
+
+	/* Sleeping is too coarse for short delays */
+	if (ns < 100000) {
+		end = fake_now() + ns;
+		while (fake_now() < end)
+			;
+		return;
+	}
+
+	ts.tv_sec = ns / 1000000000ULL;
+	ts.tv_nsec = ns % 1000000000ULL;
+	while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+		;
+}
+
+static struct fake_map_entry *fake_map_slot(const struct fake_map *map, uint64_t key)
+{
+	uint64_t hash = key;
+	size_t i;
+
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+
+	i = hash & (map->size - 1);
+	while (map->entry[i].used && map->entry[i].key != key)
+		i = (i + 1) & (map->size - 1);
+
+	return &map->entry[i];
+}
+
+static int fake_map_grow(struct fake_map *map)
+{
+	struct fake_map old = *map;
+	size_t i;
+
+	map->size = old.size ? old.size * 2 : 64;
+	map->entry = calloc(map->size, sizeof(*map->entry));
+	if (!map->entry) {
+		*map = old;
+		return -1;
+	}
+
+	for (i = 0; i < old.size; i++) {
+		if (old.entry[i].used)
+			*fake_map_slot(map, old.entry[i].key) = old.entry[i];
+	}
+	free(old.entry);
+
+	return 0;
+}
+
+static bool fake_map_get(const struct fake_map *map, uint64_t key, uint64_t *value)
+{
+	struct fake_map_entry *entry;
+
+	if (!map->count)
+		return false;
+
+	entry = fake_map_slot(map, key);
+	if (!entry->used)
+		return false;
+
+	*value = entry->value;
+	return true;
+}
+
+static int fake_map_set(struct fake_map *map, uint64_t key, uint64_t value)
+{
+	struct fake_map_entry *entry;
+
+	/* Keep the map at most half full */
+	if (2 * (map->count + 1) > map->size && fake_map_grow(map))
+		return -1;
+
+	entry = fake_map_slot(map, key);
+	if (!entry->used) {
+		entry->used = true;
+		entry->key = key;
+		map->count++;
+	}
+	entry->value = value;
+
+	return 0;
+}
+
+static void fake_map_free(struct fake_map *map)
+{
+	free(map->entry);
+	memset(map, 0, sizeof(*map));
+}
+
+static uint64_t fake_memory_read(uint64_t addr)
+{
+	uint64_t value = 0;
+
+	fake_map_get(&fake_memory, addr & ~7ULL, &value);
+	return value;
+}
+
+/* Write size bytes from the matching position of the doubleword data */
+static int fake_memory_write(uint64_t addr, uint64_t data, int size)
+{
+	int offset = addr & 7;
+	uint64_t mask;
+
+	if (size <= 0 || size > 8 - offset)
+		size = 8 - offset;
+
+	mask = size == 8 ? ~0ULL : ((1ULL << (size * 8)) - 1) << ((8 - offset - size) * 8);
+	data = (fake_memory_read(addr) & ~mask) | (data & mask);
+
+	return fake_map_set(&fake_memory, addr & ~7ULL, data);
+}
+
+static void fake_put(void)
+{
+	if (!fake_users || --fake_users)
+		return;
+
+	fake_map_free(&fake_memory);
+	fake_map_free(&fake_cfam);
+}
+
+static struct fake_chip *fake_chip(struct pib *pib)
+{
+	if (!pib->priv) {
+		pib->priv = calloc(1, sizeof(struct fake_chip));
+		if (pib->priv)
+			fake_users++;
+	}
+
+	return pib->priv;
+}
+
+static struct fake_cpu *fake_chip_cpu(struct fake_chip *chip, uint64_t base, int id)
+{
+	struct fake_cpu *cpu, **tmp;
+	int i;
+
+	for (i = 0; i < chip->nr_cpus; i++) {
+		cpu = chip->cpu[i];
+		if (cpu->base == base && cpu->id == id)
+			return cpu;
+	}
+
+	tmp = realloc(chip->cpu, (chip->nr_cpus + 1) * sizeof(*tmp));
+	if (!tmp)
+		return NULL;
+	chip->cpu = tmp;
+
+	cpu = calloc(1, sizeof(*cpu));
+	if (!cpu)
+		return NULL;
+
+	cpu->base = base;
+	cpu->id = id;
+	cpu->msr = FAKE_RESET_MSR;
+	cpu->nia = FAKE_RESET_NIA;
+	chip->cpu[chip->nr_cpus++] = cpu;
+
+	return cpu;
+}
+
+static void fake_cpu_update(struct fake_cpu *cpu, uint64_t now)
+{
+	if (cpu->quiesced != cpu->next_quiesced && now >= cpu->ready_ns)
+		cpu->quiesced = cpu->next_quiesced;
+}
+
+static void fake_cpu_control(struct fake_cpu *cpu, uint64_t value)
+{
+	const struct fake_latency *latency = fake_get_latency();
+	uint64_t now = fake_now();
+	bool stopped;
+
+	fake_cpu_update(cpu, now);
+	stopped = cpu->quiesced && cpu->next_quiesced && !cpu->ram_mode;
+
+	if (value & FAKE_CTRL_STOP) {
+		cpu->next_quiesced = true;
+		cpu->ready_ns = now + latency->stop;
+	}
+
+	if ((value & FAKE_CTRL_STEP) && stopped)
+		cpu->nia += 4;
+
+	if ((value & FAKE_CTRL_SRESET) && stopped) {
+		cpu->nia = FAKE_RESET_NIA;
+		cpu->msr = FAKE_RESET_MSR;
+		value |= FAKE_CTRL_START;
+	}
+
+	if ((value & FAKE_CTRL_START) && stopped) {
+		cpu->next_quiesced = false;
+		cpu->ready_ns = now + latency->start;
+	}
+
+	if ((value & FAKE_CTRL_RAM_ENTER) && cpu->quiesced)
+		cpu->ram_mode = true;
+
+	if (value & FAKE_CTRL_RAM_EXIT)
+		cpu->ram_mode = false;
+}
+
+static uint64_t fake_cpu_status(struct fake_cpu *cpu)
+{
+	uint64_t value = FAKE_STATUS_ACTIVE;
+
+	fake_cpu_update(cpu, fake_now());
+
+	if (cpu->quiesced)
+		value |= FAKE_STATUS_QUIESCED;
+	if (cpu->ram_mode)
+		value |= FAKE_STATUS_RAM_MODE;
+
+	return value;
+}
+
+/* Returns non-zero if the instruction raised an exception */
+static int fake_cpu_execute(struct fake_cpu *cpu, uint32_t opcode)
+{
+	int rt = (opcode >> 21) & 0x1f;
+	int ra = (opcode >> 16) & 0x1f;
+	uint64_t mask = 0, ea;
+	int i, spr;
+
+	/* ld */
+	if ((opcode >> 26) == 58 && (opcode & 3) == 0) {
+		ea = (int16_t)(opcode & 0xfffc);
+		if (ra)
+			ea += cpu->gpr[ra];
+		if (ea & 7)
+			return 1;
+
+		cpu->gpr[rt] = fake_memory_read(ea);
+		return 0;
+	}
+
+	/* CR fields for mfocrf/mtocrf in the same order as ram_getcr() */
+	for (i = 0; i < 8; i++) {
+		if (opcode & (1 << (12 + i)))
+			mask |= 0xfULL << (4 * i);
+	}
+
+	switch (opcode & OPCODE_MASK) {
+	case MFNIA_OPCODE:
+		cpu->gpr[rt] = cpu->nia;
+		break;
+
+	case MTNIA_OPCODE:
+		cpu->nia = cpu->gpr[rt];
+		break;
+
+	case MFMSR_OPCODE:
+		cpu->gpr[rt] = cpu->msr;
+		break;
+
+	case MTMSR_OPCODE:
+		cpu->msr = cpu->gpr[rt];
+		break;
+
+	case MFSPR_OPCODE:
+		spr = MXSPR_SPR(opcode);
+		cpu->gpr[rt] = spr == FAKE_SPR_SCRATCH ? cpu->scratch : cpu->spr[spr];
+		break;
+
+	case MTSPR_OPCODE:
+		spr = MXSPR_SPR(opcode);
+		if (spr == FAKE_SPR_SCRATCH)
+			cpu->scratch = cpu->gpr[rt];
+		else
+			cpu->spr[spr] = cpu->gpr[rt];
+		break;
+
+	case MFOCRF_OPCODE & OPCODE_MASK:
+		cpu->gpr[rt] = cpu->cr & mask;
+		break;
+
+	case MTOCRF_OPCODE & OPCODE_MASK:
+		cpu->cr = (cpu->cr & ~mask) | (cpu->gpr[rt] & mask);
+		break;
+
+	default:
+		return 1;
+	}
+
+	return 0;
+}
+
+static void fake_cpu_ram(struct fake_cpu *cpu, uint64_t opcode)
+{
+	uint64_t now = fake_now();
+
+	fake_cpu_update(cpu, now);
+
+	if (!cpu->ram_mode || !cpu->quiesced)
+		cpu->ram_status = FAKE_RAM_ERROR;
+	else if (fake_cpu_execute(cpu, opcode))
+		cpu->ram_status = FAKE_RAM_EXCEPTION;
+	else
+		cpu->ram_status = FAKE_RAM_DONE;
+
+	cpu->ram_ready_ns = now + fake_get_latency()->ram;
+}
+
+static int fake_core_read(struct fake_chip *chip, uint64_t addr, uint64_t *value)
+{
+	uint64_t reg = addr & FAKE_CORE_REG_MASK;
+	struct fake_cpu *cpu;
+
+	cpu = fake_chip_cpu(chip, addr & ~FAKE_CORE_REG_MASK, reg % FAKE_MAX_THREADS);
+	if (!cpu)
+		return -1;
+
+	switch (reg & ~(FAKE_MAX_THREADS - 1)) {
+	case FAKE_THREAD_STATUS:
+		*value = fake_cpu_status(cpu);
+		break;
+
+	case FAKE_THREAD_RAM:
+		*value = fake_now() < cpu->ram_ready_ns ? 0 : cpu->ram_status;
+		break;
+
+	case FAKE_THREAD_SCR0:
+		*value = cpu->scratch;
+		break;
+
+	default:
+		*value = 0;
+		break;
+	}
+
+	return 0;
+}
+
+static int fake_core_write(struct fake_chip *chip, uint64_t addr, uint64_t value)
+{
+	uint64_t reg = addr & FAKE_CORE_REG_MASK;
+	struct fake_cpu *cpu;
+
+	cpu = fake_chip_cpu(chip, addr & ~FAKE_CORE_REG_MASK, reg % FAKE_MAX_THREADS);
+	if (!cpu)
+		return -1;
+
+	switch (reg & ~(FAKE_MAX_THREADS - 1)) {
+	case FAKE_THREAD_CTRL:
+		fake_cpu_control(cpu, value);
+		break;
+
+	case FAKE_THREAD_RAM:
+		fake_cpu_ram(cpu, value);
+		break;
+
+	case FAKE_THREAD_SCR0:
+		cpu->scratch = value;
+		break;
+	}
+
+	return 0;
+}
+
+static int fake_adu_start(struct fake_adu *adu, uint64_t cmd)
+{
+	uint64_t addr = GETFIELD(FAKE_ADU_ADDRESS, adu->control);
+	uint64_t tsize = GETFIELD(FAKE_ADU_TSIZE, cmd);
+	int size;
+
+	if ((addr & ~7ULL) == FAKE_MEM_ERROR)
+		return -1;
+
+	if (cmd & FAKE_ADU_TREAD) {
+		/* Reads always return the whole doubleword */
+		adu->data = fake_memory_read(addr);
+	} else {
+		/* Cache inhibited writes encode the size as a power of two */
+		if (GETFIELD(FAKE_ADU_TTYPE, cmd) == FAKE_ADU_CI_WRITE && tsize >= 2)
+			size = 1 << ((tsize >> 1) - 1);
+		else
+			size = tsize >> 1;
+
+		if (fake_memory_write(addr, adu->data, size))
+			return -1;
+	}
+
+	adu->status = FAKE_ADU_ADDR_DONE | FAKE_ADU_DATA_DONE;
+	adu->ready_ns = fake_now() + fake_get_latency()->adu;
+
+	return 0;
+}
+
+static int fake_adu_read(struct fake_adu *adu, uint64_t reg, uint64_t *value)
+{
+	switch (reg) {
+	case FAKE_ADU_CONTROL:
+		*value = adu->control;
+		break;
+
+	case FAKE_ADU_CMD:
+		*value = adu->cmd;
+		break;
+
+	case FAKE_ADU_STATUS:
+		*value = fake_now() < adu->ready_ns ? 0 : adu->status;
+		break;
+
+	case FAKE_ADU_DATA:
+		*value = adu->data;
+		break;
+
+	default:
+		*value = 0;
+		break;
+	}
+
+	return 0;
+}
+
+static int fake_adu_write(struct fake_adu *adu, uint64_t reg, uint64_t value)
+{
+	switch (reg) {
+	case FAKE_ADU_CONTROL:
+		adu->control = value;
+		break;
+
+	case FAKE_ADU_CMD:
+		adu->cmd = value & ~(FAKE_ADU_START_OP | FAKE_ADU_CLEAR_STATUS | FAKE_ADU_RESET);
+		if (value & (FAKE_ADU_CLEAR_STATUS | FAKE_ADU_RESET))
+			adu->status = 0;
+		if (value & FAKE_ADU_START_OP)
+			return fake_adu_start(adu, value);
+		break;
+
+	case FAKE_ADU_DATA:
+		adu->data = value;
+		break;
+	}
+
+	return 0;
+}
 
 static struct proc fake_proc = {
 	.target = {
@@ -29,24 +718,67 @@ static struct proc fake_proc = {
 };
 DECLARE_HW_UNIT(fake_proc);
 
+static uint64_t fake_cfam_key(struct fsi *fsi, uint32_t addr)
+{
+	return ((uint64_t)pdbg_target_index(&fsi->target) << 32) | addr;
+}
+
 static int fake_fsi_read(struct fsi *fsi, uint32_t addr, uint32_t *value)
 {
-	*value = 0xfeed0cfa;
+	uint64_t data;
+
+	fake_delay(fake_get_latency()->fsi);
+
+	if (fake_map_get(&fake_cfam, fake_cfam_key(fsi, addr), &data))
+		*value = data;
+	else
+		*value = FAKE_FSI_DEFAULT;
+
 	PR_DEBUG("fake_fsi_read(0x%04" PRIx32 ", 0x%04" PRIx32 ")\n", addr, *value);
 	return 0;
 }
 
 static int fake_fsi_write(struct fsi *fsi, uint32_t addr, uint32_t value)
 {
+	fake_delay(fake_get_latency()->fsi);
+
 	PR_DEBUG("fake_fsi_write(0x%04" PRIx32 ", 0x%04" PRIx32 ")\n", addr, value);
+	return fake_map_set(&fake_cfam, fake_cfam_key(fsi, addr), value);
+}
+
+static int fake_fsi_probe(struct pdbg_target *target)
+{
+	const char *env = getenv("PDBG_FAKE_OFFLINE");
+	char *end;
+	long index;
+
+	while (env && *env) {
+		index = strtol(env, &end, 0);
+		if (end == env)
+			break;
+
+		if (index == pdbg_target_index(target))
+			return -1;
+
+		env = *end == ',' ? end + 1 : end;
+	}
+
+	fake_users++;
 	return 0;
 }
 
+static void fake_fsi_release(struct pdbg_target *target)
+{
+	fake_put();
+}
+
 static struct fsi fake_fsi = {
 	.target = {
 		.name =	"Fake FSI",
 		.compatible = "ibm,fake-fsi",
 		.class = "fsi",
+		.probe = fake_fsi_probe,
+		.release = fake_fsi_release,
 	},
 	.read = fake_fsi_read,
 	.write = fake_fsi_write,
@@ -55,25 +787,201 @@ DECLARE_HW_UNIT(fake_fsi);
 
 static int fake_pib_read(struct pib *pib, uint64_t addr, uint64_t *value)
 {
-	*value = 0xdeadbeef;
+	struct fake_chip *chip = fake_chip(pib);
+	int rc = 0;
+
+	fake_delay(fake_get_latency()->pib);
+
+	if (!chip || addr == FAKE_PIB_ERROR)
+		return -1;
+
+	if (addr >= FAKE_CORE_BASE && addr < FAKE_CORE_END)
+		rc = fake_core_read(chip, addr, value);
+	else if (addr >= FAKE_ADU_BASE && addr <= FAKE_ADU_BASE + FAKE_ADU_DATA)
+		rc = fake_adu_read(&chip->adu, addr - FAKE_ADU_BASE, value);
+	else if (!fake_map_get(&chip->regs, addr, value))
+		*value = FAKE_PIB_DEFAULT;
+
 	PR_DEBUG("fake_pib_read(0x%08" PRIx64 ", 0x%08" PRIx64 ")\n", addr, *value);
-	return 0;
+	return rc;
 }
 
 static int fake_pib_write(struct pib *pib, uint64_t addr, uint64_t value)
 {
+	struct fake_chip *chip = fake_chip(pib);
+
+	fake_delay(fake_get_latency()->pib);
+
 	PR_DEBUG("fake_pib_write(0x%08" PRIx64 ", 0x%08" PRIx64 ")\n", addr, value);
+
+	if (!chip || addr == FAKE_PIB_ERROR)
+		return -1;
+
+	if (addr >= FAKE_CORE_BASE && addr < FAKE_CORE_END)
+		return fake_core_write(chip, addr, value);
+	else if (addr >= FAKE_ADU_BASE && addr <= FAKE_ADU_BASE + FAKE_ADU_DATA)
+		return fake_adu_write(&chip->adu, addr - FAKE_ADU_BASE, value);
+
+	return fake_map_set(&chip->regs, addr, value);
+}
+
+static int fake_pib_read_list(struct pib *pib, const uint64_t *addr, uint64_t *value, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (fake_pib_read(pib, addr[i], &value[i]))
+			break;
+	}
+
+	return i;
+}
+
+static void fake_pib_release(struct pdbg_target *target)
+{
+	struct pib *pib = target_to_pib(target);
+	struct fake_chip *chip = pib->priv;
+	int i;
+
+	if (!chip)
+		return;
+
+	for (i = 0; i < chip->nr_cpus; i++)
+		free(chip->cpu[i]);
+	free(chip->cpu);
+	fake_map_free(&chip->regs);
+	free(chip);
+	pib->priv = NULL;
+	fake_put();
+}
+
+static bool fake_istep_fails(uint32_t major, uint32_t minor)
+{
+	const char *env = getenv("PDBG_FAKE_ISTEP_FAIL");
+	unsigned int fail_major, fail_minor;
+
+	if (!env || sscanf(env, "%u.%u", &fail_major, &fail_minor) != 2)
+		return false;
+
+	return major == fail_major && minor == fail_minor;
+}
+
+/* Answers chip-ops the way the SBE does, with the status (and FFDC on
+ * failure) after the reply data */
+static int fake_sbefifo_transport(uint8_t *msg, uint32_t msg_len,
+				  uint8_t *out, uint32_t *out_len, void *priv)
+{
+	uint32_t reply[FAKE_SBE_MAX_REPLY];
+	uint32_t cmd, step, status = 0;
+	int n = 0;
+
+	if (msg_len < 8)
+		return EPROTO;
+
+	memcpy(&cmd, msg + 4, sizeof(cmd));
+	cmd = be32toh(cmd);
+
+	if (cmd == FAKE_SBE_CMD_ISTEP && msg_len >= 12) {
+		memcpy(&step, msg + 8, sizeof(step));
+		step = be32toh(step);
+
+		fake_delay(fake_get_latency()->istep);
+		if (fake_istep_fails(step >> 16, step & 0xffff))
+			status = SBEFIFO_PRI_INTERNAL_ERROR | SBEFIFO_SEC_GENERIC_FAILURE;
+	} else {
+		status = SBEFIFO_PRI_INVALID_COMMAND | SBEFIFO_SEC_INVALID_CMD;
+	}
+
+	reply[n++] = htobe32(0xc0de0000 | cmd);
+	reply[n++] = htobe32(status);
+	if (status) {
+		reply[n++] = htobe32(0xffdc0002);
+		reply[n++] = htobe32(cmd);
+	}
+
+	/* Distance from the end back to the status header, in words */
+	reply[n] = htobe32(n + 1);
+	n++;
+
+	if (*out_len < n * sizeof(uint32_t))
+		return EPROTO;
+
+	memcpy(out, reply, n * sizeof(uint32_t));
+	*out_len = n * sizeof(uint32_t);
+
 	return 0;
 }
 
+static struct sbefifo_context *fake_sbefifo_context(struct sbefifo *sbefifo)
+{
+	return sbefifo->sf_ctx;
+}
+
+static int fake_sbefifo_probe(struct pdbg_target *target)
+{
+	struct sbefifo *sf = target_to_sbefifo(target);
+
+	if (sbefifo_connect_transport(SBEFIFO_PROC_P10, fake_sbefifo_transport, sf, &sf->sf_ctx))
+		return -1;
+
+	stats_sbefifo_attach(sf->sf_ctx, target);
+	trace_sbefifo_attach(sf->sf_ctx, target);
+
+	return 0;
+}
+
+static void fake_sbefifo_release(struct pdbg_target *target)
+{
+	struct sbefifo *sf = target_to_sbefifo(target);
+
+	sbefifo_disconnect(sf->sf_ctx);
+	sf->sf_ctx = NULL;
+}
+
+static struct sbefifo fake_sbefifo = {
+	.target = {
+		.name =	"Fake SBE FIFO",
+		.compatible = "ibm,fake-sbefifo",
+		.class = "sbefifo_transport",
+		.probe = fake_sbefifo_probe,
+		.release = fake_sbefifo_release,
+	},
+	.get_sbefifo_context = fake_sbefifo_context,
+};
+DECLARE_HW_UNIT(fake_sbefifo);
+
+/* Reads the registers of several threads of a processor in one go, as
+ * the SBE FIFO does */
+static int fake_pib_thread_getregs_all(struct pib *pib, struct thread **threads,
+				       struct thread_regs **regs, int *rc,
+				       int count)
+{
+	int i, ret = 0;
+
+	for (i = 0; i < count; i++) {
+		if (target_class_parent(TARGET_CLASS("pib"), &threads[i]->target, true) != &pib->target)
+			rc[i] = -1;
+		else
+			rc[i] = threads[i]->getregs(threads[i], regs[i]);
+
+		if (rc[i])
+			ret = -1;
+	}
+
+	return ret;
+}
+
 static struct pib fake_pib = {
 	.target = {
 		.name =	"Fake PIB",
 		.compatible = "ibm,fake-pib",
 		.class = "pib",
+		.release = fake_pib_release,
 	},
 	.read = fake_pib_read,
 	.write = fake_pib_write,
+	.read_list = fake_pib_read_list,
+	.thread_getregs_all = fake_pib_thread_getregs_all,
 	.fd = -1,
 };
 DECLARE_HW_UNIT(fake_pib);
@@ -87,12 +995,245 @@ static struct core fake_core = {
 };
 DECLARE_HW_UNIT(fake_core);
 
+static int fake_thread_read(struct thread *thread, uint64_t reg, uint64_t *value)
+{
+	struct pdbg_target *core = require_target_class_parent(TARGET_CLASS("core"), &thread->target, true);
+
+	return pib_read(core, reg + thread->id, value);
+}
+
+static int fake_thread_write(struct thread *thread, uint64_t reg, uint64_t value)
+{
+	struct pdbg_target *core = require_target_class_parent(TARGET_CLASS("core"), &thread->target, true);
+
+	return pib_write(core, reg + thread->id, value);
+}
+
+static struct thread_state fake_thread_state(struct thread *thread)
+{
+	struct thread_state thread_state;
+	uint64_t value;
+
+	memset(&thread_state, 0, sizeof(thread_state));
+	if (fake_thread_read(thread, FAKE_THREAD_STATUS, &value))
+		return thread_state;
+
+	thread_state.quiesced = !!(value & FAKE_STATUS_QUIESCED);
+	thread_state.active = !!(value & FAKE_STATUS_ACTIVE);
+	thread_state.sleep_state = PDBG_THREAD_STATE_RUN;
+	thread_state.smt_state = PDBG_SMT_UNKNOWN;
+
+	return thread_state;
+}
+
+static int fake_thread_probe(struct pdbg_target *target)
+{
+	struct thread *thread = target_to_thread(target);
+
+	thread->id = pdbg_target_index(target);
+	if (thread->id < 0 || thread->id >= FAKE_MAX_THREADS)
+		return -1;
+
+	thread->status = thread->state(thread);
+
+	return 0;
+}
+
+static int fake_thread_quiesced(void *priv)
+{
+	struct thread *thread = priv;
+
+	thread->status = thread->state(thread);
+	return thread->status.quiesced;
+}
+
+static int fake_thread_running(void *priv)
+{
+	struct thread *thread = priv;
+
+	thread->status = thread->state(thread);
+	return !thread->status.quiesced;
+}
+
+static int fake_thread_stop_request(struct thread *thread)
+{
+	return fake_thread_write(thread, FAKE_THREAD_CTRL, FAKE_CTRL_STOP);
+}
+
+static int fake_thread_stop(struct thread *thread)
+{
+	CHECK_ERR(fake_thread_stop_request(thread));
+	if (poll_until_cancellable(fake_thread_quiesced, thread, FAKE_THREAD_TIMEOUT_US,
+				   &poll_backoff_slow)) {
+		PR_ERROR("Unable to quiesce thread\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+static int fake_thread_start_running(struct thread *thread, uint64_t ctrl)
+{
+	/* Can only start or sreset a thread if it is quiesced */
+	if (!(thread->status.quiesced))
+		return 1;
+
+	CHECK_ERR(fake_thread_write(thread, FAKE_THREAD_CTRL, ctrl));
+	if (poll_until(fake_thread_running, thread, FAKE_THREAD_TIMEOUT_US, &poll_backoff_slow)) {
+		PR_ERROR("Unable to start thread\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+static int fake_thread_start(struct thread *thread)
+{
+	return fake_thread_start_running(thread, FAKE_CTRL_START);
+}
+
+static int fake_thread_sreset(struct thread *thread)
+{
+	return fake_thread_start_running(thread, FAKE_CTRL_SRESET);
+}
+
+static int fake_thread_step(struct thread *thread, int count)
+{
+	int i;
+
+	/* Can only step if a thread is quiesced */
+	if (!(thread->status.quiesced))
+		return 1;
+
+	for (i = 0; i < count; i++)
+		CHECK_ERR(fake_thread_write(thread, FAKE_THREAD_CTRL, FAKE_CTRL_STEP));
+
+	return 0;
+}
+
+static int fake_ram_setup(struct thread *thread)
+{
+	struct pdbg_target *core = require_target_class_parent(TARGET_CLASS("core"), &thread->target, true);
+	struct pdbg_target *target;
+
+	if (thread->ram_is_setup)
+		return 1;
+
+	/* We can only ram a thread if all the threads on the core are
+	 * quiesced */
+	pdbg_for_each_target("thread", core, target) {
+		if (pdbg_target_probe(target) != PDBG_TARGET_ENABLED)
+			return 1;
+
+		if (!(target_to_thread(target)->status.quiesced))
+			return 1;
+	}
+
+	CHECK_ERR(fake_thread_write(thread, FAKE_THREAD_CTRL, FAKE_CTRL_RAM_ENTER));
+	thread->ram_is_setup = true;
+
+	return 0;
+}
+
+struct fake_ram_poll {
+	struct thread *thread;
+	uint64_t status;
+};
+
+static int fake_ram_done(void *priv)
+{
+	struct fake_ram_poll *poll = priv;
+
+	if (fake_thread_read(poll->thread, FAKE_THREAD_RAM, &poll->status))
+		return -1;
+
+	return poll->status != 0;
+}
+
+static int fake_ram_instruction(struct thread *thread, uint64_t opcode, uint64_t *scratch)
+{
+	struct fake_ram_poll poll = {
+		.thread = thread,
+	};
+
+	if (!thread->ram_is_setup)
+		return 1;
+
+	CHECK_ERR(fake_thread_write(thread, FAKE_THREAD_SCR0, *scratch));
+	CHECK_ERR(fake_thread_write(thread, FAKE_THREAD_RAM, opcode));
+
+	if (poll_until(fake_ram_done, &poll, FAKE_RAM_TIMEOUT_US, &poll_backoff_fast)) {
+		PR_ERROR("Timeout RAMing opcode=%" PRIx64 "\n", opcode);
+		return 1;
+	}
+
+	if (!(poll.status & FAKE_RAM_DONE)) {
+		PR_ERROR("Error RAMing opcode=%" PRIx64 " (status=%" PRIx64 ")\n",
+			 opcode, poll.status);
+		return 1;
+	}
+
+	CHECK_ERR(fake_thread_read(thread, FAKE_THREAD_SCR0, scratch));
+
+	return 0;
+}
+
+static int fake_ram_destroy(struct thread *thread)
+{
+	if (!thread->ram_is_setup)
+		return 1;
+
+	CHECK_ERR(fake_thread_write(thread, FAKE_THREAD_CTRL, FAKE_CTRL_RAM_EXIT));
+	thread->ram_is_setup = false;
+
+	return 0;
+}
+
+static int fake_ram_getxer(struct thread *thread, uint64_t *value)
+{
+	CHECK_ERR(ram_getspr(thread, SPR_XER, value));
+
+	return 0;
+}
+
+static int fake_ram_putxer(struct thread *thread, uint64_t value)
+{
+	CHECK_ERR(ram_putspr(thread, SPR_XER, value));
+
+	return 0;
+}
+
 static struct thread fake_thread = {
 	.target = {
 		.name =	"Fake Thread",
 		.compatible = "ibm,fake-thread",
 		.class = "thread",
+		.probe = fake_thread_probe,
 	},
+	.state = fake_thread_state,
+	.start = fake_thread_start,
+	.stop = fake_thread_stop,
+	.stop_request = fake_thread_stop_request,
+	.quiesced = fake_thread_quiesced,
+	.step = fake_thread_step,
+	.sreset = fake_thread_sreset,
+	.ram_setup = fake_ram_setup,
+	.ram_instruction = fake_ram_instruction,
+	.ram_destroy = fake_ram_destroy,
+	.getmem = ram_getmem,
+	.getregs = ram_getregs,
+	.getgpr = ram_getgpr,
+	.putgpr = ram_putgpr,
+	.getspr = ram_getspr,
+	.putspr = ram_putspr,
+	.getmsr = ram_getmsr,
+	.putmsr = ram_putmsr,
+	.getnia = ram_getnia,
+	.putnia = ram_putnia,
+	.getxer = fake_ram_getxer,
+	.putxer = fake_ram_putxer,
+	.getcr = ram_getcr,
+	.putcr = ram_putcr,
 };
 DECLARE_HW_UNIT(fake_thread);
 
@@ -102,6 +1243,7 @@ static void register_fake(void)
 	pdbg_hwunit_register(PDBG_DEFAULT_BACKEND, &fake_proc_hw_unit);
 	pdbg_hwunit_register(PDBG_DEFAULT_BACKEND, &fake_fsi_hw_unit);
 	pdbg_hwunit_register(PDBG_DEFAULT_BACKEND, &fake_pib_hw_unit);
+	pdbg_hwunit_register(PDBG_DEFAULT_BACKEND, &fake_sbefifo_hw_unit);
 	pdbg_hwunit_register(PDBG_DEFAULT_BACKEND, &fake_core_hw_unit);
 	pdbg_hwunit_register(PDBG_DEFAULT_BACKEND, &fake_thread_hw_unit);
 }
@@ -66,6 +66,34 @@ static int xscom_read(struct pib *pib, uint64_t addr, uint64_t *val)
 	return 0;
 }
 
+/*
+ * The debugfs access file maps SCOM addresses linearly, so a run of
+ * consecutive registers can be read with a single pread(). The kernel
+ * stops at the first register which fails and returns what it read up
+ * to there, so the caller only has to read the rest individually.
+ */
+static int xscom_read_list(struct pib *pib, const uint64_t *addr, uint64_t *val, int count)
+{
+	uint64_t start;
+	ssize_t rc, len;
+	int i, n;
+
+	for (i = 0; i < count; i += n) {
+		start = xscom_mangle_addr(addr[i]);
+		for (n = 1; i + n < count; n++) {
+			if (xscom_mangle_addr(addr[i + n]) != start + 8 * n)
+				break;
+		}
+
+		len = 8 * n;
+		rc = pread64(pib->fd, &val[i], len, start);
+		if (rc != len)
+			return i + (rc > 0 ? rc / 8 : 0);
+	}
+
+	return count;
+}
+
 static int xscom_write(struct pib *pib, uint64_t addr, uint64_t val)
 {
 	int rc;
@@ -120,6 +148,7 @@ static struct pib host_pib = {
 	},
 	.read = xscom_read,
 	.write = xscom_write,
+	.read_list = xscom_read_list,
 	.fd = -1,
 };
 DECLARE_HW_UNIT(host_pib);
@@ -27,8 +27,10 @@
 
 #include "operations.h"
 #include "bitutils.h"
+#include "regfield.h"
 #include "hwunit.h"
 #include "debug.h"
+#include "poll.h"
 
 #define HTM_ERR(x) ({int rc = (x); if (rc) {PR_ERROR("HTM Error %d %s:%d\n", \
 			rc, __FILE__, __LINE__);} \
@@ -100,7 +102,7 @@
 #define   HTM_MEM_SIZE_SMALL_P10	PPC_BIT(5)
 #define   HTM_MEM_BASE			PPC_BITMASK(14,39)
 #define   HTM_MEM_BASE_P10		PPC_BITMASK(8,39)
-#define	  HTM_MEM_SIZE			PPC_BITMASK(40,48)
+#define	  HTM_MEM_SIZE			REG_FIELD(40, 48)
 #define HTM_STATUS			2
 #define   HTM2_STATUS_MASK		PPC_BITMASK(22,39)
 #define   HTM2_STATUS_CRESP_OV		PPC_BIT(22)
@@ -251,8 +253,8 @@ struct htm_status {
 
 static struct htm *check_and_convert(struct pdbg_target *target)
 {
-	if (!pdbg_target_is_class(target, "nhtm") &&
-	    !pdbg_target_is_class(target, "chtm"))
+	if (!target_is_class(target, TARGET_CLASS("nhtm")) &&
+	    !target_is_class(target, TARGET_CLASS("chtm")))
 	    return NULL;
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
@@ -488,7 +490,7 @@ static int get_status(struct htm *htm, struct htm_status *status)
 		status->mem_size_select = val & HTM_MEM_SIZE_SMALL;
 		status->mem_base = val & HTM_MEM_BASE;
 	}
-	status->mem_size = GETFIELD(HTM_MEM_SIZE,val);
+	status->mem_size = field_get(HTM_MEM_SIZE, val);
 
 	if (HTM_ERR(pib_read(&htm->target, HTM_LAST_ADDRESS, &status->mem_last)))
 		return -1;
@@ -620,7 +622,7 @@ static int configure_chtm(struct htm *htm, bool wrap)
 {
 	uint64_t val;
 
-	if (!pdbg_target_is_class(&htm->target, "chtm"))
+	if (!target_is_class(&htm->target, TARGET_CLASS("chtm")))
 		return 0;
 
 	if (HTM_ERR(configure_debugfs_memtrace(htm)))
@@ -645,7 +647,7 @@ static int do_configure_chtm_p10(struct htm *htm)
 
 	/* P10 only: mask PC Logic checkstop in wrapping mode */
 	if (pdbg_target_compatible(&htm->target, "ibm,power10-chtm")) {
-		core = pdbg_target_require_parent("core", &htm->target);
+		core = require_target_class_parent(TARGET_CLASS("core"), &htm->target, true);
 		if (HTM_ERR(pib_read(core, CORE_FIR_MASK, &mask)))
 			return -1;
 		if (HTM_ERR(pib_write(core, CORE_FIR_MASK, mask | CORE_FIR_PC_LOGIC)))
@@ -659,7 +661,7 @@ static int do_configure_chtm_p8(struct htm *htm)
 	uint64_t hid0, ncu;
 	struct pdbg_target *core;
 
-	core = pdbg_target_require_parent("core", &htm->target);
+	core = require_target_class_parent(TARGET_CLASS("core"), &htm->target, true);
 	if (HTM_ERR(pib_read(core, HID0_REGISTER, &hid0)))
 		return -1;
 	hid0 |= HID0_TRACE_BITS;
@@ -678,7 +680,7 @@ static int do_configure_chtm_p8(struct htm *htm)
 static int deconfigure_chtm(struct htm *htm)
 {
 
-	if (!pdbg_target_is_class(&htm->target, "chtm"))
+	if (!target_is_class(&htm->target, TARGET_CLASS("chtm")))
 		return 0;
 
 	if (htm->deconfigure && htm->deconfigure(htm) < 0)
@@ -698,7 +700,7 @@ static int do_deconfigure_chtm_p10(struct htm *htm)
 	struct pdbg_target *core;
 	uint64_t mask;
 
-	core = pdbg_target_require_parent("core", &htm->target);
+	core = require_target_class_parent(TARGET_CLASS("core"), &htm->target, true);
 	/* clear fir first before unmasking it */
 	if (HTM_ERR(pib_write(core, CORE_FIR_AND, ~CORE_FIR_PC_LOGIC)))
 		return -1;
@@ -715,7 +717,7 @@ static int do_deconfigure_chtm_p8(struct htm *htm)
 	struct pdbg_target *core;
 	uint64_t ncu, hid0;
 
-	core = pdbg_target_require_parent("core", &htm->target);
+	core = require_target_class_parent(TARGET_CLASS("core"), &htm->target, true);
 	if (HTM_ERR(pib_read(core, NCU_MODE_REGISTER, &ncu)))
 		return -1;
 	ncu &= ~NCU_MODE_HTM_ENABLE;
@@ -735,7 +737,7 @@ static int configure_nhtm(struct htm *htm, bool wrap)
 {
 	uint64_t val;
 
-	if (!pdbg_target_is_class(&htm->target, "nhtm"))
+	if (!target_is_class(&htm->target, TARGET_CLASS("nhtm")))
 		return 0;
 
 	if (HTM_ERR(configure_debugfs_memtrace(htm)))
@@ -814,7 +816,7 @@ static int configure_nhtm(struct htm *htm, bool wrap)
 
 static int deconfigure_nhtm(struct htm *htm)
 {
-	if (!pdbg_target_is_class(&htm->target, "nhtm"))
+	if (!target_is_class(&htm->target, TARGET_CLASS("nhtm")))
 		return 0;
 	// FIXME: write and test this
 	return 0;
@@ -835,7 +837,7 @@ static char *get_debugfs_file(struct htm *htm, const char *file)
 	uint32_t index;
 	char *filename;
 
-	pib = pdbg_target_parent("pib", &htm->target);
+	pib = target_class_parent(TARGET_CLASS("pib"), &htm->target, true);
 	assert(pib);
 	index = pdbg_target_index(pib);
 	if (asprintf(&filename, "%s/%08x/%s", DEBUGFS_MEMTRACE, index, file) == -1) {
@@ -972,7 +974,7 @@ static int configure_memory(struct htm *htm)
 	if (small)
 		shift = 24;
 	mem_size = (size >> shift) - 1;
-	val = SETFIELD(HTM_MEM_SIZE, val, mem_size);
+	val = field_set(HTM_MEM_SIZE, val, mem_size);
 
 	/*
 	 * Clear out the base
@@ -1026,7 +1028,7 @@ static int do_post_configure_chtm_p8(struct htm *htm)
 
 	/* NHTM doesn't have a core as a parent but donesn't need this
 	 * bit toggled */
-	core = pdbg_target_parent("core", &htm->target);
+	core = target_class_parent(TARGET_CLASS("core"), &htm->target, true);
 	if (!core)
 		return 0; /* nhtm case */
 
@@ -1046,7 +1048,7 @@ static int do_post_configure_chtm_p10(struct htm *htm)
 	struct pdbg_target *core;
 	uint64_t hid0;
 
-	core = pdbg_target_require_parent("core", &htm->target);
+	core = require_target_class_parent(TARGET_CLASS("core"), &htm->target, true);
 	if (HTM_ERR(pib_read(core, HIDQ_REGISTER, &hid0)))
 		return -1;
 	hid0 = HIDQ_ONE_PPC | HIDQ_DIS_PROC_REC | HIDQ_HILE;
@@ -1064,7 +1066,7 @@ static int do_pre_deconfigure_chtm_p10(struct htm *htm)
 	struct pdbg_target *core;
 	uint64_t hid0;
 
-	core = pdbg_target_require_parent("core", &htm->target);
+	core = require_target_class_parent(TARGET_CLASS("core"), &htm->target, true);
 	hid0 = HIDQ_DIS_PROC_REC | HIDQ_HILE;
 	if (HTM_ERR(pib_write(core, HIDQ_REGISTER, hid0)))
 		return -1;
@@ -1072,6 +1074,40 @@ static int do_pre_deconfigure_chtm_p10(struct htm *htm)
 	return 0;
 }
 
+
+#define HTM_START_TIMEOUT_US	1000000
+
+struct htm_state_poll {
+	struct htm *htm;
+	enum htm_state state;
+};
+
+static int htm_state_done(void *priv)
+{
+	struct htm_state_poll *p = priv;
+	struct htm_status status;
+
+	if (HTM_ERR(get_status(p->htm, &status)))
+		return -1;
+
+	return status.state == p->state;
+}
+
+static int htm_wait_state(struct htm *htm, enum htm_state state, unsigned long timeout_us)
+{
+	struct htm_state_poll poll = { .htm = htm, .state = state };
+	int rc;
+
+	rc = poll_until(htm_state_done, &poll, timeout_us, &poll_backoff_fast);
+	if (rc == POLL_TIMEOUT) {
+		PR_ERROR("Timeout waiting for HTM state %d on %s\n",
+			 state, pdbg_target_path(&htm->target));
+		return -1;
+	}
+
+	return rc;
+}
+
 static int __do_htm_start(struct htm *htm, bool wrap)
 {
 	struct htm_status status;
@@ -1094,12 +1130,8 @@ static int __do_htm_start(struct htm *htm, bool wrap)
 	if (HTM_ERR(pib_write(&htm->target, HTM_SCOM_TRIGGER, HTM_TRIG_START)))
 		return -1;
 
-	while (1) {
-		if (HTM_ERR(get_status(htm, &status)))
-			return -1;
-		if (status.state == TRACING)
-			break;
-	}
+	if (htm_wait_state(htm, TRACING, HTM_START_TIMEOUT_US))
+		return -1;
 
 	if (htm->post_configure && htm->post_configure(htm))
 		return -1;
@@ -1174,19 +1206,24 @@ static bool htm_complete(struct htm_status *status)
 	return (status->state == COMPLETE);
 }
 
-static int htm_wait_complete(struct htm *htm)
+static int htm_complete_done(void *priv)
 {
+	struct htm *htm = priv;
 	struct htm_status status;
 
-	while (1) {
-		if (HTM_ERR(get_status(htm, &status)))
-			return -1;
-		PR_DEBUG("loop curr:0x%016" PRIx64 "\n", status.mem_last);
-		if (htm_complete(&status))
-			break;
-		usleep(100000);
-	}
-	return 0;
+	if (HTM_ERR(get_status(htm, &status)))
+		return -1;
+	PR_DEBUG("loop curr:0x%016" PRIx64 "\n", status.mem_last);
+
+	return htm_complete(&status);
+}
+
+/* Recording only completes once the trace buffer is full, which can take
+ * arbitrarily long, so there is no deadline. It can still be cancelled
+ * with pdbg_set_cancel(). */
+static int htm_wait_complete(struct htm *htm)
+{
+	return poll_until_cancellable(htm_complete_done, htm, 0, &poll_backoff_slow);
 }
 
 static int do_htm_status(struct htm *htm)
@@ -1265,6 +1302,7 @@ static int copy_file(int output, int input, uint64_t size)
 {
 	char *buf;
 	size_t r;
+	int rc = -1;
 
 	buf = malloc(COPY_BUF_SIZE);
 	if (!buf) {
@@ -1273,6 +1311,11 @@ static int copy_file(int output, int input, uint64_t size)
 	}
 
 	while (size) {
+		if (pdbg_cancelled()) {
+			PR_NOTICE("HTM dump cancelled\n");
+			goto out;
+		}
+
 		r = read(input, buf, MIN(COPY_BUF_SIZE, size));
 		if (r == -1) {
 			PR_ERROR("Failed to read\n");
@@ -1290,12 +1333,11 @@ static int copy_file(int output, int input, uint64_t size)
 		size -= r;
 	}
 
-	return 0;
+	rc = 0;
 
 out:
 	free(buf);
-	return -1;
-
+	return rc;
 }
 
 static int do_htm_dump(struct htm *htm, char *filename)
@@ -1409,8 +1451,11 @@ static int do_htm_record(struct htm *htm, char *filename)
 	if (__do_htm_start(htm, false) < 0)
 		return -1;
 
-	if (htm_wait_complete(htm))
+	if (htm_wait_complete(htm)) {
+		/* Don't leave the trace running if the wait was cancelled */
+		do_htm_stop(htm);
 		return -1;
+	}
 
 	if (do_htm_stop(htm) < 0)
 		return -1;
@@ -22,31 +22,64 @@
 #define MAX_HW_UNITS	1024
 #define MAX_BACKENDS	16
 
-static const struct hw_unit_info *g_hw_unit[MAX_BACKENDS][MAX_HW_UNITS];
+/* Open addressing hash of compatible string to hw unit, kept at less
+ * than half full so probe sequences stay short */
+#define HW_UNIT_HASH_SIZE	(2 * MAX_HW_UNITS)
+
+static const struct hw_unit_info *g_hw_unit[MAX_BACKENDS][HW_UNIT_HASH_SIZE];
 static int g_hw_unit_count[MAX_BACKENDS];
 
+static inline const char *hw_unit_compatible(const struct hw_unit_info *p)
+{
+	return ((struct pdbg_target *)p->hw_unit)->compatible;
+}
+
+static uint32_t compatible_hash(const char *compat)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*compat) {
+		hash ^= (unsigned char)*compat++;
+		hash *= 16777619u;
+	}
+
+	return hash & (HW_UNIT_HASH_SIZE - 1);
+}
+
 void pdbg_hwunit_register(enum pdbg_backend backend, const struct hw_unit_info *hw_unit)
 {
+	const struct hw_unit_info **slot = g_hw_unit[backend];
+	const char *compat = hw_unit_compatible(hw_unit);
+	uint32_t i;
+
 	assert(g_hw_unit_count[backend] < MAX_HW_UNITS);
 
-	g_hw_unit[backend][g_hw_unit_count[backend]] = hw_unit;
+	/* Intern the class up front so its handle never changes */
+	target_class_intern(((struct pdbg_target *)hw_unit->hw_unit)->class);
+
+	for (i = compatible_hash(compat); slot[i]; i = (i + 1) & (HW_UNIT_HASH_SIZE - 1)) {
+		/* The first unit registered for a compatible string wins */
+		if (!strcmp(hw_unit_compatible(slot[i]), compat))
+			return;
+	}
+
+	slot[i] = hw_unit;
 	g_hw_unit_count[backend]++;
 }
 
 static const struct hw_unit_info *find_driver(enum pdbg_backend backend,
 					      const char *compat)
 {
-	const struct hw_unit_info *p;
-	struct pdbg_target *target;
-	int i;
+	const struct hw_unit_info **slot = g_hw_unit[backend];
+	uint32_t i;
 
-	for (i = 0; i < g_hw_unit_count[backend]; i++) {
-		p = g_hw_unit[backend][i];
-		target = p->hw_unit;
+	if (!g_hw_unit_count[backend])
+		return NULL;
 
-		// XXX: should this be using pdbg_target_compatible?
-		if (!strcmp(target->compatible, compat))
-			return p;
+	// XXX: should this be using pdbg_target_compatible?
+	for (i = compatible_hash(compat); slot[i]; i = (i + 1) & (HW_UNIT_HASH_SIZE - 1)) {
+		if (!strcmp(hw_unit_compatible(slot[i]), compat))
+			return slot[i];
 	}
 
 	return NULL;
@@ -71,9 +71,17 @@ struct mem {
 	int (*putmem)(struct mem *, uint64_t, uint64_t, int, int, uint8_t);
 	int (*read)(struct mem *, uint64_t, uint8_t *, uint64_t, uint8_t, bool);
 	int (*write)(struct mem *, uint64_t, uint8_t *, uint64_t, uint8_t, bool);
+	struct mem_cache *cache;
+
+	/* Reads at or above this real address are never cached. 0 if the
+	 * address map isn't known, in which case nothing is cached. */
+	uint64_t mmio_base;
 };
 #define target_to_mem(x) container_of(x, struct mem, target)
 
+/* POWER9 and POWER10 map MMIO at and above this real address */
+#define P9_MMIO_BASE	0x0006000000000000ULL
+
 struct chipop {
 	struct pdbg_target target;
 	uint32_t (*ffdc_get)(struct chipop *, const uint8_t **, uint32_t *);
@@ -82,6 +90,7 @@ struct chipop {
 	int (*mpipl_continue)(struct chipop *);
 	int (*mpipl_get_ti_info)(struct chipop *, uint8_t **, uint32_t *);
 	int (*dump)(struct chipop *, uint8_t, uint8_t, uint8_t, uint8_t **, uint32_t *);
+	int (*dump_fd)(struct chipop *, uint8_t, uint8_t, uint8_t, int, uint32_t *);
 	int (*lpc_timeout)(struct chipop *, uint32_t *);
 };
 #define target_to_chipop(x) container_of(x, struct chipop, target)
@@ -90,6 +99,7 @@ struct chipop_ody {
 	struct pdbg_target target;
 	uint32_t (*ffdc_get)(struct chipop_ody*, struct pdbg_target*, const uint8_t **, uint32_t *);
 	int (*dump)(struct chipop_ody *, uint8_t, uint8_t, uint8_t, uint8_t **, uint32_t *);
+	int (*dump_fd)(struct chipop_ody *, uint8_t, uint8_t, uint8_t, int, uint32_t *);
 };
 #define target_to_chipop_ody(x) container_of(x, struct chipop_ody, target)
 
@@ -100,14 +110,19 @@ struct sbefifo {
 };
 #define target_to_sbefifo(x) container_of(x, struct sbefifo, target)
 
+struct thread;
+
 struct pib {
 	struct pdbg_target target;
 	int (*read)(struct pib *, uint64_t, uint64_t *);
 	int (*write)(struct pib *, uint64_t, uint64_t);
+	/* Returns the number of registers read before the first failure */
+	int (*read_list)(struct pib *, const uint64_t *, uint64_t *, int);
 	int (*thread_start_all)(struct pib *);
 	int (*thread_stop_all)(struct pib *);
 	int (*thread_step_all)(struct pib *, int);
 	int (*thread_sreset_all)(struct pib *);
+	int (*thread_getregs_all)(struct pib *, struct thread **, struct thread_regs **, int *, int);
 	void *priv;
 	int fd;
 };
@@ -154,6 +169,12 @@ struct thread {
 	int (*stop)(struct thread *);
 	int (*sreset)(struct thread *);
 
+	/* Optional, stop() split in two so that many threads can be
+	 * stopped at once. stop_request() asks the thread to stop and
+	 * quiesced() is the poll_fn which waits for it. */
+	int (*stop_request)(struct thread *);
+	int (*quiesced)(void *thread);
+
 	bool ram_did_quiesce; /* was the thread quiesced by ram mode */
 
 	/* ram_setup() should be called prior to using ram_instruction() to
@@ -45,14 +45,11 @@ static int i2c_set_addr(int fd, int addr)
 
 static int i2c_set_scom_addr(struct i2c_data *i2c_data, uint32_t addr)
 {
-	uint8_t data[4];
-
-	addr <<= 1;
-	data[3] = GETFIELD(PPC_BITMASK32(0, 7), addr);
-	data[2] = GETFIELD(PPC_BITMASK32(8, 15), addr);
-	data[1] = GETFIELD(PPC_BITMASK32(16, 23), addr);
-	data[0] = GETFIELD(PPC_BITMASK32(23, 31), addr);
-	if (write(i2c_data->fd, data, sizeof(data)) != 4) {
+	uint32_t data;
+
+	/* The address is sent least significant byte first */
+	data = htole32(addr << 1);
+	if (write(i2c_data->fd, &data, sizeof(data)) != 4) {
 		PR_ERROR("Error writing address bytes\n");
 		return -1;
 	}
@@ -81,23 +78,14 @@ static int i2c_putscom(struct pib *pib, uint64_t addr, uint64_t value)
 {
 	struct i2c_data *i2c_data = pib->priv;
 	uint8_t data[12];
-
-	/* Setup scom address */
-	addr <<= 1;
-	data[3] = GETFIELD(PPC_BITMASK32(0, 7), addr);
-	data[2] = GETFIELD(PPC_BITMASK32(8, 15), addr);
-	data[1] = GETFIELD(PPC_BITMASK32(16, 23), addr);
-	data[0] = GETFIELD(PPC_BITMASK32(23, 31), addr);
-
-	/* Add data value */
-	data[11] = GETFIELD(PPC_BITMASK(0, 7), value);
-	data[10] = GETFIELD(PPC_BITMASK(8, 15), value);
-	data[9] = GETFIELD(PPC_BITMASK(16, 23), value);
-	data[8] = GETFIELD(PPC_BITMASK(23, 31), value);
-	data[7] = GETFIELD(PPC_BITMASK(32, 39), value);
-	data[6] = GETFIELD(PPC_BITMASK(40, 47), value);
-	data[5] = GETFIELD(PPC_BITMASK(48, 55), value);
-	data[4] = GETFIELD(PPC_BITMASK(56, 63), value);
+	uint32_t le_addr;
+	uint64_t le_value;
+
+	/* Address and value are both sent least significant byte first */
+	le_addr = htole32(addr << 1);
+	le_value = htole64(value);
+	memcpy(&data[0], &le_addr, sizeof(le_addr));
+	memcpy(&data[4], &le_value, sizeof(le_value));
 
 	/* Write value */
 	if (write(i2c_data->fd, data, sizeof(data)) != 12) {
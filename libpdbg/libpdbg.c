@@ -1,10 +1,12 @@
 #include <string.h>
 #include <endian.h>
+#include <time.h>
 
 #include "target.h"
 #include "libpdbg.h"
 
 static pdbg_progress_tick_t progress_tick;
+static __thread struct pdbg_cancel *cancel_token;
 static bool pdbg_short_context = false;
 
 struct pdbg_target *get_parent(struct pdbg_target *target, bool system)
@@ -38,39 +40,27 @@ struct pdbg_target *get_parent(struct pdbg_target *target, bool system)
 
 struct pdbg_target *__pdbg_next_target(const char *class, struct pdbg_target *parent, struct pdbg_target *last, bool system)
 {
-	struct pdbg_target *next, *tmp;
 	struct pdbg_target_class *target_class;
 
-	if (class && !find_target_class(class))
+	target_class = find_target_class(class);
+	if (!target_class)
 		return NULL;
 
-	target_class = require_target_class(class);
+	target_class_expand(target_class);
+
+	/* Children of the given parent are found through the subtree index */
+	if (parent)
+		return tree_index_next(target_class, parent, last, system);
 
-retry:
 	/* No more targets left to check in this class */
 	if ((last && last->class_link.next == &target_class->targets.n) ||
 	    list_empty(&target_class->targets))
 		return NULL;
 
 	if (last)
-		next = list_entry(last->class_link.next, struct pdbg_target, class_link);
-	else
-		if (!(next = list_top(&target_class->targets, struct pdbg_target, class_link)))
-			return NULL;
+		return list_entry(last->class_link.next, struct pdbg_target, class_link);
 
-	if (!parent)
-		/* Parent is null, no need to check if this is a child */
-		return next;
-	else {
-		/* Check if this target is a child of the given parent */
-		for (tmp = next; tmp && get_parent(tmp, system) && tmp != parent; tmp = get_parent(tmp, system)) {}
-		if (tmp == parent)
-			return next;
-		else {
-			last = next;
-			goto retry;
-		}
-	}
+	return list_top(&target_class->targets, struct pdbg_target, class_link);
 }
 
 static struct pdbg_target *target_map_child(struct pdbg_target *next, bool system)
@@ -124,11 +114,14 @@ struct pdbg_target *__pdbg_next_child_target(struct pdbg_target *parent, struct
 	 *    - If there is no associated virtual node,
 	 *        No children
 	 */
+	target_expand(parent);
 	if (list_empty(&parent->children)) {
 		if (parent->vnode)
 			parent = parent->vnode;
 		else
 			return NULL;
+
+		target_expand(parent);
 	}
 
 	 /*
@@ -229,26 +222,33 @@ uint32_t pdbg_target_index(struct pdbg_target *target)
 }
 
 /* Find a target parent from the given class */
-struct pdbg_target *target_parent(const char *klass, struct pdbg_target *target, bool system)
+struct pdbg_target *target_class_parent(struct pdbg_target_class *target_class,
+					struct pdbg_target *target, bool system)
 {
 	struct pdbg_target *parent;
 
-	if (!klass)
-		return get_parent(target, system);
-
 	for (parent = get_parent(target, system); parent && get_parent(parent, system); parent = get_parent(parent, system)) {
-		const char *tclass = pdbg_target_class_name(parent);
-
-		if (!tclass)
-			continue;
-
-		if (!strcmp(klass, tclass))
+		if (target_is_class(parent, target_class))
 			return parent;
 	}
 
 	return NULL;
 }
 
+struct pdbg_target *target_parent(const char *klass, struct pdbg_target *target, bool system)
+{
+	struct pdbg_target_class *target_class;
+
+	if (!klass)
+		return get_parent(target, system);
+
+	target_class = find_target_class(klass);
+	if (!target_class)
+		return NULL;
+
+	return target_class_parent(target_class, target, system);
+}
+
 struct pdbg_target *pdbg_target_parent(const char *klass, struct pdbg_target *target)
 {
 	return target_parent(klass, target, true);
@@ -267,6 +267,15 @@ struct pdbg_target *require_target_parent(const char *klass, struct pdbg_target
 	return parent;
 }
 
+struct pdbg_target *require_target_class_parent(struct pdbg_target_class *target_class,
+						struct pdbg_target *target, bool system)
+{
+	struct pdbg_target *parent = target_class_parent(target_class, target, system);
+
+	assert(parent);
+	return parent;
+}
+
 struct pdbg_target *pdbg_target_require_parent(const char *klass, struct pdbg_target *target)
 {
 	return require_target_parent(klass, target, true);
@@ -289,6 +298,17 @@ const char *pdbg_target_class_name(struct pdbg_target *target)
 	return target->class;
 }
 
+const char *pdbg_class_lookup(const char *klass)
+{
+	struct pdbg_target_class *target_class;
+
+	target_class = find_target_class(klass);
+	if (!target_class)
+		return NULL;
+
+	return target_class->name;
+}
+
 const char *pdbg_target_name(struct pdbg_target *target)
 {
 	return target->name;
@@ -344,6 +364,50 @@ void pdbg_set_progress_tick(pdbg_progress_tick_t fn)
 	progress_tick = fn;
 }
 
+static uint64_t cancel_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+struct pdbg_cancel *pdbg_set_cancel(struct pdbg_cancel *cancel)
+{
+	struct pdbg_cancel *old = cancel_token;
+
+	cancel_token = cancel;
+	return old;
+}
+
+struct pdbg_cancel *pdbg_get_cancel(void)
+{
+	return cancel_token;
+}
+
+void pdbg_cancel_timeout(struct pdbg_cancel *cancel, uint64_t timeout_us)
+{
+	cancel->deadline_us = timeout_us ? cancel_now_us() + timeout_us : 0;
+}
+
+bool pdbg_cancelled(void)
+{
+	struct pdbg_cancel *cancel = cancel_token;
+
+	if (!cancel)
+		return false;
+
+	if (cancel->cancelled)
+		return true;
+
+	if (cancel->deadline_us && cancel_now_us() >= cancel->deadline_us) {
+		cancel->cancelled = 1;
+		return true;
+	}
+
+	return false;
+}
+
 bool pdbg_context_short(void)
 {
 	if (pdbg_target_root()) {
@@ -19,6 +19,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <signal.h>
 
 #include <stdbool.h>
 
@@ -46,6 +47,16 @@ struct pdbg_target;
  */
 struct pdbg_target_class;
 
+/**
+ * @struct pdbg_attr_spec
+ * @brief Compiled packed attribute specification
+ *
+ * An opaque type representing a parsed specification of packed integers.
+ *
+ * @see pdbg_attr_spec_compile
+ */
+struct pdbg_attr_spec;
+
 /**
  * @brief Identifies the processor type
  */
@@ -220,6 +231,18 @@ enum pdbg_backend {
 	 * via SBE.
 	 */
 	PDBG_BACKEND_SBEFIFO,
+
+	/**
+	 * This backend replays a trace recorded with pdbg_record_start()
+	 * without accessing any hardware.
+	 *
+	 * This backend requires the path of the trace file. The device
+	 * trees are taken from the trace and pdbg_get_backend() returns
+	 * the backend the trace was recorded with. Setting the
+	 * PDBG_REPLAY_LATENCY environment variable makes every operation
+	 * take as long as it did when it was recorded.
+	 */
+	PDBG_BACKEND_REPLAY,
 };
 
 /**
@@ -434,6 +457,73 @@ bool pdbg_target_set_attribute_packed(struct pdbg_target *target, const char *na
  */
 bool pdbg_target_get_attribute_packed(struct pdbg_target *target, const char *name, const char *spec, uint32_t count, void *val);
 
+/**
+ * @brief Compile a packed attribute specification
+ *
+ * Parses a specification as used by pdbg_target_set_attribute_packed()
+ * once, so that the same attributes can be accessed repeatedly without
+ * interpreting the specification again.
+ *
+ * @param[in] spec specification of packed integers, e.g. "4124"
+ * @return the compiled specification, NULL if spec is invalid
+ *
+ * @see pdbg_attr_spec_free
+ */
+struct pdbg_attr_spec *pdbg_attr_spec_compile(const char *spec);
+
+/**
+ * @brief Free a compiled packed attribute specification
+ * @param[in] spec the compiled specification
+ */
+void pdbg_attr_spec_free(struct pdbg_attr_spec *spec);
+
+/**
+ * @brief Overwrite the value of given attribute using a compiled specification
+ *
+ * @see pdbg_target_set_attribute_packed
+ *
+ * @param[in] target pdbg_target to set the attribute on
+ * @param[in] name name of the attribute to set
+ * @param[in] spec compiled specification of packed integers
+ * @param[in] count repetition count
+ * @param[in] val value of the attribute to set
+ * @return true on success, false on failure
+ */
+bool pdbg_target_set_attribute_spec(struct pdbg_target *target, const char *name, const struct pdbg_attr_spec *spec, uint32_t count, const void *val);
+
+/**
+ * @brief Get the value of the given attribute using a compiled specification
+ *
+ * @see pdbg_target_get_attribute_packed
+ *
+ * @param[in] target pdbg_target to get the attribute from
+ * @param[in] name name of the attribute to get
+ * @param[in] spec compiled specification of packed integers
+ * @param[in] count repetition count
+ * @param[out] val value of the attribute
+ * @return true on success, false on failure
+ */
+bool pdbg_target_get_attribute_spec(struct pdbg_target *target, const char *name, const struct pdbg_attr_spec *spec, uint32_t count, void *val);
+
+/**
+ * @brief Get the value of the given attribute for all targets of a class
+ *
+ * The attribute is read from every target of the class, in the order of
+ * pdbg_for_each_class_target(), as by pdbg_target_get_attribute(). The
+ * values of the first target are stored at the start of val, followed
+ * by those of the next target and so on.
+ *
+ * @param[in] klass the class of the targets
+ * @param[in] name name of the attribute to get
+ * @param[in] size Size of element
+ * @param[in] count Number of elements for each target
+ * @param[out] val buffer for max_targets * count elements
+ * @param[in] max_targets maximum number of targets to store
+ * @return the number of targets stored, -1 if there are more than
+ * max_targets targets or the attribute of any target doesn't match
+ */
+int pdbg_target_class_get_attribute(const char *klass, const char *name, uint32_t size, uint32_t count, void *val, uint32_t max_targets);
+
 /**
  * @brief Get the given property value as a uint32_t
  * @param[in] target pdbg_target to get the property from
@@ -530,6 +620,41 @@ uint64_t pdbg_target_address(struct pdbg_target *target, uint64_t *size);
  */
 bool pdbg_set_backend(enum pdbg_backend backend, const char *backend_option);
 
+/**
+ * @brief Record all backend transactions to a trace file
+ * @param[in] path the trace file to create
+ * @return true on success, false otherwise
+ *
+ * Every FSI, PIB, memory and SBEFIFO transaction, its result and how
+ * long it took, as well as the result of probing each target, is
+ * written to the trace. The trace also contains the device trees in
+ * use, so it can be replayed with the PDBG_BACKEND_REPLAY backend
+ * without access to the system. Recording starts with
+ * pdbg_targets_init() and so this function must be called before
+ * it. Setting the PDBG_RECORD environment variable to a path has the
+ * same effect.
+ *
+ * Recording stops when the device tree is released or when
+ * pdbg_record_stop() is called.
+ */
+bool pdbg_record_start(const char *path);
+
+/**
+ * @brief Stop recording backend transactions and close the trace file
+ */
+void pdbg_record_stop(void);
+
+/**
+ * @brief Check whether backend transactions are recorded or replayed
+ *
+ * A trace is replayed in the order it was recorded, so operations
+ * should not be issued from several threads at once while this is
+ * true.
+ *
+ * @return true if a trace is being recorded or replayed
+ */
+bool pdbg_trace_active(void);
+
 /**
  * @brief Initialises the targeting system from the given flattened device tree.
  *
@@ -543,6 +668,14 @@ bool pdbg_set_backend(enum pdbg_backend backend, const char *backend_option);
  * PDBG_DTB, then it will override the default device tree or the specified
  * device tree.
  *
+ * If the PDBG_CACHE_DIR environment variable names a writable directory,
+ * backend detection results are cached there and re-used by later
+ * invocations on the same boot. Only detection is cached: the tree is
+ * always expanded (see pdbg_targets_init_lazy() to expand it on
+ * demand) and targets are always probed, as their probe results change
+ * with the state of the host. Remove the directory contents to discard
+ * stale results, e.g. after a hardware configuration change.
+ *
  * @note This function can only be called once.  If the call fails, then it
  * indicates failure to identify the system device tree to load. On failure,
  * it's possible to call this function again with different argument or after
@@ -552,6 +685,32 @@ bool pdbg_set_backend(enum pdbg_backend backend, const char *backend_option);
  */
 bool pdbg_targets_init(void *fdt);
 
+/**
+ * @brief Initialises the targeting system, creating targets on demand
+ *
+ * @param [in]  fdt The system device tree pointer, NULL to use default
+ * @return true on success, false on failure
+ *
+ * Same as pdbg_targets_init(), except that the device trees are only
+ * scanned and targets are not created until they are needed. The
+ * children of a target are created when they are first iterated over
+ * and the targets of a class when the class is first iterated over, so
+ * applications which only use a few targets of a large system don't
+ * pay for the rest of the tree.
+ *
+ * The resulting tree, and the order targets are iterated over, are the
+ * same as with pdbg_targets_init(). Iterating over the whole tree, as
+ * pdbg_target_probe_all() does, creates every target, so that call
+ * takes longer than after pdbg_targets_init() as it does the work
+ * pdbg_targets_init() would have done. Applications which go on to use
+ * every target gain little from this call.
+ *
+ * @note The tree is changed while it is looked at, so iterating over
+ * targets from several threads at once is not safe until every target
+ * has been created.
+ */
+bool pdbg_targets_init_lazy(void *fdt);
+
 /**
  * @brief Probe all targets
  *
@@ -590,13 +749,48 @@ void pdbg_target_probe_all(struct pdbg_target *parent);
  * target in the tree between the given target and this parent to
  * determine the state of the given target.
  *
+ * Targets below a subtree invalidated with pdbg_target_invalidate()
+ * are validated again the first time they are probed afterwards.
+ *
  * @note Currently trying to probe a target with a status of
- * PDBG_TARGET_RELEASED will result in an assert error. This may
- * change in future if there is a use case for re-probing targets that
- * have been released.
+ * PDBG_TARGET_RELEASED will result in an assert error, unless it has
+ * been invalidated since it was released.
  */
 enum pdbg_target_status pdbg_target_probe(struct pdbg_target *target);
 
+/**
+ * @brief Invalidate the status of a subtree of targets
+ *
+ * @param[in] target the root of the subtree
+ *
+ * Marks the status of the given target and all targets below it as
+ * possibly out of date, eg. after a chip has been powered on. Nothing is
+ * probed here. Each target is validated again the next time it is
+ * probed with pdbg_target_probe():
+ *
+ * - Targets which didn't exist or were released are probed again.
+ * - Enabled targets keep their backend context and stay enabled, unless
+ *   their parent doesn't exist any more, in which case they are
+ *   released.
+ * - Disabled targets stay disabled.
+ *
+ * Until then pdbg_target_status() returns the old status. A target
+ * which has gone away should be released with pdbg_target_release()
+ * before invalidating it, so it is probed again once it comes back.
+ */
+void pdbg_target_invalidate(struct pdbg_target *target);
+
+/**
+ * @brief Invalidate and probe a subtree of targets
+ *
+ * @param[in] target the root of the subtree
+ * @return pdbg_target_status of the target after probing it again
+ *
+ * Same as pdbg_target_invalidate() followed by pdbg_target_probe() of
+ * the given target. Targets below it are probed again lazily.
+ */
+enum pdbg_target_status pdbg_target_reprobe(struct pdbg_target *target);
+
 /**
  * @brief Release the given target
  * @param[in] target the pdbg_target to release
@@ -605,9 +799,8 @@ enum pdbg_target_status pdbg_target_probe(struct pdbg_target *target);
  * neccessary. Once a target has been release it should not be used
  * again.
  *
- * @note It is currently not possible to reprobe a target once
- * released. This may change in future if a use case requiring this is
- * found.
+ * @note A released target can only be probed again after it has been
+ * invalidated, see pdbg_target_reprobe().
  */
 void pdbg_target_release(struct pdbg_target *target);
 
@@ -664,11 +857,26 @@ uint32_t pdbg_parent_index(struct pdbg_target *target, char *klass);
 
 /**
  * @brief Get the target class name
+ *
+ * Class names are interned, so all targets of a class return the same
+ * pointer.
+ *
  * @param[in] target the pdbg_target
  * @return char* the class name
  */
 const char *pdbg_target_class_name(struct pdbg_target *target);
 
+/**
+ * @brief Look up the interned name of a target class
+ *
+ * The returned pointer can be compared with the result of
+ * pdbg_target_class_name() instead of comparing strings.
+ *
+ * @param[in] klass the class name
+ * @return the interned class name, NULL if there is no such class
+ */
+const char *pdbg_class_lookup(const char *klass);
+
 /**
  * @brief Get the target name
  * @param[in] target the pdbg_target
@@ -787,6 +995,23 @@ int fsi_ody_write(struct pdbg_target *target, uint32_t addr, uint32_t val);
  */
 int pib_read(struct pdbg_target *target, uint64_t addr, uint64_t *val);
 
+/**
+ * @brief Read a list of PIB SCOM registers
+ *
+ * Backends which support it read the whole list in as few operations as
+ * possible, e.g. a single access for a run of consecutive registers.
+ * Otherwise the registers are read one at a time, as are the ones after
+ * a register the backend failed to read. No register is read twice.
+ *
+ * @param[in] target the pdbg_target
+ * @param[in] addr array of address offsets relative to target
+ * @param[out] val array receiving the read data
+ * @param[in] count number of registers to read
+ * @param[out] rc array of count return codes, one per register (may be NULL)
+ * @return int 0 if all registers were read successfully, -1 otherwise
+ */
+int pib_read_list(struct pdbg_target *target, const uint64_t *addr, uint64_t *val, int count, int *rc);
+
 /**
  * @brief Write a PIB SCOM register
  * @param[in] target the pdbg_target
@@ -831,6 +1056,8 @@ int pib_write_mask(struct pdbg_target *target, uint64_t addr, uint64_t val, uint
  * @param[in] mask the data mask
  * @param[in] data value the masked register value must match
  * @return int 0 if successful, -1 otherwise
+ *
+ * Gives up and returns -1 if the register does not match within one second.
  */
 int pib_wait(struct pdbg_target *pib_dt, uint64_t addr, uint64_t mask, uint64_t data);
 
@@ -1079,6 +1306,20 @@ int thread_getfpr(struct pdbg_target *thread, int fpr, uint64_t *value);
  */
 int thread_getregs(struct pdbg_target *target, struct thread_regs *regs);
 
+/**
+ * @brief Get the value of all interesting registers on a list of threads
+ * @param[in] targets array of thread targets to operate on
+ * @param[in] count number of thread targets in the array
+ * @param[out] regs array of count register structures, one per thread
+ * @param[out] rc array of count return codes, one per thread (may be NULL)
+ * @return 0 on success, -1 if registers could not be read on any thread
+ *
+ * Backends which can batch register reads (eg. SBEFIFO) read the registers
+ * of all the given threads on a processor in one go. Otherwise this is
+ * equivalent to calling thread_getregs() on each thread.
+ */
+int thread_getregs_list(struct pdbg_target **targets, int count, struct thread_regs *regs, int *rc);
+
 /**
  * @brief the pdbg thread states
  */
@@ -1397,6 +1638,38 @@ int mem_read(struct pdbg_target *target, uint64_t addr, uint8_t *output, uint64_
  */
 int mem_write(struct pdbg_target *target, uint64_t addr, uint8_t *input, uint64_t size, uint8_t block_size, bool ci);
 
+/**
+ * @brief Enable or disable read caching on a mem class target
+ *
+ * @param[in]  target the mem class target to operate on
+ * @param[in]  enable true to enable the cache, false to disable and free it
+ *
+ * @return 0 on success, -1 on failure or if the target can't tell
+ * memory from MMIO (eg. the processor type is unknown)
+ *
+ * When enabled, small cacheable reads via mem_read() are served from a
+ * cache of 128 byte lines so repeated reads of nearby addresses (eg. when
+ * unwinding a stack) only access the hardware once per line. Cache
+ * inhibited and block sized reads, and reads of MMIO space, always bypass
+ * the cache. If a whole line can't be read, the requested bytes are read
+ * uncached.
+ *
+ * Writes via mem_write() or the adu_putmem() family, through any mem
+ * target, invalidate overlapping lines in every cache. Starting, stepping,
+ * stopping or resetting threads, or RAMing instructions on them,
+ * invalidates all caches. Anything else modifying memory, such as the
+ * host itself, DMA or another process, requires an explicit call to
+ * mem_cache_invalidate().
+ */
+int mem_cache_enable(struct pdbg_target *target, bool enable);
+
+/**
+ * @brief Invalidate the read cache of a mem class target
+ *
+ * @param[in]  target the mem class target to operate on, NULL for all
+ */
+void mem_cache_invalidate(struct pdbg_target *target);
+
 /**
  * @brief Read a register on an OPB
  * @param[in] target pdbg_target on the OPB to read
@@ -1472,6 +1745,158 @@ void pdbg_set_progress_tick(pdbg_progress_tick_t fn);
  */
 void pdbg_progress_tick(uint64_t cur, uint64_t end);
 
+/**
+ * @brief Cancellation token for long running operations
+ *
+ * Long running operations such as reading memory, dumping HTM or SBE
+ * data and instruction ramming check the token of the calling thread
+ * at chunk boundaries. Once cancelled is set or the deadline has
+ * passed they stop, clean up any hardware state they have set up
+ * (ADU locks, special wakeup and RAM mode) and return an error.
+ *
+ * cancelled may be set from a signal handler.
+ *
+ * @see pdbg_set_cancel()
+ */
+struct pdbg_cancel {
+	volatile sig_atomic_t cancelled;
+	uint64_t deadline_us; /* CLOCK_MONOTONIC, 0 for no deadline */
+};
+
+/**
+ * @brief Set the cancellation token of the calling thread
+ * @param[in] cancel token, NULL to disable cancellation
+ *
+ * @return the previously set token
+ */
+struct pdbg_cancel *pdbg_set_cancel(struct pdbg_cancel *cancel);
+
+/**
+ * @brief Get the cancellation token of the calling thread
+ *
+ * Threads started to run operations on behalf of another thread can
+ * install the token of that thread with pdbg_set_cancel().
+ *
+ * @return the token set with pdbg_set_cancel(), NULL if none
+ */
+struct pdbg_cancel *pdbg_get_cancel(void);
+
+/**
+ * @brief Set the deadline of a cancellation token
+ * @param[in] cancel token
+ * @param[in] timeout_us time from now after which operations are
+ * cancelled, 0 to clear the deadline
+ */
+void pdbg_cancel_timeout(struct pdbg_cancel *cancel, uint64_t timeout_us);
+
+/**
+ * @brief Check if operations of the calling thread should stop
+ *
+ * @return true if the token of the calling thread has been cancelled
+ * or its deadline has passed, false otherwise
+ */
+bool pdbg_cancelled(void);
+
+/**
+ * @brief Operations accounted for by the statistics interface
+ *
+ * @see pdbg_stats_enable()
+ */
+enum pdbg_stats_op {
+	PDBG_STATS_FSI_READ,
+	PDBG_STATS_FSI_WRITE,
+	PDBG_STATS_PIB_READ,
+	PDBG_STATS_PIB_WRITE,
+	PDBG_STATS_MEM_READ,
+	PDBG_STATS_MEM_WRITE,
+	PDBG_STATS_SBEFIFO_OP,
+	PDBG_STATS_RAM_INSN,
+};
+
+#define PDBG_STATS_HIST_BUCKETS	32
+
+/**
+ * @brief Statistics for one operation on one backend
+ *
+ * Latencies are in nanoseconds. hist[i] counts operations which took
+ * between 2^i and 2^(i+1) - 1 nanoseconds, with the last bucket
+ * counting everything slower than that.
+ */
+struct pdbg_stats {
+	enum pdbg_stats_op op;
+	const char *class;	/**< class of the targets, eg. "pib" */
+	const char *backend;	/**< compatible string of the hardware unit */
+	uint64_t count;
+	uint64_t errors;
+	uint64_t retries;
+	uint64_t bytes;
+	uint64_t total_ns;
+	uint64_t min_ns;
+	uint64_t max_ns;
+	uint64_t hist[PDBG_STATS_HIST_BUCKETS];
+};
+
+/**
+ * @brief Enable or disable recording of operation statistics
+ * @param[in] enable true to start recording, false to stop
+ *
+ * When enabled the number of operations, bytes transferred, retries,
+ * errors and latencies of fsi_read/write, pib_read/write,
+ * mem_read/write, SBEFIFO operations and instruction ramming are
+ * recorded for every backend (hardware unit) used. Statistics are
+ * disabled by default, unless the PDBG_STATS environment variable is
+ * set. Disabling keeps what has been recorded so far.
+ */
+void pdbg_stats_enable(bool enable);
+
+/**
+ * @brief Check whether operation statistics are being recorded
+ * @return true if enabled, false otherwise
+ */
+bool pdbg_stats_enabled(void);
+
+/**
+ * @brief Discard all recorded operation statistics
+ */
+void pdbg_stats_reset(void);
+
+/**
+ * @brief Type for the callback of pdbg_stats_foreach()
+ * @param[in] stats statistics for one operation on one backend
+ * @param[in] priv private data passed to pdbg_stats_foreach()
+ * @return 0 to continue iterating, anything else to stop
+ */
+typedef int (*pdbg_stats_cb_t)(const struct pdbg_stats *stats, void *priv);
+
+/**
+ * @brief Iterate over the recorded operation statistics
+ * @param[in] fn callback
+ * @param[in] priv private data passed to the callback
+ * @return 0 on success, otherwise the first non-zero callback return value
+ *
+ * Entries are visited in the order the (operation, backend) pair was
+ * first seen.
+ */
+int pdbg_stats_foreach(pdbg_stats_cb_t fn, void *priv);
+
+/**
+ * @brief Get the name of an operation
+ * @param[in] op operation
+ * @return name of the operation, NULL if op is invalid
+ */
+const char *pdbg_stats_op_name(enum pdbg_stats_op op);
+
+/**
+ * @brief Estimate a latency percentile from the histogram
+ * @param[in] stats statistics for one operation on one backend
+ * @param[in] percent percentile to calculate (0-100)
+ * @return latency in nanoseconds below which percent of the operations completed
+ *
+ * The result is the upper bound of the histogram bucket containing the
+ * percentile, so it is accurate to within a factor of two.
+ */
+uint64_t pdbg_stats_percentile(const struct pdbg_stats *stats, unsigned int percent);
+
 #define PDBG_ERROR	0
 #define PDBG_WARNING	1
 #define PDBG_NOTICE	2
@@ -1522,7 +1947,8 @@ bool pdbg_context_short(void);
  * 
  * This function needs to be called if for some very good reason we are
  * switching the backend in the running process. It clears/releases the 
- * existing dev tree (if any) children by children along with the root node.
+ * existing dev tree (if any) along with the root node. All pdbg_target
+ * pointers, names and paths obtained from the tree become invalid.
  * 
  * Call this function before ##pdbg_set_backend() if there is a
  * dev tree already is in place and we are switching the backend
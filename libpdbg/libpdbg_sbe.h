@@ -20,10 +20,23 @@ enum sbe_state {
 	SBE_STATE_INVALID     = 0x0000000F,
 };
 
+/**
+ * @brief Find and probe the chip-op target of a pib
+ *
+ * The chip-op target can be passed to sbe_istep() and sbe_ffdc_get()
+ * instead of the pib. Unlike the pib, that doesn't look up or probe any
+ * targets, so it can be done from several threads at once.
+ *
+ * @param[in]  target pib target
+ *
+ * @return the chip-op target, NULL if there is none
+ */
+struct pdbg_target *sbe_chipop_target(struct pdbg_target *target);
+
 /**
  * @brief Execute IPL istep using SBE
  *
- * @param[in]  target pib target to operate on
+ * @param[in]  target pib target to operate on, or its chip-op target
  * @param[in]  major istep major number
  * @param[in]  minor istep minor number
  *
@@ -34,7 +47,7 @@ int sbe_istep(struct pdbg_target *target, uint32_t major, uint32_t minor);
 /**
  * @brief Get FFDC data if error is generated
  *
- * @param[in]  target pib target to operate on
+ * @param[in]  target pib target to operate on, or its chip-op target
  * @param[out] status The status word
  * @param[out] ffdc pointer to output buffer to store ffdc data
  * @param[out] ffdc_len the sizeof the ffdc data returned
@@ -92,6 +105,31 @@ int sbe_mpipl_get_ti_info(struct pdbg_target *target, uint8_t **data, uint32_t *
  */
 int sbe_dump(struct pdbg_target *target, uint8_t type, uint8_t clock, uint8_t fa_collect, uint8_t **data, uint32_t *data_len);
 
+/**
+ * @brief Get sbe dump and write it to a file descriptor
+ *
+ * Same as sbe_dump(), but the dump data is written to fd instead of
+ * being returned in a single allocated buffer.  If fd refers to a
+ * regular file, the dump is received directly into the file at the
+ * current offset and the file offset is advanced past the dump data.
+ * Otherwise (e.g. a pipe) the SBE FIFO still returns the whole dump in
+ * one piece, so all of it (up to 80MB) is held in memory before it is
+ * written out in chunks.
+ *
+ * The status and FFDC returned by the SBE are available using
+ * sbe_ffdc_get().
+ *
+ * @param[in] target pib target to operate on
+ * @param[in] type Type of dump
+ * @param[in] clock Clock on or off
+ * @param[in] fa_collect Fast Array collection (0 off, 1 on)
+ * @param[in] fd File descriptor to write the dump to
+ * @param[out] data_len length of the data written
+ *
+ * @return 0 on success, -1 on failure
+ */
+int sbe_dump_fd(struct pdbg_target *target, uint8_t type, uint8_t clock, uint8_t fa_collect, int fd, uint32_t *data_len);
+
 /**
  * @brief Get sbe state
  *
@@ -21,7 +21,7 @@
 
 static struct sbefifo *ocmb_to_sbefifo(struct ocmb *ocmb)
 {
-	struct pdbg_target *pib = pdbg_target_require_parent("pib", &ocmb->target);
+	struct pdbg_target *pib = require_target_class_parent(TARGET_CLASS("pib"), &ocmb->target, true);
 	struct pdbg_target *target;
 	struct sbefifo *sbefifo = NULL;
 
@@ -19,18 +19,20 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <assert.h>
+#include <ccan/array_size/array_size.h>
 
 #include "hwunit.h"
 #include "bitutils.h"
+#include "regfield.h"
 #include "p10_scom_addr.h"
 
 #define t(x) (&(x)->target)
 
-static uint64_t p10_eq_translate(struct eq *eq, uint64_t addr)
+static void p10_eq_xlate(int index, struct scom_xlate *xlate)
 {
-	addr = set_chiplet_id(addr, EQ0_CHIPLET_ID + pdbg_target_index(t(eq)));
-
-	return addr;
+	scom_xlate_add(xlate, 0, 0, CHIPLET_ID_FIELD,
+		       scom_field(CHIPLET_ID_FIELD, EQ0_CHIPLET_ID + index), false);
 }
 
 static struct eq p10_eq = {
@@ -38,21 +40,20 @@ static struct eq p10_eq = {
 		.name = "POWER eq",
 		.compatible = "ibm,power10-eq",
 		.class = "eq",
-		.translate = translate_cast(p10_eq_translate),
+		.translate = scom_xlate_translate,
+		.xlate_build = p10_eq_xlate,
 	},
 };
 DECLARE_HW_UNIT(p10_eq);
 
-static uint64_t p10_pec_translate(struct pec *pec, uint64_t addr)
+static void p10_pec_xlate(int index, struct scom_xlate *xlate)
 {
-	int chip_unitnum = pdbg_target_index(t(pec));
-
-	if (get_chiplet_id(addr) >= N0_CHIPLET_ID &&
-	    get_chiplet_id(addr) <= N1_CHIPLET_ID)
-		return set_chiplet_id(addr,
-				      chip_unitnum ? N0_CHIPLET_ID : N1_CHIPLET_ID );
-	else
-		return set_chiplet_id(addr, PCI0_CHIPLET_ID + pdbg_target_index(t(pec)));
+	scom_xlate_add_range(xlate, 0, 0, CHIPLET_ID_FIELD, N0_CHIPLET_ID, N1_CHIPLET_ID,
+			     CHIPLET_ID_FIELD,
+			     scom_field(CHIPLET_ID_FIELD, index ? N0_CHIPLET_ID : N1_CHIPLET_ID),
+			     true);
+	scom_xlate_add(xlate, 0, 0, CHIPLET_ID_FIELD,
+		       scom_field(CHIPLET_ID_FIELD, PCI0_CHIPLET_ID + index), false);
 }
 
 static struct pec p10_pec = {
@@ -60,30 +61,28 @@ static struct pec p10_pec = {
 		.name = "POWER pec",
 		.compatible = "ibm,power10-pec",
 		.class = "pec",
-		.translate = translate_cast(p10_pec_translate),
+		.translate = scom_xlate_translate,
+		.xlate_build = p10_pec_xlate,
 	},
 };
 DECLARE_HW_UNIT(p10_pec);
 
-static uint64_t p10_phb_translate(struct phb *phb, uint64_t addr)
+static void p10_phb_xlate(int index, struct scom_xlate *xlate)
 {
-	int chip_unitnum = pdbg_target_index(t(phb));
-
-	if (get_chiplet_id(addr) >= N0_CHIPLET_ID && get_chiplet_id(addr) <= N1_CHIPLET_ID) {
-		addr = set_chiplet_id(addr, chip_unitnum / 3 ? N0_CHIPLET_ID : N1_CHIPLET_ID);
-		return set_sat_id(addr, 1 + chip_unitnum % 3);
-	} else {
-		addr = set_chiplet_id(addr, chip_unitnum / 3 + PCI0_CHIPLET_ID);
-		if (get_ring_id(addr) == 2) {
-			if (get_sat_id(addr) >= 1 && get_sat_id(addr) <= 3)
-				return set_sat_id(addr, 1 + chip_unitnum % 3);
-			else
-				return set_sat_id(addr, 4 + chip_unitnum % 3);
-		}
-	}
-
-	/*  We'll never get here due to the assert but gcc complains */
-	return addr;
+	uint64_t ring = scom_field(RING_ID_FIELD, 2);
+
+	scom_xlate_add_range(xlate, 0, 0, CHIPLET_ID_FIELD, N0_CHIPLET_ID, N1_CHIPLET_ID,
+			     CHIPLET_ID_FIELD | SAT_ID_FIELD,
+			     scom_field(CHIPLET_ID_FIELD, index / 3 ? N0_CHIPLET_ID : N1_CHIPLET_ID) |
+			     scom_field(SAT_ID_FIELD, 1 + index % 3),
+			     true);
+
+	scom_xlate_add(xlate, 0, 0, CHIPLET_ID_FIELD,
+		       scom_field(CHIPLET_ID_FIELD, index / 3 + PCI0_CHIPLET_ID), false);
+	scom_xlate_add_range(xlate, RING_ID_FIELD, ring, SAT_ID_FIELD, 1, 3,
+			     SAT_ID_FIELD, scom_field(SAT_ID_FIELD, 1 + index % 3), true);
+	scom_xlate_add(xlate, RING_ID_FIELD, ring,
+		       SAT_ID_FIELD, scom_field(SAT_ID_FIELD, 4 + index % 3), false);
 }
 
 static struct phb p10_phb = {
@@ -91,14 +90,16 @@ static struct phb p10_phb = {
 		.name = "POWER phb",
 		.compatible = "ibm,power10-phb",
 		.class = "phb",
-		.translate = translate_cast(p10_phb_translate),
+		.translate = scom_xlate_translate,
+		.xlate_build = p10_phb_xlate,
 	},
 };
 DECLARE_HW_UNIT(p10_phb);
 
-static uint64_t p10_nmmu_translate(struct nmmu *nmmu, uint64_t addr)
+static void p10_nmmu_xlate(int index, struct scom_xlate *xlate)
 {
-	return set_chiplet_id(addr, pdbg_target_index(t(nmmu)) + N0_CHIPLET_ID);
+	scom_xlate_add(xlate, 0, 0, CHIPLET_ID_FIELD,
+		       scom_field(CHIPLET_ID_FIELD, N0_CHIPLET_ID + index), false);
 }
 
 static struct nmmu p10_nmmu = {
@@ -106,36 +107,22 @@ static struct nmmu p10_nmmu = {
 		.name = "POWER nmmu",
 		.compatible = "ibm,power10-nmmu",
 		.class = "nmmu",
-		.translate = translate_cast(p10_nmmu_translate),
+		.translate = scom_xlate_translate,
+		.xlate_build = p10_nmmu_xlate,
 	},
 };
 DECLARE_HW_UNIT(p10_nmmu);
 
-static uint64_t p10_iohs_translate(struct iohs *iohs, uint64_t addr)
+static void p10_iohs_xlate(int index, struct scom_xlate *xlate)
 {
-	int chip_unitnum = pdbg_target_index(t(iohs));
-
-	if (get_chiplet_id(addr) >= AXON0_CHIPLET_ID &&
-	    get_chiplet_id(addr) <= AXON7_CHIPLET_ID)
-		addr = set_chiplet_id(addr, AXON0_CHIPLET_ID + chip_unitnum);
-	else if (get_chiplet_id(addr) >= PAU0_CHIPLET_ID &&
-		 get_chiplet_id(addr) <= PAU3_CHIPLET_ID) {
-		addr = set_chiplet_id(addr, chip_unitnum/2 + PAU0_CHIPLET_ID);
-	} else
-		/* We should bail here with an assert but it makes testing hard and we
-		 * should never hit it anyway as all code will have been validated
-		 * through the EKB CI process (LOL). */
-		assert(1);
-
-	if (get_chiplet_id(addr) >= PAU0_CHIPLET_ID &&
-	    get_chiplet_id(addr) <= PAU3_CHIPLET_ID) {
-		if (chip_unitnum % 2)
-			addr = set_io_group_addr(addr, 0x1);
-		else
-			addr = set_io_group_addr(addr, 0x0);
-	}
-
-	return addr;
+	scom_xlate_add_range(xlate, 0, 0, CHIPLET_ID_FIELD, AXON0_CHIPLET_ID, AXON7_CHIPLET_ID,
+			     CHIPLET_ID_FIELD,
+			     scom_field(CHIPLET_ID_FIELD, AXON0_CHIPLET_ID + index), true);
+	scom_xlate_add_range(xlate, 0, 0, CHIPLET_ID_FIELD, PAU0_CHIPLET_ID, PAU3_CHIPLET_ID,
+			     CHIPLET_ID_FIELD | IO_GROUP_ADDR_FIELD,
+			     scom_field(CHIPLET_ID_FIELD, index / 2 + PAU0_CHIPLET_ID) |
+			     scom_field(IO_GROUP_ADDR_FIELD, index % 2),
+			     true);
 }
 
 static struct iohs p10_iohs = {
@@ -143,16 +130,17 @@ static struct iohs p10_iohs = {
 		.name = "POWER iohs",
 		.compatible = "ibm,power10-iohs",
 		.class = "iohs",
-		.translate = translate_cast(p10_iohs_translate),
+		.translate = scom_xlate_translate,
+		.xlate_build = p10_iohs_xlate,
 	},
 };
 DECLARE_HW_UNIT(p10_iohs);
 
-/* We take a struct pdbg_target and avoid the casting here as the translation is
- * the same for both target types. */
-static uint64_t p10_mimc_translate(struct pdbg_target *mimc, uint64_t addr)
+/* The translation is the same for both mi and mc targets */
+static void p10_mimc_xlate(int index, struct scom_xlate *xlate)
 {
-	return set_chiplet_id(addr, pdbg_target_index(mimc) + MC0_CHIPLET_ID);
+	scom_xlate_add(xlate, 0, 0, CHIPLET_ID_FIELD,
+		       scom_field(CHIPLET_ID_FIELD, MC0_CHIPLET_ID + index), false);
 }
 
 static struct mi p10_mi = {
@@ -160,7 +148,8 @@ static struct mi p10_mi = {
 		.name = "POWER mi",
 		.compatible = "ibm,power10-mi",
 		.class = "mi",
-		.translate = p10_mimc_translate,
+		.translate = scom_xlate_translate,
+		.xlate_build = p10_mimc_xlate,
 	},
 };
 DECLARE_HW_UNIT(p10_mi);
@@ -170,54 +159,40 @@ static struct mc p10_mc = {
 		.name = "POWER mc",
 		.compatible = "ibm,power10-mc",
 		.class = "mc",
-		.translate = p10_mimc_translate,
+		.translate = scom_xlate_translate,
+		.xlate_build = p10_mimc_xlate,
 	},
 };
 DECLARE_HW_UNIT(p10_mc);
 
-static uint64_t p10_mcc_translate(struct mcc *mcc, uint64_t addr)
+static void p10_mcc_xlate(int index, struct scom_xlate *xlate)
 {
-	int chip_unitnum = pdbg_target_index(t(mcc));
-	uint8_t offset = get_sat_offset(addr);
-
-	addr = set_chiplet_id(addr, chip_unitnum/2 + MC0_CHIPLET_ID);
-	if (chip_unitnum % 2) {
-		switch (get_sat_id(addr)) {
-		case 0x4:
-			addr = set_sat_id(addr, 0x5);
-			break;
-		case 0x8:
-			addr = set_sat_id(addr, 0x9);
-			break;
-		case 0x0:
-			if (offset >= 0x22 && offset <= 0x2b)
-				addr = set_sat_offset(addr, offset + 0x10);
-			break;
-		case 0xd:
-			if (offset >= 0x00 && offset <= 0x1f)
-				addr = set_sat_offset(addr, offset + 0x20);
-			break;
-		}
+	scom_xlate_add(xlate, 0, 0, CHIPLET_ID_FIELD,
+		       scom_field(CHIPLET_ID_FIELD, index / 2 + MC0_CHIPLET_ID), false);
+
+	if (index % 2) {
+		scom_xlate_add(xlate, SAT_ID_FIELD, scom_field(SAT_ID_FIELD, 0x4),
+			       SAT_ID_FIELD, scom_field(SAT_ID_FIELD, 0x5), true);
+		scom_xlate_add(xlate, SAT_ID_FIELD, scom_field(SAT_ID_FIELD, 0x8),
+			       SAT_ID_FIELD, scom_field(SAT_ID_FIELD, 0x9), true);
+		/* offset + 0x10 */
+		scom_xlate_add_range(xlate, SAT_ID_FIELD, scom_field(SAT_ID_FIELD, 0x0),
+				     SAT_OFFSET_FIELD, 0x22, 0x2b, 0x10, 0x10, true);
+		/* offset + 0x20 */
+		scom_xlate_add_range(xlate, SAT_ID_FIELD, scom_field(SAT_ID_FIELD, 0xd),
+				     SAT_OFFSET_FIELD, 0x00, 0x1f, 0x20, 0x20, true);
 	} else {
-		switch (get_sat_id(addr)) {
-		case 0x5:
-			addr = set_sat_id(addr, 0x4);
-			break;
-		case 0x9:
-			addr = set_sat_id(addr, 0x8);
-			break;
-		case 0x0:
-			if (offset >= 0x32 && offset <= 0x3b)
-				addr = set_sat_offset(addr, offset - 0x10);
-			break;
-		case 0xd:
-			if (offset >= 0x20 && offset <= 0x3f)
-				addr = set_sat_offset(addr, offset - 0x20);
-			break;
-		}
+		scom_xlate_add(xlate, SAT_ID_FIELD, scom_field(SAT_ID_FIELD, 0x5),
+			       SAT_ID_FIELD, scom_field(SAT_ID_FIELD, 0x4), true);
+		scom_xlate_add(xlate, SAT_ID_FIELD, scom_field(SAT_ID_FIELD, 0x9),
+			       SAT_ID_FIELD, scom_field(SAT_ID_FIELD, 0x8), true);
+		/* offset - 0x10 */
+		scom_xlate_add_range(xlate, SAT_ID_FIELD, scom_field(SAT_ID_FIELD, 0x0),
+				     SAT_OFFSET_FIELD, 0x32, 0x3b, 0x10, 0, true);
+		/* offset - 0x20 */
+		scom_xlate_add_range(xlate, SAT_ID_FIELD, scom_field(SAT_ID_FIELD, 0xd),
+				     SAT_OFFSET_FIELD, 0x20, 0x3f, 0x20, 0, true);
 	}
-
-	return addr;
 }
 
 static struct mcc p10_mcc = {
@@ -225,42 +200,31 @@ static struct mcc p10_mcc = {
 		.name = "POWER mcc",
 		.compatible = "ibm,power10-mcc",
 		.class = "mcc",
-		.translate = translate_cast(p10_mcc_translate),
+		.translate = scom_xlate_translate,
+		.xlate_build = p10_mcc_xlate,
 	},
 };
 DECLARE_HW_UNIT(p10_mcc);
 
-static uint64_t p10_omic_translate(struct omic *omic, uint64_t addr)
-{
-	int chip_unitnum = pdbg_target_index(t(omic));
-	int chiplet_id = get_chiplet_id(addr);
-
-	if (chiplet_id >= PAU0_CHIPLET_ID && chiplet_id <= PAU3_CHIPLET_ID) {
-		if (chip_unitnum == 0 || chip_unitnum == 1)
-			addr = set_chiplet_id(addr, PAU0_CHIPLET_ID);
-		else if (chip_unitnum == 2 || chip_unitnum == 3)
-			addr = set_chiplet_id(addr, PAU2_CHIPLET_ID);
-		else if (chip_unitnum == 4 || chip_unitnum == 5)
-			addr = set_chiplet_id(addr, PAU1_CHIPLET_ID);
-		else if (chip_unitnum == 6 || chip_unitnum == 7)
-			addr = set_chiplet_id(addr, PAU3_CHIPLET_ID);
-		else
-			assert(0);
-
-		if (chip_unitnum % 2)
-			addr = set_io_group_addr(addr, 0x3);
-		else
-			addr = set_io_group_addr(addr, 0x2);
-	} else {
-		addr = set_chiplet_id(addr, chip_unitnum/2 + MC0_CHIPLET_ID);
-
-		if (chip_unitnum % 2)
-			addr = set_ring_id(addr, 0x6);
-		else
-			addr = set_ring_id(addr, 0x5);
-	}
+/* PAU chiplet used for each pair of OMI controllers */
+static const uint8_t p10_omic_pau_chiplet[] = {
+	PAU0_CHIPLET_ID, PAU2_CHIPLET_ID, PAU1_CHIPLET_ID, PAU3_CHIPLET_ID,
+};
 
-	return addr;
+static void p10_omic_xlate(int index, struct scom_xlate *xlate)
+{
+	assert(index / 2 < ARRAY_SIZE(p10_omic_pau_chiplet));
+
+	scom_xlate_add_range(xlate, 0, 0, CHIPLET_ID_FIELD, PAU0_CHIPLET_ID, PAU3_CHIPLET_ID,
+			     CHIPLET_ID_FIELD | IO_GROUP_ADDR_FIELD,
+			     scom_field(CHIPLET_ID_FIELD, p10_omic_pau_chiplet[index / 2]) |
+			     scom_field(IO_GROUP_ADDR_FIELD, index % 2 ? 0x3 : 0x2),
+			     true);
+
+	scom_xlate_add(xlate, 0, 0, CHIPLET_ID_FIELD | RING_ID_SET_FIELD,
+		       scom_field(CHIPLET_ID_FIELD, index / 2 + MC0_CHIPLET_ID) |
+		       scom_field(RING_ID_SET_FIELD, index % 2 ? 0x6 : 0x5),
+		       false);
 }
 
 static struct omic p10_omic = {
@@ -268,59 +232,35 @@ static struct omic p10_omic = {
 		.name = "POWER omic",
 		.compatible = "ibm,power10-omic",
 		.class = "omic",
-		.translate = translate_cast(p10_omic_translate),
+		.translate = scom_xlate_translate,
+		.xlate_build = p10_omic_xlate,
 	},
 };
 DECLARE_HW_UNIT(p10_omic);
 
-static uint64_t p10_omi_translate(struct omi *omi, uint64_t addr)
+static void p10_omi_xlate(int index, struct scom_xlate *xlate)
 {
-	int chip_unitnum = pdbg_target_index(t(omi));
-	int chiplet_id = get_chiplet_id(addr);
-
-	if (chiplet_id >= PAU0_CHIPLET_ID && chiplet_id <= PAU3_CHIPLET_ID) {
-		if (chip_unitnum >= 0 && chip_unitnum <= 3)
-			addr = set_chiplet_id(addr, PAU0_CHIPLET_ID);
-		else if (chip_unitnum >= 4 && chip_unitnum <= 7)
-			addr = set_chiplet_id(addr, PAU2_CHIPLET_ID);
-		else if (chip_unitnum >= 8 && chip_unitnum <= 11)
-			addr = set_chiplet_id(addr, PAU1_CHIPLET_ID);
-		else if (chip_unitnum >= 12 && chip_unitnum <= 15)
-			addr = set_chiplet_id(addr, PAU3_CHIPLET_ID);
-		else
-			assert(0);
-
-		if (chip_unitnum % 2)
-			addr = set_io_lane(addr, 8 + get_io_lane(addr) % 8);
-		else
-			addr = set_io_lane(addr, get_io_lane(addr) % 8);
-
-		if ((chip_unitnum / 2) % 2)
-			addr = set_io_group_addr(addr, 0x3);
-		else
-			addr = set_io_group_addr(addr, 0x2);
-	} else {
-		addr = set_chiplet_id(addr, chip_unitnum/4 + MC0_CHIPLET_ID);
-
-		if (get_sat_offset(addr) >= 16 && get_sat_offset(addr) <= 47) {
-			if (chip_unitnum % 2)
-				addr = set_sat_offset(addr, 32 + get_sat_offset(addr) % 16);
-			else
-				addr = set_sat_offset(addr, 16 + get_sat_offset(addr) % 16);
-		} else {
-			if (chip_unitnum % 2)
-				addr = set_sat_offset(addr, 56 + get_sat_offset(addr) % 4);
-			else
-				addr = set_sat_offset(addr, 48 + get_sat_offset(addr) % 4);
-		}
-
-		if ((chip_unitnum / 2) %2)
-			addr = set_ring_id(addr, 0x6);
-		else
-			addr = set_ring_id(addr, 0x5);
-	}
-
-	return addr;
+	assert(index / 4 < ARRAY_SIZE(p10_omic_pau_chiplet));
+
+	/* lane = lane % 8 (+ 8 for odd units) */
+	scom_xlate_add_range(xlate, 0, 0, CHIPLET_ID_FIELD, PAU0_CHIPLET_ID, PAU3_CHIPLET_ID,
+			     CHIPLET_ID_FIELD | scom_field(IO_LANE_FIELD, 0x18) | IO_GROUP_ADDR_FIELD,
+			     scom_field(CHIPLET_ID_FIELD, p10_omic_pau_chiplet[index / 4]) |
+			     scom_field(IO_LANE_FIELD, index % 2 ? 0x8 : 0x0) |
+			     scom_field(IO_GROUP_ADDR_FIELD, (index / 2) % 2 ? 0x3 : 0x2),
+			     true);
+
+	scom_xlate_add(xlate, 0, 0, CHIPLET_ID_FIELD | RING_ID_SET_FIELD,
+		       scom_field(CHIPLET_ID_FIELD, index / 4 + MC0_CHIPLET_ID) |
+		       scom_field(RING_ID_SET_FIELD, (index / 2) % 2 ? 0x6 : 0x5),
+		       false);
+
+	/* 16..47: offset = offset % 16 + (32 for odd units, 16 otherwise) */
+	scom_xlate_add_range(xlate, 0, 0, SAT_OFFSET_FIELD, 16, 47,
+			     0x30, index % 2 ? 32 : 16, true);
+
+	/* Otherwise: offset = offset % 4 + (56 for odd units, 48 otherwise) */
+	scom_xlate_add(xlate, 0, 0, 0x3c, index % 2 ? 56 : 48, false);
 }
 
 static struct omi p10_omi = {
@@ -328,14 +268,16 @@ static struct omi p10_omi = {
 		.name = "POWER omi",
 		.compatible = "ibm,power10-omi",
 		.class = "omi",
-		.translate = translate_cast(p10_omi_translate),
+		.translate = scom_xlate_translate,
+		.xlate_build = p10_omi_xlate,
 	},
 };
 DECLARE_HW_UNIT(p10_omi);
 
-static uint64_t p10_pauc_translate(struct pauc *pauc, uint64_t addr)
+static void p10_pauc_xlate(int index, struct scom_xlate *xlate)
 {
-	return set_chiplet_id(addr, pdbg_target_index(t(pauc)) + PAU0_CHIPLET_ID);
+	scom_xlate_add(xlate, 0, 0, CHIPLET_ID_FIELD,
+		       scom_field(CHIPLET_ID_FIELD, PAU0_CHIPLET_ID + index), false);
 }
 
 static struct pauc p10_pauc = {
@@ -343,40 +285,44 @@ static struct pauc p10_pauc = {
 		.name = "POWER pauc",
 		.compatible = "ibm,power10-pauc",
 		.class = "pauc",
-		.translate = translate_cast(p10_pauc_translate),
+		.translate = scom_xlate_translate,
+		.xlate_build = p10_pauc_xlate,
 	},
 };
 DECLARE_HW_UNIT(p10_pauc);
 
-static uint64_t p10_pau_translate(struct pau *pau, uint64_t addr)
+static void p10_pau_xlate(int index, struct scom_xlate *xlate)
 {
-	int chip_unitnum = pdbg_target_index(t(pau));
+	uint8_t from0, from1, to0, to1;
 
-	addr = set_chiplet_id(addr, chip_unitnum/2 + PAU0_CHIPLET_ID);
+	scom_xlate_add(xlate, 0, 0, CHIPLET_ID_FIELD,
+		       scom_field(CHIPLET_ID_FIELD, index / 2 + PAU0_CHIPLET_ID), false);
 
-	switch (chip_unitnum) {
+	switch (index) {
 	case 0:
 	case 3:
 	case 4:
 	case 6:
-		if (get_ring_id(addr) == 0x4)
-			addr = set_ring_id(addr, 0x2);
-		else if (get_ring_id(addr) == 0x5)
-			addr = set_ring_id(addr, 0x3);
+		from0 = 0x4; to0 = 0x2;
+		from1 = 0x5; to1 = 0x3;
 		break;
 
 	case 1:
 	case 2:
 	case 5:
 	case 7:
-		if (get_ring_id(addr) == 0x2)
-			addr = set_ring_id(addr, 0x4);
-		else if (get_ring_id(addr) == 0x3)
-			addr = set_ring_id(addr, 0x5);
+		from0 = 0x2; to0 = 0x4;
+		from1 = 0x3; to1 = 0x5;
 		break;
+
+	default:
+		return;
 	}
 
-	return addr;
+	scom_xlate_add(xlate, RING_ID_FIELD, scom_field(RING_ID_FIELD, from0),
+		       RING_ID_SET_FIELD, scom_field(RING_ID_SET_FIELD, to0), true);
+	scom_xlate_add(xlate, RING_ID_FIELD, scom_field(RING_ID_FIELD, from1),
+		       RING_ID_SET_FIELD, scom_field(RING_ID_SET_FIELD, to1), true);
 }
 
 static struct pau p10_pau = {
@@ -384,13 +330,18 @@ static struct pau p10_pau = {
 		.name = "POWER pau",
 		.compatible = "ibm,power10-pau",
 		.class = "pau",
-		.translate = translate_cast(p10_pau_translate),
+		.translate = scom_xlate_translate,
+		.xlate_build = p10_pau_xlate,
 	},
 };
 DECLARE_HW_UNIT(p10_pau);
 
 #define HEADER_CHECK_DATA ((uint64_t) 0xc0ffee03 << 32)
 
+/* Scan data register address fields */
+#define SCAN_DATA_SET_PULSE	REG_BIT(49)
+#define SCAN_DATA_BITS		REG_FIELD(56, 63)
+
 static int p10_chiplet_getring(struct chiplet *chiplet, uint64_t ring_addr, int64_t ring_len, uint32_t result[])
 {
 	uint64_t scan_type_addr;
@@ -422,14 +373,9 @@ static int p10_chiplet_getring(struct chiplet *chiplet, uint64_t ring_addr, int6
 
 	while (ring_len > 0) {
 		ring_len -= bits;
-		if (set_pulse) {
-			scan_data_addr |= 0x4000;
-			set_pulse = 0;
-		} else
-			scan_data_addr &= ~0x4000ULL;
-
-		scan_data_addr &= ~0xffull;
-		scan_data_addr |= bits;
+		scan_data_addr = field_set(SCAN_DATA_SET_PULSE, scan_data_addr, set_pulse);
+		scan_data_addr = field_set(SCAN_DATA_BITS, scan_data_addr, bits);
+		set_pulse = 0;
 		pib_read(&chiplet->target, scan_data_addr, &data);
 
 		/* Discard lower 32 bits */
@@ -471,9 +417,10 @@ static int p10_chiplet_probe(struct pdbg_target *target)
 	return 0;
 }
 
-static uint64_t p10_chiplet_translate(struct chiplet *chiplet, uint64_t addr)
+static void p10_chiplet_xlate(int index, struct scom_xlate *xlate)
 {
-	return set_chiplet_id(addr, pdbg_target_index(t(chiplet)));
+	scom_xlate_add(xlate, 0, 0, CHIPLET_ID_FIELD,
+		       scom_field(CHIPLET_ID_FIELD, index), false);
 }
 
 static struct chiplet p10_chiplet = {
@@ -482,7 +429,8 @@ static struct chiplet p10_chiplet = {
 		.compatible = "ibm,power10-chiplet",
 		.class = "chiplet",
 		.probe = p10_chiplet_probe,
-		.translate = translate_cast(p10_chiplet_translate),
+		.translate = scom_xlate_translate,
+		.xlate_build = p10_chiplet_xlate,
 	},
 	.getring = p10_chiplet_getring,
 };
@@ -493,7 +441,8 @@ static struct chiplet ody_chiplet = {
 		.name = "POWER Ody Chiplet",
 		.compatible = "ibm,ody-chiplet",
 		.class = "ody_chiplet",
-		.translate = translate_cast(p10_chiplet_translate),
+		.translate = scom_xlate_translate,
+		.xlate_build = p10_chiplet_xlate,
 	},
 	.getring = p10_chiplet_getring,
 };
@@ -529,7 +478,7 @@ static uint64_t p10_memport_translate(struct mem_port *memport, uint64_t addr)
 {
 	/*If this memport is a child of odyssey ocmb, we need to perform translation*/
 	struct pdbg_target *target = get_parent(t(memport), false);
-	if(strcmp(target->class,"ocmb") == 0)
+	if (target_is_class(target, TARGET_CLASS("ocmb")))
 	{
 		if(!is_ody_ocmb_chip(target))
 		{
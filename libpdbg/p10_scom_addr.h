@@ -59,77 +59,86 @@ enum {
         EQ7_CHIPLET_ID   = 0x27,    ///< Quad7 chiplet (super chiplet)
 };
 
+/* SCOM address fields, for use with scom_xlate rules */
+#define CHIPLET_ID_FIELD	0x000000003F000000ULL
+#define RING_ID_FIELD		0x0000000000003C00ULL	/* as read by get_ring_id() */
+#define RING_ID_SET_FIELD	0x000000000000FC00ULL	/* as written by set_ring_id() */
+#define SAT_ID_FIELD		0x00000000000003C0ULL
+#define SAT_OFFSET_FIELD	0x000000000000003FULL
+#define IO_LANE_FIELD		0x0000001F00000000ULL
+#define IO_GROUP_ADDR_FIELD	0x000003E000000000ULL
+
 /* Extract pervasive chiplet ID from SCOM address */
-static uint8_t get_chiplet_id(uint64_t addr)
+static inline uint8_t get_chiplet_id(uint64_t addr)
 {
 	return ((addr >> 24) & 0x3F);
 }
 
 /* Modify SCOM address to update pervasive chiplet ID */
-static uint64_t set_chiplet_id(uint64_t addr, uint8_t chiplet_id)
+static inline uint64_t set_chiplet_id(uint64_t addr, uint8_t chiplet_id)
 {
 	addr &= 0xFFFFFFFFC0FFFFFFULL;
 	addr |= ((chiplet_id & 0x3F) << 24);
 	return addr;
 }
 
-static uint8_t get_ring_id(uint64_t addr)
+static inline uint8_t get_ring_id(uint64_t addr)
 {
     return (addr >> 10) & 0xF;
 }
 
-static uint64_t set_ring_id(uint64_t addr, uint64_t ring)
+static inline uint64_t set_ring_id(uint64_t addr, uint64_t ring)
 {
     addr &= 0xFFFFFFFFFFFF03FFULL;
     addr |= ((ring & 0x3F) << 10);
     return addr;
 }
 
-static uint32_t get_io_lane(uint64_t addr)
+static inline uint32_t get_io_lane(uint64_t addr)
 {
     return (addr >> 32) & 0x1F;
 }
 
-static uint64_t set_io_lane(uint64_t addr, uint64_t lane)
+static inline uint64_t set_io_lane(uint64_t addr, uint64_t lane)
 {
     addr &= 0xFFFFFFE0FFFFFFFFULL;
     addr |= (lane & 0x1F) <<  32;
     return addr;
 }
 
-static uint64_t set_ody_ring_id(uint64_t addr, uint8_t ring)
+static inline uint64_t set_ody_ring_id(uint64_t addr, uint8_t ring)
 {
     addr &= 0xFFFFFFFFFFFFC3FFULL;
     addr |= ((ring & 0xF) << 10);
     return addr;
 }
 
-static uint8_t get_sat_id(uint64_t addr)
+static inline uint8_t get_sat_id(uint64_t addr)
 {
 	return ((addr >> 6) & 0xF);
 }
 
 /* Modify SCOM address to update satellite ID field */
-static uint64_t set_sat_id(uint64_t addr, uint8_t sat_id)
+static inline uint64_t set_sat_id(uint64_t addr, uint8_t sat_id)
 {
 	addr &= 0xFFFFFFFFFFFFFC3FULL;
 	addr |= ((sat_id & 0xF) << 6);
 	return addr;
 }
 
-static uint8_t get_sat_offset(uint64_t addr)
+static inline uint8_t get_sat_offset(uint64_t addr)
 {
 	return addr & 0x3F;
 }
 
-static uint64_t set_sat_offset(uint64_t addr, uint8_t sat_offset)
+static inline uint64_t set_sat_offset(uint64_t addr, uint8_t sat_offset)
 {
 	addr &= 0xFFFFFFFFFFFFFFC0ULL;
 	addr |= (sat_offset & 0x3F);
 	return addr;
 }
 
-static uint64_t set_io_group_addr(uint64_t addr, uint64_t group_addr)
+static inline uint64_t set_io_group_addr(uint64_t addr, uint64_t group_addr)
 {
     addr &= 0xFFFFFC1FFFFFFFFFULL;
     addr |= (group_addr & 0x1F) << 37;
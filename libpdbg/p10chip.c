@@ -21,6 +21,7 @@
 #include "operations.h"
 #include "chip.h"
 #include "debug.h"
+#include "poll.h"
 
 /*
  * NOTE!
@@ -39,19 +40,19 @@
 #define  SPECIAL_WKUP_DONE	PPC_BIT(1)
 #define QME_SPWU_FSP		0xE8834
 
-#define RAS_STATUS_TIMEOUT	100 /* 100ms */
-#define SPECIAL_WKUP_TIMEOUT	100 /* 100ms */
+#define RAS_STATUS_TIMEOUT_US	100000 /* 100ms */
+#define SPECIAL_WKUP_TIMEOUT_US	100000 /* 100ms */
 
 static int thread_read(struct thread *thread, uint64_t addr, uint64_t *data)
 {
-	struct pdbg_target *core = pdbg_target_require_parent("core", &thread->target);
+	struct pdbg_target *core = require_target_class_parent(TARGET_CLASS("core"), &thread->target, true);
 
 	return pib_read(core, addr, data);
 }
 
 static uint64_t thread_write(struct thread *thread, uint64_t addr, uint64_t data)
 {
-	struct pdbg_target *chip = pdbg_target_require_parent("core", &thread->target);
+	struct pdbg_target *chip = require_target_class_parent(TARGET_CLASS("core"), &thread->target, true);
 
 	return pib_write(chip, addr, data);
 }
@@ -125,7 +126,7 @@ static int p10_thread_probe(struct pdbg_target *target)
 
 static void p10_thread_release(struct pdbg_target *target)
 {
-	struct core *core = target_to_core(pdbg_target_require_parent("core", target));
+	struct core *core = target_to_core(require_target_class_parent(TARGET_CLASS("core"), target, true));
 	struct thread *thread = target_to_thread(target);
 
 	if (thread->status.quiesced)
@@ -152,19 +153,27 @@ static int p10_thread_start(struct thread *thread)
 	return 0;
 }
 
+static int p10_thread_quiesced(void *priv)
+{
+	struct thread *thread = priv;
+
+	thread->status = thread->state(thread);
+	return thread->status.quiesced;
+}
+
+static int p10_thread_stop_request(struct thread *thread)
+{
+	return thread_write(thread, P10_DIRECT_CONTROL, PPC_BIT(7 + 8*thread->id));
+}
+
 static int p10_thread_stop(struct thread *thread)
 {
-	int i = 0;
-
-	thread_write(thread, P10_DIRECT_CONTROL, PPC_BIT(7 + 8*thread->id));
-	do {
-		usleep(1000);
-		if (i++ > RAS_STATUS_TIMEOUT) {
-			PR_ERROR("Unable to quiesce thread\n");
-			return 1;
-		}
-		thread->status = thread->state(thread);
-	} while (!thread->status.quiesced);
+	CHECK_ERR(p10_thread_stop_request(thread));
+	if (poll_until_cancellable(p10_thread_quiesced, thread, RAS_STATUS_TIMEOUT_US,
+				   &poll_backoff_slow)) {
+		PR_ERROR("Unable to quiesce thread\n");
+		return 1;
+	}
 
 	return 0;
 }
@@ -193,15 +202,27 @@ static struct thread p10_thread = {
 	.state = p10_thread_state,
 	.start = p10_thread_start,
 	.stop = p10_thread_stop,
+	.stop_request = p10_thread_stop_request,
+	.quiesced = p10_thread_quiesced,
 	.sreset = p10_thread_sreset,
 };
 DECLARE_HW_UNIT(p10_thread);
 
+static int p10_spwkup_done(void *priv)
+{
+	struct pdbg_target *target = priv;
+	uint64_t value;
+
+	if (pib_read(target, QME_SSH_FSP, &value))
+		return -1;
+
+	return !!(value & SPECIAL_WKUP_DONE);
+}
+
 static int p10_core_probe(struct pdbg_target *target)
 {
 	struct core *core = target_to_core(target);
-	uint64_t value;
-	int i = 0;
+	int rc;
 
 	/*
 	 * BMC applications using libpdbg, do not need special wakeup
@@ -214,16 +235,19 @@ static int p10_core_probe(struct pdbg_target *target)
 	}
 
 	CHECK_ERR(pib_write(target, QME_SPWU_FSP, PPC_BIT(0)));
-	do {
-		usleep(1000);
-		CHECK_ERR(pib_read(target, QME_SSH_FSP, &value));
-
-		if (i++ > SPECIAL_WKUP_TIMEOUT) {
-			PR_ERROR("Timeout waiting for special wakeup on %s\n",
-				 pdbg_target_path(target));
-			break;
-		}
-	} while (!(value & SPECIAL_WKUP_DONE));
+	rc = poll_until_cancellable(p10_spwkup_done, target, SPECIAL_WKUP_TIMEOUT_US,
+				    &poll_backoff_slow);
+	if (rc == POLL_TIMEOUT && pdbg_cancelled())
+		rc = -1;
+
+	if (rc == POLL_TIMEOUT) {
+		PR_ERROR("Timeout waiting for special wakeup on %s\n",
+			 pdbg_target_path(target));
+	} else if (rc) {
+		/* The core won't be released, so drop special wakeup now */
+		pib_write(target, QME_SPWU_FSP, 0);
+		return rc;
+	}
 
 	core->release_spwkup = true;
 
@@ -263,33 +287,15 @@ static void p10_core_release(struct pdbg_target *target)
 #define NUM_CORES_PER_EQ 4
 #define EQ0_CHIPLET_ID 0x20
 
-static uint64_t p10_core_translate(struct core *c, uint64_t addr)
+static void p10_core_xlate(int index, struct scom_xlate *xlate)
 {
-	int region = 0;
-	int chip_unitnum = pdbg_target_index(&c->target);
-	int chiplet_id = EQ0_CHIPLET_ID + chip_unitnum / NUM_CORES_PER_EQ;
-
-	switch(chip_unitnum % NUM_CORES_PER_EQ) {
-	case 0:
-		region = 8;
-		break;
-	case 1:
-		region = 4;
-		break;
-	case 2:
-		region = 2;
-		break;
-	case 3:
-		region = 1;
-		break;
-	}
-	addr &= 0xFFFFFFFFC0FFFFFFULL;
-	addr |= ((chiplet_id & 0x3F) << 24);
-
-	addr &= 0xFFFFFFFFFFFF0FFFULL;
-	addr |= ((region & 0xF) << 12);
+	static const uint8_t region[NUM_CORES_PER_EQ] = { 8, 4, 2, 1 };
+	int chiplet_id = EQ0_CHIPLET_ID + index / NUM_CORES_PER_EQ;
 
-	return addr;
+	scom_xlate_add(xlate, 0, 0, 0x3F000000ULL | 0xF000ULL,
+		       scom_field(0x3F000000ULL, chiplet_id) |
+		       scom_field(0xF000ULL, region[index % NUM_CORES_PER_EQ]),
+		       false);
 }
 
 static struct core p10_core = {
@@ -299,7 +305,8 @@ static struct core p10_core = {
 		.class = "core",
 		.probe = p10_core_probe,
 		.release = p10_core_release,
-		.translate = translate_cast(p10_core_translate),
+		.translate = scom_xlate_translate,
+		.xlate_build = p10_core_xlate,
 	},
 };
 DECLARE_HW_UNIT(p10_core);
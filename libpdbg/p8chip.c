@@ -324,7 +324,7 @@ static void p8_ram_unquiesce_siblings(struct thread *thread)
 {
 	struct pdbg_target *target;
 	struct core *chip = target_to_core(
-		pdbg_target_require_parent("core", &thread->target));
+		require_target_class_parent(TARGET_CLASS("core"), &thread->target, true));
 
 	pdbg_for_each_compatible(&chip->target, target, "ibm,power8-thread") {
 		struct thread *tmp;
@@ -349,7 +349,7 @@ static int p8_ram_quiesce_siblings(struct thread *thread)
 {
 	struct pdbg_target *target;
 	struct core *chip = target_to_core(
-		pdbg_target_require_parent("core", &thread->target));
+		require_target_class_parent(TARGET_CLASS("core"), &thread->target, true));
 	int rc = 0;
 
 	pdbg_for_each_compatible(&chip->target, target, "ibm,power8-thread") {
@@ -380,7 +380,7 @@ static int p8_ram_setup(struct thread *thread)
 {
 	struct pdbg_target *target;
 	struct core *chip = target_to_core(
-		pdbg_target_require_parent("core", &thread->target));
+		require_target_class_parent(TARGET_CLASS("core"), &thread->target, true));
 	uint64_t ram_mode, val;
 
 	if (thread->ram_is_setup)
@@ -426,7 +426,7 @@ static int p8_ram_setup(struct thread *thread)
 static int p8_ram_instruction(struct thread *thread, uint64_t opcode, uint64_t *scratch)
 {
 	struct core *chip = target_to_core(
-		pdbg_target_require_parent("core", &thread->target));
+		require_target_class_parent(TARGET_CLASS("core"), &thread->target, true));
 	uint64_t val;
 
 	if (!thread->ram_is_setup)
@@ -462,7 +462,7 @@ static int p8_ram_instruction(struct thread *thread, uint64_t opcode, uint64_t *
 static int p8_ram_destroy(struct thread *thread)
 {
 	struct core *chip = target_to_core(
-		pdbg_target_require_parent("core", &thread->target));
+		require_target_class_parent(TARGET_CLASS("core"), &thread->target, true));
 	uint64_t val, ram_mode;
 
 	if (!(thread->state(thread).active)) {
@@ -529,7 +529,7 @@ static int p8_ram_putxer(struct thread *thread, uint64_t value)
 static int p8_get_hid0(struct pdbg_target *chip, uint64_t *value);
 static int emulate_sreset(struct thread *thread)
 {
-	struct pdbg_target *chip = pdbg_target_parent("core", &thread->target);
+	struct pdbg_target *chip = target_class_parent(TARGET_CLASS("core"), &thread->target, true);
 	uint64_t hid0;
 	uint64_t old_nia, old_msr;
 	uint64_t new_nia, new_msr;
@@ -600,7 +600,7 @@ static int p8_thread_probe(struct pdbg_target *target)
 
 static void p8_thread_release(struct pdbg_target *target)
 {
-	struct core *core = target_to_core(pdbg_target_require_parent("core", target));
+	struct core *core = target_to_core(require_target_class_parent(TARGET_CLASS("core"), target, true));
 	struct thread *thread = target_to_thread(target);
 
 	if (thread->status.quiesced)
@@ -22,6 +22,7 @@
 
 #include "hwunit.h"
 #include "bitutils.h"
+#include "regfield.h"
 #include "p9_scom_addr.h"
 
 #define t(x) (&(x)->target)
@@ -74,15 +75,12 @@ struct mba p9_mba = {
 };
 DECLARE_HW_UNIT(p9_mba);
 
-static uint64_t p9_mcs_translate(struct mcs *mcs, uint64_t addr)
+static void p9_mcs_xlate(int index, struct scom_xlate *xlate)
 {
-	uint32_t chiplet = N3_CHIPLET_ID - 2 * (pdbg_target_index(t(mcs)) / 2);
-	uint32_t sat = 2 * (pdbg_target_index(t(mcs)) % 2);
-
-	addr = set_chiplet_id(addr, chiplet);
-	addr = set_sat_id(addr, sat);
-
-	return addr;
+	scom_xlate_add(xlate, 0, 0, CHIPLET_ID_FIELD | SAT_ID_FIELD,
+		       scom_field(CHIPLET_ID_FIELD, N3_CHIPLET_ID - 2 * (index / 2)) |
+		       scom_field(SAT_ID_FIELD, 2 * (index % 2)),
+		       false);
 }
 
 struct mcs p9_mcs = {
@@ -90,7 +88,8 @@ struct mcs p9_mcs = {
                 .name = "POWER9 mcs",
                 .compatible = "ibm,power9-mcs",
                 .class = "mcs",
-		.translate = translate_cast(p9_mcs_translate),
+		.translate = scom_xlate_translate,
+		.xlate_build = p9_mcs_xlate,
         },
 };
 DECLARE_HW_UNIT(p9_mcs);
@@ -155,33 +154,35 @@ struct eq p9_eq = {
 };
 DECLARE_HW_UNIT(p9_eq);
 
-static uint64_t p9_mca_translate(struct mca *mca, uint64_t addr)
+static void p9_mca_xlate(int index, struct scom_xlate *xlate)
 {
-	int chiplet_unitnum = pdbg_target_index(t(mca));
-
-	if (get_chiplet_id(addr) == MC01_CHIPLET_ID ||
-	    get_chiplet_id(addr) ==  MC23_CHIPLET_ID) {
-		addr = set_chiplet_id(addr, MC01_CHIPLET_ID + chiplet_unitnum / 4);
-		if ((get_ring(addr) & 0xf) == MC_MC01_0_RING_ID)
-			/* mc */
-			return set_sat_id(addr, get_sat_id(addr) - get_sat_id(addr) % 4 +
-					  chiplet_unitnum % 4);
-		else
-			/* iomc */
-			return set_ring(addr, (MC_IOM01_0_RING_ID + chiplet_unitnum % 4) & 0xf);
-	} else {
-		//mcs->mca regisers
-		uint8_t mcs_unitnum = chiplet_unitnum / 2;
-		uint8_t mcs_sat_offset = get_sat_offset(addr) & 0x2f;
-
-		addr = set_chiplet_id(addr, N3_CHIPLET_ID - 2 * (mcs_unitnum / 2));
-		addr = set_sat_id(addr, 2 * (mcs_unitnum % 2));
-
-		mcs_sat_offset |= (chiplet_unitnum % 2) << 4;
-		addr = set_sat_offset(addr, mcs_sat_offset);
-
-		return addr;
+	uint64_t chiplet = scom_field(CHIPLET_ID_FIELD, MC01_CHIPLET_ID + index / 4);
+	uint8_t mcs_unitnum = index / 2;
+	int i;
+
+	for (i = MC01_CHIPLET_ID; i <= MC23_CHIPLET_ID; i++) {
+		uint64_t match = scom_field(CHIPLET_ID_FIELD, i);
+
+		/* mc: sat id = sat id - sat id % 4 + index % 4 */
+		scom_xlate_add(xlate, CHIPLET_ID_FIELD | scom_field(RING_FIELD, 0xf),
+			       match | scom_field(RING_FIELD, MC_MC01_0_RING_ID),
+			       CHIPLET_ID_FIELD | scom_field(SAT_ID_FIELD, 0x3),
+			       chiplet | scom_field(SAT_ID_FIELD, index % 4),
+			       true);
+
+		/* iomc */
+		scom_xlate_add(xlate, CHIPLET_ID_FIELD, match,
+			       CHIPLET_ID_FIELD | RING_FIELD,
+			       chiplet | scom_field(RING_FIELD, (MC_IOM01_0_RING_ID + index % 4) & 0xf),
+			       true);
 	}
+
+	/* mcs->mca registers */
+	scom_xlate_add(xlate, 0, 0, CHIPLET_ID_FIELD | SAT_ID_FIELD | 0x10,
+		       scom_field(CHIPLET_ID_FIELD, N3_CHIPLET_ID - 2 * (mcs_unitnum / 2)) |
+		       scom_field(SAT_ID_FIELD, 2 * (mcs_unitnum % 2)) |
+		       (index % 2) << 4,
+		       false);
 }
 
 struct mca p9_mca = {
@@ -189,7 +190,8 @@ struct mca p9_mca = {
                 .name = "POWER9 mca",
                 .compatible = "ibm,power9-mca",
                 .class = "mca",
-		.translate = translate_cast(p9_mca_translate),
+		.translate = scom_xlate_translate,
+		.xlate_build = p9_mca_xlate,
         },
 };
 DECLARE_HW_UNIT(p9_mca);
@@ -204,12 +206,12 @@ struct mcbist p9_mcbist = {
 DECLARE_HW_UNIT(p9_mcbist);
 
 /* TODO: This could be modelled directly under the N1/N3 chiplet */
-static uint64_t p9_mi_translate(struct mi *mi, uint64_t addr)
+static void p9_mi_xlate(int index, struct scom_xlate *xlate)
 {
-	int chip_unitnum = pdbg_target_index(t(mi));
-
-	addr = set_chiplet_id(addr, N3_CHIPLET_ID - 2 * (chip_unitnum / 2));
-	return set_sat_id(addr, 2 * (chip_unitnum % 2));
+	scom_xlate_add(xlate, 0, 0, CHIPLET_ID_FIELD | SAT_ID_FIELD,
+		       scom_field(CHIPLET_ID_FIELD, N3_CHIPLET_ID - 2 * (index / 2)) |
+		       scom_field(SAT_ID_FIELD, 2 * (index % 2)),
+		       false);
 }
 
 struct mi p9_mi = {
@@ -217,7 +219,8 @@ struct mi p9_mi = {
                 .name = "POWER9 mi",
                 .compatible = "ibm,power9-mi",
                 .class = "mi",
-		.translate = translate_cast(p9_mi_translate),
+		.translate = scom_xlate_translate,
+		.xlate_build = p9_mi_xlate,
         },
 };
 DECLARE_HW_UNIT(p9_mi);
@@ -473,12 +476,13 @@ struct ppe p9_ppe = {
 };
 DECLARE_HW_UNIT(p9_ppe);
 
-static uint64_t p9_pec_translate(struct pec *pec, uint64_t addr)
+static void p9_pec_xlate(int index, struct scom_xlate *xlate)
 {
-	if (get_chiplet_id(addr) == N2_CHIPLET_ID)
-		return set_ring(addr, (N2_PCIS0_0_RING_ID + pdbg_target_index(t(pec))) & 0xF);
-	else
-		return set_chiplet_id(addr, PCI0_CHIPLET_ID + pdbg_target_index(t(pec)));
+	scom_xlate_add(xlate, CHIPLET_ID_FIELD, scom_field(CHIPLET_ID_FIELD, N2_CHIPLET_ID),
+		       RING_FIELD, scom_field(RING_FIELD, (N2_PCIS0_0_RING_ID + index) & 0xF),
+		       true);
+	scom_xlate_add(xlate, 0, 0, CHIPLET_ID_FIELD,
+		       scom_field(CHIPLET_ID_FIELD, PCI0_CHIPLET_ID + index), false);
 }
 
 struct pec p9_pec = {
@@ -486,47 +490,42 @@ struct pec p9_pec = {
                 .name = "POWER9 pec",
                 .compatible = "ibm,power9-pec",
                 .class = "pec",
-		.translate = translate_cast(p9_pec_translate),
+		.translate = scom_xlate_translate,
+		.xlate_build = p9_pec_xlate,
         },
 };
 DECLARE_HW_UNIT(p9_pec);
 
-static uint64_t p9_phb_translate(struct phb *phb, uint64_t addr)
+static void p9_phb_xlate(int index, struct scom_xlate *xlate)
 {
-	int chip_unitnum = pdbg_target_index(t(phb));
-
-	if (get_chiplet_id(addr) == N2_CHIPLET_ID) {
-		// nest
-		if (chip_unitnum == 0)
-		{
-			addr = set_ring(addr, N2_PCIS0_0_RING_ID & 0xF);
-			addr = set_sat_id(addr, get_sat_id(addr) < 4 ? 1 : 4);
-
-			return addr;
-		} else {
-			addr = set_ring(addr, (N2_PCIS0_0_RING_ID + (chip_unitnum / 3) + 1) & 0xF);
-			addr = set_sat_id(addr, (get_sat_id(addr) < 4 ? 1 : 4) +
-					  (chip_unitnum % 2 ? 0 : 1) +
-					  (2 * (chip_unitnum / 5)));
-
-			return addr;
-		}
+	uint64_t n2 = scom_field(CHIPLET_ID_FIELD, N2_CHIPLET_ID);
+	uint64_t sat_hi = scom_field(SAT_ID_FIELD, 0xc);
+	uint64_t ring, chiplet;
+	int sat = 0;
+
+	if (index == 0) {
+		ring = scom_field(RING_FIELD, N2_PCIS0_0_RING_ID & 0xF);
+		chiplet = scom_field(CHIPLET_ID_FIELD, PCI0_CHIPLET_ID);
 	} else {
-		// pci
-		if (chip_unitnum == 0) {
-			addr = set_chiplet_id(addr, PCI0_CHIPLET_ID);
-			addr = set_sat_id(addr, (get_sat_id(addr) < 4 ? 1 : 4));
-
-			return addr;
-		} else {
-			addr = set_chiplet_id(addr, PCI0_CHIPLET_ID + (chip_unitnum / 3) + 1);
-			addr = set_sat_id(addr, (get_sat_id(addr) < 4 ? 1 : 4) +
-					  (chip_unitnum % 2 ? 0 : 1) +
-					  (2 * (chip_unitnum / 5)));
-
-			return addr;
-		}
+		ring = scom_field(RING_FIELD, (N2_PCIS0_0_RING_ID + (index / 3) + 1) & 0xF);
+		chiplet = scom_field(CHIPLET_ID_FIELD, PCI0_CHIPLET_ID + (index / 3) + 1);
+		sat = (index % 2 ? 0 : 1) + (2 * (index / 5));
 	}
+
+	/* nest, sat id < 4 */
+	scom_xlate_add(xlate, CHIPLET_ID_FIELD | sat_hi, n2,
+		       RING_FIELD | SAT_ID_FIELD,
+		       ring | scom_field(SAT_ID_FIELD, 1 + sat), true);
+	/* nest, sat id >= 4 */
+	scom_xlate_add(xlate, CHIPLET_ID_FIELD, n2,
+		       RING_FIELD | SAT_ID_FIELD,
+		       ring | scom_field(SAT_ID_FIELD, 4 + sat), true);
+
+	/* pci */
+	scom_xlate_add(xlate, sat_hi, 0, CHIPLET_ID_FIELD | SAT_ID_FIELD,
+		       chiplet | scom_field(SAT_ID_FIELD, 1 + sat), true);
+	scom_xlate_add(xlate, 0, 0, CHIPLET_ID_FIELD | SAT_ID_FIELD,
+		       chiplet | scom_field(SAT_ID_FIELD, 4 + sat), false);
 }
 
 struct phb p9_phb = {
@@ -534,7 +533,8 @@ struct phb p9_phb = {
                 .name = "POWER9 phb",
                 .compatible = "ibm,power9-phb",
                 .class = "phb",
-		.translate = translate_cast(p9_phb_translate),
+		.translate = scom_xlate_translate,
+		.xlate_build = p9_phb_xlate,
         },
 };
 DECLARE_HW_UNIT(p9_phb);
@@ -610,6 +610,10 @@ DECLARE_HW_UNIT(p9_pauc);
 
 #define HEADER_CHECK_DATA ((uint64_t) 0xc0ffee03 << 32)
 
+/* Scan data register address fields */
+#define SCAN_DATA_SET_PULSE	REG_BIT(49)
+#define SCAN_DATA_BITS		REG_FIELD(56, 63)
+
 static int p9_chiplet_getring(struct chiplet *chiplet, uint64_t ring_addr, int64_t ring_len, uint32_t result[])
 {
 	uint64_t scan_type_addr;
@@ -641,14 +645,9 @@ static int p9_chiplet_getring(struct chiplet *chiplet, uint64_t ring_addr, int64
 
 	while (ring_len > 0) {
 		ring_len -= bits;
-		if (set_pulse) {
-			scan_data_addr |= 0x4000;
-			set_pulse = 0;
-		} else
-			scan_data_addr &= ~0x4000ULL;
-
-		scan_data_addr &= ~0xffull;
-		scan_data_addr |= bits;
+		scan_data_addr = field_set(SCAN_DATA_SET_PULSE, scan_data_addr, set_pulse);
+		scan_data_addr = field_set(SCAN_DATA_BITS, scan_data_addr, bits);
+		set_pulse = 0;
 		pib_read(&chiplet->target, scan_data_addr, &data);
 
 		/* Discard lower 32 bits */
@@ -690,9 +689,10 @@ static int p9_chiplet_probe(struct pdbg_target *target)
         return 0;
 }
 
-static uint64_t p9_chiplet_translate(struct chiplet *chiplet, uint64_t addr)
+static void p9_chiplet_xlate(int index, struct scom_xlate *xlate)
 {
-	return set_chiplet_id(addr, pdbg_target_index(t(chiplet)));
+	scom_xlate_add(xlate, 0, 0, CHIPLET_ID_FIELD,
+		       scom_field(CHIPLET_ID_FIELD, index), false);
 }
 
 static struct chiplet p9_chiplet = {
@@ -701,7 +701,8 @@ static struct chiplet p9_chiplet = {
                 .compatible = "ibm,power9-chiplet",
                 .class = "chiplet",
                 .probe = p9_chiplet_probe,
-		.translate = translate_cast(p9_chiplet_translate),
+		.translate = scom_xlate_translate,
+		.xlate_build = p9_chiplet_xlate,
         },
 	.getring = p9_chiplet_getring,
 };
@@ -221,6 +221,12 @@ enum {
         OB_PPE_SAT_ID = 0x1
 };
 
+/* SCOM address fields, for use with scom_xlate rules */
+#define CHIPLET_ID_FIELD	0x000000003F000000ULL
+#define RING_FIELD		0x000000000000FC00ULL
+#define SAT_ID_FIELD		0x00000000000003C0ULL
+#define SAT_OFFSET_FIELD	0x000000000000003FULL
+
 /* Extract pervasive chiplet ID from SCOM address */
 static uint8_t get_chiplet_id(uint64_t addr)
 {
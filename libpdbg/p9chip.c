@@ -26,6 +26,7 @@
 #include "debug.h"
 #include "sprs.h"
 #include "chip.h"
+#include "poll.h"
 
 /*
  * NOTE!
@@ -73,19 +74,19 @@
 #define PPM_SSHFSP	0xf0111
 #define  SPECIAL_WKUP_DONE PPC_BIT(1)
 
-#define RAS_STATUS_TIMEOUT	100 /* 100ms */
-#define SPECIAL_WKUP_TIMEOUT	100 /* 100ms */
+#define RAS_STATUS_TIMEOUT_US	100000 /* 100ms */
+#define SPECIAL_WKUP_TIMEOUT_US	100000 /* 100ms */
 
 static uint64_t thread_read(struct thread *thread, uint64_t addr, uint64_t *data)
 {
-	struct pdbg_target *chip = pdbg_target_require_parent("core", &thread->target);
+	struct pdbg_target *chip = require_target_class_parent(TARGET_CLASS("core"), &thread->target, true);
 
 	return pib_read(chip, addr, data);
 }
 
 static uint64_t thread_write(struct thread *thread, uint64_t addr, uint64_t data)
 {
-	struct pdbg_target *chip = pdbg_target_require_parent("core", &thread->target);
+	struct pdbg_target *chip = require_target_class_parent(TARGET_CLASS("core"), &thread->target, true);
 
 	return pib_write(chip, addr, data);
 }
@@ -146,7 +147,7 @@ static int p9_thread_probe(struct pdbg_target *target)
 
 static void p9_thread_release(struct pdbg_target *target)
 {
-	struct core *core = target_to_core(pdbg_target_require_parent("core", target));
+	struct core *core = target_to_core(require_target_class_parent(TARGET_CLASS("core"), target, true));
 	struct thread *thread = target_to_thread(target);
 
 	if (thread->status.quiesced)
@@ -173,19 +174,27 @@ static int p9_thread_start(struct thread *thread)
 	return 0;
 }
 
-static int p9_thread_stop(struct thread *thread)
+static int p9_thread_quiesced(void *priv)
 {
-	int i = 0;
+	struct thread *thread = priv;
 
-	thread_write(thread, P9_DIRECT_CONTROL, PPC_BIT(7 + 8*thread->id));
-	do {
-		usleep(1000);
-		if (i++ > RAS_STATUS_TIMEOUT) {
-			PR_ERROR("Unable to quiesce thread\n");
-			return 1;
-		}
-		thread->status = thread->state(thread);
-	} while (!thread->status.quiesced);
+	thread->status = thread->state(thread);
+	return thread->status.quiesced;
+}
+
+static int p9_thread_stop_request(struct thread *thread)
+{
+	return thread_write(thread, P9_DIRECT_CONTROL, PPC_BIT(7 + 8*thread->id));
+}
+
+static int p9_thread_stop(struct thread *thread)
+{
+	CHECK_ERR(p9_thread_stop_request(thread));
+	if (poll_until_cancellable(p9_thread_quiesced, thread, RAS_STATUS_TIMEOUT_US,
+				   &poll_backoff_slow)) {
+		PR_ERROR("Unable to quiesce thread\n");
+		return 1;
+	}
 
 	return 0;
 }
@@ -244,7 +253,7 @@ static int p9_ram_setup(struct thread *thread)
 {
 	struct pdbg_target *target;
 	struct core *chip = target_to_core(
-		pdbg_target_require_parent("core", &thread->target));
+		require_target_class_parent(TARGET_CLASS("core"), &thread->target, true));
 	uint64_t value;
 
 	if (thread->ram_is_setup)
@@ -452,6 +461,8 @@ static struct thread p9_thread = {
 	.state = p9_thread_state,
 	.start = p9_thread_start,
 	.stop = p9_thread_stop,
+	.stop_request = p9_thread_stop_request,
+	.quiesced = p9_thread_quiesced,
 	.step = p9_thread_step,
 	.sreset = p9_thread_sreset,
 	.ram_setup = p9_ram_setup,
@@ -474,23 +485,36 @@ static struct thread p9_thread = {
 };
 DECLARE_HW_UNIT(p9_thread);
 
+static int p9_spwkup_done(void *priv)
+{
+	struct pdbg_target *target = priv;
+	uint64_t value;
+
+	if (pib_read(target, PPM_SSHFSP, &value))
+		return -1;
+
+	return !!(value & SPECIAL_WKUP_DONE);
+}
+
 static int p9_core_probe(struct pdbg_target *target)
 {
 	struct core *core = target_to_core(target);
-	int i = 0;
-	uint64_t value;
+	int rc;
 
 	CHECK_ERR(pib_write(target, PPM_SPWKUP_FSP, PPC_BIT(0)));
-	do {
-		usleep(1000);
-		CHECK_ERR(pib_read(target, PPM_SSHFSP, &value));
-
-		if (i++ > SPECIAL_WKUP_TIMEOUT) {
-			PR_ERROR("Timeout waiting for special wakeup on %s\n",
-				 pdbg_target_path(target));
-			break;
-		}
-	} while (!(value & SPECIAL_WKUP_DONE));
+	rc = poll_until_cancellable(p9_spwkup_done, target, SPECIAL_WKUP_TIMEOUT_US,
+				    &poll_backoff_slow);
+	if (rc == POLL_TIMEOUT && pdbg_cancelled())
+		rc = -1;
+
+	if (rc == POLL_TIMEOUT) {
+		PR_ERROR("Timeout waiting for special wakeup on %s\n",
+			 pdbg_target_path(target));
+	} else if (rc) {
+		/* The core won't be released, so drop special wakeup now */
+		pib_write(target, PPM_SPWKUP_FSP, 0);
+		return rc;
+	}
 
 	/* Child threads will set this to false if they are released while quiesced */
 	core->release_spwkup = true;
@@ -0,0 +1,161 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "libpdbg.h"
+#include "poll.h"
+
+const struct poll_backoff poll_backoff_fast = {
+	.spins = 8,
+	.yields = 8,
+	.min_sleep_us = 10,
+	.max_sleep_us = 1000,
+};
+
+const struct poll_backoff poll_backoff_slow = {
+	.spins = 1,
+	.yields = 0,
+	.min_sleep_us = 100,
+	.max_sleep_us = 100000,
+};
+
+static uint64_t poll_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int __poll_until_all(poll_fn fn, void **priv, int *status, int count,
+			    unsigned long timeout_us, const struct poll_backoff *backoff,
+			    bool cancellable)
+{
+	uint64_t now, deadline = 0;
+	unsigned int round, sleep_us;
+	int i, rc, pending, *result;
+	bool failed = false;
+
+	if (!backoff)
+		backoff = &poll_backoff_fast;
+
+	result = status;
+	if (!result) {
+		result = calloc(count, sizeof(*result));
+		if (!result)
+			return -1;
+	} else {
+		for (i = 0; i < count; i++)
+			result[i] = 0;
+	}
+
+	if (timeout_us)
+		deadline = poll_now_us() + timeout_us;
+
+	sleep_us = backoff->min_sleep_us;
+	for (round = 0; ; round++) {
+		pending = 0;
+		for (i = 0; i < count; i++) {
+			if (result[i])
+				continue;
+
+			rc = fn(priv[i]);
+			if (rc < 0) {
+				result[i] = rc;
+				failed = true;
+			} else if (rc > 0) {
+				result[i] = 1;
+			} else {
+				pending++;
+			}
+		}
+
+		if (!pending) {
+			rc = failed ? -1 : 0;
+			break;
+		}
+
+		now = poll_now_us();
+		if ((deadline && now >= deadline) || (cancellable && pdbg_cancelled())) {
+			rc = failed ? -1 : POLL_TIMEOUT;
+			break;
+		}
+
+		if (round < backoff->spins)
+			continue;
+
+		if (round < backoff->spins + backoff->yields) {
+			sched_yield();
+			continue;
+		}
+
+		/* Don't oversleep the deadline */
+		if (deadline && now + sleep_us > deadline)
+			usleep(deadline - now);
+		else
+			usleep(sleep_us);
+
+		sleep_us *= 2;
+		if (sleep_us > backoff->max_sleep_us)
+			sleep_us = backoff->max_sleep_us;
+	}
+
+	if (result != status)
+		free(result);
+
+	return rc;
+}
+
+int poll_until_all(poll_fn fn, void **priv, int *status, int count,
+		   unsigned long timeout_us, const struct poll_backoff *backoff)
+{
+	return __poll_until_all(fn, priv, status, count, timeout_us, backoff, false);
+}
+
+int poll_until_all_cancellable(poll_fn fn, void **priv, int *status, int count,
+			       unsigned long timeout_us, const struct poll_backoff *backoff)
+{
+	return __poll_until_all(fn, priv, status, count, timeout_us, backoff, true);
+}
+
+static int __poll_until(poll_fn fn, void *priv, unsigned long timeout_us,
+			const struct poll_backoff *backoff, bool cancellable)
+{
+	int status, rc;
+
+	rc = __poll_until_all(fn, &priv, &status, 1, timeout_us, backoff, cancellable);
+	if (rc < 0)
+		return status;
+
+	return rc;
+}
+
+int poll_until(poll_fn fn, void *priv, unsigned long timeout_us,
+	       const struct poll_backoff *backoff)
+{
+	return __poll_until(fn, priv, timeout_us, backoff, false);
+}
+
+int poll_until_cancellable(poll_fn fn, void *priv, unsigned long timeout_us,
+			   const struct poll_backoff *backoff)
+{
+	return __poll_until(fn, priv, timeout_us, backoff, true);
+}
@@ -0,0 +1,77 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBPDBG_POLL_H
+#define __LIBPDBG_POLL_H
+
+/* Returned by the poll functions if the deadline passed */
+#define POLL_TIMEOUT	1
+
+/*
+ * How to wait between polls. The condition is first polled back to back
+ * spins times, then yields times with a sched_yield() in between. After
+ * that the sleep between polls doubles from min_sleep_us up to
+ * max_sleep_us.
+ */
+struct poll_backoff {
+	unsigned int spins;
+	unsigned int yields;
+	unsigned int min_sleep_us;
+	unsigned int max_sleep_us;
+};
+
+/* For hardware which usually responds within a few accesses */
+extern const struct poll_backoff poll_backoff_fast;
+
+/* For state changes which take milliseconds or longer */
+extern const struct poll_backoff poll_backoff_slow;
+
+/*
+ * Poll callback. Returns 1 once the condition is met, 0 if it should be
+ * polled again and a negative value on error.
+ */
+typedef int (*poll_fn)(void *priv);
+
+/*
+ * Poll until fn(priv) returns non-zero or timeout_us have passed. A
+ * timeout of 0 waits forever. Returns 0 if the condition was met,
+ * POLL_TIMEOUT on timeout or the error returned by fn.
+ */
+int poll_until(poll_fn fn, void *priv, unsigned long timeout_us,
+	       const struct poll_backoff *backoff);
+
+/*
+ * Same as poll_until(), except that cancelling the calling thread (see
+ * pdbg_set_cancel()) also ends the poll as a timeout. Only for long
+ * waits which are safe to abandon, not for transport handshakes.
+ */
+int poll_until_cancellable(poll_fn fn, void *priv, unsigned long timeout_us,
+			   const struct poll_backoff *backoff);
+
+/*
+ * Same as poll_until() for count conditions which are all polled in
+ * each round. Conditions which are met or failed are not polled again.
+ * If status is not NULL it receives the result for each condition (1
+ * met, 0 timed out, negative on error). Returns 0 if all conditions were
+ * met, -1 if any failed and POLL_TIMEOUT otherwise.
+ */
+int poll_until_all(poll_fn fn, void **priv, int *status, int count,
+		   unsigned long timeout_us, const struct poll_backoff *backoff);
+
+/* Same as poll_until_all(), but ends early if cancelled */
+int poll_until_all_cancellable(poll_fn fn, void **priv, int *status, int count,
+			       unsigned long timeout_us, const struct poll_backoff *backoff);
+
+#endif
@@ -0,0 +1,91 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBPDBG_REGFIELD_H
+#define __LIBPDBG_REGFIELD_H
+
+#include <stdint.h>
+
+#include "bitutils.h"
+
+/*
+ * Type checked register field accessors.
+ *
+ * A field of a 64 bit register is described by its first and last PPC
+ * bit number:
+ *
+ *	#define HTM_MEM_SIZE	REG_FIELD(40, 48)
+ *
+ *	size = field_get(HTM_MEM_SIZE, val);
+ *	val = field_set(HTM_MEM_SIZE, val, size);
+ *
+ * Unlike GETFIELD()/SETFIELD() the shift is part of the descriptor, so
+ * it never has to be derived from the mask at runtime, and passing a
+ * plain mask or a value where a field is expected fails to compile.
+ * With constant descriptors every accessor compiles to a single shift
+ * and mask. Constant values which don't fit the field are reported at
+ * compile time.
+ */
+
+struct reg_field {
+	uint64_t mask;
+	unsigned int shift;
+};
+
+#define REG_FIELD(bs, be) \
+	((struct reg_field) { .mask = PPC_BITMASK(bs, be), .shift = PPC_BITLSHIFT(be) })
+
+/* A single bit field */
+#define REG_BIT(bit)	REG_FIELD(bit, bit)
+
+extern void __field_value_overflow(void)
+	__attribute__((error("value does not fit in register field")));
+
+/* Only generates code, and so an error, for constant values that don't fit */
+static inline void __field_check(struct reg_field f, uint64_t val)
+{
+	uint64_t overflow = val & ~(f.mask >> f.shift);
+
+	if (__builtin_constant_p(overflow) && overflow)
+		__field_value_overflow();
+}
+
+/* Extract field f from reg */
+static inline uint64_t field_get(struct reg_field f, uint64_t reg)
+{
+	return (reg & f.mask) >> f.shift;
+}
+
+/*
+ * These two are macros so the compiler folds the descriptor into the
+ * expression before optimising it. As inline functions GCC turns the
+ * masking into a longer xor/and/xor sequence.
+ */
+
+/* Return val placed in field f, with all other bits clear */
+#define field_prep(f, val)						\
+	({								\
+		struct reg_field __f = (f);				\
+		uint64_t __val = (val);					\
+									\
+		__field_check(__f, __val);				\
+		(__val << __f.shift) & __f.mask;			\
+	})
+
+/* Return reg with field f replaced by val */
+#define field_set(f, reg, val)						\
+	(((uint64_t)(reg) & ~(f).mask) | field_prep(f, val))
+
+#endif
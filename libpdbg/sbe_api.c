@@ -60,7 +60,15 @@ static struct chipop *pib_to_chipop(struct pdbg_target *pib)
 	struct pdbg_target *chipop;
 	uint32_t index;
 
-	assert(pdbg_target_is_class(pib, "pib"));
+	/* Found earlier with sbe_chipop_target() */
+	if (target_is_class(pib, TARGET_CLASS("chipop"))) {
+		if (pdbg_target_status(pib) != PDBG_TARGET_ENABLED)
+			return NULL;
+
+		return target_to_chipop(pib);
+	}
+
+	assert(target_is_class(pib, TARGET_CLASS("pib")));
 
 	if (pdbg_target_status(pib) != PDBG_TARGET_ENABLED)
 		return NULL;
@@ -78,6 +86,17 @@ static struct chipop *pib_to_chipop(struct pdbg_target *pib)
 	return NULL;
 }
 
+struct pdbg_target *sbe_chipop_target(struct pdbg_target *target)
+{
+	struct chipop *chipop;
+
+	chipop = pib_to_chipop(target);
+	if (!chipop)
+		return NULL;
+
+	return &chipop->target;
+}
+
 int sbe_istep(struct pdbg_target *target, uint32_t major, uint32_t minor)
 {
 	struct chipop *chipop;
@@ -92,6 +111,10 @@ int sbe_istep(struct pdbg_target *target, uint32_t major, uint32_t minor)
 		return -1;
 	}
 
+	/* A chip-op can't be interrupted once it has been sent */
+	if (pdbg_cancelled())
+		return -1;
+
 	rc = chipop->istep(chipop, major, minor);
 	if (rc) {
 		PR_ERROR("sbe istep() returned rc=%d\n", rc);
@@ -173,6 +196,9 @@ int sbe_mpipl_get_ti_info(struct pdbg_target *target, uint8_t **data, uint32_t *
 int sbe_dump(struct pdbg_target *target, uint8_t type, uint8_t clock,
 		uint8_t fa_collect, uint8_t **data, uint32_t *data_len)
 {
+	if (pdbg_cancelled())
+		return -1;
+
 	if(!is_ody_ocmb_chip(target)) {
 		struct chipop *chipop;
 		int rc;
@@ -212,6 +238,51 @@ int sbe_dump(struct pdbg_target *target, uint8_t type, uint8_t clock,
 	return 0;
 }
 
+int sbe_dump_fd(struct pdbg_target *target, uint8_t type, uint8_t clock,
+		uint8_t fa_collect, int fd, uint32_t *data_len)
+{
+	if (pdbg_cancelled())
+		return -1;
+
+	if(!is_ody_ocmb_chip(target)) {
+		struct chipop *chipop;
+		int rc;
+
+		chipop = pib_to_chipop(target);
+		if (!chipop)
+			return -1;
+
+		if (!chipop->dump_fd) {
+			PR_ERROR("dump_fd() not implemented for the target\n");
+			return -1;
+		}
+
+		rc = chipop->dump_fd(chipop, type, clock, fa_collect, fd, data_len);
+		if (rc) {
+			PR_ERROR("sbe dump_fd() returned rc=%d\n", rc);
+			return -1;
+		}
+	} else {
+		struct chipop_ody *chipop;
+		int rc;
+		struct pdbg_target *co_target = get_ody_chipop_target(target);
+		chipop = target_to_chipop_ody(co_target);
+		if (!chipop)
+			return -1;
+
+		if (!chipop->dump_fd) {
+			PR_ERROR("dump_fd() not implemented for the target\n");
+			return -1;
+		}
+		rc = chipop->dump_fd(chipop, type, clock, fa_collect, fd, data_len);
+		if (rc) {
+			PR_ERROR("sbe dump_fd() returned rc=%d\n", rc);
+			return -1;
+		}
+	}
+	return 0;
+}
+
 int sbe_ffdc_get(struct pdbg_target *target, uint32_t *status, uint8_t **ffdc,
 				uint32_t *ffdc_len)
 {
@@ -275,10 +346,10 @@ int sbe_ffdc_get(struct pdbg_target *target, uint32_t *status, uint8_t **ffdc,
 
 static int sbe_read_msg_register(struct pdbg_target *pib, uint32_t *value)
 {
-	struct pdbg_target *fsi = pdbg_target_parent_virtual("fsi", pib);
+	struct pdbg_target *fsi = target_class_parent(TARGET_CLASS("fsi"), pib, false);
 	int rc;
 
-	assert(pdbg_target_is_class(pib, "pib"));
+	assert(target_is_class(pib, TARGET_CLASS("pib")));
 	assert(fsi);
 
 	if (pdbg_target_status(pib) != PDBG_TARGET_ENABLED)
@@ -295,10 +366,10 @@ static int sbe_read_msg_register(struct pdbg_target *pib, uint32_t *value)
 
 static int sbe_read_state_register(struct pdbg_target *pib, uint32_t *value)
 {
-	struct pdbg_target *fsi = pdbg_target_parent_virtual("fsi", pib);
+	struct pdbg_target *fsi = target_class_parent(TARGET_CLASS("fsi"), pib, false);
 	int rc;
 
-	assert(pdbg_target_is_class(pib, "pib"));
+	assert(target_is_class(pib, TARGET_CLASS("pib")));
 	assert(fsi);
 
 	if (pdbg_target_status(pib) != PDBG_TARGET_ENABLED)
@@ -318,7 +389,7 @@ static int sbe_ody_read_msg_register(struct pdbg_target *fsi, uint32_t *value)
 	int rc;
 
 	assert(fsi);
-	assert(pdbg_target_is_class(fsi, "fsi-ody"));
+	assert(target_is_class(fsi, TARGET_CLASS("fsi-ody")));
 
 	if (pdbg_target_status(fsi) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -337,7 +408,7 @@ static int sbe_ody_read_state_register(struct pdbg_target *fsi, uint32_t *value)
 	int rc;
 
 	assert(fsi);
-	assert(pdbg_target_is_class(fsi, "fsi-ody"));
+	assert(target_is_class(fsi, TARGET_CLASS("fsi-ody")));
 
 	if (pdbg_target_status(fsi) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -352,10 +423,10 @@ static int sbe_ody_read_state_register(struct pdbg_target *fsi, uint32_t *value)
 
 static int sbe_write_state_register(struct pdbg_target *pib, uint32_t value)
 {
-	struct pdbg_target *fsi = pdbg_target_parent_virtual("fsi", pib);
+	struct pdbg_target *fsi = target_class_parent(TARGET_CLASS("fsi"), pib, false);
 	int rc;
 
-	assert(pdbg_target_is_class(pib, "pib"));
+	assert(target_is_class(pib, TARGET_CLASS("pib")));
 	assert(fsi);
 
 	if (pdbg_target_status(pib) != PDBG_TARGET_ENABLED)
@@ -375,7 +446,7 @@ static int sbe_ody_write_state_register(struct pdbg_target *fsi, uint32_t value)
 	int rc;
 
 	assert(fsi);
-	assert(pdbg_target_is_class(fsi, "fsi-ody"));
+	assert(target_is_class(fsi, TARGET_CLASS("fsi-ody")));
 
 	if (pdbg_target_status(fsi) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -19,6 +19,8 @@
 #include <stdlib.h>
 #include <inttypes.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <string.h>
 
 #include <libsbefifo/libsbefifo.h>
 
@@ -27,6 +29,8 @@
 #include "sprs.h"
 #include "chip.h"
 #include "bitutils.h"
+#include "stats.h"
+#include "trace.h"
 
 #define SBE_MSG_REG	0x2809
 #define   SBE_MSG_ASYNC_FFDC PPC_BIT32(1)
@@ -168,7 +172,7 @@ static int sbefifo_op_putmem_pba(struct mem *sbefifo_mem,
 
 static uint32_t sbefifo_op_ffdc_get(struct chipop *chipop, const uint8_t **ffdc, uint32_t *ffdc_len)
 {
-	struct pdbg_target *fsi = pdbg_target_require_parent("fsi", &chipop->target);
+	struct pdbg_target *fsi = require_target_class_parent(TARGET_CLASS("fsi"), &chipop->target, true);
 	struct sbefifo *sbefifo = target_to_sbefifo(chipop->target.parent);
 	struct sbefifo_context *sctx = sbefifo->get_sbefifo_context(sbefifo);
 	uint32_t status, value = 0;
@@ -190,6 +194,8 @@ static uint32_t sbefifo_op_ffdc_get(struct chipop *chipop, const uint8_t **ffdc,
 		goto end;
 	}
 
+	/* The caller wants this FFDC back, so fetching it can't be left to
+	 * the FFDC capture thread. It is captured like any other FFDC. */
 	if ((value & SBE_MSG_ASYNC_FFDC) == SBE_MSG_ASYNC_FFDC) {
 		sbefifo_get_ffdc(sbefifo->sf_ctx);
 		return sbefifo_ffdc_get(sctx, ffdc, ffdc_len);
@@ -227,6 +233,8 @@ static uint32_t sbefifo_op_ody_ffdc_get(struct chipop_ody *chipop, struct pdbg_t
 		goto end;
 	}
 
+	/* The caller wants this FFDC back, so fetching it can't be left to
+	 * the FFDC capture thread. It is captured like any other FFDC. */
 	if ((value & SBE_MSG_ASYNC_FFDC) == SBE_MSG_ASYNC_FFDC) {
 		sbefifo_get_ffdc(sbefifo->sf_ctx);
 		return sbefifo_ffdc_get(sctx, ffdc, ffdc_len);
@@ -288,6 +296,22 @@ static int sbefifo_op_ody_dump(struct chipop_ody *chipop, uint8_t type, uint8_t
 	return sbefifo_get_dump(sctx, type, clock, fa_collect, data, data_len);
 }
 
+static int sbefifo_op_dump_fd(struct chipop *chipop, uint8_t type, uint8_t clock, uint8_t fa_collect, int fd, uint32_t *data_len)
+{
+	struct sbefifo *sbefifo = target_to_sbefifo(chipop->target.parent);
+	struct sbefifo_context *sctx = sbefifo->get_sbefifo_context(sbefifo);
+
+	return sbefifo_get_dump_fd(sctx, type, clock, fa_collect, fd, data_len);
+}
+
+static int sbefifo_op_ody_dump_fd(struct chipop_ody *chipop, uint8_t type, uint8_t clock, uint8_t fa_collect, int fd, uint32_t *data_len)
+{
+	struct sbefifo *sbefifo = target_to_sbefifo(chipop->target.parent);
+	struct sbefifo_context *sctx = sbefifo->get_sbefifo_context(sbefifo);
+
+	return sbefifo_get_dump_fd(sctx, type, clock, fa_collect, fd, data_len);
+}
+
 static int sbefifo_op_lpc_timeout(struct chipop *chipop, uint32_t *timeout_flag)
 {
 	struct sbefifo *sbefifo = target_to_sbefifo(chipop->target.parent);
@@ -419,10 +443,10 @@ static uint8_t sbefifo_core_id(struct sbefifo_context *sctx, struct thread *thre
 
 	if (sbefifo_proc(sctx) == SBEFIFO_PROC_P9)
 		/* P9 uses pervasive (chiplet) id as core-id */
-		parent = pdbg_target_require_parent("chiplet", &thread->target);
+		parent = require_target_class_parent(TARGET_CLASS("chiplet"), &thread->target, true);
 	else
 		/* P10 uses core id as core-id */
-		parent = pdbg_target_require_parent("core", &thread->target);
+		parent = require_target_class_parent(TARGET_CLASS("core"), &thread->target, true);
 
 	return pdbg_target_index(parent) & 0xff;
 }
@@ -443,7 +467,7 @@ static void sbefifo_thread_release(struct pdbg_target *target)
 
 static int sbefifo_thread_op(struct thread *thread, uint32_t oper)
 {
-	struct pdbg_target *pib = pdbg_target_require_parent("pib", &thread->target);
+	struct pdbg_target *pib = require_target_class_parent(TARGET_CLASS("pib"), &thread->target, true);
 	struct sbefifo *sbefifo = pib_to_sbefifo(pib);
 	struct sbefifo_context *sctx = sbefifo->get_sbefifo_context(sbefifo);
 	uint8_t mode = 0;
@@ -467,7 +491,7 @@ static int sbefifo_thread_op(struct thread *thread, uint32_t oper)
 
 static struct thread_state sbefifo_thread_state(struct thread *thread)
 {
-	struct pdbg_target *pib = pdbg_target_require_parent("pib", &thread->target);
+	struct pdbg_target *pib = require_target_class_parent(TARGET_CLASS("pib"), &thread->target, true);
 	struct sbefifo *sbefifo = pib_to_sbefifo(pib);
 	struct sbefifo_context *sctx = sbefifo->get_sbefifo_context(sbefifo);
 
@@ -544,81 +568,26 @@ static int sbefifo_thread_sreset(struct thread *thread)
 	return rc;
 }
 
-static int sbefifo_thread_getregs(struct thread *thread, struct thread_regs *regs)
-{
-	struct pdbg_target *pib = pdbg_target_require_parent("pib", &thread->target);
-	struct sbefifo *sbefifo = pib_to_sbefifo(pib);
-	struct sbefifo_context *sctx = sbefifo->get_sbefifo_context(sbefifo);
-	uint32_t reg_id[34];
-	uint64_t *value;
-	uint8_t core_id;
-	int ret, i;
-
-	for (i=0; i<32; i++)
-		reg_id[i] = i;
-
-	core_id = sbefifo_core_id(sctx, thread);
-
-	ret = sbefifo_register_get(sctx,
-				   core_id,
-				   thread->id,
-				   SBEFIFO_REGISTER_TYPE_GPR,
-				   reg_id,
-				   32,
-				   &value);
-	if (ret)
-		return ret;
+#define SBEFIFO_NUM_GPRS	32
+#define SBEFIFO_NUM_SPRS	34
 
-	for (i=0; i<32; i++)
-		regs->gprs[i] = value[i];
-
-	free(value);
-
-	reg_id[0] = SPR_NIA;
-	reg_id[1] = SPR_MSR;
-	reg_id[2] = SPR_CFAR;
-	reg_id[3] = SPR_LR;
-	reg_id[4] = SPR_CTR;
-	reg_id[5] = SPR_TAR;
-	reg_id[6] = SPR_CR;
-	reg_id[7] = SPR_XER;
-	reg_id[8] = SPR_LPCR;
-	reg_id[9] = SPR_PTCR;
-	reg_id[10] = SPR_LPIDR;
-	reg_id[11] = SPR_PIDR;
-	reg_id[12] = SPR_HFSCR;
-	reg_id[13] = SPR_HDSISR;
-	reg_id[14] = SPR_HDAR;
-	reg_id[15] = SPR_HSRR0;
-	reg_id[16] = SPR_HSRR1;
-	reg_id[17] = SPR_HDEC;
-	reg_id[18] = SPR_HEIR;
-	reg_id[19] = SPR_HID;
-	reg_id[20] = SPR_HSPRG0;
-	reg_id[21] = SPR_HSPRG1;
-	reg_id[22] = SPR_FSCR;
-	reg_id[23] = SPR_DSISR;
-	reg_id[24] = SPR_DAR;
-	reg_id[25] = SPR_SRR0;
-	reg_id[26] = SPR_SRR1;
-	reg_id[27] = SPR_DEC;
-	reg_id[28] = SPR_TB;
-	reg_id[29] = SPR_SPRG0;
-	reg_id[30] = SPR_SPRG1;
-	reg_id[31] = SPR_SPRG2;
-	reg_id[32] = SPR_SPRG3;
-	reg_id[33] = SPR_PPR;
+static uint32_t sbefifo_gpr_ids[SBEFIFO_NUM_GPRS] = {
+	 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+	16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+};
 
-	ret = sbefifo_register_get(sctx,
-				   core_id,
-				   thread->id,
-				   SBEFIFO_REGISTER_TYPE_SPR,
-				   reg_id,
-				   34,
-				   &value);
-	if (ret)
-		return ret;
+/* The order must match sbefifo_unpack_sprs() */
+static uint32_t sbefifo_spr_ids[SBEFIFO_NUM_SPRS] = {
+	SPR_NIA, SPR_MSR, SPR_CFAR, SPR_LR, SPR_CTR, SPR_TAR, SPR_CR,
+	SPR_XER, SPR_LPCR, SPR_PTCR, SPR_LPIDR, SPR_PIDR, SPR_HFSCR,
+	SPR_HDSISR, SPR_HDAR, SPR_HSRR0, SPR_HSRR1, SPR_HDEC, SPR_HEIR,
+	SPR_HID, SPR_HSPRG0, SPR_HSPRG1, SPR_FSCR, SPR_DSISR, SPR_DAR,
+	SPR_SRR0, SPR_SRR1, SPR_DEC, SPR_TB, SPR_SPRG0, SPR_SPRG1,
+	SPR_SPRG2, SPR_SPRG3, SPR_PPR,
+};
 
+static void sbefifo_unpack_sprs(uint64_t *value, struct thread_regs *regs)
+{
 	regs->nia = value[0];
 	regs->msr = value[1];
 	regs->cfar = value[2];
@@ -653,15 +622,110 @@ static int sbefifo_thread_getregs(struct thread *thread, struct thread_regs *reg
 	regs->sprg2 = value[31];
 	regs->sprg3 = value[32];
 	regs->ppr = value[33];
+}
+
+/*
+ * Read the GPRs and SPRs of count threads using a single batch of register
+ * chip-ops. GPRs are read straight into regs, SPRs go via the caller
+ * provided sprs buffer (SBEFIFO_NUM_SPRS entries per thread).
+ */
+static int sbefifo_threads_getregs(struct sbefifo_context *sctx,
+				   struct thread **threads,
+				   struct thread_regs **regs,
+				   uint64_t *sprs,
+				   int *rc,
+				   int count)
+{
+	struct sbefifo_register_request *req;
+	int i, ret;
+
+	req = calloc(count * 2, sizeof(*req));
+	if (!req) {
+		for (i = 0; i < count; i++)
+			rc[i] = ENOMEM;
+		return ENOMEM;
+	}
+
+	for (i = 0; i < count; i++) {
+		uint8_t core_id = sbefifo_core_id(sctx, threads[i]);
+
+		req[i*2] = (struct sbefifo_register_request) {
+			.core_id = core_id,
+			.thread_id = threads[i]->id,
+			.reg_type = SBEFIFO_REGISTER_TYPE_GPR,
+			.reg_count = SBEFIFO_NUM_GPRS,
+			.reg_id = sbefifo_gpr_ids,
+			.value = regs[i]->gprs,
+		};
+
+		req[i*2+1] = (struct sbefifo_register_request) {
+			.core_id = core_id,
+			.thread_id = threads[i]->id,
+			.reg_type = SBEFIFO_REGISTER_TYPE_SPR,
+			.reg_count = SBEFIFO_NUM_SPRS,
+			.reg_id = sbefifo_spr_ids,
+			.value = &sprs[i * SBEFIFO_NUM_SPRS],
+		};
+	}
+
+	ret = sbefifo_register_get_list(sctx, req, count * 2);
+
+	for (i = 0; i < count; i++) {
+		rc[i] = req[i*2].rc ? req[i*2].rc : req[i*2+1].rc;
+		if (!rc[i])
+			sbefifo_unpack_sprs(&sprs[i * SBEFIFO_NUM_SPRS], regs[i]);
+	}
+
+	free(req);
+	return ret;
+}
+
+static int sbefifo_thread_getregs(struct thread *thread, struct thread_regs *regs)
+{
+	struct pdbg_target *pib = require_target_class_parent(TARGET_CLASS("pib"), &thread->target, true);
+	struct sbefifo *sbefifo = pib_to_sbefifo(pib);
+	struct sbefifo_context *sctx = sbefifo->get_sbefifo_context(sbefifo);
+	uint64_t sprs[SBEFIFO_NUM_SPRS];
+	int rc;
 
-	free(value);
+	sbefifo_threads_getregs(sctx, &thread, &regs, sprs, &rc, 1);
+
+	return rc;
+}
+
+static int sbefifo_pib_thread_getregs(struct pib *pib, struct thread **threads,
+				      struct thread_regs **regs, int *rc,
+				      int count)
+{
+	struct sbefifo *sbefifo = pib_to_sbefifo(&pib->target);
+	struct sbefifo_context *sctx = sbefifo->get_sbefifo_context(sbefifo);
+	uint64_t *sprs;
+	int i;
+
+	/* Only threads driven by the SBEFIFO backend can be batched */
+	for (i = 0; i < count; i++)
+		if (threads[i]->getregs != sbefifo_thread_getregs)
+			break;
+
+	sprs = malloc(count * SBEFIFO_NUM_SPRS * sizeof(*sprs));
+	if (i < count || !sprs) {
+		for (i = 0; i < count; i++)
+			rc[i] = threads[i]->getregs(threads[i], regs[i]);
+	} else {
+		sbefifo_threads_getregs(sctx, threads, regs, sprs, rc, count);
+	}
+	free(sprs);
+
+	for (i = 0; i < count; i++)
+		if (rc[i])
+			return -1;
 
 	return 0;
 }
 
 static int sbefifo_thread_get_reg(struct thread *thread, uint8_t reg_type, uint32_t reg_id, uint64_t *value)
 {
-	struct pdbg_target *pib = pdbg_target_require_parent("pib", &thread->target);
+	struct pdbg_target *pib = require_target_class_parent(TARGET_CLASS("pib"), &thread->target, true);
 	struct sbefifo *sbefifo = pib_to_sbefifo(pib);
 	struct sbefifo_context *sctx = sbefifo->get_sbefifo_context(sbefifo);
 	uint64_t *v;
@@ -688,7 +752,7 @@ static int sbefifo_thread_get_reg(struct thread *thread, uint8_t reg_type, uint3
 
 static int sbefifo_thread_put_reg(struct thread *thread, uint8_t reg_type, uint32_t reg_id, uint64_t value)
 {
-	struct pdbg_target *pib = pdbg_target_require_parent("pib", &thread->target);
+	struct pdbg_target *pib = require_target_class_parent(TARGET_CLASS("pib"), &thread->target, true);
 	struct sbefifo *sbefifo = pib_to_sbefifo(pib);
 	struct sbefifo_context *sctx = sbefifo->get_sbefifo_context(sbefifo);
 	uint8_t core_id;
@@ -829,6 +893,52 @@ static struct sbefifo_context *sbefifo_op_get_context(struct sbefifo *sbefifo)
 	return sbefifo->sf_ctx;
 }
 
+/* Size of the ring FFDC is queued in until it's written out */
+#define SBEFIFO_FFDC_RING_SIZE	(1024 * 1024)
+
+/*
+ * With PDBG_FFDC_DIR set all FFDC returned by the SBE is appended to a
+ * file per sbefifo in that directory, eg. proc0-sbefifo.ffdc, by a
+ * background thread (see sbefifo_ffdc_capture_start()).
+ */
+static void sbefifo_ffdc_capture(struct sbefifo *sf, struct pdbg_target *target)
+{
+	const char *dir, *path;
+	char file[PATH_MAX], *p;
+	int fd, rc;
+
+	dir = getenv("PDBG_FFDC_DIR");
+	if (!dir || !*dir)
+		return;
+
+	path = pdbg_target_path(target);
+	if (*path == '/')
+		path++;
+
+	if (snprintf(file, sizeof(file), "%s/%s.ffdc", dir, path) >= sizeof(file))
+		return;
+
+	for (p = file + strlen(dir) + 1; *p; p++) {
+		if (*p == '/')
+			*p = '-';
+	}
+
+	fd = open(file, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		PR_ERROR("Unable to open %s for FFDC: %s\n", file, strerror(errno));
+		return;
+	}
+
+	rc = sbefifo_ffdc_capture_start(sf->sf_ctx, fd, SBEFIFO_FFDC_RING_SIZE);
+	if (rc) {
+		PR_ERROR("Unable to start FFDC capture: %s\n", strerror(rc));
+		close(fd);
+		return;
+	}
+
+	PR_DEBUG("Capturing FFDC of %s in %s\n", pdbg_target_path(target), file);
+}
+
 static int sbefifo_probe(struct pdbg_target *target)
 {
 	struct sbefifo *sf = target_to_sbefifo(target);
@@ -858,16 +968,45 @@ static int sbefifo_probe(struct pdbg_target *target)
 		return rc;
 	}
 
+	stats_sbefifo_attach(sf->sf_ctx, target);
+	trace_sbefifo_attach(sf->sf_ctx, target);
+	sbefifo_ffdc_capture(sf, target);
+
 	return 0;
 }
 
 static void sbefifo_release(struct pdbg_target *target)
 {
+	struct sbefifo *sf = target_to_sbefifo(target);
+
 	/*
 	 * FIXME: Need to add reference counting for sbefifo context, so it is
 	 * not freed till every last hwunit using sbefifo driver has been
 	 * released.
 	 */
+
+	/* Make sure all FFDC captured so far ends up on disk */
+	if (sf->sf_ctx)
+		sbefifo_ffdc_capture_stop(sf->sf_ctx);
+}
+
+static int sbefifo_mem_probe(struct pdbg_target *target)
+{
+	struct mem *mem = target_to_mem(target);
+
+	/* Memory chip-ops are used on more than one processor */
+	switch (pdbg_get_proc()) {
+	case PDBG_PROC_P9:
+	case PDBG_PROC_P10:
+		mem->mmio_base = P9_MMIO_BASE;
+		break;
+
+	default:
+		mem->mmio_base = 0;
+		break;
+	}
+
+	return 0;
 }
 
 static struct mem sbefifo_mem = {
@@ -875,6 +1014,7 @@ static struct mem sbefifo_mem = {
 		.name = "SBE FIFO Chip-op based memory access",
 		.compatible = "ibm,sbefifo-mem",
 		.class = "mem",
+		.probe = sbefifo_mem_probe,
 	},
 	.read = sbefifo_op_getmem,
 	.write = sbefifo_op_putmem,
@@ -886,6 +1026,7 @@ static struct mem sbefifo_pba = {
 		.name = "SBE FIFO Chip-op based memory access",
 		.compatible = "ibm,sbefifo-mem-pba",
 		.class = "mem",
+		.probe = sbefifo_mem_probe,
 	},
 	.read = sbefifo_op_getmem_pba,
 	.write = sbefifo_op_putmem_pba,
@@ -904,6 +1045,7 @@ static struct chipop sbefifo_chipop = {
 	.mpipl_continue = sbefifo_op_mpipl_continue,
 	.mpipl_get_ti_info = sbefifo_op_mpipl_get_ti_info,
 	.dump = sbefifo_op_dump,
+	.dump_fd = sbefifo_op_dump_fd,
 	.lpc_timeout = sbefifo_op_lpc_timeout,
 };
 DECLARE_HW_UNIT(sbefifo_chipop);
@@ -915,6 +1057,7 @@ static struct chipop_ody sbefifo_chipop_ody = {
 		.class = "chipop-ody",
 	},
 	.dump = sbefifo_op_ody_dump,
+	.dump_fd = sbefifo_op_ody_dump_fd,
 	.ffdc_get = sbefifo_op_ody_ffdc_get,
 };
 DECLARE_HW_UNIT(sbefifo_chipop_ody);
@@ -931,6 +1074,7 @@ static struct pib sbefifo_pib = {
 	.thread_stop_all = sbefifo_pib_thread_stop,
 	.thread_step_all = sbefifo_pib_thread_step,
 	.thread_sreset_all = sbefifo_pib_thread_sreset,
+	.thread_getregs_all = sbefifo_pib_thread_getregs,
 	.fd = -1,
 };
 DECLARE_HW_UNIT(sbefifo_pib);
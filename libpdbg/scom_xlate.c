@@ -0,0 +1,103 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <assert.h>
+#include <string.h>
+
+#include "target.h"
+#include "scom_xlate.h"
+
+void scom_xlate_add(struct scom_xlate *xlate, uint64_t mask, uint64_t match,
+		    uint64_t clear, uint64_t set, bool last)
+{
+	struct scom_xlate_rule *rule;
+
+	assert(xlate->count < SCOM_XLATE_MAX_RULES);
+	assert((match & ~mask) == 0);
+	assert((set & ~clear) == 0);
+
+	rule = &xlate->rule[xlate->count++];
+	rule->mask = mask;
+	rule->match = match;
+	rule->clear = clear;
+	rule->set = set;
+	rule->last = last ? ~0ULL : 0;
+}
+
+void scom_xlate_add_range(struct scom_xlate *xlate, uint64_t mask, uint64_t match,
+			  uint64_t field, uint64_t lo, uint64_t hi,
+			  uint64_t clear, uint64_t set, bool last)
+{
+	uint64_t field_max = field >> __builtin_ctzll(field);
+
+	assert(lo <= hi && hi <= field_max);
+
+	/* Split lo..hi into naturally aligned power of two sized blocks,
+	 * each of which can be matched with a single mask */
+	while (lo <= hi) {
+		uint64_t size = lo ? lo & -lo : field_max + 1;
+
+		while (lo + size - 1 > hi)
+			size >>= 1;
+
+		scom_xlate_add(xlate, mask | (field & ~scom_field(field, size - 1)),
+			       match | scom_field(field, lo), clear, set, last);
+		lo += size;
+	}
+}
+
+static const struct scom_xlate *scom_xlate_get(struct pdbg_target *target)
+{
+	struct pdbg_target_class *target_class;
+	int index = pdbg_target_index(target);
+
+	if (target->xlate && target->xlate->index == index)
+		return target->xlate;
+
+	if (!target->xlate) {
+		target_class = target->target_class;
+		assert(target_class);
+
+		target->xlate = arena_zalloc(&target_class->arena, sizeof(*target->xlate));
+		assert(target->xlate);
+	}
+
+	memset(target->xlate, 0, sizeof(*target->xlate));
+	target->xlate->index = index;
+	target->xlate_build(index, target->xlate);
+
+	return target->xlate;
+}
+
+uint64_t scom_xlate_translate(struct pdbg_target *target, uint64_t addr)
+{
+	return scom_xlate_addr(scom_xlate_get(target), addr);
+}
+
+void scom_xlate_list(struct pdbg_target *target, uint64_t *addr, int count)
+{
+	const struct scom_xlate *xlate;
+	int i;
+
+	if (!target->xlate_build) {
+		for (i = 0; i < count; i++)
+			addr[i] = target->translate(target, addr[i]);
+		return;
+	}
+
+	xlate = scom_xlate_get(target);
+	for (i = 0; i < count; i++)
+		addr[i] = scom_xlate_addr(xlate, addr[i]);
+}
@@ -0,0 +1,105 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBPDBG_SCOM_XLATE_H
+#define __LIBPDBG_SCOM_XLATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct pdbg_target;
+
+/*
+ * Table driven chip unit SCOM address translation.
+ *
+ * Instead of open coding the translation of a chip unit address a
+ * hardware unit can provide a function that describes it as a list of
+ * rules for a given chip unit number. Each rule is matched against the
+ * untranslated address and, if (addr & mask) == match, replaces the
+ * clear bits of the translated address with set. Rules are applied in
+ * order and a matching rule marked last stops any further rules from
+ * applying, which is how else branches are expressed.
+ *
+ * The rules are compiled once per target and evaluated without
+ * branching, so many addresses can be translated in bulk with
+ * scom_xlate_list().
+ */
+
+#define SCOM_XLATE_MAX_RULES	16
+
+struct scom_xlate_rule {
+	uint64_t mask;
+	uint64_t match;
+	uint64_t clear;
+	uint64_t set;
+	uint64_t last;
+};
+
+struct scom_xlate {
+	int index;
+	int count;
+	struct scom_xlate_rule rule[SCOM_XLATE_MAX_RULES];
+};
+
+/* Builds the translation rules for chip unit number index */
+typedef void (*scom_xlate_build_t)(int index, struct scom_xlate *xlate);
+
+/* Place value into the (contiguous) address field given by mask */
+static inline uint64_t scom_field(uint64_t mask, uint64_t value)
+{
+	return (value << __builtin_ctzll(mask)) & mask;
+}
+
+/* Add a rule. A mask of 0 matches every address. */
+void scom_xlate_add(struct scom_xlate *xlate, uint64_t mask, uint64_t match,
+		    uint64_t clear, uint64_t set, bool last);
+
+/*
+ * Add a rule which additionally requires the value of address field
+ * to be within lo..hi (inclusive). The range is split into as many
+ * rules as required.
+ */
+void scom_xlate_add_range(struct scom_xlate *xlate, uint64_t mask, uint64_t match,
+			  uint64_t field, uint64_t lo, uint64_t hi,
+			  uint64_t clear, uint64_t set, bool last);
+
+/* Translate a single address with the given rules */
+static inline uint64_t scom_xlate_addr(const struct scom_xlate *xlate, uint64_t addr)
+{
+	uint64_t out = addr, done = 0;
+	int i;
+
+	for (i = 0; i < xlate->count; i++) {
+		const struct scom_xlate_rule *rule = &xlate->rule[i];
+		uint64_t hit = -(uint64_t)((addr & rule->mask) == rule->match) & ~done;
+
+		out = (out & ~(rule->clear & hit)) | (rule->set & hit);
+		done |= hit & rule->last;
+	}
+
+	return out;
+}
+
+/* Translate hook for hardware units providing an xlate_build function */
+uint64_t scom_xlate_translate(struct pdbg_target *target, uint64_t addr);
+
+/*
+ * Translate count addresses in place using the translate hook of
+ * target. Falls back to calling target->translate() for each address
+ * if the target does not provide translation rules.
+ */
+void scom_xlate_list(struct pdbg_target *target, uint64_t *addr, int count);
+
+#endif
@@ -0,0 +1,234 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <ccan/array_size/array_size.h>
+
+#include <libsbefifo/libsbefifo.h>
+
+#include "target.h"
+#include "stats.h"
+#include "debug.h"
+
+/*
+ * Operation statistics are kept per (operation, hardware unit) pair.
+ * The class and compatible strings of a target point into the static
+ * hardware unit description it was created from, so they outlive the
+ * device tree and identify the backend without any copying.
+ */
+
+#define STATS_MAX_ENTRIES	256
+#define STATS_HASH_SIZE		512
+
+bool pdbg_stats_active;
+__thread unsigned int stats_retries;
+
+static struct pdbg_stats stats_table[STATS_MAX_ENTRIES];
+static int stats_count;
+static bool stats_overflow;
+
+/* Operations may be accounted from several threads at once */
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Index + 1 into stats_table, 0 for an empty slot */
+static uint16_t stats_hash[STATS_HASH_SIZE];
+
+static const char *stats_op_names[] = {
+	[PDBG_STATS_FSI_READ]	= "fsi_read",
+	[PDBG_STATS_FSI_WRITE]	= "fsi_write",
+	[PDBG_STATS_PIB_READ]	= "pib_read",
+	[PDBG_STATS_PIB_WRITE]	= "pib_write",
+	[PDBG_STATS_MEM_READ]	= "mem_read",
+	[PDBG_STATS_MEM_WRITE]	= "mem_write",
+	[PDBG_STATS_SBEFIFO_OP]	= "sbefifo_operation",
+	[PDBG_STATS_RAM_INSN]	= "ram_instruction",
+};
+
+static __attribute__((constructor)) void stats_init(void)
+{
+	const char *env = getenv("PDBG_STATS");
+
+	if (env && *env && strcmp(env, "0"))
+		pdbg_stats_active = true;
+}
+
+void pdbg_stats_enable(bool enable)
+{
+	pdbg_stats_active = enable;
+	stats_retries = 0;
+}
+
+bool pdbg_stats_enabled(void)
+{
+	return pdbg_stats_active;
+}
+
+void pdbg_stats_reset(void)
+{
+	pthread_mutex_lock(&stats_lock);
+	memset(stats_table, 0, sizeof(stats_table));
+	memset(stats_hash, 0, sizeof(stats_hash));
+	stats_count = 0;
+	stats_overflow = false;
+	stats_retries = 0;
+	pthread_mutex_unlock(&stats_lock);
+}
+
+const char *pdbg_stats_op_name(enum pdbg_stats_op op)
+{
+	if (op >= ARRAY_SIZE(stats_op_names))
+		return NULL;
+
+	return stats_op_names[op];
+}
+
+static struct pdbg_stats *stats_lookup(enum pdbg_stats_op op, struct pdbg_target *target)
+{
+	struct pdbg_stats *stats;
+	uintptr_t key = (uintptr_t)target->compatible;
+	unsigned int slot;
+
+	slot = ((key >> 4) * 31 + op) % STATS_HASH_SIZE;
+	while (stats_hash[slot]) {
+		stats = &stats_table[stats_hash[slot] - 1];
+		if (stats->op == op && stats->backend == target->compatible)
+			return stats;
+
+		slot = (slot + 1) % STATS_HASH_SIZE;
+	}
+
+	if (stats_count == STATS_MAX_ENTRIES) {
+		if (!stats_overflow)
+			PR_DEBUG("Too many different operations, not recording %s on %s\n",
+				 stats_op_names[op], target->compatible);
+		stats_overflow = true;
+		return NULL;
+	}
+
+	stats = &stats_table[stats_count++];
+	stats_hash[slot] = stats_count;
+
+	stats->op = op;
+	stats->class = target->class;
+	stats->backend = target->compatible;
+	stats->min_ns = UINT64_MAX;
+
+	return stats;
+}
+
+uint64_t __stats_start(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void stats_add(enum pdbg_stats_op op, struct pdbg_target *target,
+		      uint64_t ns, uint64_t bytes, int rc)
+{
+	struct pdbg_stats *stats;
+	int bucket;
+
+	pthread_mutex_lock(&stats_lock);
+	stats = stats_lookup(op, target);
+	if (!stats) {
+		pthread_mutex_unlock(&stats_lock);
+		return;
+	}
+
+	stats->count++;
+	if (rc)
+		stats->errors++;
+	stats->retries += stats_retries;
+	stats_retries = 0;
+	stats->bytes += bytes;
+
+	stats->total_ns += ns;
+	if (ns < stats->min_ns)
+		stats->min_ns = ns;
+	if (ns > stats->max_ns)
+		stats->max_ns = ns;
+
+	bucket = 63 - __builtin_clzll(ns | 1);
+	if (bucket >= PDBG_STATS_HIST_BUCKETS)
+		bucket = PDBG_STATS_HIST_BUCKETS - 1;
+	stats->hist[bucket]++;
+	pthread_mutex_unlock(&stats_lock);
+}
+
+void __stats_record(enum pdbg_stats_op op, struct pdbg_target *target,
+		    uint64_t start, uint64_t bytes, int rc)
+{
+	/* Enabled half way through an operation */
+	if (!start)
+		return;
+
+	stats_add(op, target, __stats_start() - start, bytes, rc);
+}
+
+static void stats_sbefifo_op(uint32_t cmd, uint32_t msg_len, uint32_t reply_len,
+			     uint64_t time_ns, int rc, void *priv)
+{
+	if (pdbg_stats_active)
+		stats_add(PDBG_STATS_SBEFIFO_OP, priv, time_ns, msg_len + reply_len, rc);
+}
+
+void stats_sbefifo_attach(struct sbefifo_context *sctx, struct pdbg_target *target)
+{
+	sbefifo_set_op_callback(sctx, stats_sbefifo_op, &pdbg_stats_active, target);
+}
+
+int pdbg_stats_foreach(pdbg_stats_cb_t fn, void *priv)
+{
+	int i, rc;
+
+	for (i = 0; i < stats_count; i++) {
+		rc = fn(&stats_table[i], priv);
+		if (rc)
+			return rc;
+	}
+
+	return 0;
+}
+
+uint64_t pdbg_stats_percentile(const struct pdbg_stats *stats, unsigned int percent)
+{
+	uint64_t want, seen = 0;
+	int i;
+
+	if (!stats->count)
+		return 0;
+
+	want = (stats->count * percent + 99) / 100;
+	if (!want)
+		want = 1;
+
+	for (i = 0; i < PDBG_STATS_HIST_BUCKETS - 1; i++) {
+		seen += stats->hist[i];
+		if (seen >= want)
+			break;
+	}
+
+	/* Upper bound of the bucket, but never more than was seen */
+	if (i == PDBG_STATS_HIST_BUCKETS - 1 || (2ULL << i) > stats->max_ns)
+		return stats->max_ns;
+
+	return 2ULL << i;
+}
@@ -0,0 +1,64 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBPDBG_STATS_H
+#define __LIBPDBG_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "libpdbg.h"
+
+struct sbefifo_context;
+
+extern bool pdbg_stats_active;
+
+uint64_t __stats_start(void);
+void __stats_record(enum pdbg_stats_op op, struct pdbg_target *target,
+		    uint64_t start, uint64_t bytes, int rc);
+
+/*
+ * Returns a start timestamp for stats_record(). Nothing is measured,
+ * and so no clock is read, unless statistics are enabled.
+ */
+static inline uint64_t stats_start(void)
+{
+	return pdbg_stats_active ? __stats_start() : 0;
+}
+
+/*
+ * Account an operation on the target implementing it. Retries counted
+ * with stats_retry() since the last recorded operation are attributed
+ * to this one.
+ */
+static inline void stats_record(enum pdbg_stats_op op, struct pdbg_target *target,
+				uint64_t start, uint64_t bytes, int rc)
+{
+	if (pdbg_stats_active)
+		__stats_record(op, target, start, bytes, rc);
+}
+
+extern __thread unsigned int stats_retries;
+
+static inline void stats_retry(void)
+{
+	if (pdbg_stats_active)
+		stats_retries++;
+}
+
+/* Account every operation on sctx against target */
+void stats_sbefifo_attach(struct sbefifo_context *sctx, struct pdbg_target *target);
+
+#endif
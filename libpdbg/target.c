@@ -1,8 +1,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <inttypes.h>
 #include <assert.h>
+#include <pthread.h>
 #include <ccan/list/list.h>
 #include <libfdt.h>
 
@@ -10,21 +12,26 @@
 #include "hwunit.h"
 #include "operations.h"
 #include "debug.h"
+#include "poll.h"
+#include "stats.h"
+#include "trace.h"
 
 struct list_head empty_list = LIST_HEAD_INIT(empty_list);
 struct list_head target_classes = LIST_HEAD_INIT(target_classes);
 
 /* Work out the address to access based on the current target and
- * final class name */
-static struct pdbg_target *get_class_target_addr(struct pdbg_target *target, const char *name, uint64_t *addr)
+ * final class */
+static struct pdbg_target *get_class_target_addr(struct pdbg_target *target,
+						 struct pdbg_target_class *target_class,
+						 uint64_t *addr)
 {
 	uint64_t old_addr = *addr;
 
 	/* Check class */
-	while (strcmp(target->class, name)) {
+	while (!target_is_class(target, target_class)) {
 		if (target->translate) {
 			*addr = target->translate(target, *addr);
-			target = target_parent(name, target, false);
+			target = target_class_parent(target_class, target, false);
 			assert(target);
 			break;
 		} else {
@@ -46,7 +53,7 @@ static struct pdbg_target *get_class_target_addr(struct pdbg_target *target, con
 
 struct pdbg_target *pdbg_address_absolute(struct pdbg_target *target, uint64_t *addr)
 {
-	return get_class_target_addr(target, "pib", addr);
+	return get_class_target_addr(target, TARGET_CLASS("pib"), addr);
 }
 
 /* The indirect access code was largely stolen from hw/xscom.c in skiboot */
@@ -75,6 +82,9 @@ static int pib_indirect_read(struct pib *pib, uint64_t addr, uint64_t *data)
 
 	/* Wait for completion */
 	for (retries = 0; retries < PIB_IND_MAX_RETRIES; retries++) {
+		if (retries)
+			stats_retry();
+
 		CHECK_ERR(pib->read(pib, indirect_addr, data));
 
 		if ((*data & PIB_DATA_IND_COMPLETE) &&
@@ -110,6 +120,9 @@ static int pib_indirect_write(struct pib *pib, uint64_t addr, uint64_t data)
 
 	/* Wait for completion */
 	for (retries = 0; retries < PIB_IND_MAX_RETRIES; retries++) {
+		if (retries)
+			stats_retry();
+
 		CHECK_ERR(pib->read(pib, indirect_addr, &data));
 
 		if ((data & PIB_DATA_IND_COMPLETE) &&
@@ -130,9 +143,10 @@ int pib_read(struct pdbg_target *pib_dt, uint64_t addr, uint64_t *data)
 {
 	struct pib *pib;
 	uint64_t target_addr = addr;
+	uint64_t start, tstart;
 	int rc;
 
-	pib_dt = get_class_target_addr(pib_dt, "pib", &target_addr);
+	pib_dt = get_class_target_addr(pib_dt, TARGET_CLASS("pib"), &target_addr);
 
 	if (pdbg_target_status(pib_dt) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -144,10 +158,16 @@ int pib_read(struct pdbg_target *pib_dt, uint64_t addr, uint64_t *data)
 		return -1;
 	}
 
-	if (target_addr & PPC_BIT(0))
+	start = stats_start();
+	tstart = trace_begin();
+	if (trace_replaying())
+		rc = trace_replay(TRACE_PIB_READ, &pib->target, target_addr, data, 8);
+	else if (target_addr & PPC_BIT(0))
 		rc = pib_indirect_read(pib, target_addr, data);
 	else
 		rc = pib->read(pib, target_addr, data);
+	trace_end(TRACE_PIB_READ, &pib->target, target_addr, data, 8, tstart, rc);
+	stats_record(PDBG_STATS_PIB_READ, &pib->target, start, 8, rc);
 
 	PR_DEBUG("rc = %d, addr = 0x%016" PRIx64 ", data = 0x%016" PRIx64 ", target = %s\n",
 		 rc, target_addr, *data, pdbg_target_path(&pib->target));
@@ -155,10 +175,76 @@ int pib_read(struct pdbg_target *pib_dt, uint64_t addr, uint64_t *data)
 	return rc;
 }
 
+int pib_read_list(struct pdbg_target *pib_dt, const uint64_t *addr, uint64_t *data, int count, int *rc)
+{
+	struct pdbg_target *target;
+	struct pib *pib = NULL;
+	uint64_t *target_addr;
+	int i, done = 0, ret = 0;
+
+	if (count <= 0)
+		return 0;
+
+	/* Traces are kept in terms of single reads */
+	if (trace_replaying())
+		goto fallback;
+
+	target_addr = malloc(count * sizeof(*target_addr));
+	if (!target_addr)
+		goto fallback;
+
+	for (i = 0; i < count; i++) {
+		target_addr[i] = addr[i];
+		target = get_class_target_addr(pib_dt, TARGET_CLASS("pib"), &target_addr[i]);
+
+		/* Indirect SCOMs need their own read/poll sequence */
+		if (target_addr[i] & PPC_BIT(0))
+			break;
+
+		if (!pib)
+			pib = target_to_pib(target);
+		else if (pib != target_to_pib(target))
+			break;
+	}
+
+	if (i == count && pdbg_target_status(&pib->target) == PDBG_TARGET_ENABLED &&
+	    pib->read_list) {
+		uint64_t start = stats_start();
+		uint64_t tstart = trace_begin();
+
+		done = pib->read_list(pib, target_addr, data, count);
+		if (done < 0)
+			done = 0;
+		trace_end_read_list(&pib->target, target_addr, data, done, tstart);
+		stats_record(PDBG_STATS_PIB_READ, &pib->target, start, 8 * done,
+			     done == count ? 0 : -1);
+		PR_DEBUG("read %d of %d registers from %s\n", done, count,
+			 pdbg_target_path(&pib->target));
+	}
+	free(target_addr);
+
+fallback:
+	/* The registers the backend didn't get to are read one by one, so
+	 * a single failing register doesn't prevent reading the others */
+	for (i = 0; i < count; i++) {
+		int err = 0;
+
+		if (i >= done)
+			err = pib_read(pib_dt, addr[i], &data[i]);
+		if (rc)
+			rc[i] = err;
+		if (err)
+			ret = -1;
+	}
+
+	return ret;
+}
+
 int pib_ody_read(struct pdbg_target *pib_dt, uint64_t addr, uint64_t *data)
 {
 	struct pib *pib;
 	uint64_t target_addr = addr;
+	uint64_t start, tstart;
 	int rc;
 	if (pdbg_target_status(pib_dt) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -170,10 +256,16 @@ int pib_ody_read(struct pdbg_target *pib_dt, uint64_t addr, uint64_t *data)
 		return -1;
 	}
 
-	if (target_addr & PPC_BIT(0))
+	start = stats_start();
+	tstart = trace_begin();
+	if (trace_replaying())
+		rc = trace_replay(TRACE_PIB_READ, &pib->target, target_addr, data, 8);
+	else if (target_addr & PPC_BIT(0))
 		rc = pib_indirect_read(pib, target_addr, data);
 	else
 		rc = pib->read(pib, target_addr, data);
+	trace_end(TRACE_PIB_READ, &pib->target, target_addr, data, 8, tstart, rc);
+	stats_record(PDBG_STATS_PIB_READ, &pib->target, start, 8, rc);
 
 	PR_DEBUG("rc = %d, addr = 0x%016" PRIx64 ", data = 0x%016" PRIx64 ", target = %s\n",
 		 rc, target_addr, *data, pdbg_target_path(&pib->target));
@@ -185,9 +277,10 @@ int pib_write(struct pdbg_target *pib_dt, uint64_t addr, uint64_t data)
 {
 	struct pib *pib;
 	uint64_t target_addr = addr;
+	uint64_t start, tstart;
 	int rc;
 
-	pib_dt = get_class_target_addr(pib_dt, "pib", &target_addr);
+	pib_dt = get_class_target_addr(pib_dt, TARGET_CLASS("pib"), &target_addr);
 
 	if (pdbg_target_status(pib_dt) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -201,10 +294,16 @@ int pib_write(struct pdbg_target *pib_dt, uint64_t addr, uint64_t data)
 
 	PR_DEBUG("addr:0x%08" PRIx64 " data:0x%016" PRIx64 "\n",
 		 target_addr, data);
-	if (target_addr & PPC_BIT(0))
+	start = stats_start();
+	tstart = trace_begin();
+	if (trace_replaying())
+		rc = trace_replay(TRACE_PIB_WRITE, &pib->target, target_addr, &data, 8);
+	else if (target_addr & PPC_BIT(0))
 		rc = pib_indirect_write(pib, target_addr, data);
 	else
 		rc = pib->write(pib, target_addr, data);
+	trace_end(TRACE_PIB_WRITE, &pib->target, target_addr, &data, 8, tstart, rc);
+	stats_record(PDBG_STATS_PIB_WRITE, &pib->target, start, 8, rc);
 
 	PR_DEBUG("rc = %d, addr = 0x%016" PRIx64 ", data = 0x%016" PRIx64 ", target = %s\n",
 		 rc, target_addr, data, pdbg_target_path(&pib->target));
@@ -216,6 +315,7 @@ int pib_ody_write(struct pdbg_target *pib_dt, uint64_t addr, uint64_t data)
 {
 	struct pib *pib;
 	uint64_t target_addr = addr;
+	uint64_t start, tstart;
 	int rc;
 
 	if (pdbg_target_status(pib_dt) != PDBG_TARGET_ENABLED)
@@ -230,10 +330,16 @@ int pib_ody_write(struct pdbg_target *pib_dt, uint64_t addr, uint64_t data)
 
 	PR_DEBUG("addr:0x%08" PRIx64 " data:0x%016" PRIx64 "\n",
 		 target_addr, data);
-	if (target_addr & PPC_BIT(0))
+	start = stats_start();
+	tstart = trace_begin();
+	if (trace_replaying())
+		rc = trace_replay(TRACE_PIB_WRITE, &pib->target, target_addr, &data, 8);
+	else if (target_addr & PPC_BIT(0))
 		rc = pib_indirect_write(pib, target_addr, data);
 	else
 		rc = pib->write(pib, target_addr, data);
+	trace_end(TRACE_PIB_WRITE, &pib->target, target_addr, &data, 8, tstart, rc);
+	stats_record(PDBG_STATS_PIB_WRITE, &pib->target, start, 8, rc);
 
 	PR_DEBUG("rc = %d, addr = 0x%016" PRIx64 ", data = 0x%016" PRIx64 ", target = %s\n",
 		 rc, target_addr, data, pdbg_target_path(&pib->target));
@@ -255,14 +361,39 @@ int pib_write_mask(struct pdbg_target *pib_dt, uint64_t addr, uint64_t data, uin
 	return pib_write(pib_dt, addr, value);
 }
 
+#define PIB_WAIT_TIMEOUT_US	1000000
+
+struct pib_wait_poll {
+	struct pib *pib;
+	uint64_t addr;
+	uint64_t mask;
+	uint64_t data;
+};
+
+static int pib_wait_done(void *priv)
+{
+	struct pib_wait_poll *p = priv;
+	uint64_t tmp;
+	int rc;
+
+	if (p->addr & PPC_BIT(0))
+		rc = pib_indirect_read(p->pib, p->addr, &tmp);
+	else
+		rc = p->pib->read(p->pib, p->addr, &tmp);
+	if (rc)
+		return -1;
+
+	return (tmp & p->mask) == p->data;
+}
+
 /* Wait for a SCOM register addr to match value & mask == data */
 int pib_wait(struct pdbg_target *pib_dt, uint64_t addr, uint64_t mask, uint64_t data)
 {
+	struct pib_wait_poll poll;
 	struct pib *pib;
-	uint64_t tmp;
 	int rc;
 
-	pib_dt = get_class_target_addr(pib_dt, "pib", &addr);
+	pib_dt = get_class_target_addr(pib_dt, TARGET_CLASS("pib"), &addr);
 
 	if (pdbg_target_status(pib_dt) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -274,16 +405,18 @@ int pib_wait(struct pdbg_target *pib_dt, uint64_t addr, uint64_t mask, uint64_t
 		return -1;
 	}
 
-	do {
-		if (addr & PPC_BIT(0))
-			rc = pib_indirect_read(pib, addr, &tmp);
-		else
-			rc = pib->read(pib, addr, &tmp);
-		if (rc)
-			return rc;
-	} while ((tmp & mask) != data);
+	poll.pib = pib;
+	poll.addr = addr;
+	poll.mask = mask;
+	poll.data = data;
+	rc = poll_until(pib_wait_done, &poll, PIB_WAIT_TIMEOUT_US, &poll_backoff_fast);
+	if (rc == POLL_TIMEOUT) {
+		PR_ERROR("Timeout waiting for 0x%016" PRIx64 " on %s\n",
+			 addr, pdbg_target_path(pib_dt));
+		return -1;
+	}
 
-	return 0;
+	return rc;
 }
 
 int opb_read(struct pdbg_target *opb_dt, uint32_t addr, uint32_t *data)
@@ -291,7 +424,7 @@ int opb_read(struct pdbg_target *opb_dt, uint32_t addr, uint32_t *data)
 	struct opb *opb;
 	uint64_t addr64 = addr;
 
-	opb_dt = get_class_target_addr(opb_dt, "opb", &addr64);
+	opb_dt = get_class_target_addr(opb_dt, TARGET_CLASS("opb"), &addr64);
 
 	if (pdbg_target_status(opb_dt) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -311,7 +444,7 @@ int opb_write(struct pdbg_target *opb_dt, uint32_t addr, uint32_t data)
 	struct opb *opb;
 	uint64_t addr64 = addr;
 
-	opb_dt = get_class_target_addr(opb_dt, "opb", &addr64);
+	opb_dt = get_class_target_addr(opb_dt, TARGET_CLASS("opb"), &addr64);
 
 	if (pdbg_target_status(opb_dt) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -330,8 +463,9 @@ int fsi_read(struct pdbg_target *fsi_dt, uint32_t addr, uint32_t *data)
 	struct fsi *fsi;
 	int rc;
 	uint64_t addr64 = addr;
+	uint64_t start, tstart;
 
-	fsi_dt = get_class_target_addr(fsi_dt, "fsi", &addr64);
+	fsi_dt = get_class_target_addr(fsi_dt, TARGET_CLASS("fsi"), &addr64);
 	fsi = target_to_fsi(fsi_dt);
 
 	if (!fsi->read) {
@@ -339,7 +473,14 @@ int fsi_read(struct pdbg_target *fsi_dt, uint32_t addr, uint32_t *data)
 		return -1;
 	}
 
-	rc = fsi->read(fsi, addr64, data);
+	start = stats_start();
+	tstart = trace_begin();
+	if (trace_replaying())
+		rc = trace_replay(TRACE_FSI_READ, &fsi->target, addr64, data, 4);
+	else
+		rc = fsi->read(fsi, addr64, data);
+	trace_end(TRACE_FSI_READ, &fsi->target, addr64, data, 4, tstart, rc);
+	stats_record(PDBG_STATS_FSI_READ, &fsi->target, start, 4, rc);
 	PR_DEBUG("rc = %d, addr = 0x%05" PRIx64 ", data = 0x%08" PRIx32 ", target = %s\n",
 		 rc, addr64, *data, pdbg_target_path(&fsi->target));
 	return rc;
@@ -350,8 +491,9 @@ int fsi_write(struct pdbg_target *fsi_dt, uint32_t addr, uint32_t data)
 	struct fsi *fsi;
 	int rc;
 	uint64_t addr64 = addr;
+	uint64_t start, tstart;
 
-	fsi_dt = get_class_target_addr(fsi_dt, "fsi", &addr64);
+	fsi_dt = get_class_target_addr(fsi_dt, TARGET_CLASS("fsi"), &addr64);
 	fsi = target_to_fsi(fsi_dt);
 
 	if (!fsi->write) {
@@ -359,7 +501,14 @@ int fsi_write(struct pdbg_target *fsi_dt, uint32_t addr, uint32_t data)
 		return -1;
 	}
 
-	rc = fsi->write(fsi, addr64, data);
+	start = stats_start();
+	tstart = trace_begin();
+	if (trace_replaying())
+		rc = trace_replay(TRACE_FSI_WRITE, &fsi->target, addr64, &data, 4);
+	else
+		rc = fsi->write(fsi, addr64, data);
+	trace_end(TRACE_FSI_WRITE, &fsi->target, addr64, &data, 4, tstart, rc);
+	stats_record(PDBG_STATS_FSI_WRITE, &fsi->target, start, 4, rc);
 	PR_DEBUG("rc = %d, addr = 0x%05" PRIx64 ", data = 0x%08" PRIx32 ", target = %s\n",
 		 rc, addr64, data, pdbg_target_path(&fsi->target));
 	return rc;
@@ -370,6 +519,7 @@ int fsi_ody_read(struct pdbg_target *fsi_dt, uint32_t addr, uint32_t *data)
 	struct fsi *fsi;
 	int rc;
 	uint64_t addr64 = addr;
+	uint64_t start, tstart;
 
 	fsi = target_to_fsi(fsi_dt);
 
@@ -378,7 +528,14 @@ int fsi_ody_read(struct pdbg_target *fsi_dt, uint32_t addr, uint32_t *data)
 		return -1;
 	}
 
-	rc = fsi->read(fsi, addr64, data);
+	start = stats_start();
+	tstart = trace_begin();
+	if (trace_replaying())
+		rc = trace_replay(TRACE_FSI_READ, &fsi->target, addr64, data, 4);
+	else
+		rc = fsi->read(fsi, addr64, data);
+	trace_end(TRACE_FSI_READ, &fsi->target, addr64, data, 4, tstart, rc);
+	stats_record(PDBG_STATS_FSI_READ, &fsi->target, start, 4, rc);
 	PR_DEBUG("rc = %d, addr = 0x%05" PRIx64 ", data = 0x%08" PRIx32 ", target = %s\n",
 		 rc, addr64, *data, pdbg_target_path(&fsi->target));
 	return rc;
@@ -389,6 +546,7 @@ int fsi_ody_write(struct pdbg_target *fsi_dt, uint32_t addr, uint32_t data)
 	struct fsi *fsi;
 	int rc;
 	uint64_t addr64 = addr;
+	uint64_t start, tstart;
 
 	fsi = target_to_fsi(fsi_dt);
 
@@ -397,7 +555,14 @@ int fsi_ody_write(struct pdbg_target *fsi_dt, uint32_t addr, uint32_t data)
 		return -1;
 	}
 
-	rc = fsi->write(fsi, addr64, data);
+	start = stats_start();
+	tstart = trace_begin();
+	if (trace_replaying())
+		rc = trace_replay(TRACE_FSI_WRITE, &fsi->target, addr64, &data, 4);
+	else
+		rc = fsi->write(fsi, addr64, data);
+	trace_end(TRACE_FSI_WRITE, &fsi->target, addr64, &data, 4, tstart, rc);
+	stats_record(PDBG_STATS_FSI_WRITE, &fsi->target, start, 4, rc);
 	PR_DEBUG("rc = %d, addr = 0x%05" PRIx64 ", data = 0x%08" PRIx32 ", target = %s\n",
 		 rc, addr64, data, pdbg_target_path(&fsi->target));
 	return rc;
@@ -422,7 +587,7 @@ int i2c_read(struct pdbg_target *i2c_dt, uint8_t addr, uint8_t reg, uint16_t siz
 	struct i2cbus *i2cbus;
 	uint64_t target_addr = addr;
 
-	i2c_dt = get_class_target_addr(i2c_dt, "i2c_bus", &target_addr);
+	i2c_dt = get_class_target_addr(i2c_dt, TARGET_CLASS("i2c_bus"), &target_addr);
 
 	if (pdbg_target_status(i2c_dt) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -443,7 +608,7 @@ int i2c_write(struct pdbg_target *i2c_dt, uint8_t addr, uint8_t reg, uint16_t si
 	struct i2cbus *i2cbus;
 	uint64_t target_addr = addr;
 
-	i2c_dt = get_class_target_addr(i2c_dt, "i2c_bus", &target_addr);
+	i2c_dt = get_class_target_addr(i2c_dt, TARGET_CLASS("i2c_bus"), &target_addr);
 
 	if (pdbg_target_status(i2c_dt) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -459,12 +624,163 @@ int i2c_write(struct pdbg_target *i2c_dt, uint8_t addr, uint8_t reg, uint16_t si
 	return i2cbus->write(i2cbus, addr, reg, size, data);
 }
 
+/*
+ * Optional read-through cache for mem targets. Memory is cached in
+ * MEM_CACHE_LINE_SIZE byte lines in a small direct-mapped cache so
+ * that callers doing many small reads (eg. stack unwinding or a
+ * debugger stepping through code) only pay for one memory access per
+ * line. Writes go straight through to the hardware and invalidate any
+ * overlapping lines in every cache, whichever mem target they go
+ * through. Anything that lets the processor run again or RAMs
+ * instructions invalidates all caches.
+ *
+ * Filling a line reads more than was asked for. If that fails, eg. at
+ * the end of memory, the requested bytes are read uncached. MMIO is
+ * never cached as reading it may have side effects, so only mem targets
+ * which know where MMIO starts in their address map are cached.
+ */
+#define MEM_CACHE_LINE_SIZE	128
+#define MEM_CACHE_LINES		64
+
+struct mem_cache_line {
+	bool valid;
+	uint64_t addr;
+	uint8_t data[MEM_CACHE_LINE_SIZE];
+};
+
+struct mem_cache {
+	struct mem_cache_line line[MEM_CACHE_LINES];
+	struct list_node link;
+};
+
+static struct list_head mem_caches = LIST_HEAD_INIT(mem_caches);
+
+static struct mem_cache_line *mem_cache_line(struct mem_cache *cache, uint64_t line_addr)
+{
+	return &cache->line[(line_addr / MEM_CACHE_LINE_SIZE) % MEM_CACHE_LINES];
+}
+
+static int mem_cache_read(struct mem *mem, uint64_t addr, uint8_t *output, uint64_t size)
+{
+	struct mem_cache_line *line;
+	uint64_t line_addr, start, end;
+	int rc;
+
+	line_addr = addr & ~((uint64_t)MEM_CACHE_LINE_SIZE - 1);
+	while (line_addr < addr + size) {
+		start = addr > line_addr ? addr : line_addr;
+		end = addr + size < line_addr + MEM_CACHE_LINE_SIZE ?
+			addr + size : line_addr + MEM_CACHE_LINE_SIZE;
+
+		line = mem_cache_line(mem->cache, line_addr);
+		if (!line->valid || line->addr != line_addr) {
+			line->valid = false;
+			rc = mem->read(mem, line_addr, line->data, MEM_CACHE_LINE_SIZE, 0, false);
+			if (rc) {
+				rc = mem->read(mem, start, output + (start - addr), end - start, 0, false);
+				if (rc)
+					return rc;
+
+				line_addr += MEM_CACHE_LINE_SIZE;
+				continue;
+			}
+
+			line->addr = line_addr;
+			line->valid = true;
+		}
+
+		memcpy(output + (start - addr), line->data + (start - line_addr), end - start);
+
+		line_addr += MEM_CACHE_LINE_SIZE;
+	}
+
+	return 0;
+}
+
+static void mem_cache_invalidate_lines(struct mem_cache *cache, uint64_t addr, uint64_t size)
+{
+	struct mem_cache_line *line;
+	uint64_t line_addr;
+	int i;
+
+	line_addr = addr & ~((uint64_t)MEM_CACHE_LINE_SIZE - 1);
+	for (i = 0; i < MEM_CACHE_LINES && line_addr < addr + size; i++) {
+		line = mem_cache_line(cache, line_addr);
+		if (line->addr == line_addr)
+			line->valid = false;
+
+		line_addr += MEM_CACHE_LINE_SIZE;
+	}
+
+	/* Larger writes than the cache can hold may alias any line */
+	if (line_addr < addr + size)
+		for (i = 0; i < MEM_CACHE_LINES; i++)
+			cache->line[i].valid = false;
+}
+
+void mem_cache_invalidate_range(uint64_t addr, uint64_t size)
+{
+	struct mem_cache *cache;
+
+	list_for_each(&mem_caches, cache, link)
+		mem_cache_invalidate_lines(cache, addr, size);
+}
+
+int mem_cache_enable(struct pdbg_target *target, bool enable)
+{
+	struct mem *mem;
+
+	assert(target_is_class(target, TARGET_CLASS("mem")));
+
+	mem = target_to_mem(target);
+
+	/* Without knowing where MMIO is there's nothing safe to cache */
+	if (enable && !mem->mmio_base) {
+		PR_DEBUG("No MMIO base for %s, not caching\n", pdbg_target_path(target));
+		return -1;
+	}
+
+	if (enable && !mem->cache) {
+		mem->cache = calloc(1, sizeof(*mem->cache));
+		if (!mem->cache)
+			return -1;
+
+		list_add_tail(&mem_caches, &mem->cache->link);
+	} else if (!enable && mem->cache) {
+		list_del_from(&mem_caches, &mem->cache->link);
+		free(mem->cache);
+		mem->cache = NULL;
+	}
+
+	return 0;
+}
+
+void mem_cache_invalidate(struct pdbg_target *target)
+{
+	struct mem_cache *cache;
+	struct mem *mem;
+
+	if (target) {
+		assert(target_is_class(target, TARGET_CLASS("mem")));
+
+		mem = target_to_mem(target);
+		if (mem->cache)
+			memset(mem->cache->line, 0, sizeof(mem->cache->line));
+
+		return;
+	}
+
+	list_for_each(&mem_caches, cache, link)
+		memset(cache->line, 0, sizeof(cache->line));
+}
+
 int mem_read(struct pdbg_target *target, uint64_t addr, uint8_t *output, uint64_t size, uint8_t block_size, bool ci)
 {
 	struct mem *mem;
+	uint64_t start, tstart;
 	int rc = -1;
 
-	assert(pdbg_target_is_class(target, "mem"));
+	assert(target_is_class(target, TARGET_CLASS("mem")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -476,7 +792,24 @@ int mem_read(struct pdbg_target *target, uint64_t addr, uint8_t *output, uint64_
 		return -1;
 	}
 
-	rc = mem->read(mem, addr, output, size, block_size, ci);
+	if (pdbg_cancelled())
+		return -1;
+
+	start = stats_start();
+	tstart = trace_begin();
+
+	/* Only small cacheable reads are worth keeping around in the cache */
+	if (trace_replaying())
+		rc = trace_replay(TRACE_MEM_READ, &mem->target, addr, output, size);
+	else if (mem->cache && !ci && !block_size &&
+		 size <= MEM_CACHE_LINES * MEM_CACHE_LINE_SIZE / 2 &&
+		 addr < mem->mmio_base && size <= mem->mmio_base - addr)
+		rc = mem_cache_read(mem, addr, output, size);
+	else
+		rc = mem->read(mem, addr, output, size, block_size, ci);
+
+	trace_end(TRACE_MEM_READ, &mem->target, addr, output, size, tstart, rc);
+	stats_record(PDBG_STATS_MEM_READ, &mem->target, start, size, rc);
 
 	return rc;
 }
@@ -484,9 +817,10 @@ int mem_read(struct pdbg_target *target, uint64_t addr, uint8_t *output, uint64_
 int mem_write(struct pdbg_target *target, uint64_t addr, uint8_t *input, uint64_t size, uint8_t block_size, bool ci)
 {
 	struct mem *mem;
+	uint64_t start, tstart;
 	int rc = -1;
 
-	assert(pdbg_target_is_class(target, "mem"));
+	assert(target_is_class(target, TARGET_CLASS("mem")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -498,7 +832,19 @@ int mem_write(struct pdbg_target *target, uint64_t addr, uint8_t *input, uint64_
 		return -1;
 	}
 
-	rc = mem->write(mem, addr, input, size, block_size, ci);
+	if (pdbg_cancelled())
+		return -1;
+
+	mem_cache_invalidate_range(addr, size);
+
+	start = stats_start();
+	tstart = trace_begin();
+	if (trace_replaying())
+		rc = trace_replay(TRACE_MEM_WRITE, &mem->target, addr, NULL, size);
+	else
+		rc = mem->write(mem, addr, input, size, block_size, ci);
+	trace_end(TRACE_MEM_WRITE, &mem->target, addr, NULL, size, tstart, rc);
+	stats_record(PDBG_STATS_MEM_WRITE, &mem->target, start, size, rc);
 
 	return rc;
 }
@@ -507,7 +853,7 @@ int ocmb_getscom(struct pdbg_target *target, uint64_t addr, uint64_t *val)
 {
 	struct ocmb *ocmb;
 
-	assert(pdbg_target_is_class(target, "ocmb") || is_child_of_ody_chip(target));
+	assert(target_is_class(target, TARGET_CLASS("ocmb")) || is_child_of_ody_chip(target));
 
 	/*TODO: https://jsw.ibm.com/browse/PFEBMC-1931 
 		Handling Odyssey as a special case can be removed,
@@ -516,7 +862,7 @@ int ocmb_getscom(struct pdbg_target *target, uint64_t addr, uint64_t *val)
 		so we need to translate before calling getscom */
 	if(is_child_of_ody_chip(target))
 	{
-		target = get_class_target_addr(target, "ocmb", &addr);
+		target = get_class_target_addr(target, TARGET_CLASS("ocmb"), &addr);
 	}
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
@@ -536,7 +882,7 @@ int ocmb_putscom(struct pdbg_target *target, uint64_t addr, uint64_t val)
 {
 	struct ocmb *ocmb;
 
-	assert(pdbg_target_is_class(target, "ocmb") || is_child_of_ody_chip(target));
+	assert(target_is_class(target, TARGET_CLASS("ocmb")) || is_child_of_ody_chip(target));
 
 	/*TODO: https://jsw.ibm.com/browse/PFEBMC-1931 
 		Handling Odyssey as a special case can be removed,
@@ -545,7 +891,7 @@ int ocmb_putscom(struct pdbg_target *target, uint64_t addr, uint64_t val)
 		so we need to translate before calling getscom */
 	if(is_child_of_ody_chip(target))
 	{
-		target = get_class_target_addr(target, "ocmb", &addr);
+		target = get_class_target_addr(target, TARGET_CLASS("ocmb"), &addr);
 	}
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
@@ -561,18 +907,67 @@ int ocmb_putscom(struct pdbg_target *target, uint64_t addr, uint64_t val)
 	return ocmb->putscom(ocmb, addr, val);
 }
 
-/* Finds the given class. Returns NULL if not found. */
-struct pdbg_target_class *find_target_class(const char *name)
+/*
+ * Classes are interned in a hash of their names and never freed. Names
+ * are not copied so have to stay valid, which the class names of the
+ * hardware units and string literals do.
+ */
+#define MAX_CLASSES		256
+#define CLASS_HASH_SIZE		(2 * MAX_CLASSES)
+
+static struct pdbg_target_class *class_hash[CLASS_HASH_SIZE];
+static int class_count;
+static pthread_mutex_t class_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Class names are mostly string literals, so the same name is usually
+ * passed with the same pointer and can be looked up by it */
+#define CLASS_CACHE_SIZE	32
+static struct pdbg_target_class *class_cache[CLASS_CACHE_SIZE];
+
+static uint32_t class_name_hash(const char *name)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*name) {
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619u;
+	}
+
+	return hash & (CLASS_HASH_SIZE - 1);
+}
+
+static struct pdbg_target_class *class_hash_find(const char *name)
 {
-	struct pdbg_target_class *target_class = NULL;
+	struct pdbg_target_class *target_class;
+	uint32_t i;
 
-	list_for_each(&target_classes, target_class, class_head_link)
-		if (!strcmp(target_class->name, name))
+	for (i = class_name_hash(name);
+	     (target_class = __atomic_load_n(&class_hash[i], __ATOMIC_ACQUIRE));
+	     i = (i + 1) & (CLASS_HASH_SIZE - 1)) {
+		if (target_class->name == name || !strcmp(target_class->name, name))
 			return target_class;
+	}
 
 	return NULL;
 }
 
+/* Finds the given class. Returns NULL if not found. */
+struct pdbg_target_class *find_target_class(const char *name)
+{
+	struct pdbg_target_class *target_class;
+	unsigned int slot = ((uintptr_t)name >> 3) % CLASS_CACHE_SIZE;
+
+	target_class = __atomic_load_n(&class_cache[slot], __ATOMIC_RELAXED);
+	if (target_class && (target_class->name == name || !strcmp(target_class->name, name)))
+		return target_class;
+
+	target_class = class_hash_find(name);
+	if (target_class)
+		__atomic_store_n(&class_cache[slot], target_class, __ATOMIC_RELAXED);
+
+	return target_class;
+}
+
 /* Same as above but dies with an assert if the target class doesn't
  * exist */
 struct pdbg_target_class *require_target_class(const char *name)
@@ -588,23 +983,42 @@ struct pdbg_target_class *require_target_class(const char *name)
 }
 
 /* Returns the existing class or allocates space for a new one */
-struct pdbg_target_class *get_target_class(struct pdbg_target *target)
+struct pdbg_target_class *target_class_intern(const char *name)
 {
 	struct pdbg_target_class *target_class;
+	uint32_t i;
 
-	if ((target_class = find_target_class(target->class)))
+	if ((target_class = find_target_class(name)))
 		return target_class;
 
+	pthread_mutex_lock(&class_lock);
+	for (i = class_name_hash(name); class_hash[i]; i = (i + 1) & (CLASS_HASH_SIZE - 1)) {
+		if (!strcmp(class_hash[i]->name, name)) {
+			pthread_mutex_unlock(&class_lock);
+			return class_hash[i];
+		}
+	}
+
 	/* Need to allocate a new class */
-	PR_DEBUG("Allocating %s target class\n", target->class);
+	assert(class_count < MAX_CLASSES);
 	target_class = calloc(1, sizeof(*target_class));
 	assert(target_class);
-	target_class->name = strdup(target->class);
+	target_class->name = name;
 	list_head_init(&target_class->targets);
+	arena_init(&target_class->arena);
 	list_add_tail(&target_classes, &target_class->class_head_link);
+	class_count++;
+	__atomic_store_n(&class_hash[i], target_class, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&class_lock);
+
 	return target_class;
 }
 
+struct pdbg_target_class *get_target_class(struct pdbg_target *target)
+{
+	return target_class_intern(target->class);
+}
+
 /*ddr5 ocmb is itself a chip but in device tree as it is kept under
  perv, mc, mcc, omi so probing ocmb will probe its parent chips which
  are failing, for now treating ody ocmb as special case*/
@@ -614,32 +1028,32 @@ enum pdbg_target_status pdbg_target_probe_ody_ocmb(struct pdbg_target *target)
 
 	if(is_child_of_ody_chip(target))
 	{
-		if (target && target->probe && target->probe(target)) {
+		if (target && trace_probe(target)) {
 			target->status = PDBG_TARGET_NONEXISTENT;
 			return PDBG_TARGET_NONEXISTENT;
 		}
 		target->status = PDBG_TARGET_ENABLED;
 
 		//point to the ocmb target and continue, it will not be NULL for sure
-		struct pdbg_target *parent_target = pdbg_target_parent("ocmb", target);
+		struct pdbg_target *parent_target = target_class_parent(TARGET_CLASS("ocmb"), target, true);
 		return pdbg_target_probe_ody_ocmb(parent_target);
 	}
 
 	if(pdbg_get_backend() == PDBG_BACKEND_KERNEL)
 	{
 		struct pdbg_target *pibtarget = get_ody_pib_target(target);
-		if (pibtarget && pibtarget->probe && pibtarget->probe(pibtarget)) {
+		if (pibtarget && trace_probe(pibtarget)) {
 			pibtarget->status = PDBG_TARGET_NONEXISTENT;
 			return PDBG_TARGET_NONEXISTENT;
 		}
 
 		struct pdbg_target *fsitarget = get_ody_fsi_target(target);
-		if (fsitarget && fsitarget->probe && fsitarget->probe(fsitarget)) {
+		if (fsitarget && trace_probe(fsitarget)) {
 			fsitarget->status = PDBG_TARGET_NONEXISTENT;
 			return PDBG_TARGET_NONEXISTENT;
 		}
 
-		if (target && target->probe && target->probe(target)) {
+		if (target && trace_probe(target)) {
 			target->status = PDBG_TARGET_NONEXISTENT;
 			return PDBG_TARGET_NONEXISTENT;
 		}
@@ -651,24 +1065,24 @@ enum pdbg_target_status pdbg_target_probe_ody_ocmb(struct pdbg_target *target)
 	else
 	{
 		struct sbefifo *sbefifo = ody_ocmb_to_sbefifo(target);
-		if (sbefifo && sbefifo->target.probe && sbefifo->target.probe(&sbefifo->target)) {
+		if (sbefifo && trace_probe(&sbefifo->target)) {
 			sbefifo->target.status = PDBG_TARGET_NONEXISTENT;
 			return PDBG_TARGET_NONEXISTENT;
 		}
-		if (target && target->probe && target->probe(target)) {
+		if (target && trace_probe(target)) {
 			target->status = PDBG_TARGET_NONEXISTENT;
 			return PDBG_TARGET_NONEXISTENT;
 		}
 
 		//probe the chip-op target
 		struct pdbg_target *co_target = get_ody_chipop_target(target);
-		if (co_target && co_target->probe && co_target->probe(co_target)) {
+		if (co_target && trace_probe(co_target)) {
 			co_target->status = PDBG_TARGET_NONEXISTENT;
 			return PDBG_TARGET_NONEXISTENT;
 		}
 
 		struct pdbg_target *fsi_target = get_ody_fsi_target(target);
-		if (fsi_target && fsi_target->probe && fsi_target->probe(fsi_target)) {
+		if (fsi_target && trace_probe(fsi_target)) {
 			fsi_target->status = PDBG_TARGET_NONEXISTENT;
 			return PDBG_TARGET_NONEXISTENT;
 		}
@@ -681,6 +1095,71 @@ enum pdbg_target_status pdbg_target_probe_ody_ocmb(struct pdbg_target *target)
 	return PDBG_TARGET_ENABLED;
 }
 
+/*
+ * Invalidating a subtree only records a new generation in its root.
+ * Targets below it find out they are stale the next time they are
+ * probed, by comparing the generation their status was determined in
+ * with those of their parents. Until anything has been invalidated
+ * there's nothing to compare.
+ */
+static uint32_t probe_generation;
+
+static bool target_stale(struct pdbg_target *target)
+{
+	struct pdbg_target *tmp;
+
+	if (!__atomic_load_n(&probe_generation, __ATOMIC_RELAXED))
+		return false;
+
+	for (tmp = target; tmp; tmp = get_parent(tmp, false)) {
+		if (tmp->invalid_gen > target->probe_gen)
+			return true;
+	}
+
+	return false;
+}
+
+void pdbg_target_invalidate(struct pdbg_target *target)
+{
+	assert(target);
+
+	target->invalid_gen = __atomic_add_fetch(&probe_generation, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Work out what to do with a stale target. Targets which didn't exist
+ * or were released are probed again. Enabled targets keep their backend
+ * context and stay enabled, unless their parent has gone away.
+ */
+static enum pdbg_target_status target_revalidate(struct pdbg_target *target)
+{
+	struct pdbg_target *parent;
+
+	target->probe_gen = __atomic_load_n(&probe_generation, __ATOMIC_RELAXED);
+
+	switch (target->status) {
+	case PDBG_TARGET_NONEXISTENT:
+	case PDBG_TARGET_RELEASED:
+		target->status = PDBG_TARGET_UNKNOWN;
+		break;
+
+	case PDBG_TARGET_ENABLED:
+		parent = get_parent(target, false);
+		if (parent && !is_ody_ocmb_chip(target) &&
+		    pdbg_target_probe(parent) != PDBG_TARGET_ENABLED) {
+			PR_INFO("%s has gone away\n", pdbg_target_path(target));
+			pdbg_target_release(target);
+			target->status = PDBG_TARGET_NONEXISTENT;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return target->status;
+}
+
 /* We walk the tree root down disabling targets which might/should
  * exist but don't */
 enum pdbg_target_status pdbg_target_probe(struct pdbg_target *target)
@@ -690,13 +1169,16 @@ enum pdbg_target_status pdbg_target_probe(struct pdbg_target *target)
 
 	assert(target);
 
+	if (target_stale(target))
+		target_revalidate(target);
+
 	status = pdbg_target_status(target);
 	assert(status != PDBG_TARGET_RELEASED);
 
 	if (status == PDBG_TARGET_DISABLED || status == PDBG_TARGET_NONEXISTENT
 	    || status == PDBG_TARGET_ENABLED)
 		/* We've already tried probing this target and by assumption
-		 * it's status won't have changed */
+		 * it's status won't have changed until it is invalidated */
 		   return status;
 
 	/* odyssey ddr5 ocmb is a chip itself but in device tree it is placed
@@ -743,7 +1225,7 @@ enum pdbg_target_status pdbg_target_probe(struct pdbg_target *target)
 		pdbg_target_probe(vnode);
 
 	/* At this point any parents must exist and have already been probed */
-	if (target->probe && target->probe(target)) {
+	if (trace_probe(target)) {
 		/* Could not find the target */
 		assert(pdbg_target_status(target) != PDBG_TARGET_MUSTEXIST);
 		target->status = PDBG_TARGET_NONEXISTENT;
@@ -754,6 +1236,12 @@ enum pdbg_target_status pdbg_target_probe(struct pdbg_target *target)
 	return PDBG_TARGET_ENABLED;
 }
 
+enum pdbg_target_status pdbg_target_reprobe(struct pdbg_target *target)
+{
+	pdbg_target_invalidate(target);
+	return pdbg_target_probe(target);
+}
+
 /* Releases a target by first recursively releasing all its children */
 void pdbg_target_release(struct pdbg_target *target)
 {
@@ -789,9 +1277,9 @@ void pdbg_target_probe_all(struct pdbg_target *parent)
 
 bool pdbg_target_is_class(struct pdbg_target *target, const char *class)
 {
-	if (!target || !target->class || !class)
+	if (!target || !target->target_class || !class)
 		return false;
-	return strcmp(target->class, class) == 0;
+	return target->target_class == find_target_class(class);
 }
 
 void *pdbg_target_priv(struct pdbg_target *target)
@@ -837,13 +1325,19 @@ struct pdbg_target *target_to_virtual(struct pdbg_target *target, bool strict)
 void clear_target_classes()
 {
     struct pdbg_target_class *child = NULL;
-    struct pdbg_target_class *next = NULL;
-    list_for_each_safe(&target_classes, child, next, class_head_link)
+
+    tree_index_invalidate();
+
+    /* Classes stay interned as handles to them may be kept */
+    list_for_each(&target_classes, child, class_head_link)
     {
-        list_del_from(&target_classes, &child->class_head_link);
-        if (child)
-            free(child);
-        child = NULL;
+        arena_free(&child->arena);
+        list_head_init(&child->targets);
+        free(child->members);
+        child->members = NULL;
+        child->nr_members = 0;
+        child->members_size = 0;
+        child->expanded = false;
     }
 }
 
@@ -867,8 +1361,8 @@ struct pdbg_target *get_backend_target(const char* class,
 	//with the proc, ocmb index and port number defined in the backend device
 	//tree
 
-	uint32_t ocmb_proc = pdbg_target_index(pdbg_target_parent("proc",
-							ocmb));
+	uint32_t ocmb_proc = pdbg_target_index(target_class_parent(TARGET_CLASS("proc"),
+							ocmb, true));
 	uint32_t fapi_pos = 0;
 	pdbg_target_get_attribute(ocmb, "ATTR_FAPI_POS", 4, 1, &fapi_pos);
 	fapi_pos = fapi_pos % 0x8;
@@ -24,6 +24,8 @@
 #include <ccan/short_types/short_types.h>
 #include "compiler.h"
 #include "libpdbg.h"
+#include "arena.h"
+#include "scom_xlate.h"
 
 #define CHIP_ID_P8  0xea
 #define CHIP_ID_P8P 0xd3
@@ -34,9 +36,20 @@
 enum chip_type {CHIP_UNKNOWN, CHIP_P8, CHIP_P8NV, CHIP_P9, CHIP_P10};
 
 struct pdbg_target_class {
-	char *name;
+	const char *name;
 	struct list_head targets;
 	struct list_node class_head_link;
+	struct arena arena;
+
+	/* Targets in class list order, see tree_index.c */
+	struct pdbg_target **members;
+	int nr_members;
+	int members_size;
+	bool members_ordered[2];
+
+	/* All targets of the class have been created, see
+	 * pdbg_targets_init_lazy() */
+	bool expanded;
 };
 
 struct pdbg_target {
@@ -47,10 +60,20 @@ struct pdbg_target {
 	int (*probe)(struct pdbg_target *target);
 	void (*release)(struct pdbg_target *target);
 	uint64_t (*translate)(struct pdbg_target *target, uint64_t addr);
+	scom_xlate_build_t xlate_build;
+	struct scom_xlate *xlate;
 	void *fdt;
 	int fdt_offset;
 	int index;
+	uint32_t trace_id;
 	enum pdbg_target_status status;
+
+	/* Probe generation the status was determined in, and the
+	 * generation the subtree below this target was last invalidated
+	 * in (see pdbg_target_invalidate()) */
+	uint32_t probe_gen;
+	uint32_t invalid_gen;
+
 	const char *dn_name;
 	struct list_node list;
 	struct list_head properties;
@@ -58,9 +81,21 @@ struct pdbg_target {
 	struct pdbg_target *parent;
 	u32 phandle;
 	bool probed;
+
+	/* All children have been created, see pdbg_targets_init_lazy() */
+	bool expanded;
 	struct list_node class_link;
 	void *priv;
 	struct pdbg_target *vnode;
+
+	/* Interned class, NULL for targets without a hardware unit */
+	struct pdbg_target_class *target_class;
+
+	/* Subtree index for the backend [0] and system [1] view */
+	uint32_t tree_pre[2];
+	uint32_t tree_last[2];
+	uint32_t tree_id;
+	int class_pos;
 };
 
 struct pdbg_mfile {
@@ -78,11 +113,44 @@ struct pdbg_dtb {
 struct pdbg_target *get_parent(struct pdbg_target *target, bool system);
 struct pdbg_target *target_parent(const char *klass, struct pdbg_target *target, bool system);
 struct pdbg_target *require_target_parent(const char *klass, struct pdbg_target *target, bool system);
+struct pdbg_target *target_class_parent(struct pdbg_target_class *target_class,
+					struct pdbg_target *target, bool system);
+struct pdbg_target *require_target_class_parent(struct pdbg_target_class *target_class,
+						struct pdbg_target *target, bool system);
 struct pdbg_target_class *find_target_class(const char *name);
 struct pdbg_target_class *require_target_class(const char *name);
+struct pdbg_target_class *target_class_intern(const char *name);
 struct pdbg_target_class *get_target_class(struct pdbg_target *target);
 bool pdbg_target_is_class(struct pdbg_target *target, const char *class);
 
+/*
+ * Classes are interned when their hardware units are registered and are
+ * never freed, so a class handle can be kept and compared by pointer.
+ *
+ * TARGET_CLASS() returns the handle for a class named by a string
+ * literal, looking it up only the first time the call site runs:
+ *
+ *	if (target_is_class(target, TARGET_CLASS("pib")))
+ */
+#define TARGET_CLASS(name)						\
+	({								\
+		static struct pdbg_target_class *__target_class;	\
+		struct pdbg_target_class *__tc;				\
+									\
+		__tc = __atomic_load_n(&__target_class, __ATOMIC_RELAXED); \
+		if (!__tc) {						\
+			__tc = target_class_intern("" name "");		\
+			__atomic_store_n(&__target_class, __tc, __ATOMIC_RELAXED); \
+		}							\
+		__tc;							\
+	})
+
+static inline bool target_is_class(struct pdbg_target *target,
+				   struct pdbg_target_class *target_class)
+{
+	return target && target->target_class == target_class;
+}
+
 extern struct list_head empty_list;
 extern struct list_head target_classes;
 
@@ -91,6 +159,46 @@ enum pdbg_backend pdbg_get_backend(void);
 const char *pdbg_get_backend_option(void);
 bool pdbg_fdt_is_readonly(void *fdt);
 
+/* Backend detection results kept in the on-disk cache. Device trees
+ * are recorded as indexes into the built-in device tree table, -1 if
+ * not a built-in device tree. */
+struct dtb_cache_detect {
+	uint32_t backend;
+	uint32_t proc;
+	int32_t backend_dtb;
+	int32_t system_dtb;
+};
+
+void dtb_cache_load(enum pdbg_backend backend, const char *option);
+bool dtb_cache_get_detect(struct dtb_cache_detect *detect);
+void dtb_cache_set_detect(const struct dtb_cache_detect *detect);
+void dtb_cache_save(void);
+
+/* Drops cached memory overlapping a range written to by any means */
+void mem_cache_invalidate_range(uint64_t addr, uint64_t size);
+
+void tree_index_invalidate(void);
+struct pdbg_target *tree_index_next(struct pdbg_target_class *target_class,
+				    struct pdbg_target *parent,
+				    struct pdbg_target *last, bool system);
+
+void dt_expand_children(struct pdbg_target *target);
+void dt_expand_class(struct pdbg_target_class *target_class);
+
+/* Create the children of a target before they are looked at */
+static inline void target_expand(struct pdbg_target *target)
+{
+	if (!target->expanded)
+		dt_expand_children(target);
+}
+
+/* Create all targets of a class before iterating over them */
+static inline void target_class_expand(struct pdbg_target_class *target_class)
+{
+	if (!target_class->expanded)
+		dt_expand_class(target_class);
+}
+
 bool target_is_virtual(struct pdbg_target *target);
 struct pdbg_target *target_to_real(struct pdbg_target *target, bool strict);
 struct pdbg_target *target_to_virtual(struct pdbg_target *target, bool strict);
@@ -99,10 +207,11 @@ bool pdbg_context_is_short(void);
 
 /**
  * @brief Clears the list of target classes
- * It clears the list of target classes
- * from the global static list target_classes
+ * It removes all targets from the classes in
+ * the global static list target_classes
  * once the device tree is cleared and associated
- * all pdbg_target objects are destroyed
+ * all pdbg_target objects are destroyed. The
+ * classes themselves stay interned.
  * 
  * @see   pdbg_release_dt_root() for more details
  */
@@ -14,18 +14,20 @@
  * limitations under the License.
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <inttypes.h>
 
 #include "libpdbg.h"
 #include "hwunit.h"
 #include "debug.h"
 #include "sprs.h"
+#include "poll.h"
 
 struct thread_state thread_status(struct pdbg_target *target)
 {
 	struct thread *thread;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 	thread = target_to_thread(target);
 	return thread->status;
 }
@@ -37,12 +39,13 @@ int thread_step(struct pdbg_target *target, int count)
 {
 	struct thread *thread;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
 
 	thread = target_to_thread(target);
+	mem_cache_invalidate(NULL);
 
 	if (!thread->step) {
 		PR_ERROR("step() not implemented for the target\n");
@@ -56,12 +59,13 @@ int thread_start(struct pdbg_target *target)
 {
 	struct thread *thread;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
 
 	thread = target_to_thread(target);
+	mem_cache_invalidate(NULL);
 
 	if (!thread->start) {
 		PR_ERROR("start() not implemented for the target\n");
@@ -75,12 +79,13 @@ int thread_stop(struct pdbg_target *target)
 {
 	struct thread *thread;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
 
 	thread = target_to_thread(target);
+	mem_cache_invalidate(NULL);
 
 	if (!thread->stop) {
 		PR_ERROR("stop() not implemented for the target\n");
@@ -94,12 +99,13 @@ int thread_sreset(struct pdbg_target *target)
 {
 	struct thread *thread;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
 
 	thread = target_to_thread(target);
+	mem_cache_invalidate(NULL);
 
 	if (!thread->sreset) {
 		PR_ERROR("sreset() not implemented for the target\n");
@@ -114,6 +120,8 @@ int thread_step_all(void)
 	struct pdbg_target *target, *thread;
 	int rc = 0, count = 0;
 
+	mem_cache_invalidate(NULL);
+
 	pdbg_for_each_class_target("pib", target) {
 		struct pib *pib = target_to_pib(target);
 
@@ -149,6 +157,8 @@ int thread_start_all(void)
 	struct pdbg_target *target, *thread;
 	int rc = 0, count = 0;
 
+	mem_cache_invalidate(NULL);
+
 	pdbg_for_each_class_target("pib", target) {
 		struct pib *pib = target_to_pib(target);
 
@@ -179,11 +189,87 @@ int thread_start_all(void)
 	return -1;
 }
 
+/* Same as for stopping a single POWER9 or POWER10 thread */
+#define THREAD_STOP_TIMEOUT_US	100000
+
+static int thread_poll_quiesced(void *priv)
+{
+	struct thread *thread = priv;
+
+	return thread->quiesced(thread);
+}
+
+/*
+ * Ask every thread to stop before waiting for any of them, so they
+ * quiesce at the same time rather than one after the other. Threads
+ * which can't be stopped that way are stopped one at a time.
+ */
+static int thread_stop_each(void)
+{
+	struct pdbg_target *target;
+	struct thread *thread;
+	void **threads;
+	int *status;
+	int rc = 0, count = 0, n = 0, i;
+
+	pdbg_for_each_class_target("thread", target) {
+		if (pdbg_target_status(target) == PDBG_TARGET_ENABLED)
+			count++;
+	}
+
+	if (!count)
+		return -1;
+
+	threads = calloc(count, sizeof(*threads));
+	status = calloc(count, sizeof(*status));
+	if (!threads || !status) {
+		free(threads);
+		free(status);
+		return -1;
+	}
+
+	pdbg_for_each_class_target("thread", target) {
+		if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
+			continue;
+
+		thread = target_to_thread(target);
+		if (!thread->stop_request || !thread->quiesced) {
+			rc |= thread_stop(target);
+			continue;
+		}
+
+		if (thread->stop_request(thread)) {
+			PR_ERROR("Unable to stop thread %s\n", pdbg_target_path(target));
+			rc |= 1;
+			continue;
+		}
+
+		threads[n++] = thread;
+	}
+
+	if (n && poll_until_all_cancellable(thread_poll_quiesced, threads, status, n,
+					    THREAD_STOP_TIMEOUT_US, &poll_backoff_slow)) {
+		for (i = 0; i < n; i++) {
+			thread = threads[i];
+			if (status[i] != 1)
+				PR_ERROR("Unable to quiesce thread %s\n",
+					 pdbg_target_path(&thread->target));
+		}
+		rc |= 1;
+	}
+
+	free(threads);
+	free(status);
+	return rc;
+}
+
 int thread_stop_all(void)
 {
-	struct pdbg_target *target, *thread;
+	struct pdbg_target *target;
 	int rc = 0, count = 0;
 
+	mem_cache_invalidate(NULL);
+
 	pdbg_for_each_class_target("pib", target) {
 		struct pib *pib = target_to_pib(target);
 
@@ -200,18 +286,7 @@ int thread_stop_all(void)
 	if (count > 0)
 		return rc;
 
-	pdbg_for_each_class_target("thread", thread) {
-		if (pdbg_target_status(thread) != PDBG_TARGET_ENABLED)
-			continue;
-
-		rc |= thread_stop(thread);
-		count++;
-	}
-
-	if (count > 0)
-		return rc;
-
-	return -1;
+	return thread_stop_each();
 }
 
 int thread_sreset_all(void)
@@ -219,6 +294,8 @@ int thread_sreset_all(void)
 	struct pdbg_target *target, *thread;
 	int rc = 0, count = 0;
 
+	mem_cache_invalidate(NULL);
+
 	pdbg_for_each_class_target("pib", target) {
 		struct pib *pib = target_to_pib(target);
 
@@ -255,12 +332,13 @@ int thread_start_proc(struct pdbg_target *target)
 	struct pib *pib;
 	int rc = 0;
 
-	assert(pdbg_target_is_class(target, "pib"));
+	assert(target_is_class(target, TARGET_CLASS("pib")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
 
 	pib = target_to_pib(target);
+	mem_cache_invalidate(NULL);
 
 	if (pib->thread_start_all) {
 		rc = pib->thread_start_all(pib);
@@ -282,12 +360,13 @@ int thread_stop_proc(struct pdbg_target *target)
 	struct pib *pib;
 	int rc = 0;
 
-	assert(pdbg_target_is_class(target, "pib"));
+	assert(target_is_class(target, TARGET_CLASS("pib")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
 
 	pib = target_to_pib(target);
+	mem_cache_invalidate(NULL);
 
 	if (pib->thread_stop_all) {
 		rc = pib->thread_stop_all(pib);
@@ -307,7 +386,7 @@ int thread_getmem(struct pdbg_target *target, uint64_t addr, uint64_t *value)
 {
 	struct thread *thread;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -372,7 +451,7 @@ int thread_getregs(struct pdbg_target *target, struct thread_regs *regs)
 {
 	struct thread *thread;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -387,11 +466,87 @@ int thread_getregs(struct pdbg_target *target, struct thread_regs *regs)
 	return thread->getregs(thread, regs);
 }
 
+int thread_getregs_list(struct pdbg_target **targets, int count, struct thread_regs *regs, int *rc)
+{
+	struct thread **threads;
+	struct thread_regs **tregs;
+	int *trc, *idx;
+	bool *done;
+	int i, j, n, ret = 0;
+
+	threads = calloc(count, sizeof(*threads));
+	tregs = calloc(count, sizeof(*tregs));
+	trc = calloc(count, sizeof(*trc));
+	idx = calloc(count, sizeof(*idx));
+	done = calloc(count, sizeof(*done));
+	if (!threads || !tregs || !trc || !idx || !done) {
+		if (rc)
+			for (i = 0; i < count; i++)
+				rc[i] = -1;
+		ret = -1;
+		goto out;
+	}
+
+	for (i = 0; i < count; i++) {
+		struct pdbg_target *pib;
+		struct pib *p;
+		int err;
+
+		if (done[i])
+			continue;
+
+		pib = target_class_parent(TARGET_CLASS("pib"), targets[i], true);
+		p = pib ? target_to_pib(pib) : NULL;
+
+		if (!p || !p->thread_getregs_all ||
+		    pdbg_target_status(targets[i]) != PDBG_TARGET_ENABLED) {
+			err = thread_getregs(targets[i], &regs[i]);
+			if (rc)
+				rc[i] = err;
+			if (err)
+				ret = -1;
+			done[i] = true;
+			continue;
+		}
+
+		/* Gather the remaining enabled threads on this processor */
+		for (j = i, n = 0; j < count; j++) {
+			if (done[j] ||
+			    pdbg_target_status(targets[j]) != PDBG_TARGET_ENABLED ||
+			    target_class_parent(TARGET_CLASS("pib"), targets[j], true) != pib)
+				continue;
+
+			assert(target_is_class(targets[j], TARGET_CLASS("thread")));
+			threads[n] = target_to_thread(targets[j]);
+			tregs[n] = &regs[j];
+			idx[n] = j;
+			done[j] = true;
+			n++;
+		}
+
+		if (p->thread_getregs_all(p, threads, tregs, trc, n))
+			ret = -1;
+
+		if (rc)
+			for (j = 0; j < n; j++)
+				rc[idx[j]] = trc[j];
+	}
+
+out:
+	free(threads);
+	free(tregs);
+	free(trc);
+	free(idx);
+	free(done);
+
+	return ret;
+}
+
 int thread_getgpr(struct pdbg_target *target, int gpr, uint64_t *value)
 {
 	struct thread *thread;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -410,7 +565,7 @@ int thread_putgpr(struct pdbg_target *target, int gpr, uint64_t value)
 {
 	struct thread *thread;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -429,7 +584,7 @@ int thread_getspr(struct pdbg_target *target, int spr, uint64_t *value)
 {
 	struct thread *thread;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -470,7 +625,7 @@ int thread_putspr(struct pdbg_target *target, int spr, uint64_t value)
 {
 	struct thread *thread;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -503,7 +658,7 @@ int thread_getfpr(struct pdbg_target *target, int fpr, uint64_t *value)
 {
 	struct thread *thread;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -522,7 +677,7 @@ int thread_putfpr(struct pdbg_target *target, int fpr, uint64_t value)
 {
 	struct thread *thread;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -541,7 +696,7 @@ int thread_getmsr(struct pdbg_target *target, uint64_t *value)
 {
 	struct thread *thread;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -560,7 +715,7 @@ int thread_putmsr(struct pdbg_target *target, uint64_t value)
 {
 	struct thread *thread;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -579,7 +734,7 @@ int thread_getnia(struct pdbg_target *target, uint64_t *value)
 {
 	struct thread *thread;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -598,7 +753,7 @@ int thread_putnia(struct pdbg_target *target, uint64_t value)
 {
 	struct thread *thread;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -617,7 +772,7 @@ int thread_getxer(struct pdbg_target *target, uint64_t *value)
 {
 	struct thread *thread;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -636,7 +791,7 @@ int thread_putxer(struct pdbg_target *target, uint64_t value)
 {
 	struct thread *thread;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -655,7 +810,7 @@ int thread_getcr(struct pdbg_target *target, uint32_t *value)
 {
 	struct thread *thread;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
@@ -677,7 +832,7 @@ int thread_putcr(struct pdbg_target *target, uint32_t value)
 	if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
 		return -1;
 
-	assert(pdbg_target_is_class(target, "thread"));
+	assert(target_is_class(target, TARGET_CLASS("thread")));
 
 	thread = target_to_thread(target);
 
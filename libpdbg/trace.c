@@ -0,0 +1,719 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <libfdt.h>
+#include <ccan/array_size/array_size.h>
+
+#include <libsbefifo/libsbefifo.h>
+
+#include "hwunit.h"
+#include "target.h"
+#include "trace.h"
+#include "debug.h"
+
+/*
+ * Trace file layout, all in host byte order:
+ *
+ *   struct trace_header
+ *   backend device tree, padded to 8 bytes
+ *   system device tree, padded to 8 bytes
+ *   records
+ *
+ * Each record is a struct trace_record followed by len bytes of data,
+ * padded to 8 bytes. Targets are referred to by a number which is
+ * defined by a TRACE_TARGET record, holding the target path, before
+ * its first use. The data of other records is:
+ *
+ *   PROBE              none
+ *   FSI/PIB/MEM_READ   the data read
+ *   FSI/PIB_WRITE      the data written
+ *   MEM_WRITE          none, memory writes can be large
+ *   SBEFIFO            the request (size bytes) followed by the raw reply
+ */
+
+#define TRACE_MAGIC	"PDBGTRC"
+#define TRACE_VERSION	1
+
+#define TRACE_ALIGN(x)	(((x) + 7) & ~(uint64_t)7)
+
+struct trace_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t backend;
+	uint32_t proc;
+	uint32_t backend_fdt_size;
+	uint32_t system_fdt_size;
+	uint32_t reserved;
+};
+
+struct trace_record {
+	uint8_t op;
+	uint8_t reserved[3];
+	uint32_t id;
+	uint64_t addr;
+	uint64_t time_ns;
+	int32_t rc;
+	uint32_t size;
+	uint32_t len;
+	uint32_t reserved2;
+};
+
+enum trace_mode trace_mode;
+
+static struct {
+	char *path;
+	FILE *f;
+	uint32_t next_id;
+	int depth;
+} record;
+
+static struct {
+	uint8_t *map;
+	size_t map_len;
+	size_t pos;
+	enum pdbg_proc proc;
+	const char **path;
+	struct pdbg_target **target;
+	uint32_t nr_targets;
+	bool latency;
+	bool diverged;
+} replay;
+
+static const char *trace_op_name[] = {
+	[TRACE_TARGET]		= "target",
+	[TRACE_PROBE]		= "probe",
+	[TRACE_FSI_READ]	= "fsi_read",
+	[TRACE_FSI_WRITE]	= "fsi_write",
+	[TRACE_PIB_READ]	= "pib_read",
+	[TRACE_PIB_WRITE]	= "pib_write",
+	[TRACE_MEM_READ]	= "mem_read",
+	[TRACE_MEM_WRITE]	= "mem_write",
+	[TRACE_SBEFIFO]		= "sbefifo",
+};
+
+static uint64_t trace_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool trace_is_sbefifo(struct pdbg_target *target)
+{
+	return target_is_class(target, TARGET_CLASS("sbefifo")) ||
+	       target_is_class(target, TARGET_CLASS("sbefifo-ody")) ||
+	       target_is_class(target, TARGET_CLASS("sbefifo_transport"));
+}
+
+/* Targets which talk to the hardware and never do so when replaying */
+static bool trace_is_transport(struct pdbg_target *target)
+{
+	return target_is_class(target, TARGET_CLASS("fsi")) ||
+	       target_is_class(target, TARGET_CLASS("fsi-ody")) ||
+	       target_is_class(target, TARGET_CLASS("pib")) ||
+	       target_is_class(target, TARGET_CLASS("pib-ody")) ||
+	       target_is_class(target, TARGET_CLASS("mem")) ||
+	       trace_is_sbefifo(target);
+}
+
+/*
+ * Recording
+ */
+
+static int record_write(const void *buf, size_t len)
+{
+	if (len && fwrite(buf, len, 1, record.f) != 1)
+		return -1;
+
+	return 0;
+}
+
+static int record_pad(size_t len)
+{
+	static const uint8_t zero[8];
+
+	return record_write(zero, TRACE_ALIGN(len) - len);
+}
+
+static void record_error(void)
+{
+	PR_ERROR("Unable to write trace %s: %s\n", record.path, strerror(errno));
+	pdbg_record_stop();
+}
+
+static void record_add(enum trace_op op, uint32_t id, uint64_t addr, uint64_t time_ns,
+		       int rc, uint32_t size, const void *data, uint32_t len,
+		       const void *data2, uint32_t len2)
+{
+	struct trace_record rec = {
+		.op = op,
+		.id = id,
+		.addr = addr,
+		.time_ns = time_ns,
+		.rc = rc,
+		.size = size,
+		.len = len + len2,
+	};
+
+	if (record_write(&rec, sizeof(rec)) ||
+	    record_write(data, len) ||
+	    record_write(data2, len2) ||
+	    record_pad(len + len2))
+		record_error();
+}
+
+static uint32_t record_target_id(struct pdbg_target *target)
+{
+	const char *path;
+
+	if (target->trace_id)
+		return target->trace_id;
+
+	path = pdbg_target_path(target);
+	target->trace_id = record.next_id++;
+	record_add(TRACE_TARGET, target->trace_id, 0, 0, 0, 0,
+		   path, strlen(path) + 1, NULL, 0);
+
+	return target->trace_id;
+}
+
+uint64_t __trace_begin(void)
+{
+	record.depth++;
+	return trace_time_ns();
+}
+
+void __trace_end(enum trace_op op, struct pdbg_target *target, uint64_t addr,
+		 const void *data, uint32_t size, uint64_t start, int rc)
+{
+	uint64_t time_ns = trace_time_ns() - start;
+
+	/* Only the outermost transaction is of interest */
+	if (--record.depth)
+		return;
+
+	record_add(op, record_target_id(target), addr, time_ns, rc, size,
+		   data, data ? size : 0, NULL, 0);
+}
+
+void __trace_end_read_list(struct pdbg_target *target, const uint64_t *addr,
+			   const uint64_t *data, int count, uint64_t start)
+{
+	uint64_t time_ns = trace_time_ns() - start;
+	int i;
+
+	if (--record.depth)
+		return;
+
+	/* Recorded as single reads, which is how they are replayed */
+	for (i = 0; i < count; i++)
+		record_add(TRACE_PIB_READ, record_target_id(target), addr[i],
+			   time_ns / count, 0, 8, &data[i], 8, NULL, 0);
+}
+
+static void record_sbefifo(const uint8_t *msg, uint32_t msg_len,
+			   const uint8_t *reply, uint32_t reply_len,
+			   uint64_t time_ns, int rc, void *priv)
+{
+	if (trace_mode != TRACE_RECORD || record.depth)
+		return;
+
+	record_add(TRACE_SBEFIFO, record_target_id(priv), 0, time_ns, rc, msg_len,
+		   msg, msg_len, reply, reply_len);
+}
+
+void trace_sbefifo_attach(struct sbefifo_context *sctx, struct pdbg_target *target)
+{
+	/* Recording is set up before any target is probed, so there is
+	 * no need to time exchanges otherwise */
+	if (trace_mode == TRACE_RECORD)
+		sbefifo_set_trace_callback(sctx, record_sbefifo, target);
+}
+
+bool pdbg_record_start(const char *path)
+{
+	if (pdbg_target_root()) {
+		PR_ERROR("pdbg_record_start() must be called before pdbg_targets_init()\n");
+		return false;
+	}
+
+	free(record.path);
+	record.path = strdup(path);
+
+	return record.path != NULL;
+}
+
+void pdbg_record_stop(void)
+{
+	if (trace_mode == TRACE_RECORD) {
+		if (fclose(record.f))
+			PR_ERROR("Unable to write trace %s: %s\n", record.path, strerror(errno));
+		trace_mode = TRACE_OFF;
+	}
+
+	free(record.path);
+	memset(&record, 0, sizeof(record));
+}
+
+bool pdbg_trace_active(void)
+{
+	return trace_active();
+}
+
+static uint32_t fdt_size(const void *fdt)
+{
+	return fdt ? fdt_totalsize(fdt) : 0;
+}
+
+void trace_start(const struct pdbg_dtb *dtb)
+{
+	struct trace_header hdr = {
+		.magic = TRACE_MAGIC,
+		.version = TRACE_VERSION,
+		.backend = pdbg_get_backend(),
+		.proc = pdbg_get_proc(),
+		.backend_fdt_size = fdt_size(dtb->backend.fdt),
+		.system_fdt_size = fdt_size(dtb->system.fdt),
+	};
+	const char *env;
+
+	if (!record.path) {
+		env = getenv("PDBG_RECORD");
+		if (!env || !*env)
+			return;
+
+		record.path = strdup(env);
+		if (!record.path)
+			return;
+	}
+
+	if (trace_mode == TRACE_REPLAY) {
+		PR_ERROR("Unable to record a trace while replaying one\n");
+		pdbg_record_stop();
+		return;
+	}
+
+	record.f = fopen(record.path, "w");
+	if (!record.f) {
+		PR_ERROR("Unable to create trace %s: %s\n", record.path, strerror(errno));
+		pdbg_record_stop();
+		return;
+	}
+
+	setvbuf(record.f, NULL, _IOFBF, 64 * 1024);
+	record.next_id = 1;
+	trace_mode = TRACE_RECORD;
+
+	if (record_write(&hdr, sizeof(hdr)) ||
+	    record_write(dtb->backend.fdt, hdr.backend_fdt_size) ||
+	    record_pad(hdr.backend_fdt_size) ||
+	    record_write(dtb->system.fdt, hdr.system_fdt_size) ||
+	    record_pad(hdr.system_fdt_size)) {
+		record_error();
+		return;
+	}
+
+	PR_INFO("Recording backend transactions to %s\n", record.path);
+}
+
+/*
+ * Replay
+ */
+
+static bool replay_target_define(const struct trace_record *rec, const char *path)
+{
+	const char **new_path;
+	struct pdbg_target **new_target;
+	uint32_t nr = rec->id + 1;
+
+	if (!rec->len || path[rec->len - 1] != '\0')
+		return false;
+
+	if (nr > replay.nr_targets) {
+		new_path = realloc(replay.path, nr * sizeof(*new_path));
+		if (!new_path)
+			return false;
+		replay.path = new_path;
+
+		new_target = realloc(replay.target, nr * sizeof(*new_target));
+		if (!new_target)
+			return false;
+		replay.target = new_target;
+
+		memset(&replay.path[replay.nr_targets], 0,
+		       (nr - replay.nr_targets) * sizeof(*new_path));
+		memset(&replay.target[replay.nr_targets], 0,
+		       (nr - replay.nr_targets) * sizeof(*new_target));
+		replay.nr_targets = nr;
+	}
+
+	replay.path[rec->id] = path;
+	replay.target[rec->id] = NULL;
+	return true;
+}
+
+/* Returns the next transaction, processing any target definitions */
+static const struct trace_record *replay_next(void)
+{
+	const struct trace_record *rec;
+
+	while (replay.pos + sizeof(*rec) <= replay.map_len) {
+		rec = (const struct trace_record *)(replay.map + replay.pos);
+		if (rec->len > replay.map_len - replay.pos - sizeof(*rec)) {
+			PR_ERROR("Truncated trace record at offset %zu\n", replay.pos);
+			return NULL;
+		}
+		replay.pos += sizeof(*rec) + TRACE_ALIGN(rec->len);
+
+		if (rec->op != TRACE_TARGET)
+			return rec;
+
+		if (!replay_target_define(rec, (const char *)(rec + 1))) {
+			PR_ERROR("Invalid trace target definition at offset %zu\n", replay.pos);
+			return NULL;
+		}
+	}
+
+	return NULL;
+}
+
+static bool replay_target_match(uint32_t id, struct pdbg_target *target)
+{
+	if (id >= replay.nr_targets || !replay.path[id])
+		return false;
+
+	if (replay.target[id])
+		return replay.target[id] == target;
+
+	if (strcmp(replay.path[id], pdbg_target_path(target)))
+		return false;
+
+	replay.target[id] = target;
+	return true;
+}
+
+static const char *replay_op_name(uint8_t op)
+{
+	if (op >= ARRAY_SIZE(trace_op_name) || !trace_op_name[op])
+		return "unknown";
+
+	return trace_op_name[op];
+}
+
+/* Returns the next transaction if it is the expected one */
+static const struct trace_record *replay_expect(enum trace_op op, struct pdbg_target *target,
+						uint64_t addr, uint32_t size)
+{
+	const struct trace_record *rec;
+
+	if (replay.diverged)
+		return NULL;
+
+	rec = replay_next();
+	if (!rec) {
+		PR_ERROR("Replay: end of trace reached at %s on %s\n",
+			 replay_op_name(op), pdbg_target_path(target));
+		replay.diverged = true;
+		return NULL;
+	}
+
+	if (rec->op != op || !replay_target_match(rec->id, target) ||
+	    rec->addr != addr || rec->size != size) {
+		PR_ERROR("Replay: expected %s on %s at 0x%016" PRIx64 ", got %s on %s at 0x%016" PRIx64 "\n",
+			 replay_op_name(rec->op),
+			 rec->id < replay.nr_targets && replay.path[rec->id] ? replay.path[rec->id] : "?",
+			 rec->addr, replay_op_name(op), pdbg_target_path(target), addr);
+		replay.diverged = true;
+		return NULL;
+	}
+
+	return rec;
+}
+
+/*
+ * Wait until the recorded time of a transaction has passed. Short
+ * transactions may take a little longer than recorded, as the sleep
+ * can overshoot by the timer slack.
+ */
+static void replay_wait(uint64_t start, uint64_t time_ns)
+{
+	uint64_t end = start + time_ns;
+	struct timespec ts = {
+		.tv_sec = end / 1000000000ULL,
+		.tv_nsec = end % 1000000000ULL,
+	};
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		;
+}
+
+int trace_replay(enum trace_op op, struct pdbg_target *target, uint64_t addr,
+		 void *data, uint32_t size)
+{
+	const struct trace_record *rec;
+	uint64_t start = 0;
+
+	if (replay.latency)
+		start = trace_time_ns();
+
+	rec = replay_expect(op, target, addr, size);
+	if (!rec)
+		return -1;
+
+	switch (op) {
+	case TRACE_FSI_READ:
+	case TRACE_PIB_READ:
+	case TRACE_MEM_READ:
+		if (rec->len != size) {
+			PR_ERROR("Replay: invalid %s record\n", replay_op_name(op));
+			replay.diverged = true;
+			return -1;
+		}
+		memcpy(data, rec + 1, size);
+		break;
+
+	default:
+		if (rec->len && data && (rec->len != size || memcmp(data, rec + 1, size))) {
+			PR_ERROR("Replay: %s on %s at 0x%016" PRIx64 " writes different data\n",
+				 replay_op_name(op), pdbg_target_path(target), addr);
+			replay.diverged = true;
+			return -1;
+		}
+		break;
+	}
+
+	if (replay.latency)
+		replay_wait(start, rec->time_ns);
+
+	return rec->rc;
+}
+
+static int replay_sbefifo_transport(uint8_t *msg, uint32_t msg_len,
+				    uint8_t *out, uint32_t *out_len,
+				    void *priv)
+{
+	const struct trace_record *rec;
+	const uint8_t *data;
+	uint64_t start = 0;
+	uint32_t reply_len;
+
+	if (replay.latency)
+		start = trace_time_ns();
+
+	rec = replay_expect(TRACE_SBEFIFO, priv, 0, msg_len);
+	if (!rec)
+		return EIO;
+
+	data = (const uint8_t *)(rec + 1);
+	if (rec->len < msg_len || rec->len - msg_len > *out_len) {
+		PR_ERROR("Replay: invalid sbefifo record\n");
+		replay.diverged = true;
+		return EIO;
+	}
+
+	if (memcmp(data, msg, msg_len)) {
+		PR_ERROR("Replay: sbefifo request differs from the trace\n");
+		replay.diverged = true;
+		return EIO;
+	}
+
+	reply_len = rec->len - msg_len;
+	memcpy(out, data + msg_len, reply_len);
+	*out_len = reply_len;
+
+	if (replay.latency)
+		replay_wait(start, rec->time_ns);
+
+	return rec->rc;
+}
+
+/* Stand in for the probe of a transport target */
+static int replay_probe_transport(struct pdbg_target *target)
+{
+	const struct trace_record *rec;
+	struct sbefifo *sf;
+	int proc, rc;
+
+	if (replay.diverged)
+		return -1;
+
+	/* Anything recorded while the target probed itself is skipped */
+	while ((rec = replay_next())) {
+		if (rec->op == TRACE_PROBE && replay_target_match(rec->id, target))
+			break;
+	}
+
+	if (!rec) {
+		PR_ERROR("Replay: %s was not probed in the trace\n", pdbg_target_path(target));
+		replay.diverged = true;
+		return -1;
+	}
+
+	if (rec->rc)
+		return rec->rc;
+
+	/* Nothing to release either */
+	target->release = NULL;
+
+	if (trace_is_sbefifo(target)) {
+		sf = target_to_sbefifo(target);
+		proc = replay.proc == PDBG_PROC_P10 ? SBEFIFO_PROC_P10 : SBEFIFO_PROC_P9;
+		rc = sbefifo_connect_transport(proc, replay_sbefifo_transport, target, &sf->sf_ctx);
+		if (rc) {
+			PR_ERROR("Unable to initialize sbefifo replay\n");
+			return rc;
+		}
+	}
+
+	return 0;
+}
+
+int trace_probe(struct pdbg_target *target)
+{
+	const struct trace_record *rec;
+	int rc;
+
+	if (!target->probe)
+		return 0;
+
+	if (trace_mode == TRACE_REPLAY && trace_is_transport(target))
+		return replay_probe_transport(target);
+
+	rc = target->probe(target);
+
+	if (trace_mode == TRACE_RECORD && !record.depth)
+		record_add(TRACE_PROBE, record_target_id(target), 0, 0, rc, 0,
+			   NULL, 0, NULL, 0);
+
+	if (trace_mode == TRACE_REPLAY) {
+		rec = replay_expect(TRACE_PROBE, target, 0, 0);
+		if (rec && rec->rc != rc)
+			PR_NOTICE("Replay: probing %s returned %d, %d in the trace\n",
+				  pdbg_target_path(target), rc, rec->rc);
+	}
+
+	return rc;
+}
+
+static bool replay_fdt(uint8_t *fdt, uint32_t size, struct pdbg_mfile *mfile)
+{
+	*mfile = (struct pdbg_mfile) {
+		.fd = -1,
+		.len = -1,
+	};
+
+	if (!size)
+		return true;
+
+	if (fdt_check_header(fdt) || fdt_totalsize(fdt) != size)
+		return false;
+
+	mfile->fdt = fdt;
+	return true;
+}
+
+bool trace_replay_load(const char *path, struct pdbg_dtb *dtb,
+		       enum pdbg_backend *backend, enum pdbg_proc *proc)
+{
+	struct trace_header *hdr;
+	struct stat sb;
+	const char *env;
+	uint64_t offset;
+	int fd;
+
+	trace_stop();
+
+	if (!path) {
+		PR_ERROR("No trace file specified\n");
+		return false;
+	}
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		PR_ERROR("Unable to open trace %s: %s\n", path, strerror(errno));
+		return false;
+	}
+
+	if (fstat(fd, &sb) || sb.st_size < sizeof(*hdr)) {
+		PR_ERROR("Invalid trace %s\n", path);
+		close(fd);
+		return false;
+	}
+
+	/* Private and writable as the device trees are updated in place */
+	replay.map = mmap(NULL, sb.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (replay.map == MAP_FAILED) {
+		PR_ERROR("Unable to map trace %s: %s\n", path, strerror(errno));
+		replay.map = NULL;
+		return false;
+	}
+	replay.map_len = sb.st_size;
+
+	hdr = (struct trace_header *)replay.map;
+	offset = sizeof(*hdr) + TRACE_ALIGN(hdr->backend_fdt_size) +
+		 TRACE_ALIGN(hdr->system_fdt_size);
+
+	if (memcmp(hdr->magic, TRACE_MAGIC, sizeof(hdr->magic)) ||
+	    hdr->version != TRACE_VERSION || offset > replay.map_len ||
+	    !hdr->system_fdt_size ||
+	    !replay_fdt(replay.map + sizeof(*hdr), hdr->backend_fdt_size, &dtb->backend) ||
+	    !replay_fdt(replay.map + sizeof(*hdr) + TRACE_ALIGN(hdr->backend_fdt_size),
+			hdr->system_fdt_size, &dtb->system)) {
+		PR_ERROR("Invalid trace %s\n", path);
+		munmap(replay.map, replay.map_len);
+		memset(&replay, 0, sizeof(replay));
+		return false;
+	}
+
+	replay.pos = offset;
+	replay.proc = hdr->proc;
+
+	env = getenv("PDBG_REPLAY_LATENCY");
+	replay.latency = env && *env && strcmp(env, "0");
+
+	*backend = hdr->backend;
+	*proc = hdr->proc;
+	trace_mode = TRACE_REPLAY;
+
+	PR_INFO("Replaying backend transactions from %s\n", path);
+	return true;
+}
+
+void trace_stop(void)
+{
+	if (trace_mode == TRACE_RECORD)
+		pdbg_record_stop();
+
+	if (replay.map)
+		munmap(replay.map, replay.map_len);
+	free(replay.path);
+	free(replay.target);
+	memset(&replay, 0, sizeof(replay));
+
+	if (trace_mode == TRACE_REPLAY)
+		trace_mode = TRACE_OFF;
+}
@@ -0,0 +1,129 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBPDBG_TRACE_H
+#define __LIBPDBG_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "libpdbg.h"
+
+struct pdbg_dtb;
+struct sbefifo_context;
+
+/*
+ * Recording and replay of backend transactions.
+ *
+ * While recording, every FSI, PIB, memory and SBEFIFO transaction
+ * issued through the generic accessors is written to a trace along
+ * with its result and how long it took, as is the result of probing
+ * each target. Only the outermost transaction is recorded, so a PIB
+ * read implemented on top of FSI is recorded as a PIB read.
+ *
+ * When replaying, targets of the transport classes (fsi, pib, mem and
+ * sbefifo) never touch the hardware. Their probes are skipped and the
+ * accessors serve the recorded results in order. Everything layered
+ * on top of them runs as usual.
+ */
+
+enum trace_op {
+	TRACE_TARGET = 1,
+	TRACE_PROBE,
+	TRACE_FSI_READ,
+	TRACE_FSI_WRITE,
+	TRACE_PIB_READ,
+	TRACE_PIB_WRITE,
+	TRACE_MEM_READ,
+	TRACE_MEM_WRITE,
+	TRACE_SBEFIFO,
+};
+
+enum trace_mode {
+	TRACE_OFF = 0,
+	TRACE_RECORD,
+	TRACE_REPLAY,
+};
+
+extern enum trace_mode trace_mode;
+
+static inline bool trace_active(void)
+{
+	return trace_mode != TRACE_OFF;
+}
+
+static inline bool trace_replaying(void)
+{
+	return trace_mode == TRACE_REPLAY;
+}
+
+uint64_t __trace_begin(void);
+void __trace_end(enum trace_op op, struct pdbg_target *target, uint64_t addr,
+		 const void *data, uint32_t size, uint64_t start, int rc);
+
+/*
+ * Bracket a transaction on target. data (may be NULL for writes which
+ * are too large to keep) holds size bytes read or written.
+ */
+static inline uint64_t trace_begin(void)
+{
+	return trace_mode == TRACE_RECORD ? __trace_begin() : 0;
+}
+
+static inline void trace_end(enum trace_op op, struct pdbg_target *target, uint64_t addr,
+			     const void *data, uint32_t size, uint64_t start, int rc)
+{
+	if (trace_mode == TRACE_RECORD)
+		__trace_end(op, target, addr, data, size, start, rc);
+}
+
+void __trace_end_read_list(struct pdbg_target *target, const uint64_t *addr,
+			   const uint64_t *data, int count, uint64_t start);
+
+/*
+ * Same as trace_end() for count PIB registers read in one go, which are
+ * recorded as count single reads.
+ */
+static inline void trace_end_read_list(struct pdbg_target *target, const uint64_t *addr,
+				       const uint64_t *data, int count, uint64_t start)
+{
+	if (trace_mode == TRACE_RECORD)
+		__trace_end_read_list(target, addr, data, count, start);
+}
+
+/*
+ * Serve a transaction from the trace. Reads fill in data, writes are
+ * checked against what was recorded. Returns the recorded result.
+ */
+int trace_replay(enum trace_op op, struct pdbg_target *target, uint64_t addr,
+		 void *data, uint32_t size);
+
+/* Calls (or when replaying, possibly skips) the probe of target */
+int trace_probe(struct pdbg_target *target);
+
+/* Starts recording once the device trees to use are known */
+void trace_start(const struct pdbg_dtb *dtb);
+
+/* Loads the trace given as backend option and the device trees in it */
+bool trace_replay_load(const char *path, struct pdbg_dtb *dtb,
+		       enum pdbg_backend *backend, enum pdbg_proc *proc);
+
+/* Stops recording or replaying */
+void trace_stop(void);
+
+/* Record every operation on sctx against target */
+void trace_sbefifo_attach(struct sbefifo_context *sctx, struct pdbg_target *target);
+
+#endif
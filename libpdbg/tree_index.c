@@ -0,0 +1,285 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "target.h"
+#include "debug.h"
+
+/*
+ * Subtree index used to iterate over the targets of a class below a
+ * given parent.
+ *
+ * Every target is numbered in pre-order, separately for the backend and
+ * the system view of the tree (see get_parent()), and also records the
+ * highest number within its subtree. A target is then a descendant of
+ * another if its number lies within the range of the other one, which
+ * needs no walking up the tree.
+ *
+ * Each class also keeps an array of its targets in the order of the
+ * class list. If the numbers of the targets are increasing along this
+ * array, as they are for most classes, the targets below a parent are
+ * a contiguous range of it, found with a binary search. Otherwise every
+ * target of the class is checked in turn.
+ *
+ * The index is built on first use and rebuilt after the tree changes.
+ */
+
+#define TREE_UNNUMBERED	0
+
+static bool tree_index_valid;
+static pthread_mutex_t tree_index_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void tree_index_invalidate(void)
+{
+	__atomic_store_n(&tree_index_valid, false, __ATOMIC_RELEASE);
+}
+
+static void tree_collect(struct pdbg_target *target, struct pdbg_target ***nodes,
+			 uint32_t *count, uint32_t *size)
+{
+	struct pdbg_target *child;
+
+	if (*count == *size) {
+		*size = *size ? *size * 2 : 256;
+		*nodes = realloc(*nodes, *size * sizeof(**nodes));
+		assert(*nodes);
+	}
+
+	target->tree_id = *count;
+	(*nodes)[(*count)++] = target;
+
+	/* Only the targets created so far, see pdbg_targets_init_lazy() */
+	list_for_each(&target->children, child, list)
+		tree_collect(child, nodes, count, size);
+}
+
+/* Links of the tree as seen through get_parent() */
+struct tree_links {
+	uint32_t *first_child;
+	uint32_t *last_child;
+	uint32_t *next_sibling;
+};
+
+#define TREE_NONE	UINT32_MAX
+
+static uint32_t tree_number(struct pdbg_target **nodes, struct tree_links *links,
+			    uint32_t id, uint32_t pre, int view)
+{
+	struct pdbg_target *target = nodes[id];
+	uint32_t child;
+
+	target->tree_pre[view] = ++pre;
+	for (child = links->first_child[id]; child != TREE_NONE; child = links->next_sibling[child])
+		pre = tree_number(nodes, links, child, pre, view);
+	target->tree_last[view] = pre;
+
+	return pre;
+}
+
+static void tree_index_view(struct pdbg_target **nodes, uint32_t count, int view)
+{
+	struct tree_links links;
+	uint32_t i, id, root_first = TREE_NONE, root_last = TREE_NONE, pre = 0;
+
+	links.first_child = malloc(count * sizeof(uint32_t));
+	links.last_child = malloc(count * sizeof(uint32_t));
+	links.next_sibling = malloc(count * sizeof(uint32_t));
+	assert(links.first_child && links.last_child && links.next_sibling);
+
+	for (i = 0; i < count; i++) {
+		links.first_child[i] = TREE_NONE;
+		links.next_sibling[i] = TREE_NONE;
+		nodes[i]->tree_pre[view] = TREE_UNNUMBERED;
+		nodes[i]->tree_last[view] = TREE_UNNUMBERED;
+	}
+
+	/* Virtual nodes linked to a real target are skipped. Walking up
+	 * the tree only ever reaches the real one. */
+	for (i = 0; i < count; i++) {
+		struct pdbg_target *parent;
+		uint32_t *first, *last;
+
+		if (target_to_real(nodes[i], false) != nodes[i])
+			continue;
+
+		parent = get_parent(nodes[i], view);
+		if (parent && parent->tree_id < count && nodes[parent->tree_id] == parent) {
+			first = &links.first_child[parent->tree_id];
+			last = &links.last_child[parent->tree_id];
+		} else {
+			first = &root_first;
+			last = &root_last;
+		}
+
+		if (*first == TREE_NONE)
+			*first = i;
+		else
+			links.next_sibling[*last] = i;
+		*last = i;
+	}
+
+	for (id = root_first; id != TREE_NONE; id = links.next_sibling[id])
+		pre = tree_number(nodes, &links, id, pre, view);
+
+	free(links.first_child);
+	free(links.last_child);
+	free(links.next_sibling);
+}
+
+static void tree_index_class(struct pdbg_target_class *target_class)
+{
+	struct pdbg_target *target;
+	int i, view, count = 0;
+
+	list_for_each(&target_class->targets, target, class_link)
+		count++;
+
+	if (count > target_class->members_size) {
+		target_class->members = realloc(target_class->members,
+						count * sizeof(*target_class->members));
+		assert(target_class->members);
+		target_class->members_size = count;
+	}
+
+	i = 0;
+	list_for_each(&target_class->targets, target, class_link) {
+		target->class_pos = i;
+		target_class->members[i++] = target;
+	}
+	target_class->nr_members = count;
+
+	for (view = 0; view < 2; view++) {
+		bool ordered = true;
+
+		for (i = 0; i < count && ordered; i++) {
+			uint32_t pre = target_class->members[i]->tree_pre[view];
+
+			if (pre == TREE_UNNUMBERED ||
+			    (i && pre <= target_class->members[i - 1]->tree_pre[view]))
+				ordered = false;
+		}
+
+		target_class->members_ordered[view] = ordered;
+	}
+}
+
+static void tree_index_build(void)
+{
+	struct pdbg_target_class *target_class;
+	struct pdbg_target **nodes = NULL;
+	uint32_t count = 0, size = 0;
+
+	if (pdbg_target_root())
+		tree_collect(pdbg_target_root(), &nodes, &count, &size);
+
+	tree_index_view(nodes, count, 0);
+	tree_index_view(nodes, count, 1);
+	free(nodes);
+
+	list_for_each(&target_classes, target_class, class_head_link)
+		tree_index_class(target_class);
+
+	PR_DEBUG("Indexed %u targets\n", count);
+}
+
+static void tree_index_update(void)
+{
+	if (__atomic_load_n(&tree_index_valid, __ATOMIC_ACQUIRE))
+		return;
+
+	pthread_mutex_lock(&tree_index_lock);
+	if (!tree_index_valid) {
+		tree_index_build();
+		__atomic_store_n(&tree_index_valid, true, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&tree_index_lock);
+}
+
+/* Is target the same as, or below, parent? */
+static bool tree_is_below(struct pdbg_target *target, struct pdbg_target *parent, int view)
+{
+	struct pdbg_target *tmp;
+
+	if (target == parent)
+		return true;
+
+	if (target->tree_pre[view] != TREE_UNNUMBERED &&
+	    parent->tree_pre[view] != TREE_UNNUMBERED)
+		return parent->tree_pre[view] <= target->tree_pre[view] &&
+		       target->tree_pre[view] <= parent->tree_last[view];
+
+	/* Not part of the index, so walk up the tree */
+	for (tmp = target; tmp && get_parent(tmp, view) && tmp != parent; tmp = get_parent(tmp, view)) {}
+
+	return tmp == parent;
+}
+
+/* First member of an ordered class numbered at or after pre */
+static int tree_lower_bound(struct pdbg_target_class *target_class, uint32_t pre, int view)
+{
+	int lo = 0, hi = target_class->nr_members;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (target_class->members[mid]->tree_pre[view] < pre)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+struct pdbg_target *tree_index_next(struct pdbg_target_class *target_class,
+				    struct pdbg_target *parent,
+				    struct pdbg_target *last, bool system)
+{
+	struct pdbg_target *next;
+	int view = system ? 1 : 0;
+	int i;
+
+	tree_index_update();
+
+	if (target_class->members_ordered[view] &&
+	    parent->tree_pre[view] != TREE_UNNUMBERED) {
+		if (last)
+			i = last->class_pos + 1;
+		else
+			i = tree_lower_bound(target_class, parent->tree_pre[view], view);
+
+		if (i >= target_class->nr_members)
+			return NULL;
+
+		next = target_class->members[i];
+		if (next->tree_pre[view] > parent->tree_last[view])
+			return NULL;
+
+		return next;
+	}
+
+	for (i = last ? last->class_pos + 1 : 0; i < target_class->nr_members; i++) {
+		next = target_class->members[i];
+		if (tree_is_below(next, parent, view))
+			return next;
+	}
+
+	return NULL;
+}
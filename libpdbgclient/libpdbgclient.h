@@ -0,0 +1,136 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __LIBPDBGCLIENT_H
+#define __LIBPDBGCLIENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Client of 'pdbg daemon <socket>'
+ *
+ * The daemon keeps the probed target tree and the open backend, and
+ * serves scom, cfam and memory accesses over a Unix socket. Each
+ * request is applied to the targets selected by its selectors, which
+ * take the same form as the -P option of pdbg (eg. "pib", "proc0/pib"
+ * or "fsi"). Register and thread accesses are not served yet.
+ *
+ * Functions return -1 and set errno on error.
+ */
+
+#define PDBG_CLIENT_MAX_SELECTORS	16
+#define PDBG_CLIENT_MAX_SEL_LEN		4096
+
+/* Largest memory access per request, larger ones have to be split */
+#define PDBG_CLIENT_MAX_DATA		(256 * 1024)
+
+enum pdbg_client_kind {
+	PDBG_CLIENT_SCOM,
+	PDBG_CLIENT_CFAM,
+	PDBG_CLIENT_MEM,
+};
+
+struct pdbg_client_op {
+	enum pdbg_client_kind kind;
+	bool write;
+	uint64_t addr;
+
+	/* Value and mask written by scom and cfam writes */
+	uint64_t value;
+	uint64_t mask;
+
+	/* Size of memory reads, or the data of memory writes */
+	uint64_t size;
+	uint8_t *data;
+};
+
+struct pdbg_client_result {
+	int rc;
+
+	/* Chip index, target path and address as printed by pdbg */
+	uint32_t index;
+	const char *path;
+	uint64_t addr;
+
+	/* Value read by scom and cfam reads, data read by memory reads */
+	uint64_t value;
+	const uint8_t *data;
+	uint64_t size;
+};
+
+struct pdbg_client_reply {
+	/* 0 on success, -1 if the request selected no targets */
+	int status;
+	int nr_results;
+	struct pdbg_client_result *results;
+	uint8_t *buf;
+};
+
+/**
+ * @brief Connect to a daemon
+ *
+ * @param[in] path Path of the daemon socket
+ * @return socket fd on success, -1 on error
+ */
+int pdbg_client_connect(const char *path);
+
+/**
+ * @brief Send a request
+ *
+ * Only one request may be outstanding on a connection, its reply has
+ * to be received before the next one is sent.
+ *
+ * @param[in] fd Socket
+ * @param[in] op The operation
+ * @param[in] sel Target selectors
+ * @param[in] nr_sel Number of target selectors
+ * @return 0 on success, -1 on error
+ */
+int pdbg_client_send(int fd, const struct pdbg_client_op *op, const char **sel, int nr_sel);
+
+/**
+ * @brief Receive the reply to a request
+ *
+ * @param[in] fd Socket
+ * @param[out] reply The reply, to be released with pdbg_client_reply_free()
+ * @return 0 on success, -1 on error
+ */
+int pdbg_client_recv(int fd, struct pdbg_client_reply *reply);
+
+/**
+ * @brief Send a request and wait for the reply
+ *
+ * @return 0 on success, -1 on error
+ */
+int pdbg_client_call(int fd, const struct pdbg_client_op *op, const char **sel, int nr_sel,
+		     struct pdbg_client_reply *reply);
+
+/**
+ * @brief Free the results of a reply
+ *
+ * @param[in] reply The reply
+ */
+void pdbg_client_reply_free(struct pdbg_client_reply *reply);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,420 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <endian.h>
+#include <assert.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "libpdbgclient.h"
+#include "rpc.h"
+
+struct rpc_request_hdr {
+	uint32_t magic;
+	uint8_t kind;
+	uint8_t write;
+	uint16_t nr_sel;
+	uint32_t sel_len;
+	uint32_t data_len;
+	uint64_t addr;
+	uint64_t value;
+	uint64_t mask;
+	uint64_t size;
+} __attribute__((packed));
+
+struct rpc_reply_hdr {
+	uint32_t magic;
+	int32_t status;
+	uint32_t nr_results;
+	uint32_t reserved;
+} __attribute__((packed));
+
+struct rpc_result_hdr {
+	int32_t rc;
+	uint32_t index;
+	uint16_t path_len;
+	uint16_t reserved;
+	uint32_t data_len;
+	uint64_t addr;
+	uint64_t value;
+} __attribute__((packed));
+
+static int write_full(int fd, const void *buf, size_t len)
+{
+	const uint8_t *p = buf;
+	ssize_t n;
+
+	while (len) {
+		n = send(fd, p, len, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		p += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/* Returns 1 if the connection is closed before anything was read */
+static int read_full(int fd, void *buf, size_t len)
+{
+	uint8_t *p = buf;
+	size_t done = 0;
+	ssize_t n;
+
+	while (done < len) {
+		n = read(fd, p + done, len - done);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		if (n == 0) {
+			errno = ECONNRESET;
+			return done ? -1 : 1;
+		}
+
+		done += n;
+	}
+
+	return 0;
+}
+
+int pdbg_client_connect(const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		int err = errno;
+
+		close(fd);
+		errno = err;
+		return -1;
+	}
+
+	return fd;
+}
+
+int pdbg_client_send(int fd, const struct pdbg_client_op *op, const char **sel, int nr_sel)
+{
+	struct rpc_request_hdr hdr;
+	size_t sel_len = 0;
+	uint8_t *buf, *p;
+	uint32_t data_len;
+	int i, rc;
+
+	if (nr_sel > PDBG_CLIENT_MAX_SELECTORS ||
+	    (op->kind == PDBG_CLIENT_MEM && op->size > PDBG_CLIENT_MAX_DATA)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (i = 0; i < nr_sel; i++)
+		sel_len += strlen(sel[i]) + 1;
+
+	if (sel_len > PDBG_CLIENT_MAX_SEL_LEN) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	data_len = op->kind == PDBG_CLIENT_MEM && op->write ? op->size : 0;
+
+	hdr.magic = htobe32(RPC_MAGIC);
+	hdr.kind = op->kind;
+	hdr.write = op->write;
+	hdr.nr_sel = htobe16(nr_sel);
+	hdr.sel_len = htobe32(sel_len);
+	hdr.data_len = htobe32(data_len);
+	hdr.addr = htobe64(op->addr);
+	hdr.value = htobe64(op->value);
+	hdr.mask = htobe64(op->mask);
+	hdr.size = htobe64(op->size);
+
+	buf = malloc(sizeof(hdr) + sel_len + data_len);
+	if (!buf)
+		return -1;
+
+	p = buf;
+	memcpy(p, &hdr, sizeof(hdr));
+	p += sizeof(hdr);
+	for (i = 0; i < nr_sel; i++) {
+		size_t len = strlen(sel[i]) + 1;
+
+		memcpy(p, sel[i], len);
+		p += len;
+	}
+	if (data_len)
+		memcpy(p, op->data, data_len);
+
+	rc = write_full(fd, buf, sizeof(hdr) + sel_len + data_len);
+	free(buf);
+
+	return rc;
+}
+
+int rpc_parse_request(const uint8_t *buf, size_t len, struct pdbg_client_op *op,
+		      const char **sel, int *nr_sel, char **sel_buf)
+{
+	struct rpc_request_hdr hdr;
+	uint32_t sel_len, data_len;
+	char *p, *end;
+	size_t total;
+	int i;
+
+	memset(op, 0, sizeof(*op));
+	*sel_buf = NULL;
+
+	if (len < sizeof(hdr))
+		return 0;
+
+	memcpy(&hdr, buf, sizeof(hdr));
+	sel_len = be32toh(hdr.sel_len);
+	data_len = be32toh(hdr.data_len);
+
+	op->kind = hdr.kind;
+	op->write = hdr.write;
+	op->addr = be64toh(hdr.addr);
+	op->value = be64toh(hdr.value);
+	op->mask = be64toh(hdr.mask);
+	op->size = be64toh(hdr.size);
+	*nr_sel = be16toh(hdr.nr_sel);
+
+	if (be32toh(hdr.magic) != RPC_MAGIC || hdr.kind > PDBG_CLIENT_MEM || hdr.write > 1 ||
+	    *nr_sel > PDBG_CLIENT_MAX_SELECTORS || sel_len > PDBG_CLIENT_MAX_SEL_LEN ||
+	    data_len > PDBG_CLIENT_MAX_DATA)
+		return -1;
+
+	if (op->kind == PDBG_CLIENT_MEM) {
+		if (op->write)
+			op->size = data_len;
+
+		if (op->size == 0 || op->size > PDBG_CLIENT_MAX_DATA)
+			return -1;
+	} else if (data_len) {
+		return -1;
+	}
+
+	total = sizeof(hdr) + sel_len + data_len;
+	if (len < total)
+		return 0;
+
+	buf += sizeof(hdr);
+
+	*sel_buf = malloc(sel_len + 1);
+	if (!*sel_buf)
+		return -1;
+
+	memcpy(*sel_buf, buf, sel_len);
+	buf += sel_len;
+
+	/* Make sure the last selector is terminated */
+	(*sel_buf)[sel_len] = '\0';
+
+	p = *sel_buf;
+	end = *sel_buf + sel_len;
+	for (i = 0; i < *nr_sel; i++) {
+		if (p >= end)
+			return -1;
+
+		sel[i] = p;
+		p += strlen(p) + 1;
+	}
+
+	if (data_len) {
+		op->data = malloc(data_len);
+		if (!op->data)
+			return -1;
+
+		memcpy(op->data, buf, data_len);
+	}
+
+	return total;
+}
+
+int rpc_encode_reply(int status, const struct pdbg_client_result *res, int count,
+		     uint8_t **out, size_t *out_len)
+{
+	struct rpc_reply_hdr hdr;
+	uint8_t *buf, *p;
+	size_t len = sizeof(hdr);
+	int i;
+
+	for (i = 0; i < count; i++) {
+		len += sizeof(struct rpc_result_hdr) + strlen(res[i].path);
+		if (!res[i].rc && res[i].data)
+			len += res[i].size;
+	}
+
+	buf = malloc(len);
+	if (!buf)
+		return -1;
+
+	hdr.magic = htobe32(RPC_MAGIC);
+	hdr.status = htobe32(status);
+	hdr.nr_results = htobe32(count);
+	hdr.reserved = 0;
+
+	p = buf;
+	memcpy(p, &hdr, sizeof(hdr));
+	p += sizeof(hdr);
+
+	for (i = 0; i < count; i++) {
+		struct rpc_result_hdr rhdr;
+		uint32_t path_len = strlen(res[i].path);
+		uint32_t data_len = !res[i].rc && res[i].data ? res[i].size : 0;
+
+		rhdr.rc = htobe32(res[i].rc);
+		rhdr.index = htobe32(res[i].index);
+		rhdr.path_len = htobe16(path_len);
+		rhdr.reserved = 0;
+		rhdr.data_len = htobe32(data_len);
+		rhdr.addr = htobe64(res[i].addr);
+		rhdr.value = htobe64(res[i].value);
+
+		memcpy(p, &rhdr, sizeof(rhdr));
+		p += sizeof(rhdr);
+		memcpy(p, res[i].path, path_len);
+		p += path_len;
+		if (data_len) {
+			memcpy(p, res[i].data, data_len);
+			p += data_len;
+		}
+	}
+
+	*out = buf;
+	*out_len = len;
+
+	return 0;
+}
+
+int pdbg_client_recv(int fd, struct pdbg_client_reply *reply)
+{
+	struct rpc_reply_hdr hdr;
+	uint8_t *p;
+	size_t len = 0, size = 0;
+	int i;
+
+	memset(reply, 0, sizeof(*reply));
+
+	if (read_full(fd, &hdr, sizeof(hdr)))
+		goto fail;
+
+	if (be32toh(hdr.magic) != RPC_MAGIC)
+		goto proto;
+
+	reply->status = (int32_t)be32toh(hdr.status);
+	reply->nr_results = be32toh(hdr.nr_results);
+	if (reply->nr_results < 0)
+		goto proto;
+
+	reply->results = calloc(reply->nr_results + 1, sizeof(*reply->results));
+	if (!reply->results)
+		goto fail;
+
+	/* Paths and data are kept in a single buffer, with the paths NUL
+	 * terminated. Pointers are only filled in once it stops moving. */
+	for (i = 0; i < reply->nr_results; i++) {
+		struct rpc_result_hdr rhdr;
+		struct pdbg_client_result *res = &reply->results[i];
+		uint32_t path_len, data_len;
+
+		if (read_full(fd, &rhdr, sizeof(rhdr)))
+			goto fail;
+
+		path_len = be16toh(rhdr.path_len);
+		data_len = be32toh(rhdr.data_len);
+		if (data_len > PDBG_CLIENT_MAX_DATA)
+			goto proto;
+
+		res->rc = (int32_t)be32toh(rhdr.rc);
+		res->index = be32toh(rhdr.index);
+		res->addr = be64toh(rhdr.addr);
+		res->value = be64toh(rhdr.value);
+		res->size = data_len;
+
+		if (len + path_len + 1 + data_len > size) {
+			size = (len + path_len + 1 + data_len) * 2;
+			p = realloc(reply->buf, size);
+			if (!p)
+				goto fail;
+			reply->buf = p;
+		}
+
+		/* Offsets for now */
+		res->path = (const char *)(uintptr_t)len;
+		if (read_full(fd, reply->buf + len, path_len))
+			goto fail;
+		reply->buf[len + path_len] = '\0';
+		len += path_len + 1;
+
+		res->data = (const uint8_t *)(uintptr_t)len;
+		if (data_len && read_full(fd, reply->buf + len, data_len))
+			goto fail;
+		len += data_len;
+	}
+
+	for (i = 0; i < reply->nr_results; i++) {
+		struct pdbg_client_result *res = &reply->results[i];
+
+		res->path = (const char *)reply->buf + (uintptr_t)res->path;
+		res->data = res->size ? reply->buf + (uintptr_t)res->data : NULL;
+	}
+
+	return 0;
+
+proto:
+	errno = EPROTO;
+fail:
+	pdbg_client_reply_free(reply);
+	return -1;
+}
+
+void pdbg_client_reply_free(struct pdbg_client_reply *reply)
+{
+	free(reply->results);
+	free(reply->buf);
+	reply->results = NULL;
+	reply->buf = NULL;
+}
+
+int pdbg_client_call(int fd, const struct pdbg_client_op *op, const char **sel, int nr_sel,
+		     struct pdbg_client_reply *reply)
+{
+	if (pdbg_client_send(fd, op, sel, nr_sel))
+		return -1;
+
+	return pdbg_client_recv(fd, reply);
+}
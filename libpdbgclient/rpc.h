@@ -0,0 +1,99 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __RPC_H
+#define __RPC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libpdbgclient.h"
+
+/*
+ * Protocol between 'pdbg daemon' and its clients
+ *
+ * A client sends one request at a time over a Unix stream socket and
+ * reads the reply before sending the next one. All numbers are big
+ * endian.
+ *
+ * Request:
+ *	u32 magic	RPC_MAGIC
+ *	u8  kind	enum pdbg_client_kind
+ *	u8  write	1 for put operations
+ *	u16 nr_sel	number of target selectors
+ *	u32 sel_len	length of the selectors
+ *	u32 data_len	length of the data written by putmem
+ *	u64 addr
+ *	u64 value	value written by putscom/putcfam
+ *	u64 mask	mask of putscom/putcfam
+ *	u64 size	size read by getmem
+ *	sel_len bytes of NUL terminated selectors, as given to -P
+ *	data_len bytes of data
+ *
+ * Reply:
+ *	u32 magic	RPC_MAGIC
+ *	i32 status	0 on success, -1 if the request was invalid or
+ *			selected no targets
+ *	u32 nr_results
+ *	u32 reserved
+ *	nr_results results, each:
+ *		i32 rc		0 on success
+ *		u32 index	chip index
+ *		u16 path_len	length of the target path
+ *		u16 reserved
+ *		u32 data_len	length of the data read by getmem
+ *		u64 addr
+ *		u64 value	value read by getscom/getcfam
+ *		path_len bytes of target path, not NUL terminated
+ *		data_len bytes of data
+ *
+ * The daemon side of the protocol is below, the client side is in
+ * libpdbgclient.h.
+ */
+
+#define RPC_MAGIC		0x50444247
+
+/**
+ * @brief Parse a request from the data received so far
+ *
+ * The daemon doesn't block on its clients, so requests are parsed from
+ * whatever has arrived rather than read from the socket.
+ *
+ * @param[in] buf Data received
+ * @param[in] len Length of the data
+ * @param[out] op The operation, op->data must be freed by the caller
+ * @param[out] sel Target selectors, pointing into *sel_buf
+ * @param[out] nr_sel Number of target selectors
+ * @param[out] sel_buf Buffer to be freed by the caller
+ * @return length of the request if all of it has arrived, 0 if more
+ * data is needed, -1 if the request is invalid
+ */
+int rpc_parse_request(const uint8_t *buf, size_t len, struct pdbg_client_op *op,
+		      const char **sel, int *nr_sel, char **sel_buf);
+
+/**
+ * @brief Build a reply
+ *
+ * @param[in] status Status of the request
+ * @param[in] res Results
+ * @param[in] count Number of results
+ * @param[out] buf The reply, to be freed by the caller
+ * @param[out] len Length of the reply
+ * @return 0 on success, -1 on error
+ */
+int rpc_encode_reply(int status, const struct pdbg_client_result *res, int count,
+		     uint8_t **buf, size_t *len);
+
+#endif
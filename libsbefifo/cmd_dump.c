@@ -66,6 +66,9 @@ static int sbefifo_get_dump_pull(uint8_t *buf, uint32_t buflen, uint8_t **data,
 	return 0;
 }
 
+/* dump size can be as large as 80MB */
+#define SBEFIFO_DUMP_MAX_SIZE	(80 * 1024 * 1024)
+
 int sbefifo_get_dump(struct sbefifo_context *sctx, uint8_t type, uint8_t clock, uint8_t fa_collect, uint8_t **data, uint32_t *data_len)
 {
 	uint8_t *msg, *out;
@@ -81,8 +84,7 @@ int sbefifo_get_dump(struct sbefifo_context *sctx, uint8_t type, uint8_t clock,
 		return rc;
 	}
 
-	/* dump size can be as large as 80MB */
-	out_len = 80 * 1024 * 1024;
+	out_len = SBEFIFO_DUMP_MAX_SIZE;
 	rc = sbefifo_operation(sctx, msg, msg_len, &out, &out_len);
 	sbefifo_reset_timeout(sctx);
 	free(msg);
@@ -95,3 +97,29 @@ int sbefifo_get_dump(struct sbefifo_context *sctx, uint8_t type, uint8_t clock,
 
 	return rc;
 }
+
+int sbefifo_get_dump_fd(struct sbefifo_context *sctx, uint8_t type, uint8_t clock, uint8_t fa_collect, int fd, uint32_t *data_len)
+{
+	uint8_t *msg;
+	uint32_t msg_len, out_len;
+	int rc;
+
+	rc = sbefifo_get_dump_push(type, clock, fa_collect, &msg, &msg_len);
+	if (rc)
+		return rc;
+	rc = sbefifo_set_long_long_timeout(sctx);
+	if (rc) {
+		free(msg);
+		return rc;
+	}
+
+	out_len = SBEFIFO_DUMP_MAX_SIZE;
+	rc = sbefifo_operation_fd(sctx, msg, msg_len, fd, &out_len);
+	sbefifo_reset_timeout(sctx);
+	free(msg);
+	if (rc)
+		return rc;
+
+	*data_len = out_len;
+	return 0;
+}
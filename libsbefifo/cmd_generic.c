@@ -70,11 +70,14 @@ int sbefifo_get_ffdc(struct sbefifo_context *sctx)
 		return rc;
 
 	rc = sbefifo_get_ffdc_pull(out, out_len);
-	if (rc)
+	if (rc) {
+		free(out);
 		return rc;
+	}
 
 	status = SBEFIFO_PRI_UNKNOWN_ERROR | SBEFIFO_SEC_GENERIC_FAILURE;
 	sbefifo_ffdc_set(sctx, status, out, out_len);
+	free(out);
 	return 0;
 }
 
@@ -54,7 +54,7 @@ static int sbefifo_register_get_push(uint8_t core_id, uint8_t thread_id, uint8_t
 	return 0;
 }
 
-static int sbefifo_register_get_pull(uint8_t *buf, uint32_t buflen, uint8_t reg_count, uint64_t **value)
+static int sbefifo_register_get_pull(uint8_t *buf, uint32_t buflen, uint8_t reg_count, uint64_t *value)
 {
 	uint32_t i;
 	uint32_t *b = (uint32_t *)buf;
@@ -62,23 +62,19 @@ static int sbefifo_register_get_pull(uint8_t *buf, uint32_t buflen, uint8_t reg_
 	if (buflen != reg_count * 8)
 		return EPROTO;
 
-	*value = malloc(reg_count * 8);
-	if (! *value)
-		return ENOMEM;
-
 	for (i=0; i<reg_count; i++) {
 		uint32_t val1, val2;
 
 		val1 = be32toh(b[i*2]);
 		val2 = be32toh(b[i*2+1]);
 
-		(*value)[i] = ((uint64_t)val1 << 32) | (uint64_t)val2;
+		value[i] = ((uint64_t)val1 << 32) | (uint64_t)val2;
 	}
 
 	return 0;
 }
 
-int sbefifo_register_get(struct sbefifo_context *sctx, uint8_t core_id, uint8_t thread_id, uint8_t reg_type, uint32_t *reg_id, uint8_t reg_count, uint64_t **value)
+static int sbefifo_register_get_one(struct sbefifo_context *sctx, uint8_t core_id, uint8_t thread_id, uint8_t reg_type, uint32_t *reg_id, uint8_t reg_count, uint64_t *value)
 {
 	uint8_t *msg, *out;
 	uint32_t msg_len, out_len;
@@ -88,18 +84,12 @@ int sbefifo_register_get(struct sbefifo_context *sctx, uint8_t core_id, uint8_t
 	if (rc)
 		return rc;
 
-	rc = sbefifo_set_long_timeout(sctx);
-	if (rc)
-		return rc;
-
 	out_len = reg_count * 8;
 	rc = sbefifo_operation(sctx, msg, msg_len, &out, &out_len);
 	free(msg);
 	if (rc)
 		return rc;
 
-	sbefifo_reset_timeout(sctx);
-
 	rc = sbefifo_register_get_pull(out, out_len, reg_count, value);
 	if (out)
 		free(out);
@@ -107,6 +97,61 @@ int sbefifo_register_get(struct sbefifo_context *sctx, uint8_t core_id, uint8_t
 	return rc;
 }
 
+int sbefifo_register_get(struct sbefifo_context *sctx, uint8_t core_id, uint8_t thread_id, uint8_t reg_type, uint32_t *reg_id, uint8_t reg_count, uint64_t **value)
+{
+	int rc;
+
+	if (reg_count == 0 || reg_count > 64)
+		return EINVAL;
+
+	*value = malloc(reg_count * 8);
+	if (! *value)
+		return ENOMEM;
+
+	rc = sbefifo_set_long_timeout(sctx);
+	if (rc)
+		goto fail;
+
+	rc = sbefifo_register_get_one(sctx, core_id, thread_id, reg_type, reg_id, reg_count, *value);
+	sbefifo_reset_timeout(sctx);
+	if (rc)
+		goto fail;
+
+	return 0;
+
+fail:
+	free(*value);
+	*value = NULL;
+	return rc;
+}
+
+int sbefifo_register_get_list(struct sbefifo_context *sctx, struct sbefifo_register_request *req, uint32_t count)
+{
+	uint32_t i;
+	int rc, ret = 0;
+
+	/* Set the timeout once for the whole batch rather than per command */
+	rc = sbefifo_set_long_timeout(sctx);
+	if (rc)
+		return rc;
+
+	for (i=0; i<count; i++) {
+		req[i].rc = sbefifo_register_get_one(sctx,
+						     req[i].core_id,
+						     req[i].thread_id,
+						     req[i].reg_type,
+						     req[i].reg_id,
+						     req[i].reg_count,
+						     req[i].value);
+		if (req[i].rc && !ret)
+			ret = req[i].rc;
+	}
+
+	sbefifo_reset_timeout(sctx);
+
+	return ret;
+}
+
 static int sbefifo_register_put_push(uint8_t core_id, uint8_t thread_id, uint8_t reg_type, uint32_t *reg_id, uint8_t reg_count, uint64_t *value, uint8_t **buf, uint32_t *buflen)
 {
 	uint32_t *msg;
@@ -103,6 +103,8 @@ int sbefifo_connect_transport(int proc, sbefifo_transport_fn transport, void *pr
 
 void sbefifo_disconnect(struct sbefifo_context *sctx)
 {
+	sbefifo_ffdc_capture_stop(sctx);
+
 	if (sctx->fd != -1)
 		close(sctx->fd);
 
@@ -122,6 +124,10 @@ int sbefifo_set_long_timeout(struct sbefifo_context *sctx)
 	unsigned int long_timeout = 30;
 	int rc;
 
+	/* Timeouts are up to the transport */
+	if (sctx->transport)
+		return 0;
+
 	LOG("long_timeout: %u sec\n", long_timeout);
 	rc = ioctl(sctx->fd, FSI_SBEFIFO_READ_TIMEOUT, &long_timeout);
 	if (rc == -1 && errno == ENOTTY) {
@@ -137,6 +143,10 @@ int sbefifo_set_long_long_timeout(struct sbefifo_context *sctx)
 	unsigned int long_timeout = 120;
 	int rc;
 
+	/* Timeouts are up to the transport */
+	if (sctx->transport)
+		return 0;
+
 	LOG("long_timeout: %u sec\n", long_timeout);
 	rc = ioctl(sctx->fd, FSI_SBEFIFO_READ_TIMEOUT, &long_timeout);
 	if (rc == -1 && errno == ENOTTY) {
@@ -151,6 +161,10 @@ int sbefifo_reset_timeout(struct sbefifo_context *sctx)
 	unsigned int timeout = 0;
 	int rc;
 
+	/* Timeouts are up to the transport */
+	if (sctx->transport)
+		return 0;
+
 	LOG("reset_timeout\n");
 	rc = ioctl(sctx->fd, FSI_SBEFIFO_READ_TIMEOUT, &timeout);
 	if (rc == -1 && errno == ENOTTY) {
@@ -17,33 +17,260 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <errno.h>
 #include <endian.h>
+#include <time.h>
+#include <pthread.h>
+#include <inttypes.h>
+#include <stdbool.h>
 
 #include "sbefifo_private.h"
 
-void sbefifo_ffdc_clear(struct sbefifo_context *sctx)
+/*
+ * FFDC capture
+ *
+ * Every FFDC blob returned by the SBE is copied into a ring buffer
+ * together with a header, and written out to a file by a background
+ * thread. The command path only takes a lock and copies the blob. When
+ * the ring is full blobs are dropped rather than waiting for the
+ * writer, and the number dropped is recorded in the next header, or in
+ * a record without FFDC when capture stops.
+ */
+#define FFDC_RECORD_MAGIC	0x46464443	/* "FFDC" */
+
+struct ffdc_record_hdr {
+	uint32_t magic;
+	uint32_t status;
+	uint32_t len;
+	uint32_t dropped;
+	uint64_t timestamp_ns;
+} __attribute__((packed));
+
+struct sbefifo_ffdc_ring {
+	pthread_t writer;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool stop;
+	int fd;
+
+	uint8_t *buf;
+	uint32_t size;
+
+	/* Free running offsets, taken modulo size */
+	uint64_t head;
+	uint64_t tail;
+
+	uint32_t dropped;
+};
+
+static void ffdc_ring_copy(struct sbefifo_ffdc_ring *ring, const void *data, uint32_t len)
 {
-	sctx->status = 0;
+	uint32_t offset = ring->head % ring->size;
+	uint32_t first = ring->size - offset;
+
+	if (first > len)
+		first = len;
+
+	memcpy(ring->buf + offset, data, first);
+	memcpy(ring->buf, (const uint8_t *)data + first, len - first);
+	ring->head += len;
+}
+
+static void ffdc_record_hdr_init(struct ffdc_record_hdr *hdr, uint32_t status,
+				 uint32_t len, uint32_t dropped)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	hdr->magic = htobe32(FFDC_RECORD_MAGIC);
+	hdr->status = htobe32(status);
+	hdr->len = htobe32(len);
+	hdr->dropped = htobe32(dropped);
+	hdr->timestamp_ns = htobe64((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+static void sbefifo_ffdc_ring_add(struct sbefifo_ffdc_ring *ring, uint32_t status,
+				  const uint8_t *ffdc, uint32_t ffdc_len)
+{
+	struct ffdc_record_hdr hdr;
+	uint64_t len = sizeof(hdr) + ffdc_len;
+
+	pthread_mutex_lock(&ring->lock);
+
+	if (ring->head - ring->tail + len > ring->size) {
+		ring->dropped++;
+		pthread_mutex_unlock(&ring->lock);
+		return;
+	}
+
+	ffdc_record_hdr_init(&hdr, status, ffdc_len, ring->dropped);
+	ring->dropped = 0;
+
+	ffdc_ring_copy(ring, &hdr, sizeof(hdr));
+	ffdc_ring_copy(ring, ffdc, ffdc_len);
+
+	pthread_cond_signal(&ring->cond);
+	pthread_mutex_unlock(&ring->lock);
+}
+
+static void *ffdc_ring_writer(void *arg)
+{
+	struct sbefifo_ffdc_ring *ring = arg;
+
+	pthread_mutex_lock(&ring->lock);
+	while (1) {
+		uint32_t offset, len;
+		ssize_t n;
+
+		while (ring->head == ring->tail && !ring->stop)
+			pthread_cond_wait(&ring->cond, &ring->lock);
+
+		if (ring->head == ring->tail)
+			break;
+
+		/* Write the contiguous part without holding the lock, the
+		 * command path only ever writes to the free part */
+		offset = ring->tail % ring->size;
+		len = ring->head - ring->tail;
+		if (len > ring->size - offset)
+			len = ring->size - offset;
+
+		pthread_mutex_unlock(&ring->lock);
+		n = write(ring->fd, ring->buf + offset, len);
+		pthread_mutex_lock(&ring->lock);
+
+		if (n < 0 && errno == EINTR)
+			continue;
 
-	if (sctx->ffdc) {
-		free(sctx->ffdc);
-		sctx->ffdc = NULL;
-		sctx->ffdc_len = 0;
+		if (n <= 0) {
+			/* Nowhere to put it, drop the rest */
+			LOG("ffdc: write failed, dropping %" PRIu64 " bytes\n",
+			    ring->head - ring->tail);
+			ring->tail = ring->head;
+			continue;
+		}
+
+		ring->tail += n;
 	}
+	pthread_mutex_unlock(&ring->lock);
+
+	return NULL;
+}
+
+int sbefifo_ffdc_capture_start(struct sbefifo_context *sctx, int fd, uint32_t ring_size)
+{
+	struct sbefifo_ffdc_ring *ring;
+	int rc;
+
+	if (sctx->ffdc_ring || ring_size <= sizeof(struct ffdc_record_hdr))
+		return EINVAL;
+
+	ring = calloc(1, sizeof(*ring));
+	if (!ring)
+		return ENOMEM;
+
+	ring->buf = malloc(ring_size);
+	if (!ring->buf) {
+		free(ring);
+		return ENOMEM;
+	}
+
+	ring->size = ring_size;
+	ring->fd = fd;
+	pthread_mutex_init(&ring->lock, NULL);
+	pthread_cond_init(&ring->cond, NULL);
+
+	rc = pthread_create(&ring->writer, NULL, ffdc_ring_writer, ring);
+	if (rc) {
+		pthread_mutex_destroy(&ring->lock);
+		pthread_cond_destroy(&ring->cond);
+		free(ring->buf);
+		free(ring);
+		return rc;
+	}
+
+	sctx->ffdc_ring = ring;
+	return 0;
+}
+
+void sbefifo_ffdc_capture_stop(struct sbefifo_context *sctx)
+{
+	struct sbefifo_ffdc_ring *ring = sctx->ffdc_ring;
+
+	if (!ring)
+		return;
+
+	pthread_mutex_lock(&ring->lock);
+	ring->stop = true;
+	pthread_cond_signal(&ring->cond);
+	pthread_mutex_unlock(&ring->lock);
+
+	pthread_join(ring->writer, NULL);
+
+	/* Let readers know the capture is missing records at the end */
+	if (ring->dropped) {
+		struct ffdc_record_hdr hdr;
+		const uint8_t *p = (const uint8_t *)&hdr;
+		size_t len = sizeof(hdr);
+
+		LOG("ffdc: dropped %u records\n", ring->dropped);
+
+		ffdc_record_hdr_init(&hdr, 0, 0, ring->dropped);
+		while (len > 0) {
+			ssize_t n = write(ring->fd, p, len);
+
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				break;
+
+			p += n;
+			len -= n;
+		}
+	}
+
+	close(ring->fd);
+	pthread_mutex_destroy(&ring->lock);
+	pthread_cond_destroy(&ring->cond);
+	free(ring->buf);
+	free(ring);
+	sctx->ffdc_ring = NULL;
+}
+
+/* The FFDC buffer is kept for the next operation, so it is only
+ * allocated when an operation returns more FFDC than any before */
+void sbefifo_ffdc_clear(struct sbefifo_context *sctx)
+{
+	sctx->status = 0;
+	sctx->ffdc_len = 0;
 }
 
 void sbefifo_ffdc_set(struct sbefifo_context *sctx, uint32_t status, uint8_t *ffdc, uint32_t ffdc_len)
 {
 	sctx->status = status;
+	sctx->ffdc_len = 0;
 
-	sctx->ffdc = malloc(ffdc_len);
-	if (!sctx->ffdc) {
-		fprintf(stderr, "Memory allocation error\n");
-		return;
+	if (ffdc_len > sctx->ffdc_size) {
+		uint8_t *buf;
+
+		buf = realloc(sctx->ffdc, ffdc_len);
+		if (!buf) {
+			fprintf(stderr, "Memory allocation error\n");
+			return;
+		}
+
+		sctx->ffdc = buf;
+		sctx->ffdc_size = ffdc_len;
 	}
 
-	memcpy(sctx->ffdc, ffdc, ffdc_len);
+	if (ffdc_len > 0)
+		memcpy(sctx->ffdc, ffdc, ffdc_len);
 	sctx->ffdc_len = ffdc_len;
+
+	if (sctx->ffdc_ring && ffdc_len > 0)
+		sbefifo_ffdc_ring_add(sctx->ffdc_ring, status, ffdc, ffdc_len);
 }
 
 uint32_t sbefifo_ffdc_get(struct sbefifo_context *sctx, const uint8_t **ffdc, uint32_t *ffdc_len)
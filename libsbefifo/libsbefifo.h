@@ -109,10 +109,30 @@ typedef int (*sbefifo_transport_fn)(uint8_t *msg, uint32_t msg_len,
 				    uint8_t *out, uint32_t *out_len,
 				    void *private_data);
 
+/*
+ * Called after every operation with the command, request and reply
+ * lengths (in bytes), the time it took and its return code. When an
+ * enabled flag is given with the callback, operations are only timed
+ * and reported while it is set.
+ */
+typedef void (*sbefifo_op_fn)(uint32_t cmd, uint32_t msg_len, uint32_t reply_len,
+			      uint64_t time_ns, int rc, void *private_data);
+
+/*
+ * Called with every request and its raw reply (including the status
+ * trailer), as exchanged with the transport.
+ */
+typedef void (*sbefifo_trace_fn)(const uint8_t *msg, uint32_t msg_len,
+				 const uint8_t *reply, uint32_t reply_len,
+				 uint64_t time_ns, int rc, void *private_data);
+
 int sbefifo_connect(const char *fifo_path, int proc, struct sbefifo_context **out);
 int sbefifo_connect_transport(int proc, sbefifo_transport_fn transport, void *priv, struct sbefifo_context **out);
 void sbefifo_disconnect(struct sbefifo_context *sctx);
 int sbefifo_proc(struct sbefifo_context *sctx);
+void sbefifo_set_op_callback(struct sbefifo_context *sctx, sbefifo_op_fn fn,
+			     const bool *enabled, void *priv);
+void sbefifo_set_trace_callback(struct sbefifo_context *sctx, sbefifo_trace_fn fn, void *priv);
 
 int sbefifo_parse_output(struct sbefifo_context *sctx, uint32_t cmd,
 			 uint8_t *buf, uint32_t buflen,
@@ -120,10 +140,26 @@ int sbefifo_parse_output(struct sbefifo_context *sctx, uint32_t cmd,
 int sbefifo_operation(struct sbefifo_context *sctx,
 		      uint8_t *msg, uint32_t msg_len,
 		      uint8_t **out, uint32_t *out_len);
+int sbefifo_operation_fd(struct sbefifo_context *sctx,
+			 uint8_t *msg, uint32_t msg_len,
+			 int fd, uint32_t *out_len);
 
 uint32_t sbefifo_ffdc_get(struct sbefifo_context *sctx, const uint8_t **ffdc, uint32_t *ffdc_len);
 void sbefifo_ffdc_dump(struct sbefifo_context *sctx);
 
+/*
+ * Copy every FFDC blob into a ring of ring_size bytes, which a background
+ * thread writes out to fd. Each blob is preceded by a header of big endian
+ * u32 magic ("FFDC"), u32 status, u32 length, u32 number of blobs dropped
+ * since the previous one because the ring was full, and u64 CLOCK_REALTIME
+ * timestamp in ns. The fd is closed by sbefifo_ffdc_capture_stop() or
+ * sbefifo_disconnect(), once everything in the ring has been written.
+ * If blobs were dropped after the last one written, a header with
+ * length 0 and the number dropped is written last.
+ */
+int sbefifo_ffdc_capture_start(struct sbefifo_context *sctx, int fd, uint32_t ring_size);
+void sbefifo_ffdc_capture_stop(struct sbefifo_context *sctx);
+
 int sbefifo_istep_execute(struct sbefifo_context *sctx, uint8_t major, uint8_t minor);
 int sbefifo_suspend_io(struct sbefifo_context *sctx);
 
@@ -169,6 +205,23 @@ int sbefifo_sram_put(struct sbefifo_context *sctx, uint16_t chiplet_id, uint64_t
 int sbefifo_register_get(struct sbefifo_context *sctx, uint8_t core_id, uint8_t thread_id, uint8_t reg_type, uint32_t *reg_id, uint8_t reg_count, uint64_t **value);
 int sbefifo_register_put(struct sbefifo_context *sctx, uint8_t core_id, uint8_t thread_id, uint8_t reg_type, uint32_t *reg_id, uint8_t reg_count, uint64_t *value);
 
+/*
+ * Register reads for sbefifo_register_get_list().  The values are written to
+ * the caller provided value array (reg_count entries) and rc holds the result
+ * of each individual chip-op.
+ */
+struct sbefifo_register_request {
+	uint8_t core_id;
+	uint8_t thread_id;
+	uint8_t reg_type;
+	uint8_t reg_count;
+	uint32_t *reg_id;
+	uint64_t *value;
+	int rc;
+};
+
+int sbefifo_register_get_list(struct sbefifo_context *sctx, struct sbefifo_register_request *req, uint32_t count);
+
 int sbefifo_hw_register_get(struct sbefifo_context *sctx, uint8_t target_type, uint8_t instance_id, uint64_t reg_id, uint64_t *value);
 int sbefifo_hw_register_put(struct sbefifo_context *sctx, uint8_t target_type, uint8_t instance_id, uint64_t reg_id, uint64_t value);
 
@@ -202,5 +255,6 @@ int sbefifo_mpipl_get_ti_info(struct sbefifo_context *sctx, uint8_t **data, uint
 #define SBEFIFO_DUMP_CLOCK_OFF           0x02
 
 int sbefifo_get_dump(struct sbefifo_context *sctx, uint8_t type, uint8_t clock, uint8_t fa_collect, uint8_t **data, uint32_t *data_len);
+int sbefifo_get_dump_fd(struct sbefifo_context *sctx, uint8_t type, uint8_t clock, uint8_t fa_collect, int fd, uint32_t *data_len);
 
 #endif /* __LIBSBEFIFO_H__ */
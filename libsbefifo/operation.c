@@ -16,17 +16,25 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
 #include <assert.h>
 #include <endian.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
 
 #include "libsbefifo.h"
 #include "sbefifo_private.h"
 
 static const uint16_t SBEFIFO_MAX_FFDC_SIZE = 0x8000;
 
+/* Chunk size used when copying a reply out to a non-seekable fd */
+#define SBEFIFO_FD_CHUNK_SIZE	(64 * 1024)
+
 static int sbefifo_read(struct sbefifo_context *sctx, void *buf, size_t *buflen)
 {
 	ssize_t n;
@@ -81,9 +89,13 @@ static int sbefifo_transport(struct sbefifo_context *sctx, uint8_t *msg, uint32_
 	return 0;
 }
 
-int sbefifo_parse_output(struct sbefifo_context *sctx, uint32_t cmd,
-			 uint8_t *buf, uint32_t buflen,
-			 uint8_t **out, uint32_t *out_len)
+/*
+ * Parse the status/FFDC trailer of a reply in place. Only the tail of
+ * the buffer is touched, the reply data is left where it is.
+ */
+static int sbefifo_parse_reply(struct sbefifo_context *sctx, uint32_t cmd,
+			       uint8_t *buf, uint32_t buflen,
+			       uint32_t *data_len)
 {
 	uint32_t offset_word, header_word, status_word;
 	uint32_t offset;
@@ -103,9 +115,13 @@ int sbefifo_parse_output(struct sbefifo_context *sctx, uint32_t cmd,
 
 	/* Last word is header offset (in words) */
 	offset_word = be32toh(*(uint32_t *) &buf[buflen-4]);
+	if (offset_word < 3 || offset_word > buflen / 4) {
+		LOG("reply: cmd=%08x, len=%u, offset=%u\n", cmd, buflen, offset_word);
+		return EPROTO;
+	}
 	offset = buflen - (offset_word * 4);
 
-	*out_len = offset;
+	*data_len = offset;
 
 	header_word = be32toh(*(uint32_t *) &buf[offset]);
 	offset += 4;
@@ -125,6 +141,23 @@ int sbefifo_parse_output(struct sbefifo_context *sctx, uint32_t cmd,
 		return ESBEFIFO;
 	}
 
+	//if there is ffdc data for success store it in internal buffer
+	if((buflen - offset-4) > *data_len) {
+		sbefifo_ffdc_set(sctx, status_word, buf + offset, buflen - offset-4);
+	}
+	return 0;
+}
+
+int sbefifo_parse_output(struct sbefifo_context *sctx, uint32_t cmd,
+			 uint8_t *buf, uint32_t buflen,
+			 uint8_t **out, uint32_t *out_len)
+{
+	int rc;
+
+	rc = sbefifo_parse_reply(sctx, cmd, buf, buflen, out_len);
+	if (rc)
+		return rc;
+
 	if (*out_len > 0) {
 		*out = malloc(*out_len);
 		if (! *out)
@@ -135,16 +168,71 @@ int sbefifo_parse_output(struct sbefifo_context *sctx, uint32_t cmd,
 		*out = NULL;
 	}
 
-	//if there is ffdc data for success store it in internal buffer
-	if((buflen - offset-4) > *out_len) {
-		sbefifo_ffdc_set(sctx, status_word, buf + offset, buflen - offset-4);
-	}
 	return 0;
 }
 
-int sbefifo_operation(struct sbefifo_context *sctx,
-		      uint8_t *msg, uint32_t msg_len,
-		      uint8_t **out, uint32_t *out_len)
+static uint64_t sbefifo_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void sbefifo_set_op_callback(struct sbefifo_context *sctx, sbefifo_op_fn fn,
+			     const bool *enabled, void *priv)
+{
+	sctx->op_fn = fn;
+	sctx->op_enabled = enabled;
+	sctx->op_priv = priv;
+}
+
+/* Operations are only timed for a callback that wants them */
+static bool sbefifo_op_timed(struct sbefifo_context *sctx)
+{
+	return sctx->op_fn && (!sctx->op_enabled || *sctx->op_enabled);
+}
+
+static void sbefifo_op_done(struct sbefifo_context *sctx, uint8_t *msg, uint32_t msg_len,
+			    uint32_t reply_len, uint64_t start, int rc)
+{
+	uint32_t cmd = be32toh(*(uint32_t *)(msg + 4));
+
+	sctx->op_fn(cmd, msg_len, rc ? 0 : reply_len,
+		    sbefifo_time_ns() - start, rc, sctx->op_priv);
+}
+
+void sbefifo_set_trace_callback(struct sbefifo_context *sctx, sbefifo_trace_fn fn, void *priv)
+{
+	sctx->trace_fn = fn;
+	sctx->trace_priv = priv;
+}
+
+/* Send a request and receive the raw reply, status trailer included */
+static int sbefifo_exchange(struct sbefifo_context *sctx, uint8_t *msg, uint32_t msg_len,
+			    uint8_t *buf, uint32_t *buflen)
+{
+	uint64_t start = 0;
+	int rc;
+
+	if (sctx->trace_fn)
+		start = sbefifo_time_ns();
+
+	if (sctx->transport)
+		rc = sctx->transport(msg, msg_len, buf, buflen, sctx->priv);
+	else
+		rc = sbefifo_transport(sctx, msg, msg_len, buf, buflen);
+
+	if (sctx->trace_fn)
+		sctx->trace_fn(msg, msg_len, buf, rc ? 0 : *buflen,
+			       sbefifo_time_ns() - start, rc, sctx->trace_priv);
+
+	return rc;
+}
+
+static int __sbefifo_operation(struct sbefifo_context *sctx,
+			       uint8_t *msg, uint32_t msg_len,
+			       uint8_t **out, uint32_t *out_len)
 {
 	uint8_t *buf;
 	uint32_t buflen;
@@ -170,10 +258,7 @@ int sbefifo_operation(struct sbefifo_context *sctx,
 
 	LOG("request: cmd=%08x, len=%u\n", cmd, msg_len);
 
-	if (sctx->transport)
-		rc = sctx->transport(msg, msg_len, buf, &buflen, sctx->priv);
-	else
-		rc = sbefifo_transport(sctx, msg, msg_len, buf, &buflen);
+	rc = sbefifo_exchange(sctx, msg, msg_len, buf, &buflen);
 
 	if (rc) {
 		free(buf);
@@ -192,3 +277,194 @@ int sbefifo_operation(struct sbefifo_context *sctx,
 	free(buf);
 	return rc;
 }
+
+int sbefifo_operation(struct sbefifo_context *sctx,
+		      uint8_t *msg, uint32_t msg_len,
+		      uint8_t **out, uint32_t *out_len)
+{
+	uint64_t start;
+	int rc;
+
+	if (!sbefifo_op_timed(sctx))
+		return __sbefifo_operation(sctx, msg, msg_len, out, out_len);
+
+	start = sbefifo_time_ns();
+	rc = __sbefifo_operation(sctx, msg, msg_len, out, out_len);
+	sbefifo_op_done(sctx, msg, msg_len, *out_len, start, rc);
+	return rc;
+}
+
+static int sbefifo_write_fd(int fd, uint8_t *buf, uint32_t buflen)
+{
+	uint32_t done = 0, released = 0;
+	ssize_t n;
+
+	while (done < buflen) {
+		size_t len = buflen - done;
+
+		if (len > SBEFIFO_FD_CHUNK_SIZE)
+			len = SBEFIFO_FD_CHUNK_SIZE;
+
+		n = write(fd, buf + done, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return errno;
+		}
+
+		done += n;
+
+		/* Hand the chunks written so far back to the kernel */
+		if (done - released >= SBEFIFO_FD_CHUNK_SIZE) {
+			uint32_t end = done & ~(uint32_t)(SBEFIFO_FD_CHUNK_SIZE - 1);
+
+			madvise(buf + released, end - released, MADV_DONTNEED);
+			released = end;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Same as sbefifo_operation(), but the reply data is written to fd
+ * rather than returned in a malloc'd buffer.
+ *
+ * The sbefifo driver returns a reply in a single read(), so it has to
+ * land in one contiguous buffer. When fd is a regular file opened for
+ * reading and writing, without O_APPEND, and ends at the current
+ * offset, that buffer is the file itself, mapped at the current offset,
+ * and the reply is received straight into the page cache. For anything
+ * else (pipes, sockets, write-only or append-only files, or files with
+ * data the status/FFDC trailer would overwrite) the reply is received
+ * into an anonymous mapping which only gets populated as far as the
+ * reply goes and which is released chunk by chunk as it is written out.
+ * The whole reply is still in memory once it has been received, it
+ * can't be streamed as the driver has no way to return it in parts.
+ *
+ * On entry *out_len is the maximum expected reply length, on success
+ * it is set to the number of bytes written to fd.
+ */
+static int __sbefifo_operation_fd(struct sbefifo_context *sctx,
+				  uint8_t *msg, uint32_t msg_len,
+				  int fd, uint32_t *out_len)
+{
+	struct stat sb;
+	uint8_t *map, *buf;
+	size_t map_len, delta = 0;
+	off_t start = 0, map_off;
+	uint32_t buflen, max_len, data_len = 0;
+	uint32_t cmd;
+	bool is_file = false;
+	int flags, rc;
+
+	assert(msg);
+	assert(msg_len > 0);
+
+	if (!sctx->transport && sctx->fd == -1)
+		return ENOTCONN;
+
+	if (fstat(fd, &sb))
+		return errno;
+
+	flags = fcntl(fd, F_GETFL);
+	if (flags < 0)
+		return errno;
+
+	buflen = (*out_len + SBEFIFO_MAX_FFDC_SIZE + 3) & ~(uint32_t)3;
+	max_len = buflen;
+
+	/*
+	 * A shared mapping needs read access, and with O_APPEND the data
+	 * goes to the end of the file rather than the current offset.
+	 */
+	if (S_ISREG(sb.st_mode) && (flags & O_ACCMODE) == O_RDWR &&
+	    !(flags & O_APPEND)) {
+		start = lseek(fd, 0, SEEK_CUR);
+		if (start < 0)
+			return errno;
+
+		/* The trailer must not land on existing data */
+		is_file = sb.st_size <= start;
+	}
+
+	if (is_file) {
+		map_off = start & ~((off_t)sysconf(_SC_PAGESIZE) - 1);
+		delta = start - map_off;
+		map_len = delta + buflen;
+
+		/* Make room for the largest possible reply */
+		if (ftruncate(fd, start + max_len))
+			return errno;
+
+		map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, map_off);
+	} else {
+		map_len = buflen;
+		map = mmap(NULL, map_len, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	}
+
+	if (map == MAP_FAILED) {
+		rc = errno;
+		goto out_truncate;
+	}
+	buf = map + delta;
+
+	cmd = be32toh(*(uint32_t *)(msg + 4));
+
+	LOG("request: cmd=%08x, len=%u, fd=%d\n", cmd, msg_len, fd);
+
+	rc = sbefifo_exchange(sctx, msg, msg_len, buf, &buflen);
+
+	if (rc) {
+		if (rc == ETIMEDOUT) {
+			uint32_t status;
+
+			status = SBEFIFO_PRI_UNKNOWN_ERROR | SBEFIFO_SEC_HW_TIMEOUT;
+			sbefifo_ffdc_set(sctx, status, NULL, 0);
+		}
+		goto out_unmap;
+	}
+
+	rc = sbefifo_parse_reply(sctx, cmd, buf, buflen, &data_len);
+	if (rc) {
+		data_len = 0;
+		goto out_unmap;
+	}
+
+	if (!is_file) {
+		rc = sbefifo_write_fd(fd, buf, data_len);
+		goto out_unmap;
+	}
+
+	if (lseek(fd, start + data_len, SEEK_SET) < 0)
+		rc = errno;
+
+out_unmap:
+	munmap(map, map_len);
+out_truncate:
+	/* Drop the status/FFDC trailer and any unused space again */
+	if (is_file && ftruncate(fd, start + data_len) && !rc)
+		rc = errno;
+
+	if (!rc)
+		*out_len = data_len;
+
+	return rc;
+}
+
+int sbefifo_operation_fd(struct sbefifo_context *sctx,
+			 uint8_t *msg, uint32_t msg_len,
+			 int fd, uint32_t *out_len)
+{
+	uint64_t start;
+	int rc;
+
+	if (!sbefifo_op_timed(sctx))
+		return __sbefifo_operation_fd(sctx, msg, msg_len, fd, out_len);
+
+	start = sbefifo_time_ns();
+	rc = __sbefifo_operation_fd(sctx, msg, msg_len, fd, out_len);
+	sbefifo_op_done(sctx, msg, msg_len, *out_len, start, rc);
+	return rc;
+}
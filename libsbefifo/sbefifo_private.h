@@ -83,9 +83,19 @@ struct sbefifo_context {
 	sbefifo_transport_fn transport;
 	void *priv;
 
+	sbefifo_op_fn op_fn;
+	const bool *op_enabled;
+	void *op_priv;
+
+	sbefifo_trace_fn trace_fn;
+	void *trace_priv;
+
 	uint32_t status;
 	uint8_t *ffdc;
 	uint32_t ffdc_len;
+	uint32_t ffdc_size;
+
+	struct sbefifo_ffdc_ring *ffdc_ring;
 };
 
 int sbefifo_set_long_timeout(struct sbefifo_context *sctx);
@@ -373,21 +373,21 @@ dnl
 define(`CHIP',
 `
 	mem$1 {
-		index = < 0x$1 >;
+		index = < $1 >;
 	};
 
 	proc$1 {
 		compatible = "ibm,power-proc", "ibm,power10-proc";
-		index = < 0x$1 >;
+		index = < $1 >;
 
 		fsi {
-			index = < 0x$1 >;
+			index = < $1 >;
 		};
 
 		pib {
 			#address-cells = < 0x02 >;
 			#size-cells = < 0x01 >;
-			index = < 0x$1 >;
+			index = < $1 >;
 
 			adu@3001C00 {
 				compatible = "ibm,power10-adu";
@@ -398,13 +398,13 @@ define(`CHIP',
 			htm@3011C80 {
 				compatible = "ibm,power10-nhtm";
 				reg = < 0x00 0x3011C80 0x40 >;
-				index = < 0x$1 >;
+				index = < $1 >;
 			};
 
 			htm@30120C0 {
 				compatible = "ibm,power10-nhtm";
 				reg = < 0x00 0x30120C0 0x40 >;
-				index = < 0x$1 >;
+				index = < $1 >;
 			};
 
 			NX(0)
@@ -795,6 +795,12 @@ define(`CHIP',
 	};
 ')dnl
 
+dnl
+dnl CHIPS([count]) - CHIP(0) to CHIP(count - 1)
+dnl
+define(`CHIPS',
+`ifelse(eval(`$1 > 0'), 1, `CHIPS(decr($1))CHIP(decr($1))')')dnl
+
 dnl
 dnl I2CBUS([index])
 dnl
@@ -834,14 +840,7 @@ define(`TPM',
 		I2CBUS(15);
 	};
 
-	CHIP(0)
-	CHIP(1)
-	CHIP(2)
-	CHIP(3)
-	CHIP(4)
-	CHIP(5)
-	CHIP(6)
-	CHIP(7)
+	CHIPS(ifdef(`NR_CHIPS', `NR_CHIPS', 8))
 
 	TPM(0)
 };
@@ -21,8 +21,23 @@
 
 #include "main.h"
 #include "optcmd.h"
+#include "output.h"
 #include "path.h"
 
+static void output_cfam(struct pdbg_target *target, uint32_t addr, uint32_t value, bool failed)
+{
+	struct output_record rec = {
+		.type = OUTPUT_CFAM,
+		.target = target,
+		.failed = failed,
+		.index = pdbg_target_index(target),
+		.addr = addr,
+		.value = value,
+	};
+
+	output_record(&rec);
+}
+
 static int getcfam(uint32_t addr)
 {
 	struct pdbg_target *target;
@@ -34,12 +49,18 @@ static int getcfam(uint32_t addr)
 			continue;
 
 		if (fsi_read(target, addr, &value)) {
-			printf("p%d: failed\n", pdbg_target_index(target));
+			if (output_structured())
+				output_cfam(target, addr, 0, true);
+			else
+				printf("p%d: failed\n", pdbg_target_index(target));
 			continue;
 
 		}
 
-		printf("p%d: 0x%x = 0x%08x\n", pdbg_target_index(target), addr, value);
+		if (output_structured())
+			output_cfam(target, addr, value, false);
+		else
+			printf("p%d: 0x%x = 0x%08x\n", pdbg_target_index(target), addr, value);
 		count++;
 	}
 
@@ -64,7 +85,10 @@ static int putcfam(uint32_t addr, uint32_t data, uint32_t mask)
 			rc = fsi_write_mask(target, addr, data, mask);
 
 		if (rc) {
-			printf("p%d: failed\n", pdbg_target_index(target));
+			if (output_structured())
+				output_cfam(target, addr, 0, true);
+			else
+				printf("p%d: failed\n", pdbg_target_index(target));
 			continue;
 		}
 
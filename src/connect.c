@@ -0,0 +1,250 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include <libpdbg.h>
+#include <libpdbgclient.h>
+
+#include "connect.h"
+#include "script.h"
+
+#define PR_ERROR(x, args...) \
+	pdbg_log(PDBG_ERROR, x, ##args)
+
+#define CONNECT_LINE_MAX	256
+#define CONNECT_BUF_SIZE	4096
+
+static uint8_t *connect_read_stdin(uint64_t *size)
+{
+	uint8_t *buf = NULL;
+	size_t allocated = 0, len = 0;
+	ssize_t n;
+
+	while (1) {
+		if (allocated == len) {
+			allocated += CONNECT_BUF_SIZE;
+			buf = realloc(buf, allocated);
+			assert(buf);
+		}
+
+		n = read(STDIN_FILENO, buf + len, allocated - len);
+		if (n <= 0)
+			break;
+
+		len += n;
+	}
+
+	*size = len;
+	return buf;
+}
+
+/* Commands are parsed as a line of a script, except for putmem which
+ * takes its data from stdin */
+static int connect_parse(int argc, char *argv[], struct script_op *op)
+{
+	char line[CONNECT_LINE_MAX];
+	size_t len = 0;
+	int i;
+
+	if (!strcmp(argv[0], "putmem")) {
+		char *endptr;
+
+		if (argc != 2)
+			return -1;
+
+		memset(op, 0, sizeof(*op));
+		op->kind = SCRIPT_MEM;
+		op->write = true;
+
+		errno = 0;
+		op->addr = strtoull(argv[1], &endptr, 0);
+		if (errno || *endptr != '\0')
+			return -1;
+
+		op->data = connect_read_stdin(&op->size);
+		return op->size ? 0 : -1;
+	}
+
+	for (i = 0; i < argc; i++) {
+		int n;
+
+		n = snprintf(line + len, sizeof(line) - len, "%s ", argv[i]);
+		if (n < 0 || n >= sizeof(line) - len)
+			return -1;
+		len += n;
+	}
+
+	if (script_parse_line(line, op) != 1 || (op->kind == SCRIPT_MEM && op->write))
+		return -1;
+
+	return 0;
+}
+
+static void connect_result(const struct pdbg_client_result *r, struct script_result *res)
+{
+	*res = (struct script_result) {
+		.rc = r->rc,
+		.index = r->index,
+		.path = r->path,
+		.addr = r->addr,
+		.value = r->value,
+		.data = r->data,
+		.size = r->size,
+	};
+}
+
+static int connect_call(int fd, const struct script_op *op, const char **sel, int nr_sel,
+			struct pdbg_client_reply *reply)
+{
+	struct pdbg_client_op cop = {
+		.kind = (enum pdbg_client_kind)op->kind,
+		.write = op->write,
+		.addr = op->addr,
+		.value = op->value,
+		.mask = op->mask,
+		.size = op->size,
+		.data = op->data,
+	};
+
+	if (pdbg_client_call(fd, &cop, sel, nr_sel, reply)) {
+		PR_ERROR("Request failed: %s\n", strerror(errno));
+		return -1;
+	}
+
+	if (reply->status) {
+		printf("No valid targets found or specified. Try adding -p/-c/-t options to specify a target.\n");
+		pdbg_client_reply_free(reply);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Memory accesses larger than the daemon takes are split up, and the
+ * data read is put back together so it is printed as a whole */
+static int connect_mem(int fd, const struct script_op *op, const char **sel, int nr_sel)
+{
+	struct script_result res = { .addr = op->addr, .size = op->size };
+	struct pdbg_client_reply reply;
+	uint8_t *data = NULL;
+	char *path = NULL;
+	uint64_t offset;
+
+	if (!op->write) {
+		data = malloc(op->size);
+		assert(data);
+		res.data = data;
+	}
+
+	for (offset = 0; offset < op->size && !res.rc; offset += PDBG_CLIENT_MAX_DATA) {
+		struct script_op chunk = *op;
+		struct pdbg_client_result *r;
+
+		chunk.addr = op->addr + offset;
+		chunk.size = op->size - offset;
+		if (chunk.size > PDBG_CLIENT_MAX_DATA)
+			chunk.size = PDBG_CLIENT_MAX_DATA;
+		if (op->write)
+			chunk.data = op->data + offset;
+
+		if (connect_call(fd, &chunk, sel, nr_sel, &reply))
+			goto fail;
+
+		if (reply.nr_results != 1) {
+			pdbg_client_reply_free(&reply);
+			goto fail;
+		}
+
+		r = &reply.results[0];
+		if (!path) {
+			path = strdup(r->path);
+			assert(path);
+			res.path = path;
+			res.index = r->index;
+		}
+
+		res.rc = r->rc;
+		if (!r->rc && !op->write) {
+			if (r->size != chunk.size)
+				res.rc = -1;
+			else
+				memcpy(data + offset, r->data, r->size);
+		}
+
+		pdbg_client_reply_free(&reply);
+	}
+
+	script_print(op, &res);
+
+	free(data);
+	free(path);
+	return res.rc ? 0 : 1;
+
+fail:
+	free(data);
+	free(path);
+	return 0;
+}
+
+int connect_run(const char *path, const char **sel, int nr_sel, int argc, char *argv[])
+{
+	struct script_op op;
+	struct pdbg_client_reply reply;
+	int fd, i, count = 0;
+
+	if (connect_parse(argc, argv, &op)) {
+		PR_ERROR("Unsupported command with --connect: %s\n", argv[0]);
+		return -1;
+	}
+
+	fd = pdbg_client_connect(path);
+	if (fd < 0) {
+		PR_ERROR("Unable to connect to %s: %s\n", path, strerror(errno));
+		goto out;
+	}
+
+	if (op.kind == SCRIPT_MEM) {
+		count = connect_mem(fd, &op, sel, nr_sel);
+		close(fd);
+		goto out;
+	}
+
+	if (connect_call(fd, &op, sel, nr_sel, &reply)) {
+		close(fd);
+		goto out;
+	}
+	close(fd);
+
+	for (i = 0; i < reply.nr_results; i++) {
+		struct script_result res;
+
+		connect_result(&reply.results[i], &res);
+		script_print(&op, &res);
+		if (res.rc == 0)
+			count++;
+	}
+
+	pdbg_client_reply_free(&reply);
+
+out:
+	free(op.data);
+	return count;
+}
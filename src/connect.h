@@ -0,0 +1,35 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __CONNECT_H
+#define __CONNECT_H
+
+/**
+ * @brief Run a command on a pdbg daemon instead of locally
+ *
+ * Supports getscom, putscom, getcfam, putcfam, getmem and putmem with
+ * the same arguments and output as the local commands.
+ *
+ * @param[in] path Path of the daemon socket
+ * @param[in] sel Target selectors, as built from -p/-c/-t/-P
+ * @param[in] nr_sel Number of target selectors
+ * @param[in] argc Number of command arguments, including the command
+ * @param[in] argv Command and its arguments
+ * @return number of successful accesses, -1 if the command is not
+ * supported
+ */
+int connect_run(const char *path, const char **sel, int nr_sel, int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,427 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <sys/poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <libpdbg.h>
+
+#include "optcmd.h"
+#include "parsers.h"
+#include "path.h"
+#include "rpc.h"
+#include "script.h"
+
+#define PR_ERROR(x, args...) \
+	pdbg_log(PDBG_ERROR, x, ##args)
+#define PR_INFO(x, args...) \
+	pdbg_log(PDBG_INFO, x, ##args)
+
+/*
+ * Serve scom, cfam and memory accesses to other processes over a Unix
+ * socket (see libpdbgclient.h), so they don't have to pay for starting
+ * pdbg, probing the targets and opening the backend for every access.
+ * Register and thread commands aren't served yet, as they depend on
+ * the threads being stopped and started around them.
+ *
+ * The socket is only accessible to the user the daemon runs as, and
+ * clients running as any other user than that or root are rejected.
+ *
+ * Clients are served from a single thread without ever blocking on one
+ * of them: requests and replies are buffered per client and only sent
+ * or received as far as the socket allows. Nothing more is read from a
+ * client until its reply has been sent, and memory accesses are limited
+ * to PDBG_CLIENT_MAX_DATA, so each client has at most about twice that
+ * buffered.
+ *
+ * All requests which have arrived by the time the socket is polled are
+ * run together as one script. Writes in it are done in order, one
+ * client's after another, so only the reads between writes are batched
+ * per chip and repeated reads are only done once.
+ */
+
+#define DAEMON_MAX_CLIENTS	64
+#define DAEMON_RECV_SIZE	65536
+
+struct daemon_client {
+	int fd;
+	bool closed;
+
+	uint8_t *in;
+	size_t in_len, in_size;
+
+	uint8_t *out;
+	size_t out_len, out_done;
+};
+
+struct daemon_request {
+	struct daemon_client *client;
+	struct script_op op;
+	const char *sel[PDBG_CLIENT_MAX_SELECTORS];
+	int nr_sel;
+	char *buf;
+	int status;
+	int first, count;
+};
+
+static int daemon_listen(const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	mode_t mask;
+	int fd, rc;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		PR_ERROR("Socket path %s too long\n", path);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		PR_ERROR("Unable to create socket: %s\n", strerror(errno));
+		return -1;
+	}
+
+	/* Only the owner may connect */
+	unlink(path);
+	mask = umask(0177);
+	rc = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+	umask(mask);
+
+	if (rc || listen(fd, SOMAXCONN)) {
+		PR_ERROR("Unable to listen on %s: %s\n", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void daemon_accept(int listen_fd, struct pollfd *fds,
+			  struct daemon_client *clients, int *nr_fds)
+{
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+	int fd;
+
+	fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+	if (fd < 0)
+		return;
+
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) ||
+	    (cred.uid != geteuid() && cred.uid != 0)) {
+		PR_ERROR("Rejecting client of another user\n");
+		close(fd);
+		return;
+	}
+
+	if (*nr_fds == DAEMON_MAX_CLIENTS + 1) {
+		PR_ERROR("Too many clients\n");
+		close(fd);
+		return;
+	}
+
+	memset(&clients[*nr_fds], 0, sizeof(clients[*nr_fds]));
+	clients[*nr_fds].fd = fd;
+	fds[*nr_fds].fd = fd;
+	(*nr_fds)++;
+}
+
+static void daemon_close(struct pollfd *fds, struct daemon_client *clients, int *nr_fds, int i)
+{
+	close(clients[i].fd);
+	free(clients[i].in);
+	free(clients[i].out);
+
+	(*nr_fds)--;
+	fds[i] = fds[*nr_fds];
+	clients[i] = clients[*nr_fds];
+}
+
+/* Receive whatever the client has sent, returns -1 once it is gone */
+static int daemon_recv(struct daemon_client *c)
+{
+	ssize_t n;
+
+	if (c->in_size - c->in_len < DAEMON_RECV_SIZE) {
+		uint8_t *in;
+
+		in = realloc(c->in, c->in_len + DAEMON_RECV_SIZE);
+		if (!in)
+			return -1;
+
+		c->in = in;
+		c->in_size = c->in_len + DAEMON_RECV_SIZE;
+	}
+
+	n = recv(c->fd, c->in + c->in_len, c->in_size - c->in_len, 0);
+	if (n == 0)
+		return -1;
+
+	if (n < 0)
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+
+	c->in_len += n;
+	return 0;
+}
+
+/* Send as much of the pending reply as the socket takes */
+static int daemon_send(struct daemon_client *c)
+{
+	ssize_t n;
+
+	while (c->out_done < c->out_len) {
+		n = send(c->fd, c->out + c->out_done, c->out_len - c->out_done, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			return -1;
+		}
+
+		c->out_done += n;
+	}
+
+	free(c->out);
+	c->out = NULL;
+	c->out_len = 0;
+	c->out_done = 0;
+
+	return 0;
+}
+
+/* Take the next request off the client's buffer, if all of it has
+ * arrived. Returns 1 if there is one, 0 if not and -1 if it is invalid. */
+static int daemon_parse(struct daemon_client *c, struct daemon_request *req)
+{
+	struct pdbg_client_op op;
+	int len;
+
+	len = rpc_parse_request(c->in, c->in_len, &op, req->sel, &req->nr_sel, &req->buf);
+	if (len <= 0) {
+		if (len < 0)
+			PR_ERROR("Invalid request\n");
+		free(req->buf);
+		free(op.data);
+		return len;
+	}
+
+	memmove(c->in, c->in + len, c->in_len - len);
+	c->in_len -= len;
+	req->client = c;
+
+	req->op = (struct script_op) {
+		.kind = (enum script_kind)op.kind,
+		.write = op.write,
+		.addr = op.addr,
+		.value = op.value,
+		.mask = op.mask,
+		.size = op.size,
+		.data = op.data,
+	};
+
+	return 1;
+}
+
+/* Add the accesses of a request on the targets it selects */
+static void daemon_expand(struct script *script, struct daemon_request *req)
+{
+	struct pdbg_target *target;
+
+	req->first = script->nr_access;
+	req->count = 0;
+
+	path_target_clear();
+	if (!path_target_parse(req->sel, req->nr_sel) || !path_target_present()) {
+		req->status = -1;
+		return;
+	}
+
+	for_each_path_target(target)
+		pdbg_target_probe(target);
+
+	script_expand(script, &req->op);
+	req->count = script->nr_access - req->first;
+	req->status = 0;
+}
+
+static void daemon_reply(struct script *script, struct daemon_request *req)
+{
+	struct daemon_client *c = req->client;
+	struct pdbg_client_result *res;
+	int i;
+
+	res = calloc(req->count + 1, sizeof(*res));
+	assert(res);
+
+	for (i = 0; i < req->count; i++) {
+		struct script_result r;
+
+		script_result(&script->access[req->first + i], &r);
+		res[i] = (struct pdbg_client_result) {
+			.rc = r.rc,
+			.index = r.index,
+			.path = r.path,
+			.addr = r.addr,
+			.value = r.value,
+			.data = r.data,
+			.size = r.size,
+		};
+	}
+
+	if (rpc_encode_reply(req->status, res, req->count, &c->out, &c->out_len) ||
+	    daemon_send(c))
+		c->closed = true;
+
+	free(res);
+}
+
+/* Serve one request of every client which has all of one buffered and
+ * no reply still to send, returns the number of requests served */
+static int daemon_serve(struct daemon_client *clients, int nr_fds,
+			struct daemon_request *reqs, struct script *script)
+{
+	int i, nr_reqs = 0;
+
+	for (i = 1; i < nr_fds; i++) {
+		struct daemon_client *c = &clients[i];
+		int rc;
+
+		if (c->closed || c->out_len)
+			continue;
+
+		rc = daemon_parse(c, &reqs[nr_reqs]);
+		if (rc < 0)
+			c->closed = true;
+		else if (rc > 0)
+			nr_reqs++;
+	}
+
+	if (!nr_reqs)
+		return 0;
+
+	for (i = 0; i < nr_reqs; i++)
+		daemon_expand(script, &reqs[i]);
+
+	script_run(script);
+
+	for (i = 0; i < nr_reqs; i++) {
+		daemon_reply(script, &reqs[i]);
+		free(reqs[i].buf);
+		free(reqs[i].op.data);
+	}
+
+	script_reset(script);
+
+	return nr_reqs;
+}
+
+static int run_daemon(char *path)
+{
+	struct pollfd fds[DAEMON_MAX_CLIENTS + 1];
+	struct daemon_client *clients;
+	struct daemon_request *reqs;
+	struct script script = {};
+	int listen_fd, nr_fds, i, served = 0;
+
+	listen_fd = daemon_listen(path);
+	if (listen_fd < 0)
+		return 0;
+
+	clients = calloc(DAEMON_MAX_CLIENTS + 1, sizeof(*clients));
+	reqs = calloc(DAEMON_MAX_CLIENTS, sizeof(*reqs));
+	assert(clients && reqs);
+
+	fds[0].fd = listen_fd;
+	fds[0].events = POLLIN;
+	nr_fds = 1;
+
+	PR_INFO("Listening on %s\n", path);
+
+	while (!pdbg_cancelled()) {
+		int rc;
+
+		rc = daemon_serve(clients, nr_fds, reqs, &script);
+		served += rc;
+
+		for (i = 1; i < nr_fds; i++) {
+			if (clients[i].closed)
+				daemon_close(fds, clients, &nr_fds, i--);
+		}
+
+		/* More requests may already be buffered */
+		if (rc)
+			continue;
+
+		/* A client gets its reply before anything more is read from
+		 * it, which bounds what is buffered for it */
+		for (i = 1; i < nr_fds; i++) {
+			fds[i].events = clients[i].out_len ? POLLOUT : POLLIN;
+			fds[i].revents = 0;
+		}
+
+		if (poll(fds, nr_fds, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+
+			PR_ERROR("poll() failed: %s\n", strerror(errno));
+			break;
+		}
+
+		for (i = 1; i < nr_fds; i++) {
+			struct daemon_client *c = &clients[i];
+
+			if (!fds[i].revents)
+				continue;
+
+			if (c->out_len)
+				rc = daemon_send(c);
+			else
+				rc = daemon_recv(c);
+
+			if (rc || (fds[i].revents & (POLLERR | POLLNVAL)))
+				daemon_close(fds, clients, &nr_fds, i--);
+		}
+
+		if (fds[0].revents & POLLIN)
+			daemon_accept(listen_fd, fds, clients, &nr_fds);
+	}
+
+	while (nr_fds > 1)
+		daemon_close(fds, clients, &nr_fds, 1);
+
+	close(listen_fd);
+	unlink(path);
+
+	free(clients);
+	free(reqs);
+	free(script.access);
+	free(script.chans);
+
+	PR_INFO("Served %d requests\n", served);
+
+	return 1;
+}
+OPTCMD_DEFINE_CMD_WITH_ARGS(daemon, run_daemon, (STRING));
@@ -14,11 +14,24 @@
  * limitations under the License.
  */
 #include <stdint.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <time.h>
 
+#include <libpdbg.h>
 #include <libpdbg_sbe.h>
 
 #include "optcmd.h"
+#include "parsers.h"
 #include "path.h"
+#include "util.h"
+
+struct istep_flags {
+	bool parallel;
+};
+
+#define ISTEP_PARALLEL_FLAG ("--parallel", parallel, parse_flag_noarg, false)
 
 struct istep_data {
 	int major;
@@ -32,7 +45,163 @@ struct istep_data {
 	{ 0, 0, 0  },
 };
 
-static int istep(uint32_t major, uint32_t minor)
+/* One processor running a minor istep in parallel with the others */
+struct istep_chip {
+	struct pdbg_target *target;
+	struct pdbg_target *chipop;
+	struct pdbg_cancel *cancel;
+	uint32_t major, minor;
+	int rc;
+	uint64_t time_us;
+	uint32_t status;
+	uint8_t *ffdc;
+	uint32_t ffdc_len;
+};
+
+static uint64_t istep_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void *istep_chip_run(void *arg)
+{
+	struct istep_chip *chip = arg;
+	uint64_t start = istep_now_us();
+
+	pdbg_set_cancel(chip->cancel);
+
+	chip->status = 0;
+	chip->ffdc = NULL;
+	chip->ffdc_len = 0;
+
+	/* Only the chip-op runs here, the targets are looked up and probed
+	 * by the main thread, as the tree may not be changed concurrently */
+	if (!chip->chipop) {
+		chip->rc = -1;
+		chip->time_us = 0;
+		return NULL;
+	}
+
+	chip->rc = sbe_istep(chip->chipop, chip->major, chip->minor);
+	chip->time_us = istep_now_us() - start;
+
+	/* Collect the FFDC while the other processors are still busy */
+	if (chip->rc &&
+	    sbe_ffdc_get(chip->chipop, &chip->status, &chip->ffdc, &chip->ffdc_len)) {
+		chip->status = 0;
+		chip->ffdc = NULL;
+		chip->ffdc_len = 0;
+	}
+
+	return NULL;
+}
+
+static void istep_chip_report(struct istep_chip *chip)
+{
+	int index = pdbg_target_index(chip->target);
+
+	if (!chip->rc) {
+		printf("p%d: istep %d.%d done in %" PRIu64 ".%03" PRIu64 " ms\n",
+		       index, chip->major, chip->minor,
+		       chip->time_us / 1000, chip->time_us % 1000);
+		return;
+	}
+
+	fprintf(stderr, "p%d: istep %d.%d failed after %" PRIu64 ".%03" PRIu64 " ms, status 0x%08x\n",
+		index, chip->major, chip->minor,
+		chip->time_us / 1000, chip->time_us % 1000, chip->status);
+
+	if (chip->ffdc) {
+		fprintf(stderr, "p%d: FFDC %u bytes\n", index, chip->ffdc_len);
+		hexdump(0, chip->ffdc, chip->ffdc_len, 4);
+		free(chip->ffdc);
+		chip->ffdc = NULL;
+	}
+}
+
+/*
+ * The processors don't depend on each other within a minor istep, so
+ * each minor istep is issued to all of them at once and they are all
+ * waited for before moving on to the next one.
+ */
+static int istep_parallel(uint32_t major, int first, int last)
+{
+	struct pdbg_target *target;
+	struct istep_chip *chip;
+	pthread_t *thread;
+	bool *started;
+	int nr_chips = 0, failed = 0, i, j;
+
+	for_each_path_target_class("pib", target) {
+		if (pdbg_target_status(target) == PDBG_TARGET_ENABLED)
+			nr_chips++;
+	}
+
+	if (!nr_chips)
+		return 0;
+
+	chip = calloc(nr_chips, sizeof(*chip));
+	thread = calloc(nr_chips, sizeof(*thread));
+	started = calloc(nr_chips, sizeof(*started));
+	if (!chip || !thread || !started) {
+		fprintf(stderr, "Failed to allocate memory\n");
+		failed = 1;
+		goto out;
+	}
+
+	j = 0;
+	for_each_path_target_class("pib", target) {
+		if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
+			continue;
+
+		chip[j].target = target;
+		chip[j].chipop = sbe_chipop_target(target);
+		chip[j].cancel = pdbg_get_cancel();
+		chip[j].major = major;
+		j++;
+	}
+
+	for (i = first; i <= last && !failed; i++) {
+		uint64_t start = istep_now_us(), time_us;
+
+		printf("Running istep %d.%d on %d processors\n", major, i, nr_chips);
+
+		for (j = 0; j < nr_chips; j++) {
+			chip[j].minor = i;
+			started[j] = !pthread_create(&thread[j], NULL, istep_chip_run, &chip[j]);
+			if (!started[j])
+				istep_chip_run(&chip[j]);
+		}
+
+		for (j = 0; j < nr_chips; j++) {
+			if (started[j])
+				pthread_join(thread[j], NULL);
+
+			istep_chip_report(&chip[j]);
+			if (chip[j].rc)
+				failed++;
+		}
+
+		time_us = istep_now_us() - start;
+		printf("istep %d.%d took %" PRIu64 ".%03" PRIu64 " ms\n",
+		       major, i, time_us / 1000, time_us % 1000);
+
+		if (failed && pdbg_cancelled())
+			fprintf(stderr, "Istep %d.%d cancelled\n", major, i);
+	}
+
+out:
+	free(chip);
+	free(thread);
+	free(started);
+
+	return failed ? 0 : nr_chips;
+}
+
+static int istep(uint32_t major, uint32_t minor, struct istep_flags flags)
 {
 	struct pdbg_target *target;
 	int count = 0, i;
@@ -63,6 +232,10 @@ static int istep(uint32_t major, uint32_t minor)
 		}
 	}
 
+	/* A trace has to be replayed in the order it was recorded */
+	if (flags.parallel && !pdbg_trace_active())
+		return istep_parallel(major, first, last);
+
 	for_each_path_target_class("pib", target) {
 		int rc;
 
@@ -72,8 +245,11 @@ static int istep(uint32_t major, uint32_t minor)
 		for (i = first; i <= last ; i++) {
 			printf("Running istep %d.%d\n", major, i);
 			rc = sbe_istep(target, major, i);
-			if (rc)
+			if (rc) {
+				if (pdbg_cancelled())
+					fprintf(stderr, "Istep %d.%d cancelled\n", major, i);
 				goto fail;
+			}
 		}
 
 		count++;
@@ -82,4 +258,5 @@ static int istep(uint32_t major, uint32_t minor)
 fail:
 	return count;
 }
-OPTCMD_DEFINE_CMD_WITH_ARGS(istep, istep, (DATA32, DATA32));
+OPTCMD_DEFINE_CMD_WITH_FLAGS(istep, istep, (DATA32, DATA32),
+			     istep_flags, (ISTEP_PARALLEL_FLAG));
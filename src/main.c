@@ -25,6 +25,7 @@
 #include <assert.h>
 #include <limits.h>
 #include <inttypes.h>
+#include <signal.h>
 
 #include <ccan/array_size/array_size.h>
 
@@ -32,8 +33,10 @@
 
 #include <libpdbg.h>
 
+#include "connect.h"
 #include "htm.h"
 #include "optcmd.h"
+#include "output.h"
 #include "progress.h"
 #include "pdbgproxy.h"
 #include "util.h"
@@ -61,6 +64,18 @@ static const char *pathsel[MAX_PATH_ARGS];
 static int pathsel_count;
 static int l_list[MAX_LINUX_CPUS];
 static int l_count;
+static bool show_stats;
+static bool lazy_init;
+static const char *connect_path;
+static struct pdbg_cancel cancel;
+
+/* Long options without a short equivalent */
+#define OPT_STATS	0x100
+#define OPT_RECORD	0x101
+#define OPT_TIMEOUT	0x102
+#define OPT_FORMAT	0x103
+#define OPT_CONNECT	0x104
+#define OPT_LAZY	0x105
 
 static int probe(void);
 
@@ -74,7 +89,8 @@ extern struct optcmd_cmd
 	optcmd_threadstatus, optcmd_sreset, optcmd_regs, optcmd_probe,
 	optcmd_getmem, optcmd_putmem, optcmd_getmemio, optcmd_putmemio,
 	optcmd_getmempba, optcmd_putmempba,
-	optcmd_gdbserver, optcmd_istep, optcmd_geti2c, optcmd_puti2c;
+	optcmd_gdbserver, optcmd_istep, optcmd_geti2c, optcmd_puti2c,
+	optcmd_script, optcmd_daemon;
 
 static struct optcmd_cmd *cmds[] = {
 	&optcmd_getscom, &optcmd_putscom, &optcmd_getcfam, &optcmd_putcfam,
@@ -84,8 +100,30 @@ static struct optcmd_cmd *cmds[] = {
 	&optcmd_getmem, &optcmd_putmem, &optcmd_getmemio, &optcmd_putmemio,
 	&optcmd_getmempba, &optcmd_putmempba,
 	&optcmd_gdbserver, &optcmd_istep, &optcmd_geti2c, &optcmd_puti2c,
+	&optcmd_script, &optcmd_daemon,
 };
 
+/* Commands which report their results through the output layer, see
+ * output.h. Everything else only prints text. */
+static const char *structured_cmds[] = {
+	"getscom", "putscom", "getcfam", "putcfam",
+	"getgpr", "putgpr", "getspr", "putspr",
+	"threadstatus", "regs", "getmem", "getmemio", "getmempba",
+	"script",
+};
+
+static bool cmd_structured(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(structured_cmds); i++) {
+		if (!strcmp(name, structured_cmds[i]))
+			return true;
+	}
+
+	return false;
+}
+
 /* Purely for printing usage text. We could integrate printing argument and flag
  * help into optcmd if desired. */
 struct action {
@@ -119,9 +157,11 @@ static struct action actions[] = {
 	{ "sreset",  "", "Reset" },
 	{ "regs",  "[--backtrace]", "State (optionally display backtrace)" },
 	{ "gdbserver <port>", "", "Start a gdb server listening on <port>" },
-	{ "istep", "<major> <minor>|0", "Execute istep on SBE" },
+	{ "istep", "<major> <minor>|0 [--parallel]", "Execute istep on SBE" },
 	{ "geti2c", "<device> <reg> <n>", "Read n bytes from i2c device" },
 	{ "puti2c", "<device> <reg> <value>", "Write a value to i2c device" },
+	{ "script", "[<file>]", "Run scom, cfam and memory accesses from a file or stdin" },
+	{ "daemon", "<socket>", "Serve scom, cfam and memory accesses on <socket>" },
 };
 
 static void print_usage(void)
@@ -148,10 +188,12 @@ static void print_usage(void)
 	printf("\t\ti2c:\tThe P8 only backend which goes via I2C.\n");
 	printf("\t\thost:\tUse the debugfs xscom nodes.\n");
 	printf("\t\tkernel:\tThe default backend which goes the kernel FSI driver.\n");
+	printf("\t\treplay:\tReplay a trace recorded with --record.\n");
 	printf("\t-d, --device=<backend device>\n");
 	printf("\t\tFor I2C the device node used by the backend to access the bus.\n");
 	printf("\t\tFor FSI the system board type, one of p8 or p9w\n");
 	printf("\t\tDefaults to /dev/i2c4 for I2C\n");
+	printf("\t\tFor replay the trace file\n");
 	printf("\t-s, --slave-address=<backend device address>\n");
 	printf("\t\tDevice slave address to use for the backend. Not used by FSI\n");
 	printf("\t\tand defaults to 0x50 for I2C\n");
@@ -159,6 +201,18 @@ static void print_usage(void)
 	printf("\t\t0:error (default) 1:warning 2:notice 3:info 4:debug\n");
 	printf("\t-S, --shutup\n");
 	printf("\t\tShut up those annoying progress bars\n");
+	printf("\t--stats\n");
+	printf("\t\tPrint hardware access statistics on exit\n");
+	printf("\t--lazy\n");
+	printf("\t\tOnly create the targets that are used\n");
+	printf("\t--record=<file>\n");
+	printf("\t\tRecord all hardware accesses to a trace file\n");
+	printf("\t--timeout=<seconds>\n");
+	printf("\t\tCancel long running operations after the given time\n");
+	printf("\t--format=<text|json|binary>\n");
+	printf("\t\tOutput format of command results (default: text)\n");
+	printf("\t--connect=<socket>\n");
+	printf("\t\tRun the command on a pdbg daemon listening on <socket>\n");
 	printf("\t-V, --version\n");
 	printf("\t-h, --help\n");
 	printf("\n");
@@ -309,6 +363,7 @@ static bool parse_options(int argc, char *argv[])
 	int t_list[MAX_THREADS];
 	int p_count = 0, c_count = 0, t_count = 0;
 	int i;
+	unsigned long timeout;
 	struct option long_opts[] = {
 		{"all",			no_argument,		NULL,	'a'},
 		{"backend",		required_argument,	NULL,	'b'},
@@ -324,6 +379,12 @@ static bool parse_options(int argc, char *argv[])
 		{"debug",		required_argument,	NULL,	'D'},
 		{"path",		required_argument,	NULL,	'P'},
 		{"shutup",		no_argument,		NULL,	'S'},
+		{"stats",		no_argument,		NULL,	OPT_STATS},
+		{"lazy",		no_argument,		NULL,	OPT_LAZY},
+		{"record",		required_argument,	NULL,	OPT_RECORD},
+		{"timeout",		required_argument,	NULL,	OPT_TIMEOUT},
+		{"format",		required_argument,	NULL,	OPT_FORMAT},
+		{"connect",		required_argument,	NULL,	OPT_CONNECT},
 		{"version",		no_argument,		NULL,	'V'},
 		{NULL,			0,			NULL,     0}
 	};
@@ -407,6 +468,8 @@ static bool parse_options(int argc, char *argv[])
 				backend = PDBG_BACKEND_CRONUS;
 			} else if (strcmp(optarg, "sbefifo") == 0) {
 				backend = PDBG_BACKEND_SBEFIFO;
+			} else if (strcmp(optarg, "replay") == 0) {
+				backend = PDBG_BACKEND_REPLAY;
 			} else {
 				fprintf(stderr, "Invalid backend '%s'\n", optarg);
 				opt_error = true;
@@ -438,6 +501,41 @@ static bool parse_options(int argc, char *argv[])
 			pdbg_set_loglevel(atoi(optarg));
 			break;
 
+		case OPT_STATS:
+			show_stats = true;
+			break;
+
+		case OPT_LAZY:
+			lazy_init = true;
+			break;
+
+		case OPT_RECORD:
+			if (!pdbg_record_start(optarg))
+				opt_error = true;
+			break;
+
+		case OPT_TIMEOUT:
+			errno = 0;
+			timeout = strtoul(optarg, &endptr, 0);
+			if (errno || *endptr != '\0' || !timeout) {
+				fprintf(stderr, "Invalid timeout '%s'\n", optarg);
+				opt_error = true;
+				break;
+			}
+			pdbg_cancel_timeout(&cancel, timeout * 1000000);
+			break;
+
+		case OPT_CONNECT:
+			connect_path = optarg;
+			break;
+
+		case OPT_FORMAT:
+			if (!output_set_format(optarg)) {
+				fprintf(stderr, "Invalid output format '%s'\n", optarg);
+				opt_error = true;
+			}
+			break;
+
 		case 'V':
 			printf("%s (commit %s)\n", PACKAGE_STRING, GIT_SHA1);
 			exit(0);
@@ -460,6 +558,11 @@ static bool parse_options(int argc, char *argv[])
 		return false;
 	}
 
+	if (connect_path && (l_count > 0 || output_structured())) {
+		fprintf(stderr, "Can't use -l or --format with --connect\n");
+		return false;
+	}
+
 	if (pathsel_count > 0 && l_count > 0) {
 		fprintf(stderr, "Can't mix -l with -P\n");
 		return false;
@@ -574,6 +677,44 @@ static int probe(void)
 }
 OPTCMD_DEFINE_CMD(probe, probe);
 
+static int print_stats_entry(const struct pdbg_stats *stats, void *priv)
+{
+	fprintf(stderr, "%-18s %-8s %-24s %9" PRIu64 " %6" PRIu64 " %7" PRIu64
+		" %11" PRIu64 " %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+		pdbg_stats_op_name(stats->op), stats->class, stats->backend,
+		stats->count, stats->errors, stats->retries, stats->bytes,
+		stats->total_ns / 1000.0,
+		stats->total_ns / 1000.0 / stats->count,
+		pdbg_stats_percentile(stats, 50) / 1000.0,
+		pdbg_stats_percentile(stats, 99) / 1000.0,
+		stats->max_ns / 1000.0);
+
+	return 0;
+}
+
+/*
+ * Print the statistics collected with --stats. Runs after the targets
+ * have been released so that is accounted for as well.
+ */
+static void print_stats(void)
+{
+	fprintf(stderr, "%-18s %-8s %-24s %9s %6s %7s %11s %10s %10s %10s %10s %10s\n",
+		"operation", "class", "backend", "count", "errors", "retries",
+		"bytes", "total(us)", "avg(us)", "p50(us)", "p99(us)", "max(us)");
+	pdbg_stats_foreach(print_stats_entry, NULL);
+}
+
+/*
+ * Stop long running operations cleanly on the first signal, so the
+ * chips are not left with locks held or special wakeup asserted. A
+ * second signal kills pdbg straight away.
+ */
+static void cancel_handler(int sig)
+{
+	cancel.cancelled = 1;
+	signal(sig, SIG_DFL);
+}
+
 /*
  * Release handler.
  */
@@ -592,19 +733,44 @@ int main(int argc, char *argv[])
 	if (!parse_options(argc, argv))
 		return 1;
 
+	pdbg_set_cancel(&cancel);
+	signal(SIGINT, cancel_handler);
+	signal(SIGTERM, cancel_handler);
+
+	if (show_stats) {
+		pdbg_stats_enable(true);
+		atexit(print_stats);
+	}
+
 	if (optind >= argc) {
 		print_usage();
 		return 1;
 	}
 
+	if (output_structured() && !cmd_structured(argv[optind])) {
+		fprintf(stderr, "Command %s doesn't support --format\n", argv[optind]);
+		return 1;
+	}
+
+	if (connect_path) {
+		rc = connect_run(connect_path, pathsel, pathsel_count,
+				 argc - optind, &argv[optind]);
+		return rc > 0 ? 0 : 1;
+	}
+
 	pdbg_context_short();
 
 	if (backend)
 		if (!pdbg_set_backend(backend, device_node))
 			return 1;
 
-	if (!pdbg_targets_init(NULL))
-		return 1;
+	if (lazy_init) {
+		if (!pdbg_targets_init_lazy(NULL))
+			return 1;
+	} else {
+		if (!pdbg_targets_init(NULL))
+			return 1;
+	}
 
 	if (l_count) {
 		if (!cpus_parse(l_list, l_count))
@@ -655,6 +821,8 @@ int main(int argc, char *argv[])
 	return 1;
 
 found_action:
+	output_flush();
+
 	if (rc > 0)
 		return 0;
 
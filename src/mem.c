@@ -30,6 +30,7 @@
 #include "optcmd.h"
 #include "parsers.h"
 #include "util.h"
+#include "output.h"
 #include "path.h"
 
 #define PR_ERROR(x, args...) \
@@ -119,11 +120,24 @@ static int _getmem(const char *mem_prefix, uint64_t addr, uint64_t size, uint8_t
 			continue;
 		}
 
+		if (output_structured()) {
+			struct output_record rec = {
+				.type = OUTPUT_MEM,
+				.target = mem,
+				.index = pdbg_target_index(target),
+				.addr = addr,
+				.data = buf,
+				.len = size,
+			};
+
+			output_record(&rec);
+		}
+
 		count++;
 		break;
 	}
 
-	if (count > 0) {
+	if (count > 0 && !output_structured()) {
 		if (raw) {
 			if (write(STDOUT_FILENO, buf, size) < 0)
 				PR_ERROR("Unable to write stdout.\n");
@@ -0,0 +1,266 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+
+#include <libpdbg.h>
+
+#include "output.h"
+#include "util.h"
+
+/* stdout is fully buffered with a larger buffer for structured output */
+#define OUTPUT_STREAM_BUF	(256 * 1024)
+
+/* Records are formatted into a local buffer first. Memory contents are
+ * formatted in chunks which fit into it. */
+#define OUTPUT_LINE_BUF		4096
+#define OUTPUT_DATA_CHUNK	1024
+
+static enum output_format format = OUTPUT_TEXT;
+
+static const char *type_names[] = {
+	[OUTPUT_SCOM] = "scom",
+	[OUTPUT_CFAM] = "cfam",
+	[OUTPUT_MEM] = "mem",
+	[OUTPUT_REG] = "reg",
+	[OUTPUT_THREAD] = "thread",
+};
+
+static const char *sleep_names[] = {
+	[PDBG_THREAD_STATE_RUN] = "run",
+	[PDBG_THREAD_STATE_DOZE] = "doze",
+	[PDBG_THREAD_STATE_NAP] = "nap",
+	[PDBG_THREAD_STATE_SLEEP] = "sleep",
+	[PDBG_THREAD_STATE_STOP] = "stop",
+};
+
+bool output_set_format(const char *name)
+{
+	if (!strcmp(name, "text"))
+		format = OUTPUT_TEXT;
+	else if (!strcmp(name, "json"))
+		format = OUTPUT_JSON;
+	else if (!strcmp(name, "binary"))
+		format = OUTPUT_BINARY;
+	else
+		return false;
+
+	if (format != OUTPUT_TEXT)
+		setvbuf(stdout, NULL, _IOFBF, OUTPUT_STREAM_BUF);
+
+	return true;
+}
+
+bool output_structured(void)
+{
+	return format != OUTPUT_TEXT;
+}
+
+void output_flush(void)
+{
+	fflush(stdout);
+}
+
+static char *put_str(char *p, const char *s)
+{
+	size_t len = strlen(s);
+
+	memcpy(p, s, len);
+	return p + len;
+}
+
+/* Target paths and register names only need quotes and backslashes
+ * escaped, anything else unusual is dropped */
+static char *put_json_str(char *p, const char *s, size_t max)
+{
+	const char *end = s + strnlen(s, max);
+
+	*p++ = '"';
+	for (; s < end; s++) {
+		if (*s == '"' || *s == '\\')
+			*p++ = '\\';
+		else if ((unsigned char)*s < 0x20)
+			continue;
+		*p++ = *s;
+	}
+	*p++ = '"';
+
+	return p;
+}
+
+static char *put_json_hex(char *p, const char *key, uint64_t value, int digits)
+{
+	p = put_str(p, key);
+	*p++ = '"';
+	*p++ = '0';
+	*p++ = 'x';
+	p = hex_format(p, value, digits);
+	*p++ = '"';
+
+	return p;
+}
+
+static char *put_json_uint(char *p, const char *key, uint64_t value)
+{
+	char digits[20];
+	int n = 0;
+
+	p = put_str(p, key);
+	do {
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+
+	while (n)
+		*p++ = digits[--n];
+
+	return p;
+}
+
+static void output_json(const struct output_record *rec)
+{
+	char line[OUTPUT_LINE_BUF];
+	char *p = line;
+	const char *path = pdbg_target_path(rec->target);
+	uint64_t pos;
+
+	p = put_str(p, "{\"type\":\"");
+	p = put_str(p, type_names[rec->type]);
+	p = put_str(p, "\",\"target\":");
+	p = put_json_str(p, path, 1024);
+	p = put_json_uint(p, ",\"index\":", rec->index);
+
+	switch (rec->type) {
+	case OUTPUT_SCOM:
+		p = put_json_hex(p, ",\"addr\":", rec->addr, 16);
+		if (!rec->failed)
+			p = put_json_hex(p, ",\"value\":", rec->value, 16);
+		break;
+
+	case OUTPUT_CFAM:
+		p = put_json_hex(p, ",\"addr\":", rec->addr, 8);
+		if (!rec->failed)
+			p = put_json_hex(p, ",\"value\":", rec->value, 8);
+		break;
+
+	case OUTPUT_REG:
+		p = put_str(p, ",\"reg\":");
+		p = put_json_str(p, rec->name, 64);
+		if (!rec->failed)
+			p = put_json_hex(p, ",\"value\":", rec->value, 16);
+		break;
+
+	case OUTPUT_THREAD:
+		p = put_str(p, ",\"active\":");
+		p = put_str(p, rec->thread->active ? "true" : "false");
+		p = put_str(p, ",\"quiesced\":");
+		p = put_str(p, rec->thread->quiesced ? "true" : "false");
+		p = put_str(p, ",\"sleep\":\"");
+		p = put_str(p, sleep_names[rec->thread->sleep_state]);
+		*p++ = '"';
+		break;
+
+	case OUTPUT_MEM:
+		p = put_json_hex(p, ",\"addr\":", rec->addr, 16);
+		p = put_json_uint(p, ",\"size\":", rec->len);
+		if (rec->failed)
+			break;
+
+		p = put_str(p, ",\"data\":\"");
+		for (pos = 0; pos < rec->len; pos += OUTPUT_DATA_CHUNK) {
+			uint64_t len = rec->len - pos;
+
+			if (len > OUTPUT_DATA_CHUNK)
+				len = OUTPUT_DATA_CHUNK;
+
+			fwrite(line, 1, p - line, stdout);
+			p = hex_format_bytes(line, rec->data + pos, len);
+		}
+		*p++ = '"';
+		break;
+	}
+
+	p = put_str(p, rec->failed ? ",\"status\":\"failed\"}\n" : ",\"status\":\"ok\"}\n");
+	fwrite(line, 1, p - line, stdout);
+}
+
+struct output_header {
+	uint8_t type;
+	uint8_t status;
+	uint16_t path_len;
+	uint32_t index;
+	uint64_t data_len;
+	uint64_t addr;
+	uint64_t value;
+} __attribute__((packed));
+
+static void output_binary(const struct output_record *rec)
+{
+	struct output_header hdr;
+	const char *path = pdbg_target_path(rec->target);
+	const void *data = NULL;
+	uint8_t state[4];
+	uint64_t len = 0;
+
+	switch (rec->type) {
+	case OUTPUT_MEM:
+		if (!rec->failed) {
+			data = rec->data;
+			len = rec->len;
+		}
+		break;
+
+	case OUTPUT_REG:
+		data = rec->name;
+		len = strlen(rec->name);
+		break;
+
+	case OUTPUT_THREAD:
+		state[0] = rec->thread->active;
+		state[1] = rec->thread->quiesced;
+		state[2] = rec->thread->sleep_state;
+		state[3] = 0;
+		data = state;
+		len = sizeof(state);
+		break;
+
+	default:
+		break;
+	}
+
+	hdr.type = rec->type;
+	hdr.status = rec->failed ? 1 : 0;
+	hdr.path_len = htobe16(strlen(path));
+	hdr.index = htobe32(rec->index);
+	hdr.data_len = htobe64(len);
+	hdr.addr = htobe64(rec->addr);
+	hdr.value = htobe64(rec->failed ? 0 : rec->value);
+
+	fwrite(&hdr, 1, sizeof(hdr), stdout);
+	fwrite(path, 1, strlen(path), stdout);
+	if (len)
+		fwrite(data, 1, len, stdout);
+}
+
+void output_record(const struct output_record *rec)
+{
+	if (format == OUTPUT_JSON)
+		output_json(rec);
+	else if (format == OUTPUT_BINARY)
+		output_binary(rec);
+}
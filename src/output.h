@@ -0,0 +1,113 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __OUTPUT_H
+#define __OUTPUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <libpdbg.h>
+
+/*
+ * Structured output of command results
+ *
+ * By default commands print their results as text. With --format=json
+ * or --format=binary every result is emitted as a record instead:
+ *
+ * json: One JSON object per line, e.g.
+ *	{"type":"scom","target":"/proc0/pib","index":0,"addr":"0x...",
+ *	 "value":"0x...","status":"ok"}
+ *
+ * binary: A fixed header followed by the target path and any data, all
+ *	numbers big endian:
+ *
+ *	u8  type	enum output_type
+ *	u8  status	0 on success, 1 on failure
+ *	u16 path_len	length of the target path
+ *	u32 index	chip index
+ *	u64 data_len	length of the data
+ *	u64 addr	address or register number
+ *	u64 value	register value
+ *	path_len bytes of target path, not NUL terminated
+ *	data_len bytes of data
+ */
+
+enum output_format {
+	OUTPUT_TEXT,
+	OUTPUT_JSON,
+	OUTPUT_BINARY,
+};
+
+enum output_type {
+	OUTPUT_SCOM = 1,
+	OUTPUT_CFAM = 2,
+	OUTPUT_MEM = 3,
+	OUTPUT_REG = 4,
+	OUTPUT_THREAD = 5,
+};
+
+struct output_record {
+	enum output_type type;
+	struct pdbg_target *target;
+	bool failed;
+
+	/* Index as printed by the text output, eg. the processor of a scom */
+	uint32_t index;
+	uint64_t addr;
+	uint64_t value;
+
+	/* Register name of OUTPUT_REG records */
+	const char *name;
+
+	/* Memory contents of OUTPUT_MEM records */
+	const uint8_t *data;
+	uint64_t len;
+
+	/* State of OUTPUT_THREAD records */
+	struct thread_state *thread;
+};
+
+/**
+ * @brief Select the output format by name
+ *
+ * @param[in] name One of "text", "json" or "binary"
+ * @return true on success, false if name is not a known format
+ */
+bool output_set_format(const char *name);
+
+/**
+ * @brief Check if results are emitted as records rather than text
+ *
+ * @return true for json and binary output
+ */
+bool output_structured(void);
+
+/**
+ * @brief Emit a result record in the selected format
+ *
+ * Records are buffered and written out in bulk.
+ *
+ * @param[in] rec The result
+ */
+void output_record(const struct output_record *rec);
+
+/**
+ * @brief Write out any buffered records
+ */
+void output_flush(void);
+
+#endif
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <errno.h>
@@ -133,6 +134,21 @@ int *parse_spr(const char *argv)
 	return spr;
 }
 
+/* Any string, eg. a file name */
+char **parse_string(const char *argv)
+{
+	char **str;
+
+	if (!argv)
+		return NULL;
+
+	str = malloc(sizeof(*str));
+	if (!str)
+		return NULL;
+
+	*str = strdup(argv);
+	return str;
+}
 
 /* A special parser that always returns true. Allows for boolean flags which
  * don't take arguments. Sets the associated field to true if specified,
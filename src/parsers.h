@@ -14,6 +14,8 @@
 #define DEFAULT_DATA32(default) (parse_number32, default)
 #define GPR (parse_gpr, NULL)
 #define SPR (parse_spr, NULL)
+#define STRING (parse_string, NULL)
+#define DEFAULT_STRING(default) (parse_string, default)
 
 uint64_t *parse_number64(const char *argv);
 uint32_t *parse_number32(const char *argv);
@@ -22,6 +24,7 @@ uint8_t *parse_number8(const char *argv);
 uint8_t *parse_number8_pow2(const char *argv);
 int *parse_gpr(const char *argv);
 int *parse_spr(const char *argv);
+char **parse_string(const char *argv);
 bool *parse_flag_noarg(const char *argv);
 
 #endif
@@ -35,7 +35,9 @@
 
 struct path_pattern {
 	char prefix[MAX_PATH_COMP_LEN];
+	const char *klass;
 	int index[MAX_PATH_INDEX];
+	bool match_all;
 	bool match_full;
 	bool match_index;
 };
@@ -126,6 +128,10 @@ static bool path_pattern_parse(const char *arg, struct path_pattern *pat)
 	if (!pat->prefix[0])
 		return false;
 
+	/* Class names are compared by their interned pointer */
+	pat->match_all = !strcmp(pat->prefix, "all");
+	pat->klass = pdbg_class_lookup(pat->prefix);
+
 	return true;
 }
 
@@ -184,12 +190,16 @@ struct pdbg_target *path_target_find_next(const char *klass, int index)
 	struct pdbg_target *target;
 	int i;
 
+	if (klass) {
+		klass = pdbg_class_lookup(klass);
+		if (!klass)
+			return NULL;
+	}
+
 	for (i=index+1; i<path_target_count; i++) {
 		target = path_target[i];
 		if (klass) {
-			const char *classname = pdbg_target_class_name(target);
-
-			if (!strcmp(klass, classname))
+			if (pdbg_target_class_name(target) == klass)
 				return target;
 		} else {
 			return target;
@@ -215,15 +225,26 @@ bool path_target_add(struct pdbg_target *target)
 	return true;
 }
 
+/*
+ * Compare the class of a target, or its full name if match_full, with the
+ * prefix of a pattern
+ */
+static bool path_pattern_is(struct pdbg_target *target, bool match_full,
+			    struct path_pattern *pat)
+{
+	if (match_full)
+		return !strcmp(pdbg_target_dn_name(target), pat->prefix);
+
+	return pdbg_target_class_name(target) == pat->klass;
+}
+
 static void path_pattern_match(struct pdbg_target *target,
 			       struct path_pattern *pats,
 			       int max_levels,
 			       int level)
 {
 	struct pdbg_target *child;
-	char comp_name[MAX_PATH_COMP_LEN];
-	const char *classname;
-	char *tok;
+	bool match_full;
 	int next = level;
 	bool found = false;
 
@@ -231,26 +252,18 @@ static void path_pattern_match(struct pdbg_target *target,
 		goto end;
 	}
 
-	if (!strcmp("all", pats[level].prefix)) {
+	if (pats[level].match_all) {
 		if (!path_target_add(target))
 			return;
 		goto end;
 	}
 
-	classname = pdbg_target_class_name(target);
-	if (!classname)
+	if (!pdbg_target_class_name(target))
 		goto end;
 
-	if (pats[level].match_full) {
-		const char *dn_name = pdbg_target_dn_name(target);
+	match_full = pats[level].match_full;
 
-		safe_strcpy(comp_name, sizeof(comp_name), dn_name);
-	} else {
-		safe_strcpy(comp_name, sizeof(comp_name), classname);
-	}
-	tok = comp_name;
-
-	if (!strcmp(tok, pats[level].prefix)) {
+	if (path_pattern_is(target, match_full, &pats[level])) {
 		found = true;
 
 		if (pats[level].match_index) {
@@ -274,7 +287,7 @@ static void path_pattern_match(struct pdbg_target *target,
 	 * If we find the same class nested which is not a match,
 	 * then stop recursion
 	 */
-	if (level > 0 && !strcmp(tok, pats[level-1].prefix)) {
+	if (level > 0 && path_pattern_is(target, match_full, &pats[level-1])) {
 		if (pats[level-1].match_index) {
 			int index = pdbg_target_index(target);
 
@@ -305,6 +318,11 @@ bool path_target_parse(const char **arg, int arg_count)
 	return true;
 }
 
+void path_target_clear(void)
+{
+	path_target_count = 0;
+}
+
 bool path_target_present(void)
 {
 	return (path_target_count > 0);
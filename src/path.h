@@ -27,6 +27,11 @@
  */
 bool path_target_parse(const char **arg, int arg_count);
 
+/**
+ * @brief Remove all targets from the list
+ */
+void path_target_clear(void);
+
 /**
  * @brief Check if there are any path targets
  *
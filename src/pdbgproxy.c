@@ -1217,6 +1217,10 @@ static int gdbserver_start(struct pdbg_target *adu, uint16_t port)
 	parser_init(callbacks);
 	adu_target = adu;
 
+	/* gdb re-reads the same memory a lot while stepping */
+	if (mem_cache_enable(adu_target, true))
+		PR_INFO("Unable to enable memory cache\n");
+
 	sock = socket(PF_INET, SOCK_STREAM, 0);
 	if (sock < 0) {
 		perror(__FUNCTION__);
@@ -1294,6 +1298,8 @@ static int gdbserver_start(struct pdbg_target *adu, uint16_t port)
 
 	printf("gdbserver: got ctrl-C, cleaning up (second ctrl-C to kill immediately).\n");
 
+	mem_cache_enable(adu_target, false);
+
 	return 1;
 }
 
@@ -24,12 +24,36 @@
 
 #include "main.h"
 #include "optcmd.h"
+#include "output.h"
 #include "path.h"
 
 static void print_proc_reg(struct pdbg_target *target, bool is_spr, int reg, uint64_t *value, int rc)
 {
 	int proc_index, chip_index, thread_index;
 
+	if (output_structured()) {
+		char name[16];
+		struct output_record rec = {
+			.type = OUTPUT_REG,
+			.target = target,
+			.failed = rc != 0,
+			.index = pdbg_target_index(target),
+			.addr = reg,
+			.value = rc ? 0 : *value,
+			.name = name,
+		};
+
+		if (is_spr && pdbg_spr_by_id(reg))
+			snprintf(name, sizeof(name), "%s", pdbg_spr_by_id(reg));
+		else if (is_spr)
+			snprintf(name, sizeof(name), "spr%d", reg);
+		else
+			snprintf(name, sizeof(name), "gpr%02d", reg);
+
+		output_record(&rec);
+		return;
+	}
+
 	thread_index = pdbg_target_index(target);
 	chip_index = pdbg_parent_index(target, "core");
 	proc_index = pdbg_parent_index(target, "pib");
@@ -24,15 +24,31 @@
 
 #include "main.h"
 #include "optcmd.h"
+#include "output.h"
 #include "path.h"
+#include "scom.h"
 
-/* Check if a target has scom region */
-static bool scommable(struct pdbg_target *target)
+bool scommable(struct pdbg_target *target)
 {
 	return !strcmp(pdbg_target_class_name(target), "pib") ||
 		pdbg_target_parent("pib", target);
 }
 
+static void output_scom(struct pdbg_target *target, struct pdbg_target *addr_base,
+			uint64_t addr, uint64_t value, bool failed)
+{
+	struct output_record rec = {
+		.type = OUTPUT_SCOM,
+		.target = target,
+		.failed = failed,
+		.index = pdbg_target_index(addr_base),
+		.addr = addr,
+		.value = value,
+	};
+
+	output_record(&rec);
+}
+
 int getscom(uint64_t addr)
 {
 	struct pdbg_target *target;
@@ -56,7 +72,16 @@ int getscom(uint64_t addr)
 		addr_base = pdbg_address_absolute(target, &xlate_addr);
 
 		if (pib_read(target, addr, &value)) {
-			printf("p%d: 0x%016" PRIx64 " failed (%s)\n", pdbg_target_index(addr_base), xlate_addr, path);
+			if (output_structured())
+				output_scom(target, addr_base, xlate_addr, 0, true);
+			else
+				printf("p%d: 0x%016" PRIx64 " failed (%s)\n", pdbg_target_index(addr_base), xlate_addr, path);
+			continue;
+		}
+
+		if (output_structured()) {
+			output_scom(target, addr_base, xlate_addr, value, false);
+			count++;
 			continue;
 		}
 
@@ -96,7 +121,10 @@ int putscom(uint64_t addr, uint64_t data, uint64_t mask)
 			rc = pib_write_mask(target, addr, data, mask);
 
 		if (rc) {
-			printf("p%d: 0x%016" PRIx64 " failed (%s)\n", pdbg_target_index(addr_base), xlate_addr, path);
+			if (output_structured())
+				output_scom(target, addr_base, xlate_addr, 0, true);
+			else
+				printf("p%d: 0x%016" PRIx64 " failed (%s)\n", pdbg_target_index(addr_base), xlate_addr, path);
 			continue;
 		}
 
@@ -0,0 +1,636 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <ctype.h>
+#include <assert.h>
+
+#include <libpdbg.h>
+
+#include "main.h"
+#include "optcmd.h"
+#include "output.h"
+#include "parsers.h"
+#include "path.h"
+#include "scom.h"
+#include "script.h"
+#include "util.h"
+
+#define PR_ERROR(x, args...) \
+	pdbg_log(PDBG_ERROR, x, ##args)
+
+/*
+ * Run a list of scom, cfam and memory accesses read from a file, or
+ * stdin, in a single invocation:
+ *
+ *	# comment
+ *	getscom <address>
+ *	putscom <address> <value> [<mask>]
+ *	getcfam <address>
+ *	putcfam <address> <value> [<mask>]
+ *	getmem <address> <size>
+ *	putmem <address> <hex bytes>
+ *
+ * Every operation is applied to the selected targets, like the command
+ * of the same name. Writes are done in the order of the script, as
+ * writing one register may change what another one reads (e.g. control
+ * and status registers, or indirect SCOMs). Between two writes the reads
+ * are grouped by the pib, fsi or mem target they go through and sorted
+ * by address, so the reads of each pib can be issued with
+ * pib_read_list(), and a register read more than once is only read
+ * once. The results are printed in the order of the script.
+ */
+
+#define SCRIPT_MAX_ARGS	4
+
+static int script_parse_number(const char *str, uint64_t *value)
+{
+	char *endptr;
+
+	errno = 0;
+	*value = strtoull(str, &endptr, 0);
+	if (errno || *endptr != '\0')
+		return -1;
+
+	return 0;
+}
+
+static int script_parse_bytes(const char *str, struct script_op *op)
+{
+	size_t i, len;
+
+	if (!strncmp(str, "0x", 2))
+		str += 2;
+
+	len = strlen(str);
+	if (len == 0 || len % 2)
+		return -1;
+
+	for (i = 0; i < len; i++) {
+		if (!isxdigit((unsigned char)str[i]))
+			return -1;
+	}
+
+	op->size = len / 2;
+	op->data = malloc(op->size);
+	assert(op->data);
+
+	for (i = 0; i < op->size; i++) {
+		char byte[3] = { str[2 * i], str[2 * i + 1], '\0' };
+
+		op->data[i] = strtoul(byte, NULL, 16);
+	}
+
+	return 0;
+}
+
+int script_parse_line(char *line, struct script_op *op)
+{
+	char *argv[SCRIPT_MAX_ARGS + 1];
+	char *tok, *saveptr = NULL;
+	int argc = 0;
+
+	for (tok = strtok_r(line, " \t\r\n", &saveptr); tok;
+	     tok = strtok_r(NULL, " \t\r\n", &saveptr)) {
+		if (tok[0] == '#')
+			break;
+
+		if (argc > SCRIPT_MAX_ARGS)
+			return -1;
+
+		argv[argc++] = tok;
+	}
+
+	/* Blank or comment */
+	if (argc == 0)
+		return 0;
+
+	memset(op, 0, sizeof(*op));
+	op->mask = UINT64_MAX;
+
+	if (!strcmp(argv[0], "getscom") || !strcmp(argv[0], "getcfam")) {
+		op->kind = argv[0][3] == 's' ? SCRIPT_SCOM : SCRIPT_CFAM;
+		if (argc != 2 || script_parse_number(argv[1], &op->addr))
+			return -1;
+	} else if (!strcmp(argv[0], "putscom") || !strcmp(argv[0], "putcfam")) {
+		op->kind = argv[0][3] == 's' ? SCRIPT_SCOM : SCRIPT_CFAM;
+		op->write = true;
+		if (argc < 3 || argc > 4 ||
+		    script_parse_number(argv[1], &op->addr) ||
+		    script_parse_number(argv[2], &op->value) ||
+		    (argc == 4 && script_parse_number(argv[3], &op->mask)))
+			return -1;
+	} else if (!strcmp(argv[0], "getmem")) {
+		op->kind = SCRIPT_MEM;
+		if (argc != 3 || script_parse_number(argv[1], &op->addr) ||
+		    script_parse_number(argv[2], &op->size) || op->size == 0)
+			return -1;
+	} else if (!strcmp(argv[0], "putmem")) {
+		op->kind = SCRIPT_MEM;
+		op->write = true;
+		if (argc != 3 || script_parse_number(argv[1], &op->addr) ||
+		    script_parse_bytes(argv[2], op))
+			return -1;
+	} else {
+		return -1;
+	}
+
+	if (op->kind == SCRIPT_CFAM &&
+	    (op->addr > UINT32_MAX || op->value > UINT32_MAX ||
+	     (op->mask != UINT64_MAX && op->mask > UINT32_MAX)))
+		return -1;
+
+	return 1;
+}
+
+static int script_read(const char *file, struct script *script)
+{
+	FILE *f;
+	char *line = NULL;
+	size_t len = 0;
+	int size = 0, lineno = 0, rc = 0;
+
+	if (!strcmp(file, "-")) {
+		f = stdin;
+	} else {
+		f = fopen(file, "r");
+		if (!f) {
+			PR_ERROR("Unable to open %s: %s\n", file, strerror(errno));
+			return -1;
+		}
+	}
+
+	while (getline(&line, &len, f) != -1) {
+		struct script_op op;
+		int ret;
+
+		lineno++;
+		ret = script_parse_line(line, &op);
+		if (ret == 0)
+			continue;
+
+		if (ret < 0) {
+			PR_ERROR("%s:%d: invalid operation\n", file, lineno);
+			rc = -1;
+			break;
+		}
+
+		if (script->nr_ops == size) {
+			size = size ? size * 2 : 64;
+			script->ops = realloc(script->ops, size * sizeof(*script->ops));
+			assert(script->ops);
+		}
+
+		op.line = lineno;
+		script->ops[script->nr_ops++] = op;
+	}
+
+	free(line);
+	if (f != stdin)
+		fclose(f);
+
+	return rc;
+}
+
+static int script_chan_id(struct script *script, struct pdbg_target *chan)
+{
+	int i;
+
+	for (i = 0; i < script->nr_chans; i++) {
+		if (script->chans[i] == chan)
+			return i;
+	}
+
+	script->chans = realloc(script->chans, (i + 1) * sizeof(*script->chans));
+	assert(script->chans);
+	script->chans[script->nr_chans++] = chan;
+
+	return i;
+}
+
+static void script_add(struct script *script, struct script_op *op,
+		       struct pdbg_target *target, struct pdbg_target *chan,
+		       uint64_t addr)
+{
+	struct script_access *access;
+
+	if (script->nr_access == script->size_access) {
+		script->size_access = script->size_access ? script->size_access * 2 : 256;
+		script->access = realloc(script->access,
+					 script->size_access * sizeof(*script->access));
+		assert(script->access);
+	}
+
+	access = &script->access[script->nr_access];
+	memset(access, 0, sizeof(*access));
+	access->op = op;
+	access->target = target;
+	access->chan = chan;
+	access->chan_id = script_chan_id(script, chan);
+	access->addr = addr;
+	access->order = script->nr_access++;
+	access->rc = -1;
+}
+
+static struct pdbg_target *script_mem_target(void)
+{
+	struct pdbg_target *target;
+
+	for_each_path_target_class("pib", target) {
+		char mem_path[128];
+		struct pdbg_target *mem;
+
+		sprintf(mem_path, "/mem%u", pdbg_target_index(target));
+
+		mem = pdbg_target_from_path(NULL, mem_path);
+		if (!mem)
+			continue;
+
+		if (pdbg_target_probe(mem) == PDBG_TARGET_ENABLED)
+			return mem;
+	}
+
+	return NULL;
+}
+
+void script_expand(struct script *script, struct script_op *op)
+{
+	struct pdbg_target *target, *mem;
+
+	switch (op->kind) {
+	case SCRIPT_SCOM:
+		for_each_path_target(target) {
+			struct pdbg_target *pib;
+			uint64_t addr = op->addr;
+
+			if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
+				continue;
+
+			if (!scommable(target))
+				continue;
+
+			pib = pdbg_address_absolute(target, &addr);
+			script_add(script, op, target, pib, addr);
+		}
+		break;
+
+	case SCRIPT_CFAM:
+		for_each_path_target_class("fsi", target) {
+			if (pdbg_target_status(target) != PDBG_TARGET_ENABLED)
+				continue;
+
+			script_add(script, op, target, target, op->addr);
+		}
+		break;
+
+	case SCRIPT_MEM:
+		/* Memory accesses may overlap, so they are only ever issued
+		 * in the order of the script */
+		mem = script_mem_target();
+		if (mem)
+			script_add(script, op, mem, mem, 0);
+		else
+			PR_ERROR("line %d: no memory target\n", op->line);
+		break;
+	}
+}
+
+static int script_access_cmp(const void *a, const void *b)
+{
+	const struct script_access *x = a, *y = b;
+
+	if (x->op->kind != y->op->kind)
+		return x->op->kind < y->op->kind ? -1 : 1;
+	if (x->chan_id != y->chan_id)
+		return x->chan_id < y->chan_id ? -1 : 1;
+	if (x->addr != y->addr)
+		return x->addr < y->addr ? -1 : 1;
+
+	return x->order < y->order ? -1 : x->order > y->order;
+}
+
+static void script_flush_reads(struct pdbg_target *pib, struct script_access **batch, int count)
+{
+	uint64_t *addr, *value;
+	int *rc;
+	int i;
+
+	if (!count)
+		return;
+
+	addr = calloc(count, sizeof(*addr));
+	value = malloc(count * sizeof(*value));
+	rc = malloc(count * sizeof(*rc));
+	assert(addr && value && rc);
+
+	for (i = 0; i < count; i++)
+		addr[i] = batch[i]->addr;
+
+	pib_read_list(pib, addr, value, count, rc);
+	for (i = 0; i < count; i++) {
+		batch[i]->rc = rc[i];
+		batch[i]->value = value[i];
+	}
+
+	free(addr);
+	free(value);
+	free(rc);
+}
+
+static int script_write(struct script_access *access)
+{
+	struct script_op *op = access->op;
+
+	switch (op->kind) {
+	case SCRIPT_SCOM:
+		if (op->mask == UINT64_MAX)
+			return pib_write(access->chan, access->addr, op->value);
+		return pib_write_mask(access->chan, access->addr, op->value, op->mask);
+
+	case SCRIPT_CFAM:
+		if (op->mask == UINT64_MAX)
+			return fsi_write(access->chan, access->addr, op->value);
+		return fsi_write_mask(access->chan, access->addr, op->value, op->mask);
+
+	case SCRIPT_MEM:
+		return mem_write(access->chan, op->addr, op->data, op->size, 0, false);
+	}
+
+	return -1;
+}
+
+static int script_read_one(struct script_access *access)
+{
+	struct script_op *op = access->op;
+	uint32_t value;
+	int rc;
+
+	switch (op->kind) {
+	case SCRIPT_SCOM:
+		return pib_read(access->chan, access->addr, &access->value);
+
+	case SCRIPT_CFAM:
+		rc = fsi_read(access->chan, access->addr, &value);
+		access->value = value;
+		return rc;
+
+	case SCRIPT_MEM:
+		access->data = malloc(op->size);
+		assert(access->data);
+		return mem_read(access->chan, op->addr, access->data, op->size, 0, false);
+	}
+
+	return -1;
+}
+
+static bool script_same_read(struct script_access *a, struct script_access *b)
+{
+	if (a->op->kind == SCRIPT_MEM)
+		return a->op->addr == b->op->addr && a->op->size == b->op->size;
+
+	return a->addr == b->addr;
+}
+
+/* Run the reads through a single pib, fsi or mem target */
+static void script_run_chan(struct script_access *access, int count)
+{
+	struct script_access **batch, *last_read = NULL;
+	int i, nr_batch = 0;
+
+	batch = malloc(count * sizeof(*batch));
+	assert(batch);
+
+	for (i = 0; i < count; i++) {
+		struct script_access *a = &access[i];
+
+		if (last_read && script_same_read(last_read, a)) {
+			a->dup = last_read;
+			continue;
+		}
+
+		last_read = a;
+		if (a->op->kind == SCRIPT_SCOM)
+			batch[nr_batch++] = a;
+		else
+			a->rc = script_read_one(a);
+	}
+
+	script_flush_reads(access[0].chan, batch, nr_batch);
+	free(batch);
+
+	/* The accesses are sorted back into script order afterwards */
+	for (i = 0; i < count; i++) {
+		struct script_access *a = &access[i];
+
+		if (!a->dup)
+			continue;
+
+		a->rc = a->dup->rc;
+		a->value = a->dup->value;
+		a->data = a->dup->data;
+		a->shared = true;
+		a->dup = NULL;
+	}
+}
+
+static int script_order_cmp(const void *a, const void *b)
+{
+	const struct script_access *x = a, *y = b;
+
+	return x->order < y->order ? -1 : x->order > y->order;
+}
+
+/* Run a sequence of reads with no write in between in any order */
+static void script_run_reads(struct script_access *access, int count)
+{
+	int i, start;
+
+	qsort(access, count, sizeof(*access), script_access_cmp);
+
+	for (start = 0; start < count; start = i) {
+		for (i = start + 1; i < count; i++) {
+			if (access[i].op->kind != access[start].op->kind ||
+			    access[i].chan_id != access[start].chan_id)
+				break;
+		}
+
+		script_run_chan(&access[start], i - start);
+	}
+
+	qsort(access, count, sizeof(*access), script_order_cmp);
+}
+
+void script_run(struct script *script)
+{
+	int start, end;
+
+	for (start = 0; start < script->nr_access; start = end) {
+		struct script_access *a = &script->access[start];
+
+		if (a->op->write) {
+			a->rc = script_write(a);
+			end = start + 1;
+			continue;
+		}
+
+		for (end = start + 1; end < script->nr_access; end++) {
+			if (script->access[end].op->write)
+				break;
+		}
+
+		script_run_reads(a, end - start);
+	}
+}
+
+void script_reset(struct script *script)
+{
+	int i;
+
+	for (i = 0; i < script->nr_access; i++) {
+		if (!script->access[i].shared)
+			free(script->access[i].data);
+	}
+
+	script->nr_access = 0;
+	script->nr_chans = 0;
+}
+
+void script_result(const struct script_access *access, struct script_result *res)
+{
+	const struct script_op *op = access->op;
+
+	res->rc = access->rc;
+	res->path = pdbg_target_path(access->target);
+	res->value = access->value;
+	res->data = access->data;
+	res->size = op->size;
+
+	/* Chip index and address as printed by the single commands */
+	if (op->kind == SCRIPT_SCOM) {
+		res->index = pdbg_target_index(access->chan);
+		res->addr = access->addr;
+	} else if (op->kind == SCRIPT_CFAM) {
+		res->index = pdbg_target_index(access->target);
+		res->addr = access->addr;
+	} else {
+		res->index = pdbg_target_index(access->target);
+		res->addr = op->addr;
+	}
+}
+
+void script_print(const struct script_op *op, const struct script_result *res)
+{
+	bool failed = res->rc != 0;
+
+	switch (op->kind) {
+	case SCRIPT_SCOM:
+		if (failed)
+			printf("p%d: 0x%016" PRIx64 " failed (%s)\n",
+			       res->index, res->addr, res->path);
+		else if (!op->write)
+			printf("p%d: 0x%016" PRIx64 " = 0x%016" PRIx64 " (%s)\n",
+			       res->index, res->addr, res->value, res->path);
+		break;
+
+	case SCRIPT_CFAM:
+		if (failed)
+			printf("p%d: failed\n", res->index);
+		else if (!op->write)
+			printf("p%d: 0x%" PRIx64 " = 0x%08" PRIx64 "\n",
+			       res->index, res->addr, res->value);
+		break;
+
+	case SCRIPT_MEM:
+		if (failed)
+			printf("Unable to %s memory using %s\n", op->write ? "write" : "read",
+			       res->path);
+		else if (!op->write)
+			hexdump(res->addr, (uint8_t *)res->data, res->size, 1);
+		break;
+	}
+}
+
+static void script_output(struct script_access *access)
+{
+	struct script_op *op = access->op;
+	struct script_result res;
+
+	script_result(access, &res);
+
+	if (output_structured()) {
+		struct output_record rec = {
+			.target = access->target,
+			.failed = res.rc != 0,
+			.index = res.index,
+			.addr = res.addr,
+			.value = op->write ? 0 : res.value,
+		};
+
+		if (op->write && !rec.failed)
+			return;
+
+		if (op->kind == SCRIPT_SCOM) {
+			rec.type = OUTPUT_SCOM;
+			rec.addr = access->addr;
+		} else if (op->kind == SCRIPT_CFAM) {
+			rec.type = OUTPUT_CFAM;
+		} else {
+			rec.type = OUTPUT_MEM;
+			rec.data = res.data;
+			rec.len = res.size;
+		}
+
+		output_record(&rec);
+		return;
+	}
+
+	script_print(op, &res);
+}
+
+static int run_script(char *file)
+{
+	struct script script = {};
+	int i, count = 0;
+
+	if (script_read(file, &script))
+		goto out;
+
+	for (i = 0; i < script.nr_ops; i++)
+		script_expand(&script, &script.ops[i]);
+
+	script_run(&script);
+
+	for (i = 0; i < script.nr_access; i++) {
+		script_output(&script.access[i]);
+		if (script.access[i].rc == 0)
+			count++;
+	}
+
+	script_reset(&script);
+
+out:
+	for (i = 0; i < script.nr_ops; i++)
+		free(script.ops[i].data);
+	free(script.ops);
+	free(script.access);
+	free(script.chans);
+
+	return count;
+}
+OPTCMD_DEFINE_CMD_WITH_ARGS(script, run_script, (DEFAULT_STRING("-")));
@@ -0,0 +1,143 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 	http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __SCRIPT_H
+#define __SCRIPT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <libpdbg.h>
+#include <libpdbgclient.h>
+
+/* The same as the kinds of daemon requests */
+enum script_kind {
+	SCRIPT_SCOM = PDBG_CLIENT_SCOM,
+	SCRIPT_CFAM = PDBG_CLIENT_CFAM,
+	SCRIPT_MEM = PDBG_CLIENT_MEM,
+};
+
+struct script_op {
+	enum script_kind kind;
+	bool write;
+	int line;
+	uint64_t addr;
+	uint64_t value;
+	uint64_t mask;
+
+	/* Size of memory reads, or the data of memory writes */
+	uint64_t size;
+	uint8_t *data;
+};
+
+struct script_access {
+	struct script_op *op;
+
+	/* Target the result is reported for */
+	struct pdbg_target *target;
+
+	/* Target the access goes through and the address on it */
+	struct pdbg_target *chan;
+	int chan_id;
+	uint64_t addr;
+
+	int order;
+	int rc;
+	uint64_t value;
+	uint8_t *data;
+
+	/* Earlier read this one is a repeat of while running, and whether
+	 * the data is that of the earlier read afterwards */
+	struct script_access *dup;
+	bool shared;
+};
+
+struct script {
+	struct script_op *ops;
+	int nr_ops;
+
+	struct script_access *access;
+	int nr_access, size_access;
+
+	struct pdbg_target **chans;
+	int nr_chans;
+};
+
+
+/* Result of an access in the form it is printed or sent to a client */
+struct script_result {
+	int rc;
+	uint32_t index;
+	const char *path;
+	uint64_t addr;
+	uint64_t value;
+	const uint8_t *data;
+	uint64_t size;
+};
+
+/**
+ * @brief Parse a single line of a script
+ *
+ * @param[in] line The line, modified while parsing
+ * @param[out] op The operation
+ * @return 1 if an operation was parsed, 0 for blank lines and comments,
+ * -1 on error
+ */
+int script_parse_line(char *line, struct script_op *op);
+
+/**
+ * @brief Add the accesses of an operation on the selected path targets
+ *
+ * @param[in] script The script
+ * @param[in] op The operation, which must stay valid until script_reset()
+ */
+void script_expand(struct script *script, struct script_op *op);
+
+/**
+ * @brief Run all accesses added so far
+ *
+ * Writes are done in the order they were added in. The reads between
+ * two writes may be done in any order, and repeated reads only once.
+ * Afterwards the accesses are in the order they were added in, with
+ * their results filled in.
+ *
+ * @param[in] script The script
+ */
+void script_run(struct script *script);
+
+/**
+ * @brief Drop all accesses so the script can be reused
+ *
+ * @param[in] script The script
+ */
+void script_reset(struct script *script);
+
+/**
+ * @brief Get the result of an access
+ *
+ * @param[in] access The access
+ * @param[out] res The result, valid until script_reset()
+ */
+void script_result(const struct script_access *access, struct script_result *res);
+
+/**
+ * @brief Print a result as text, like the single commands do
+ *
+ * @param[in] op The operation
+ * @param[in] res The result
+ */
+void script_print(const struct script_op *op, const struct script_result *res);
+
+#endif
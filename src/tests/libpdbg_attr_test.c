@@ -29,23 +29,14 @@ static void usage(void)
 	fprintf(stderr, "       libpdbg_attr_test <path> write <prop> array 1|2|4|8 <count> <value1> [<value2> ...]\n");
 	fprintf(stderr, "       libpdbg_attr_test <path> read <prop> packed <spec> <count>\n");
 	fprintf(stderr, "       libpdbg_attr_test <path> write <prop> packed <spec> <count> <value1> [<value2> ...]\n");
+	fprintf(stderr, "       libpdbg_attr_test <class> readclass <prop> 1|2|4|8 <count>\n");
 	exit(1);
 }
 
-static void read_array(struct pdbg_target *target,
-		       const char *attr,
-		       unsigned int size,
-		       unsigned int count)
+static void print_array(void *buf, unsigned int size, unsigned int count)
 {
-	void *buf;
 	unsigned int i;
 
-	buf = malloc(size * count);
-	assert(buf);
-
-	if (!pdbg_target_get_attribute(target, attr, size, count, buf))
-		exit(88);
-
 	if (size == 1) {
 		uint8_t *v = (uint8_t *)buf;
 
@@ -72,6 +63,53 @@ static void read_array(struct pdbg_target *target,
 
 	}
 	printf("\n");
+}
+
+static void read_array(struct pdbg_target *target,
+		       const char *attr,
+		       unsigned int size,
+		       unsigned int count)
+{
+	void *buf;
+
+	buf = malloc(size * count);
+	assert(buf);
+
+	if (!pdbg_target_get_attribute(target, attr, size, count, buf))
+		exit(88);
+
+	print_array(buf, size, count);
+
+	free(buf);
+}
+
+static void read_class(const char *klass,
+		       const char *attr,
+		       unsigned int size,
+		       unsigned int count)
+{
+	struct pdbg_target *target;
+	unsigned int max = 0;
+	int i, n;
+	void *buf;
+
+	pdbg_for_each_class_target(klass, target)
+		max++;
+
+	buf = malloc(size * count * (max + 1));
+	assert(buf);
+
+	n = pdbg_target_class_get_attribute(klass, attr, size, count, buf, max + 1);
+	if (n < 0)
+		exit(88);
+	assert(n == max);
+
+	/* Too small a buffer is an error */
+	if (max > 0)
+		assert(pdbg_target_class_get_attribute(klass, attr, size, count, buf, max - 1) == -1);
+
+	for (i = 0; i < n; i++)
+		print_array((uint8_t *)buf + i * size * count, size, count);
 
 	free(buf);
 }
@@ -203,6 +241,7 @@ static void write_packed(struct pdbg_target *target,
 			 unsigned int count,
 			 const char **argv)
 {
+	struct pdbg_attr_spec *aspec;
 	void *buf;
 	size_t size, pos;
 	unsigned int i, j;
@@ -247,9 +286,15 @@ static void write_packed(struct pdbg_target *target,
 		}
 	}
 
-	if (!pdbg_target_set_attribute_packed(target, attr, spec, count, buf))
+	aspec = pdbg_attr_spec_compile(spec);
+	if (!aspec)
 		exit(99);
 
+	if (!pdbg_target_set_attribute_spec(target, attr, aspec, count, buf))
+		exit(99);
+
+	pdbg_attr_spec_free(aspec);
+
 	free(buf);
 }
 
@@ -264,6 +309,20 @@ int main(int argc, const char **argv)
 	if (argc < 6)
 		usage();
 
+	if (strcmp(argv[2], "readclass") == 0) {
+		if (argc != 6)
+			usage();
+
+		size = atol(argv[4]);
+		count = atol(argv[5]);
+
+		pdbg_set_backend(PDBG_BACKEND_FAKE, NULL);
+		assert(pdbg_targets_init(NULL));
+
+		read_class(argv[1], argv[3], size, count);
+		return 0;
+	}
+
 	path = argv[1];
 
 	if (strcmp(argv[2], "read") == 0)
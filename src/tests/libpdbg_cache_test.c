@@ -0,0 +1,139 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <assert.h>
+#include <sys/stat.h>
+
+#include <libpdbg.h>
+
+static char cache_dir[] = "/tmp/pdbg-cache-test-XXXXXX";
+static char cache_file[1024];
+
+static int count_status(struct pdbg_target *target, enum pdbg_target_status status)
+{
+	struct pdbg_target *child;
+	int count = 0;
+
+	if (pdbg_target_status(target) == status)
+		count++;
+
+	pdbg_for_each_child_target(target, child)
+		count += count_status(child, status);
+
+	return count;
+}
+
+/* Returns the size of the single cache file, -1 if there is none */
+static off_t find_cache_file(void)
+{
+	struct dirent *dent;
+	struct stat sb;
+	DIR *dir;
+	int count = 0;
+
+	dir = opendir(cache_dir);
+	assert(dir);
+
+	while ((dent = readdir(dir))) {
+		if (dent->d_name[0] == '.')
+			continue;
+
+		snprintf(cache_file, sizeof(cache_file), "%s/%s", cache_dir, dent->d_name);
+		count++;
+	}
+	closedir(dir);
+
+	if (!count)
+		return -1;
+
+	assert(count == 1);
+	assert(strstr(cache_file, ".cache"));
+	assert(stat(cache_file, &sb) == 0);
+	return sb.st_size;
+}
+
+/* Returns the number of enabled targets, *nonexistent the others */
+static int run(int *nonexistent)
+{
+	struct pdbg_target *root;
+	int enabled;
+
+	assert(pdbg_set_backend(PDBG_BACKEND_FAKE, NULL));
+	assert(pdbg_targets_init(NULL));
+
+	root = pdbg_target_root();
+	assert(root);
+
+	pdbg_target_probe_all(root);
+	enabled = count_status(root, PDBG_TARGET_ENABLED);
+	*nonexistent = count_status(root, PDBG_TARGET_NONEXISTENT);
+
+	pdbg_release_dt_root();
+	return enabled;
+}
+
+int main(void)
+{
+	off_t size;
+	int enabled, nonexistent;
+	FILE *f;
+
+	assert(mkdtemp(cache_dir));
+	assert(setenv("PDBG_CACHE_DIR", cache_dir, 1) == 0);
+
+	/* First run creates the cache */
+	assert(find_cache_file() == -1);
+	enabled = run(&nonexistent);
+	assert(enabled > 0);
+	assert(nonexistent == 0);
+	size = find_cache_file();
+	assert(size > 0);
+
+	/* Second run uses it and gets the same results */
+	assert(run(&nonexistent) == enabled);
+	assert(nonexistent == 0);
+	assert(find_cache_file() == size);
+
+	/* A chip which is off is nonexistent ... */
+	assert(setenv("PDBG_FAKE_OFFLINE", "1", 1) == 0);
+	assert(run(&nonexistent) < enabled);
+	assert(nonexistent > 0);
+
+	/* ... and found again once it is back */
+	assert(unsetenv("PDBG_FAKE_OFFLINE") == 0);
+	assert(run(&nonexistent) == enabled);
+	assert(nonexistent == 0);
+	assert(find_cache_file() == size);
+
+	/* A corrupt cache is ignored and replaced */
+	f = fopen(cache_file, "w");
+	assert(f);
+	fputs("junk", f);
+	fclose(f);
+
+	assert(run(&nonexistent) == enabled);
+	assert(find_cache_file() == size);
+
+	unlink(cache_file);
+	rmdir(cache_dir);
+
+	return 0;
+}
@@ -0,0 +1,403 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include <libpdbg.h>
+
+#define ADU_LATENCY_US	2000
+
+static struct pdbg_target *probe_path(const char *path)
+{
+	struct pdbg_target *target;
+
+	target = pdbg_target_from_path(NULL, path);
+	assert(target);
+	assert(pdbg_target_probe(target) == PDBG_TARGET_ENABLED);
+
+	return target;
+}
+
+static void test_registers(void)
+{
+	struct pdbg_target *pib0, *pib1, *fsi;
+	uint64_t value;
+	uint32_t cfam;
+
+	pib0 = probe_path("/proc0/pib");
+	pib1 = probe_path("/proc1/pib");
+	fsi = probe_path("/proc0/fsi");
+
+	assert(pib_read(pib0, 0xf000f, &value) == 0);
+	assert(value == 0xdeadbeef);
+	assert(pib_write(pib0, 0xf000f, 0x1234) == 0);
+	assert(pib_read(pib0, 0xf000f, &value) == 0);
+	assert(value == 0x1234);
+
+	/* Every chip has its own registers */
+	assert(pib_read(pib1, 0xf000f, &value) == 0);
+	assert(value == 0xdeadbeef);
+
+	assert(fsi_read(fsi, 0x1000, &cfam) == 0);
+	assert(cfam == 0xfeed0cfa);
+	assert(fsi_write(fsi, 0x1000, 0xc0ffee) == 0);
+	assert(fsi_read(fsi, 0x1000, &cfam) == 0);
+	assert(cfam == 0xc0ffee);
+}
+
+static int count_pib_reads(const struct pdbg_stats *stats, void *priv)
+{
+	uint64_t *bytes = priv;
+
+	if (stats->op == PDBG_STATS_PIB_READ)
+		*bytes += stats->bytes;
+
+	return 0;
+}
+
+static void test_read_list(void)
+{
+	uint64_t addr[] = { 0xf000f, 0xf0010, 0xbad0000, 0xf0011 };
+	uint64_t value[4], bytes = 0;
+	struct pdbg_target *pib;
+	int rc[4];
+
+	pib = probe_path("/proc0/pib");
+	assert(pib_write(pib, 0xf0011, 0x11) == 0);
+
+	/* A failing register doesn't stop the ones after it being read */
+	pdbg_stats_reset();
+	pdbg_stats_enable(true);
+	assert(pib_read_list(pib, addr, value, 4, rc) == -1);
+	pdbg_stats_enable(false);
+
+	assert(rc[0] == 0 && value[0] == 0x1234);
+	assert(rc[1] == 0 && value[1] == 0xdeadbeef);
+	assert(rc[2] != 0);
+	assert(rc[3] == 0 && value[3] == 0x11);
+
+	/* And none is read twice */
+	pdbg_stats_foreach(count_pib_reads, &bytes);
+	assert(bytes == 4 * 8);
+
+	assert(pib_read_list(pib, addr, value, 2, NULL) == 0);
+	assert(value[0] == 0x1234 && value[1] == 0xdeadbeef);
+}
+
+static void test_memory(void)
+{
+	struct pdbg_target *mem0, *mem1;
+	uint8_t buf[32], out[32], zero[32];
+	int i;
+
+	mem0 = probe_path("/mem0");
+	mem1 = probe_path("/mem1");
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i + 1;
+	memset(zero, 0, sizeof(zero));
+
+	assert(mem_write(mem0, 0x1000, buf, sizeof(buf), 0, false) == 0);
+
+	/* Memory is shared by all processors */
+	assert(mem_read(mem1, 0x1000, out, sizeof(out), 0, false) == 0);
+	assert(!memcmp(buf, out, sizeof(buf)));
+
+	assert(mem_read(mem0, 0x1003, out, 13, 0, false) == 0);
+	assert(!memcmp(buf + 3, out, 13));
+
+	assert(mem_read(mem0, 0x2000, out, sizeof(out), 0, false) == 0);
+	assert(!memcmp(zero, out, sizeof(out)));
+}
+
+static void test_threads(void)
+{
+	struct pdbg_target *thread0, *thread1;
+	struct thread_state status;
+	uint64_t value;
+	uint32_t cr;
+
+	thread0 = probe_path("/proc0/pib/core@10010/thread@0");
+	thread1 = probe_path("/proc0/pib/core@10010/thread@1");
+
+	status = thread_status(thread0);
+	assert(status.active && !status.quiesced);
+
+	/* Running threads can't be rammed */
+	assert(thread_getgpr(thread0, 1, &value) != 0);
+
+	assert(thread_stop(thread0) == 0);
+	assert(thread_status(thread0).quiesced);
+
+	/* Nor can threads with a running sibling */
+	assert(thread_getgpr(thread0, 1, &value) != 0);
+	assert(thread_stop(thread1) == 0);
+
+	assert(thread_putgpr(thread0, 5, 0x5555) == 0);
+	assert(thread_putgpr(thread1, 5, 0x1111) == 0);
+	assert(thread_getgpr(thread0, 5, &value) == 0);
+	assert(value == 0x5555);
+
+	assert(thread_putspr(thread0, 8, 0x8888) == 0);
+	assert(thread_getspr(thread0, 8, &value) == 0);
+	assert(value == 0x8888);
+
+	assert(thread_putmsr(thread0, 0x8000000000001033ULL) == 0);
+	assert(thread_getmsr(thread0, &value) == 0);
+	assert(value == 0x8000000000001033ULL);
+
+	assert(thread_putcr(thread0, 0x12345678) == 0);
+	assert(thread_getcr(thread0, &cr) == 0);
+	assert(cr == 0x12345678);
+
+	assert(thread_putnia(thread0, 0x2000) == 0);
+	assert(thread_step(thread0, 2) == 0);
+	assert(thread_getnia(thread0, &value) == 0);
+	assert(value == 0x2008);
+
+	/* Loads go to the memory written through the ADU */
+	assert(thread_getmem(thread0, 0x1000, &value) == 0);
+	assert(value == 0x0102030405060708ULL);
+
+	assert(thread_start(thread0) == 0);
+	assert(!thread_status(thread0).quiesced);
+	assert(thread_getgpr(thread1, 5, &value) != 0);
+
+	assert(thread_stop(thread0) == 0);
+	assert(thread_sreset(thread0) == 0);
+	assert(!thread_status(thread0).quiesced);
+	assert(thread_stop(thread0) == 0);
+	assert(thread_getnia(thread0, &value) == 0);
+	assert(value == 0x100);
+}
+
+static void test_cancel(void)
+{
+	struct pdbg_cancel cancel = { 0 };
+	struct pdbg_target *mem0, *thread0;
+	uint8_t buf[64 * 8];
+	uint64_t value;
+
+	mem0 = probe_path("/mem0");
+	thread0 = probe_path("/proc0/pib/core@10010/thread@0");
+
+	assert(pdbg_set_cancel(&cancel) == NULL);
+	assert(!pdbg_cancelled());
+
+	/* Times out long before all the doublewords are read */
+	pdbg_cancel_timeout(&cancel, 4 * ADU_LATENCY_US);
+	assert(mem_read(mem0, 0x1000, buf, sizeof(buf), 0, false) != 0);
+	assert(pdbg_cancelled());
+
+	/* Nothing is started once cancelled */
+	assert(mem_write(mem0, 0x1000, buf, 8, 0, false) != 0);
+	assert(thread_getgpr(thread0, 5, &value) != 0);
+
+	/* Which leaves the ADU and the thread usable afterwards */
+	cancel.cancelled = 0;
+	pdbg_cancel_timeout(&cancel, 0);
+	assert(!pdbg_cancelled());
+	assert(mem_read(mem0, 0x1000, buf, 8, 0, false) == 0);
+	assert(buf[0] == 1);
+	assert(thread_getgpr(thread0, 5, &value) == 0);
+	assert(value == 0x5555);
+
+	assert(pdbg_set_cancel(NULL) == &cancel);
+}
+
+/* Number of bytes read over the PIB by a mem_read() */
+static uint64_t mem_read_pib(struct pdbg_target *mem, uint64_t addr, uint8_t *out, uint64_t size, int *rc)
+{
+	uint64_t bytes = 0;
+
+	pdbg_stats_reset();
+	pdbg_stats_enable(true);
+	*rc = mem_read(mem, addr, out, size, 0, false);
+	pdbg_stats_enable(false);
+
+	pdbg_stats_foreach(count_pib_reads, &bytes);
+	return bytes;
+}
+
+static void test_mem_cache(void)
+{
+	struct pdbg_target *mem0, *mem1, *thread0;
+	uint8_t buf[256], out[64], zero[64];
+	uint64_t value;
+	int i, rc;
+
+	mem0 = probe_path("/mem0");
+	mem1 = probe_path("/mem1");
+	thread0 = probe_path("/proc0/pib/core@10010/thread@0");
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i;
+	memset(zero, 0, sizeof(zero));
+	assert(mem_write(mem0, 0x4000, buf, sizeof(buf), 0, false) == 0);
+
+	assert(mem_cache_enable(mem0, true) == 0);
+
+	/* The first read fills the line, the rest of it is cached */
+	assert(mem_read_pib(mem0, 0x4008, out, 8, &rc) > 0 && rc == 0);
+	assert(!memcmp(out, buf + 0x8, 8));
+	assert(mem_read_pib(mem0, 0x4010, out, 16, &rc) == 0 && rc == 0);
+	assert(!memcmp(out, buf + 0x10, 16));
+
+	/* Reads crossing into the next line fill that line too */
+	assert(mem_read_pib(mem0, 0x4078, out, 16, &rc) > 0 && rc == 0);
+	assert(!memcmp(out, buf + 0x78, 16));
+	assert(mem_read_pib(mem0, 0x4070, out, 32, &rc) == 0 && rc == 0);
+	assert(!memcmp(out, buf + 0x70, 32));
+
+	/* Writes through any mem target invalidate the lines they touch */
+	memset(buf + 0x10, 0xaa, 8);
+	assert(mem_write(mem1, 0x4010, buf + 0x10, 8, 0, false) == 0);
+	assert(mem_read_pib(mem0, 0x4010, out, 8, &rc) > 0 && rc == 0);
+	assert(!memcmp(out, buf + 0x10, 8));
+	assert(mem_read_pib(mem0, 0x4080, out, 8, &rc) == 0 && rc == 0);
+
+	/* As does ramming instructions */
+	assert(thread_getgpr(thread0, 5, &value) == 0);
+	assert(mem_read_pib(mem0, 0x4080, out, 8, &rc) > 0 && rc == 0);
+	assert(!memcmp(out, buf + 0x80, 8));
+
+	/* A line which can't be filled is read uncached ... */
+	assert(mem_read_pib(mem0, 0xbad0000, out, 64, &rc) > 0 && rc == 0);
+	assert(!memcmp(out, zero, 64));
+	assert(mem_read_pib(mem0, 0xbad0000, out, 64, &rc) > 0 && rc == 0);
+	assert(mem_read_pib(mem0, 0xbad0040, out, 8, &rc) > 0 && rc != 0);
+
+	/* ... and MMIO never is */
+	assert(mem_read_pib(mem0, 0x0006000000000000ULL, out, 8, &rc) > 0 && rc == 0);
+	assert(mem_read_pib(mem0, 0x0006000000000000ULL, out, 8, &rc) > 0 && rc == 0);
+
+	assert(mem_cache_enable(mem0, false) == 0);
+}
+
+static void test_getregs_list(void)
+{
+	struct pdbg_target *targets[5];
+	struct thread_regs regs[5], expect;
+	int rc[5] = { 0 };
+
+	/* Interleaved processors, running and unprobed threads */
+	targets[0] = probe_path("/proc0/pib/core@10010/thread@0");
+	targets[1] = probe_path("/proc1/pib/core@10010/thread@0");
+	targets[2] = probe_path("/proc0/pib/core@10010/thread@1");
+	targets[3] = pdbg_target_from_path(NULL, "/proc2/pib/core@10010/thread@0");
+	targets[4] = probe_path("/proc1/pib/core@10010/thread@1");
+	assert(targets[3]);
+
+	assert(thread_stop(targets[0]) == 0);
+	assert(thread_stop(targets[2]) == 0);
+	assert(thread_putgpr(targets[2], 5, 0x2222) == 0);
+	assert(thread_putnia(targets[2], 0x3000) == 0);
+
+	/* Each thread reports its own result */
+	assert(thread_getregs_list(targets, 5, regs, rc) == -1);
+	assert(rc[0] == 0 && rc[2] == 0);
+	assert(rc[1] != 0 && rc[3] != 0 && rc[4] != 0);
+
+	assert(regs[2].gprs[5] == 0x2222);
+	assert(regs[2].nia == 0x3000);
+	assert(thread_getregs(targets[0], &expect) == 0);
+	assert(regs[0].gprs[5] == expect.gprs[5]);
+	assert(regs[0].nia == expect.nia);
+
+	/* The return codes are optional */
+	assert(thread_getregs_list(targets, 1, regs, NULL) == 0);
+	assert(thread_getregs_list(&targets[3], 1, regs, NULL) == -1);
+	assert(thread_getregs_list(targets, 3, regs, NULL) == -1);
+
+	assert(thread_start(targets[2]) == 0);
+}
+
+/* The fake PIB can't stop all its threads, so they are stopped together */
+static void test_stop_all(void)
+{
+	struct pdbg_target *thread;
+	int count = 0;
+
+	pdbg_for_each_class_target("thread", thread) {
+		if (pdbg_target_status(thread) != PDBG_TARGET_ENABLED)
+			continue;
+
+		if (thread_status(thread).quiesced)
+			assert(thread_start(thread) == 0);
+		count++;
+	}
+	assert(count > 1);
+
+	assert(thread_stop_all() == 0);
+	pdbg_for_each_class_target("thread", thread) {
+		if (pdbg_target_status(thread) == PDBG_TARGET_ENABLED)
+			assert(thread_status(thread).quiesced);
+	}
+}
+
+/* Releasing every target starts the next system from scratch */
+static void test_release(void)
+{
+	struct pdbg_target *mem0, *fsi;
+	uint8_t buf[8], zero[8];
+	uint32_t cfam;
+
+	memset(zero, 0, sizeof(zero));
+	pdbg_target_release(pdbg_target_root());
+	pdbg_release_dt_root();
+
+	assert(pdbg_set_backend(PDBG_BACKEND_FAKE, NULL));
+	assert(pdbg_targets_init(NULL));
+
+	mem0 = probe_path("/mem0");
+	fsi = probe_path("/proc0/fsi");
+
+	assert(mem_read(mem0, 0x1000, buf, sizeof(buf), 0, false) == 0);
+	assert(!memcmp(buf, zero, sizeof(buf)));
+	assert(fsi_read(fsi, 0x1000, &cfam) == 0);
+	assert(cfam == 0xfeed0cfa);
+
+	pdbg_target_release(pdbg_target_root());
+}
+
+int main(void)
+{
+	char latency[32];
+
+	assert(setenv("PDBG_BACKEND_DTB", "fake-sim-backend.dtb", 0) == 0);
+	snprintf(latency, sizeof(latency), "adu=%d", ADU_LATENCY_US);
+	assert(setenv("PDBG_FAKE_LATENCY", latency, 1) == 0);
+
+	assert(pdbg_set_backend(PDBG_BACKEND_FAKE, NULL));
+	assert(pdbg_targets_init(NULL));
+
+	test_registers();
+	test_read_list();
+	test_memory();
+	test_threads();
+	test_cancel();
+	test_mem_cache();
+	test_getregs_list();
+	test_stop_all();
+	test_release();
+
+	pdbg_release_dt_root();
+	return 0;
+}
@@ -0,0 +1,153 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Checks that iterating over the targets of a class below a parent
+ * returns the same targets, in the same order, as walking up the tree
+ * from every target of the class would.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <libpdbg.h>
+
+#define MAX_TARGETS	16384
+#define MAX_CLASSES	256
+
+static struct pdbg_target *targets[MAX_TARGETS];
+static int nr_targets;
+static const char *classes[MAX_CLASSES];
+static int nr_classes;
+
+static void *read_dtb(const char *path)
+{
+	FILE *f;
+	long len;
+	void *fdt;
+
+	f = fopen(path, "r");
+	assert(f);
+	assert(fseek(f, 0, SEEK_END) == 0);
+	len = ftell(f);
+	assert(len > 0);
+	rewind(f);
+
+	fdt = malloc(len);
+	assert(fdt);
+	assert(fread(fdt, 1, len, f) == (size_t)len);
+	fclose(f);
+
+	return fdt;
+}
+
+static void collect(struct pdbg_target *target)
+{
+	struct pdbg_target *child;
+	const char *class;
+	int i;
+
+	assert(nr_targets < MAX_TARGETS);
+	targets[nr_targets++] = target;
+
+	class = pdbg_target_class_name(target);
+	if (class) {
+		for (i = 0; i < nr_classes; i++) {
+			if (!strcmp(classes[i], class))
+				break;
+		}
+
+		if (i == nr_classes) {
+			assert(nr_classes < MAX_CLASSES);
+			classes[nr_classes++] = class;
+		}
+	}
+
+	pdbg_for_each_child_target(target, child)
+		collect(child);
+}
+
+static bool is_below(struct pdbg_target *target, struct pdbg_target *parent)
+{
+	struct pdbg_target *tmp;
+
+	for (tmp = target; tmp && pdbg_target_parent(NULL, tmp) && tmp != parent;
+	     tmp = pdbg_target_parent(NULL, tmp)) {}
+
+	return tmp == parent;
+}
+
+static int check_class(const char *class, struct pdbg_target *parent)
+{
+	struct pdbg_target *target, *expect;
+	int count = 0;
+
+	expect = NULL;
+	pdbg_for_each_target(class, parent, target) {
+		do {
+			expect = __pdbg_next_target(class, NULL, expect, true);
+			assert(expect);
+		} while (!is_below(expect, parent));
+
+		assert(target == expect);
+		count++;
+	}
+
+	/* Nothing was missed at the end either */
+	while ((expect = __pdbg_next_target(class, NULL, expect, true)))
+		assert(!is_below(expect, parent));
+
+	return count;
+}
+
+static void test_tree(const char *path)
+{
+	void *fdt;
+	int i, j, found = 0;
+
+	fdt = read_dtb(path);
+
+	assert(pdbg_set_backend(PDBG_BACKEND_FAKE, NULL));
+	assert(pdbg_targets_init(fdt));
+
+	nr_targets = 0;
+	nr_classes = 0;
+	collect(pdbg_target_root());
+
+	for (i = 0; i < nr_classes; i++) {
+		for (j = 0; j < nr_targets; j++)
+			found += check_class(classes[i], targets[j]);
+	}
+
+	printf("%s: %d targets, %d classes, %d matches\n", path, nr_targets, nr_classes, found);
+	assert(found > 0);
+
+	pdbg_release_dt_root();
+	free(fdt);
+}
+
+int main(void)
+{
+	pdbg_set_loglevel(PDBG_ERROR);
+
+	test_tree("fake.dtb");
+	test_tree("p9.dtb");
+	test_tree("p10.dtb");
+
+	return 0;
+}
@@ -0,0 +1,221 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Checks that a tree created on demand by pdbg_targets_init_lazy() is
+ * the same as the one created by pdbg_targets_init(), whichever way it
+ * is first looked at.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <libpdbg.h>
+
+#define MAX_TARGETS	16384
+#define MAX_CLASSES	256
+
+struct snapshot {
+	char *tree[MAX_TARGETS];
+	int nr_tree;
+	char *classes[MAX_CLASSES];
+	int nr_classes;
+	char *class_targets[MAX_TARGETS];
+	int nr_class_targets;
+};
+
+static struct snapshot eager, lazy;
+
+static void *read_dtb(const char *path)
+{
+	FILE *f;
+	long len;
+	void *fdt;
+
+	f = fopen(path, "r");
+	assert(f);
+	assert(fseek(f, 0, SEEK_END) == 0);
+	len = ftell(f);
+	assert(len > 0);
+	rewind(f);
+
+	fdt = malloc(len);
+	assert(fdt);
+	assert(fread(fdt, 1, len, f) == (size_t)len);
+	fclose(f);
+
+	return fdt;
+}
+
+static char *describe(struct pdbg_target *target)
+{
+	char *str;
+
+	assert(asprintf(&str, "%s %s %d %d", pdbg_target_path(target),
+			pdbg_target_class_name(target) ?: "-",
+			pdbg_target_index(target), pdbg_target_status(target)) > 0);
+	return str;
+}
+
+static void walk(struct snapshot *snap, struct pdbg_target *target)
+{
+	struct pdbg_target *child;
+	const char *class;
+	int i;
+
+	assert(snap->nr_tree < MAX_TARGETS);
+	snap->tree[snap->nr_tree++] = describe(target);
+
+	class = pdbg_target_class_name(target);
+	if (class && snap == &eager) {
+		for (i = 0; i < snap->nr_classes; i++) {
+			if (!strcmp(snap->classes[i], class))
+				break;
+		}
+
+		if (i == snap->nr_classes) {
+			assert(snap->nr_classes < MAX_CLASSES);
+			snap->classes[snap->nr_classes++] = strdup(class);
+		}
+	}
+
+	pdbg_for_each_child_target(target, child)
+		walk(snap, child);
+}
+
+/* Targets of every class, in the order the classes were found in eager */
+static void walk_classes(struct snapshot *snap, bool reverse)
+{
+	struct pdbg_target *target;
+	int i;
+
+	for (i = 0; i < eager.nr_classes; i++) {
+		const char *class = eager.classes[reverse ? eager.nr_classes - 1 - i : i];
+
+		pdbg_for_each_class_target(class, target) {
+			assert(snap->nr_class_targets < MAX_TARGETS);
+			snap->class_targets[snap->nr_class_targets++] = describe(target);
+		}
+	}
+}
+
+static void compare(char **a, int nr_a, char **b, int nr_b)
+{
+	int i;
+
+	assert(nr_a == nr_b);
+	for (i = 0; i < nr_a; i++) {
+		if (strcmp(a[i], b[i])) {
+			printf("mismatch: %s != %s\n", a[i], b[i]);
+			assert(0);
+		}
+	}
+}
+
+static void snapshot_free(struct snapshot *snap, bool classes)
+{
+	int i;
+
+	for (i = 0; i < snap->nr_tree; i++)
+		free(snap->tree[i]);
+	for (i = 0; i < snap->nr_class_targets; i++)
+		free(snap->class_targets[i]);
+	if (classes) {
+		for (i = 0; i < snap->nr_classes; i++)
+			free(snap->classes[i]);
+		snap->nr_classes = 0;
+	}
+
+	snap->nr_tree = 0;
+	snap->nr_class_targets = 0;
+}
+
+/* Iterate over a few classes below a parent before anything else */
+static void first_lookup(void)
+{
+	struct pdbg_target *proc, *target;
+	int count = 0;
+
+	pdbg_for_each_class_target("proc", proc) {
+		pdbg_for_each_target("core", proc, target)
+			count++;
+		pdbg_for_each_target("thread", proc, target)
+			count++;
+	}
+
+	target = pdbg_target_from_path(NULL, "/proc1/pib");
+	assert(target);
+	count++;
+
+	printf("  first lookup: %d targets\n", count);
+}
+
+static void test_tree(const char *path)
+{
+	void *fdt;
+	int order;
+
+	fdt = read_dtb(path);
+
+	assert(pdbg_set_backend(PDBG_BACKEND_FAKE, NULL));
+	assert(pdbg_targets_init(fdt));
+	walk(&eager, pdbg_target_root());
+	walk_classes(&eager, false);
+	pdbg_release_dt_root();
+
+	printf("%s: %d targets, %d classes\n", path, eager.nr_tree, eager.nr_classes);
+
+	/* Tree first, classes first, and a narrow lookup first */
+	for (order = 0; order < 3; order++) {
+		assert(pdbg_set_backend(PDBG_BACKEND_FAKE, NULL));
+		assert(pdbg_targets_init_lazy(fdt));
+
+		if (order == 2)
+			first_lookup();
+
+		if (order == 1) {
+			walk_classes(&lazy, true);
+			snapshot_free(&lazy, false);
+		}
+
+		walk(&lazy, pdbg_target_root());
+		walk_classes(&lazy, false);
+
+		compare(eager.tree, eager.nr_tree, lazy.tree, lazy.nr_tree);
+		compare(eager.class_targets, eager.nr_class_targets,
+			lazy.class_targets, lazy.nr_class_targets);
+
+		pdbg_release_dt_root();
+		snapshot_free(&lazy, false);
+	}
+
+	snapshot_free(&eager, true);
+	free(fdt);
+}
+
+int main(void)
+{
+	pdbg_set_loglevel(PDBG_ERROR);
+
+	test_tree("fake.dtb");
+	test_tree("p9.dtb");
+	test_tree("p10.dtb");
+
+	return 0;
+}
@@ -0,0 +1,204 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <assert.h>
+
+#include <libpdbg.h>
+
+#include "poll.h"
+
+#define MAX_POLLS	64
+
+struct cond {
+	/* Met on this poll, never if 0 */
+	int met_at;
+	/* Fails with this error instead, if set */
+	int error;
+
+	int polls;
+	uint64_t when[MAX_POLLS];
+};
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int cond_poll(void *priv)
+{
+	struct cond *c = priv;
+
+	if (c->polls < MAX_POLLS)
+		c->when[c->polls] = now_us();
+	c->polls++;
+
+	if (c->error)
+		return c->error;
+
+	return c->polls == c->met_at;
+}
+
+/* No sleeping between polls, so nothing here depends on timing */
+static const struct poll_backoff busy = {
+	.spins = 1000,
+};
+
+static void test_poll_until(void)
+{
+	struct cond c = { .met_at = 5 };
+	uint64_t start;
+
+	/* Polled until the condition is met, and no more */
+	assert(poll_until(cond_poll, &c, 0, &busy) == 0);
+	assert(c.polls == 5);
+
+	/* Met straight away */
+	c = (struct cond) { .met_at = 1 };
+	assert(poll_until(cond_poll, &c, 0, NULL) == 0);
+	assert(c.polls == 1);
+
+	/* Errors end the poll */
+	c = (struct cond) { .error = -EIO };
+	assert(poll_until(cond_poll, &c, 0, &busy) == -EIO);
+	assert(c.polls == 1);
+
+	/* Gives up once the deadline has passed, and not before */
+	c = (struct cond) { 0 };
+	start = now_us();
+	assert(poll_until(cond_poll, &c, 20000, &poll_backoff_fast) == POLL_TIMEOUT);
+	assert(now_us() - start >= 20000);
+	assert(c.polls > 1);
+}
+
+static void test_backoff(void)
+{
+	const struct poll_backoff backoff = {
+		.spins = 3,
+		.yields = 2,
+		.min_sleep_us = 1000,
+		.max_sleep_us = 4000,
+	};
+	struct cond c = { .met_at = 10 };
+	unsigned int sleep_us = 1000;
+	int i;
+
+	assert(poll_until(cond_poll, &c, 0, &backoff) == 0);
+	assert(c.polls == 10);
+
+	/*
+	 * Polls 1 to 6 are back to back or yield in between. From then
+	 * on each poll waits at least twice as long as the one before,
+	 * up to max_sleep_us.
+	 */
+	for (i = 6; i < c.polls; i++) {
+		assert(c.when[i] - c.when[i - 1] >= sleep_us);
+		sleep_us *= 2;
+		if (sleep_us > backoff.max_sleep_us)
+			sleep_us = backoff.max_sleep_us;
+	}
+}
+
+static void test_poll_until_all(void)
+{
+	struct cond c[3];
+	void *priv[3] = { &c[0], &c[1], &c[2] };
+	int status[3];
+
+	/* Each condition is polled until it is met */
+	c[0] = (struct cond) { .met_at = 1 };
+	c[1] = (struct cond) { .met_at = 4 };
+	c[2] = (struct cond) { .met_at = 2 };
+	assert(poll_until_all(cond_poll, priv, status, 3, 0, &busy) == 0);
+	assert(c[0].polls == 1 && c[1].polls == 4 && c[2].polls == 2);
+	assert(status[0] == 1 && status[1] == 1 && status[2] == 1);
+
+	/* A failure doesn't stop the others being polled */
+	c[0] = (struct cond) { .met_at = 3 };
+	c[1] = (struct cond) { .error = -EIO };
+	c[2] = (struct cond) { .met_at = 5 };
+	assert(poll_until_all(cond_poll, priv, status, 3, 0, &busy) == -1);
+	assert(c[0].polls == 3 && c[1].polls == 1 && c[2].polls == 5);
+	assert(status[0] == 1 && status[1] == -EIO && status[2] == 1);
+
+	/* Conditions not met by the deadline are reported as such */
+	c[0] = (struct cond) { .met_at = 1 };
+	c[1] = (struct cond) { 0 };
+	c[2] = (struct cond) { .met_at = 2 };
+	assert(poll_until_all(cond_poll, priv, status, 3, 10000, &poll_backoff_fast) == POLL_TIMEOUT);
+	assert(status[0] == 1 && status[1] == 0 && status[2] == 1);
+	assert(c[0].polls == 1 && c[2].polls == 2 && c[1].polls > 2);
+
+	/* As are failures, which take precedence */
+	c[0] = (struct cond) { .error = -EIO };
+	c[1] = (struct cond) { 0 };
+	c[2] = (struct cond) { .met_at = 1 };
+	assert(poll_until_all(cond_poll, priv, status, 3, 10000, &poll_backoff_fast) == -1);
+	assert(status[0] == -EIO && status[1] == 0 && status[2] == 1);
+
+	/* The status array is optional */
+	c[0] = (struct cond) { .met_at = 2 };
+	c[1] = (struct cond) { .met_at = 1 };
+	c[2] = (struct cond) { .met_at = 3 };
+	assert(poll_until_all(cond_poll, priv, NULL, 3, 0, &busy) == 0);
+}
+
+static void test_cancel(void)
+{
+	struct pdbg_cancel cancel = { .cancelled = 1 };
+	struct cond c = { 0 };
+	void *c_ptr = &c;
+
+	/* A cancelled wait ends after one round, like a timeout */
+	assert(pdbg_set_cancel(&cancel) == NULL);
+	assert(poll_until_cancellable(cond_poll, &c, 0, &poll_backoff_slow) == POLL_TIMEOUT);
+	assert(c.polls == 1);
+
+	/* Unless the condition is met on that round */
+	c = (struct cond) { .met_at = 1 };
+	assert(poll_until_cancellable(cond_poll, &c, 0, &poll_backoff_slow) == 0);
+
+	c = (struct cond) { .met_at = 1 };
+	assert(poll_until_all_cancellable(cond_poll, (void **)&c_ptr, NULL, 1, 0,
+					  &poll_backoff_slow) == 0);
+
+	/* Other polls only end at their deadline */
+	c = (struct cond) { .met_at = 5 };
+	assert(poll_until(cond_poll, &c, 0, &busy) == 0);
+	assert(c.polls == 5);
+
+	c = (struct cond) { 0 };
+	assert(poll_until(cond_poll, &c, 10000, &poll_backoff_fast) == POLL_TIMEOUT);
+	assert(c.polls > 1);
+
+	assert(pdbg_set_cancel(NULL) == &cancel);
+}
+
+int main(void)
+{
+	test_poll_until();
+	test_backoff();
+	test_poll_until_all();
+	test_cancel();
+
+	return 0;
+}
@@ -248,6 +248,65 @@ static void test3(void)
 	}
 }
 
+static void test4(void)
+{
+	struct pdbg_target *root, *target;
+	enum pdbg_target_status status;
+
+	assert(pdbg_set_backend(PDBG_BACKEND_FAKE, NULL));
+	assert(pdbg_targets_init(NULL));
+
+	root = pdbg_target_root();
+	assert(root);
+
+	pdbg_target_probe_all(root);
+	for_each_target(root, check_status, PDBG_TARGET_ENABLED);
+
+	/* Released targets come back once they are invalidated */
+	pdbg_for_each_class_target("core", target) {
+		pdbg_target_release(target);
+	}
+	pdbg_for_each_class_target("core", target) {
+		for_each_target(target, check_status, PDBG_TARGET_RELEASED);
+	}
+
+	pdbg_for_each_class_target("core", target) {
+		status = pdbg_target_reprobe(target);
+		assert(status == PDBG_TARGET_ENABLED);
+	}
+
+	/* Threads below are only probed again when they are used */
+	pdbg_for_each_class_target("thread", target) {
+		check_status(target, PDBG_TARGET_RELEASED);
+	}
+	pdbg_for_each_class_target("thread", target) {
+		status = pdbg_target_probe(target);
+		assert(status == PDBG_TARGET_ENABLED);
+	}
+
+	/* Enabled targets stay enabled */
+	pdbg_target_invalidate(root);
+	pdbg_target_probe_all(root);
+	for_each_target(root, check_status, PDBG_TARGET_ENABLED);
+
+	/* Invalidating a parent affects the targets below it */
+	pdbg_for_each_class_target("pib", target) {
+		pdbg_target_release(target);
+	}
+	pdbg_for_each_class_target("fsi", target) {
+		pdbg_target_invalidate(target);
+	}
+	pdbg_for_each_class_target("thread", target) {
+		status = pdbg_target_probe(target);
+		assert(status == PDBG_TARGET_ENABLED);
+	}
+	pdbg_for_each_class_target("pib", target) {
+		check_status(target, PDBG_TARGET_ENABLED);
+	}
+
+	pdbg_target_release(root);
+}
+
 int main(void)
 {
 	int test_id = TEST_ID;
@@ -258,6 +317,8 @@ int main(void)
 		test2();
 	} else if (test_id == 3) {
 		test3();
+	} else if (test_id == 4) {
+		test4();
 	} else {
 		printf("No test for TEST_ID=%d\n", test_id);
 		return 1;
@@ -0,0 +1,268 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures what a short lived pdbg invocation pays before and around
+ * its first access, using the fake backend:
+ *
+ *   init_ns        pdbg_targets_init() or pdbg_targets_init_lazy()
+ *   init_bytes     memory allocated by init and still in use after it
+ *   select_ns      finding the pib of processor 1 by class
+ *   probe_ns       probing that pib and its parents
+ *   first_scom_ns  the first SCOM read
+ *   scom_ns        each further SCOM read
+ *   probe_all_ns   pdbg_target_probe_all() on what is left
+ *   release_ns     pdbg_release_dt_root()
+ *
+ * Each is the average over all iterations. The results are printed as
+ * one JSON object per line for every device tree and way of building
+ * the tree, so they can be collected and compared between changes.
+ *
+ * Usage: libpdbg_startup_bench [-n <iterations>] [<system.dtb>[:<backend.dtb>] ...]
+ *
+ * Without a device tree, fake.dtb, p9.dtb, p10.dtb and the synthetic 16
+ * socket p10-16.dtb (with fake-backend-16.dtb) are measured.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <assert.h>
+#include <malloc.h>
+#include <time.h>
+
+#include <libpdbg.h>
+
+#define BENCH_SCOMS	1000
+#define BENCH_SCOM_ADDR	0xf000f
+
+enum bench_result {
+	BENCH_INIT,
+	BENCH_INIT_BYTES,
+	BENCH_SELECT,
+	BENCH_PROBE,
+	BENCH_FIRST_SCOM,
+	BENCH_SCOM,
+	BENCH_PROBE_ALL,
+	BENCH_RELEASE,
+	BENCH_NR_RESULTS,
+};
+
+static const char *bench_result_name[] = {
+	[BENCH_INIT] = "init_ns",
+	[BENCH_INIT_BYTES] = "init_bytes",
+	[BENCH_SELECT] = "select_ns",
+	[BENCH_PROBE] = "probe_ns",
+	[BENCH_FIRST_SCOM] = "first_scom_ns",
+	[BENCH_SCOM] = "scom_ns",
+	[BENCH_PROBE_ALL] = "probe_all_ns",
+	[BENCH_RELEASE] = "release_ns",
+};
+
+static const char *default_trees[] = {
+	"fake.dtb",
+	"p9.dtb",
+	"p10.dtb",
+	"p10-16.dtb:fake-backend-16.dtb",
+};
+
+static void *read_dtb(const char *path)
+{
+	FILE *f;
+	long len;
+	void *fdt;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+
+	assert(fseek(f, 0, SEEK_END) == 0);
+	len = ftell(f);
+	assert(len > 0);
+	rewind(f);
+
+	fdt = malloc(len);
+	assert(fdt);
+	assert(fread(fdt, 1, len, f) == (size_t)len);
+	fclose(f);
+
+	return fdt;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t allocated_bytes(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+	struct mallinfo2 mi = mallinfo2();
+
+	return mi.uordblks + mi.hblkhd;
+#else
+	return 0;
+#endif
+}
+
+static int count_targets(struct pdbg_target *target)
+{
+	struct pdbg_target *child;
+	int count = 1;
+
+	pdbg_for_each_child_target(target, child)
+		count += count_targets(child);
+
+	return count;
+}
+
+static struct pdbg_target *select_pib(void)
+{
+	struct pdbg_target *pib;
+
+	pdbg_for_each_class_target("pib", pib) {
+		if (pdbg_target_index(pib) == 1)
+			return pib;
+	}
+
+	return NULL;
+}
+
+static void bench_once(void *fdt, bool lazy, uint64_t *result, int *targets)
+{
+	struct pdbg_target *pib;
+	uint64_t start, bytes, val;
+	int i;
+
+	assert(pdbg_set_backend(PDBG_BACKEND_FAKE, NULL));
+
+	bytes = allocated_bytes();
+	start = now_ns();
+	if (lazy)
+		assert(pdbg_targets_init_lazy(fdt));
+	else
+		assert(pdbg_targets_init(fdt));
+	result[BENCH_INIT] += now_ns() - start;
+	result[BENCH_INIT_BYTES] += allocated_bytes() - bytes;
+
+	start = now_ns();
+	pib = select_pib();
+	result[BENCH_SELECT] += now_ns() - start;
+	assert(pib);
+
+	start = now_ns();
+	assert(pdbg_target_probe(pib) == PDBG_TARGET_ENABLED);
+	result[BENCH_PROBE] += now_ns() - start;
+
+	start = now_ns();
+	assert(!pib_read(pib, BENCH_SCOM_ADDR, &val));
+	result[BENCH_FIRST_SCOM] += now_ns() - start;
+
+	start = now_ns();
+	for (i = 0; i < BENCH_SCOMS; i++)
+		assert(!pib_read(pib, BENCH_SCOM_ADDR, &val));
+	result[BENCH_SCOM] += (now_ns() - start) / BENCH_SCOMS;
+
+	start = now_ns();
+	pdbg_target_probe_all(NULL);
+	result[BENCH_PROBE_ALL] += now_ns() - start;
+
+	if (!*targets)
+		*targets = count_targets(pdbg_target_root());
+
+	start = now_ns();
+	pdbg_release_dt_root();
+	result[BENCH_RELEASE] += now_ns() - start;
+}
+
+static void bench_tree(const char *arg, int iterations)
+{
+	char *system, *backend;
+	void *fdt;
+	int lazy, i;
+
+	system = strdup(arg);
+	assert(system);
+
+	backend = strchr(system, ':');
+	if (backend) {
+		*backend++ = '\0';
+		setenv("PDBG_BACKEND_DTB", backend, 1);
+	} else {
+		unsetenv("PDBG_BACKEND_DTB");
+	}
+
+	fdt = read_dtb(system);
+
+	for (lazy = 0; lazy < 2; lazy++) {
+		uint64_t result[BENCH_NR_RESULTS] = {};
+		int targets = 0;
+
+		for (i = 0; i < iterations; i++)
+			bench_once(fdt, lazy, result, &targets);
+
+		printf("{\"tree\":\"%s\",\"backend\":\"%s\",\"mode\":\"%s\","
+		       "\"iterations\":%d,\"targets\":%d",
+		       system, backend ?: "builtin", lazy ? "lazy" : "eager",
+		       iterations, targets);
+		for (i = 0; i < BENCH_NR_RESULTS; i++)
+			printf(",\"%s\":%" PRIu64, bench_result_name[i], result[i] / iterations);
+		printf("}\n");
+		fflush(stdout);
+	}
+
+	free(fdt);
+	free(system);
+}
+
+int main(int argc, char * const argv[])
+{
+	int iterations = 10;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "n:")) != -1) {
+		switch (opt) {
+		case 'n':
+			iterations = atoi(optarg);
+			break;
+
+		default:
+			fprintf(stderr, "Usage: %s [-n <iterations>] [<system.dtb>[:<backend.dtb>] ...]\n", argv[0]);
+			return 1;
+		}
+	}
+	assert(iterations > 0);
+
+	pdbg_set_loglevel(PDBG_ERROR);
+
+	if (optind == argc) {
+		for (i = 0; i < sizeof(default_trees) / sizeof(default_trees[0]); i++)
+			bench_tree(default_trees[i], iterations);
+	} else {
+		for (i = optind; i < argc; i++)
+			bench_tree(argv[i], iterations);
+	}
+
+	return 0;
+}
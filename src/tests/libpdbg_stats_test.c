@@ -0,0 +1,131 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <assert.h>
+
+#include <libpdbg.h>
+
+static int count_entry(const struct pdbg_stats *stats, void *priv)
+{
+	int *count = priv;
+
+	(*count)++;
+	return 0;
+}
+
+static int count_entries(void)
+{
+	int count = 0;
+
+	assert(pdbg_stats_foreach(count_entry, &count) == 0);
+	return count;
+}
+
+static int find_entry(const struct pdbg_stats *stats, void *priv)
+{
+	const struct pdbg_stats **found = priv;
+
+	if (stats->op != (*found)->op)
+		return 0;
+
+	*found = stats;
+	return 1;
+}
+
+static const struct pdbg_stats *find(enum pdbg_stats_op op)
+{
+	struct pdbg_stats key = { .op = op };
+	const struct pdbg_stats *found = &key;
+
+	if (!pdbg_stats_foreach(find_entry, &found))
+		return NULL;
+
+	return found;
+}
+
+int main(void)
+{
+	struct pdbg_target *pib = NULL, *fsi = NULL, *target;
+	const struct pdbg_stats *stats;
+	uint64_t value;
+	uint32_t value32;
+	int i;
+
+	assert(pdbg_set_backend(PDBG_BACKEND_FAKE, NULL));
+	assert(pdbg_targets_init(NULL));
+
+	pdbg_for_each_class_target("pib", target) {
+		pib = target;
+		break;
+	}
+	pdbg_for_each_class_target("fsi", target) {
+		fsi = target;
+		break;
+	}
+	assert(pib && fsi);
+	assert(pdbg_target_probe(pib) == PDBG_TARGET_ENABLED);
+	assert(pdbg_target_probe(fsi) == PDBG_TARGET_ENABLED);
+
+	/* Nothing is recorded unless enabled */
+	pdbg_stats_enable(false);
+	assert(!pdbg_stats_enabled());
+	assert(pib_read(pib, 0xf000f, &value) == 0);
+	assert(count_entries() == 0);
+
+	pdbg_stats_enable(true);
+	assert(pdbg_stats_enabled());
+
+	for (i = 0; i < 3; i++)
+		assert(pib_read(pib, 0xf000f, &value) == 0);
+	assert(pib_write(pib, 0xf000f, value) == 0);
+	assert(fsi_read(fsi, 0x1000, &value32) == 0);
+
+	assert(count_entries() == 3);
+
+	stats = find(PDBG_STATS_PIB_READ);
+	assert(stats);
+	assert(!strcmp(stats->class, "pib"));
+	assert(!strcmp(stats->backend, "ibm,fake-pib"));
+	assert(!strcmp(pdbg_stats_op_name(stats->op), "pib_read"));
+	assert(stats->count == 3);
+	assert(stats->errors == 0);
+	assert(stats->bytes == 24);
+	assert(stats->min_ns <= stats->max_ns);
+	assert(stats->total_ns >= stats->max_ns);
+	assert(pdbg_stats_percentile(stats, 50) <= stats->max_ns);
+	assert(pdbg_stats_percentile(stats, 100) == stats->max_ns);
+
+	stats = find(PDBG_STATS_PIB_WRITE);
+	assert(stats && stats->count == 1 && stats->bytes == 8);
+
+	stats = find(PDBG_STATS_FSI_READ);
+	assert(stats && stats->count == 1 && stats->bytes == 4);
+	assert(!strcmp(stats->class, "fsi"));
+
+	/* Statistics survive the tree going away */
+	pdbg_release_dt_root();
+	assert(count_entries() == 3);
+
+	pdbg_stats_reset();
+	assert(count_entries() == 0);
+	assert(find(PDBG_STATS_PIB_READ) == NULL);
+
+	return 0;
+}
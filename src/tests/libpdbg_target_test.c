@@ -61,6 +61,7 @@ int main(void)
 {
 	struct pdbg_target *root, *target, *parent, *parent2;
 	const char *name;
+	char buf[32];
 	int count;
 
 	assert(pdbg_set_backend(PDBG_BACKEND_FAKE, NULL));
@@ -277,5 +278,29 @@ int main(void)
 		assert(!strncmp(name, "thread", 6));
 	}
 
+	/* Class names are interned */
+	name = pdbg_class_lookup("thread");
+	assert(name);
+	snprintf(buf, sizeof(buf), "%s", "thread");
+	assert(pdbg_class_lookup(buf) == name);
+	assert(pdbg_class_lookup("nosuchclass") == NULL);
+
+	pdbg_for_each_class_target("thread", target)
+		assert(pdbg_target_class_name(target) == name);
+
+	/* and stay the same when the tree is loaded again */
+	pdbg_release_dt_root();
+	assert(pdbg_set_backend(PDBG_BACKEND_FAKE, NULL));
+	assert(pdbg_targets_init(NULL));
+	assert(pdbg_class_lookup("thread") == name);
+
+	count = count_class_target("thread");
+	assert(count == 64);
+
+	pdbg_for_each_class_target("thread", target) {
+		assert(pdbg_target_class_name(target) == name);
+		assert(pdbg_target_parent("core", target));
+	}
+
 	return 0;
 }
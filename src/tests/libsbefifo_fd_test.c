@@ -0,0 +1,237 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <endian.h>
+#include <assert.h>
+#include <sys/stat.h>
+
+#include <libsbefifo/libsbefifo.h>
+
+#define TEST_CMD	0xa801
+#define TEST_DATA_LEN	5000	/* more than a page */
+#define TEST_MAX_LEN	8192
+#define TEST_OLD_LEN	16384
+#define TEST_OLD_BYTE	0xaa
+
+static uint32_t test_status;
+
+static uint8_t data_byte(uint32_t i)
+{
+	return (i * 7 + 1) & 0xff;
+}
+
+/* Reply with TEST_DATA_LEN bytes of data, or fail with test_status */
+static int test_transport(uint8_t *msg, uint32_t msg_len,
+			  uint8_t *out, uint32_t *out_len, void *priv)
+{
+	uint32_t data_len = test_status ? 0 : TEST_DATA_LEN;
+	uint32_t *trailer;
+	uint32_t cmd, i;
+
+	assert(msg_len == 8);
+	memcpy(&cmd, msg + 4, sizeof(cmd));
+	assert(be32toh(cmd) == TEST_CMD);
+
+	if (*out_len < data_len + 12)
+		return EPROTO;
+
+	for (i = 0; i < data_len; i++)
+		out[i] = data_byte(i);
+
+	trailer = (uint32_t *)(out + data_len);
+	trailer[0] = htobe32(0xc0de0000 | TEST_CMD);
+	trailer[1] = htobe32(test_status);
+	trailer[2] = htobe32(3);
+
+	*out_len = data_len + 12;
+	return 0;
+}
+
+static int test_ops;
+
+static void test_op_fn(uint32_t cmd, uint32_t msg_len, uint32_t reply_len,
+		       uint64_t time_ns, int rc, void *priv)
+{
+	assert(cmd == TEST_CMD);
+	assert(msg_len == 8);
+	assert(reply_len == TEST_DATA_LEN);
+	assert(rc == 0);
+	test_ops++;
+}
+
+static int run_op(struct sbefifo_context *sctx, int fd, uint32_t *len)
+{
+	uint32_t msg[2] = { htobe32(2), htobe32(TEST_CMD) };
+
+	*len = TEST_MAX_LEN;
+	return sbefifo_operation_fd(sctx, (uint8_t *)msg, sizeof(msg), fd, len);
+}
+
+static void check_data(int fd, off_t off)
+{
+	uint8_t buf[TEST_DATA_LEN];
+	uint32_t i;
+
+	assert(pread(fd, buf, sizeof(buf), off) == sizeof(buf));
+	for (i = 0; i < TEST_DATA_LEN; i++)
+		assert(buf[i] == data_byte(i));
+}
+
+static void check_old(int fd, off_t off, size_t len)
+{
+	uint8_t buf[TEST_OLD_LEN];
+	size_t i;
+
+	assert(len <= sizeof(buf));
+	assert(pread(fd, buf, len, off) == (ssize_t)len);
+	for (i = 0; i < len; i++)
+		assert(buf[i] == TEST_OLD_BYTE);
+}
+
+static void fill_old(const char *path)
+{
+	uint8_t buf[TEST_OLD_LEN];
+	int fd;
+
+	memset(buf, TEST_OLD_BYTE, sizeof(buf));
+	fd = open(path, O_WRONLY | O_TRUNC);
+	assert(fd >= 0);
+	assert(write(fd, buf, sizeof(buf)) == sizeof(buf));
+	close(fd);
+}
+
+static off_t file_size(int fd)
+{
+	struct stat sb;
+
+	assert(fstat(fd, &sb) == 0);
+	return sb.st_size;
+}
+
+int main(void)
+{
+	struct sbefifo_context *sctx;
+	char path[] = "/tmp/libsbefifo_fd_test.XXXXXX";
+	uint8_t buf[TEST_DATA_LEN];
+	bool enabled = false;
+	uint32_t len;
+	int fd, pfd[2];
+	ssize_t n, done;
+
+	assert(sbefifo_connect_transport(SBEFIFO_PROC_P10, test_transport, NULL, &sctx) == 0);
+
+	fd = mkstemp(path);
+	assert(fd >= 0);
+
+	/* Empty file, received in place */
+	assert(run_op(sctx, fd, &len) == 0);
+	assert(len == TEST_DATA_LEN);
+	assert(file_size(fd) == TEST_DATA_LEN);
+	assert(lseek(fd, 0, SEEK_CUR) == TEST_DATA_LEN);
+	check_data(fd, 0);
+
+	/* Appended to what is already there */
+	assert(run_op(sctx, fd, &len) == 0);
+	assert(file_size(fd) == 2 * TEST_DATA_LEN);
+	check_data(fd, TEST_DATA_LEN);
+
+	/* A failed operation leaves the file as it was */
+	test_status = SBEFIFO_PRI_INVALID_COMMAND | SBEFIFO_SEC_INVALID_CMD;
+	assert(run_op(sctx, fd, &len) == ESBEFIFO);
+	assert(file_size(fd) == 2 * TEST_DATA_LEN);
+	assert(lseek(fd, 0, SEEK_CUR) == 2 * TEST_DATA_LEN);
+	test_status = 0;
+	close(fd);
+
+	/* Data after the offset is overwritten by the reply only */
+	fill_old(path);
+	fd = open(path, O_RDWR);
+	assert(fd >= 0);
+	assert(lseek(fd, 100, SEEK_SET) == 100);
+	assert(run_op(sctx, fd, &len) == 0);
+	assert(len == TEST_DATA_LEN);
+	assert(file_size(fd) == TEST_OLD_LEN);
+	assert(lseek(fd, 0, SEEK_CUR) == 100 + TEST_DATA_LEN);
+	check_old(fd, 0, 100);
+	check_data(fd, 100);
+	check_old(fd, 100 + TEST_DATA_LEN, TEST_OLD_LEN - 100 - TEST_DATA_LEN);
+	close(fd);
+
+	/* Write-only files can't be mapped */
+	fd = open(path, O_WRONLY | O_TRUNC);
+	assert(fd >= 0);
+	assert(run_op(sctx, fd, &len) == 0);
+	assert(len == TEST_DATA_LEN);
+	close(fd);
+	fd = open(path, O_RDONLY);
+	assert(fd >= 0);
+	assert(file_size(fd) == TEST_DATA_LEN);
+	check_data(fd, 0);
+	close(fd);
+
+	/* O_APPEND writes at the end, whatever the offset */
+	fill_old(path);
+	fd = open(path, O_RDWR | O_APPEND);
+	assert(fd >= 0);
+	assert(lseek(fd, 0, SEEK_SET) == 0);
+	assert(run_op(sctx, fd, &len) == 0);
+	assert(len == TEST_DATA_LEN);
+	assert(file_size(fd) == TEST_OLD_LEN + TEST_DATA_LEN);
+	check_old(fd, 0, TEST_OLD_LEN);
+	check_data(fd, TEST_OLD_LEN);
+	close(fd);
+
+	unlink(path);
+
+	/* Pipes get the data written out */
+	assert(pipe(pfd) == 0);
+	assert(run_op(sctx, pfd[1], &len) == 0);
+	assert(len == TEST_DATA_LEN);
+	close(pfd[1]);
+
+	for (done = 0; (n = read(pfd[0], buf + done, sizeof(buf) - done)) > 0; done += n)
+		;
+	assert(done == TEST_DATA_LEN);
+	for (n = 0; n < TEST_DATA_LEN; n++)
+		assert(buf[n] == data_byte(n));
+	close(pfd[0]);
+
+	/* Operations are only reported while the callback is enabled */
+	fd = open("/dev/null", O_WRONLY);
+	assert(fd >= 0);
+	sbefifo_set_op_callback(sctx, test_op_fn, &enabled, NULL);
+	assert(run_op(sctx, fd, &len) == 0);
+	assert(test_ops == 0);
+	enabled = true;
+	assert(run_op(sctx, fd, &len) == 0);
+	assert(test_ops == 1);
+	sbefifo_set_op_callback(sctx, test_op_fn, NULL, NULL);
+	enabled = false;
+	assert(run_op(sctx, fd, &len) == 0);
+	assert(test_ops == 2);
+	close(fd);
+
+	sbefifo_disconnect(sctx);
+
+	return 0;
+}
@@ -0,0 +1,250 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <endian.h>
+#include <assert.h>
+#include <sys/poll.h>
+
+#include <libsbefifo/libsbefifo.h>
+
+#define TEST_CMD	0xa801
+#define TEST_STATUS	(SBEFIFO_PRI_INTERNAL_ERROR | SBEFIFO_SEC_GENERIC_FAILURE)
+
+/* magic, status, len, dropped and timestamp */
+#define HDR_LEN		24
+#define FFDC_WORDS	2
+#define RECORD_LEN	(HDR_LEN + FFDC_WORDS * 4)
+
+/* Room for three records, so they wrap around the end of the ring */
+#define RING_SIZE	(3 * RECORD_LEN + RECORD_LEN / 2)
+
+static uint32_t test_seq;
+
+/* Fail every command with FFDC carrying a sequence number */
+static int test_transport(uint8_t *msg, uint32_t msg_len,
+			  uint8_t *out, uint32_t *out_len, void *priv)
+{
+	uint32_t reply[] = {
+		htobe32(0xc0de0000 | TEST_CMD),
+		htobe32(TEST_STATUS),
+		htobe32(0xffdc0000 | FFDC_WORDS),
+		htobe32(test_seq++),
+		htobe32(5),
+	};
+
+	assert(*out_len >= sizeof(reply));
+	memcpy(out, reply, sizeof(reply));
+	*out_len = sizeof(reply);
+
+	return 0;
+}
+
+static void run_op(struct sbefifo_context *sctx)
+{
+	uint32_t msg[2] = { htobe32(2), htobe32(TEST_CMD) };
+	uint32_t out_len = 0;
+	uint8_t *out = NULL;
+
+	assert(sbefifo_operation(sctx, (uint8_t *)msg, sizeof(msg), &out, &out_len) == ESBEFIFO);
+	free(out);
+}
+
+static uint32_t get_be32(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return be32toh(v);
+}
+
+/* Checks the record at buf, returns the sequence number of its FFDC */
+static uint32_t check_record(const uint8_t *buf, uint32_t dropped)
+{
+	uint64_t ts;
+
+	assert(get_be32(buf) == 0x46464443);
+	assert(get_be32(buf + 4) == TEST_STATUS);
+	assert(get_be32(buf + 8) == FFDC_WORDS * 4);
+	assert(get_be32(buf + 12) == dropped);
+
+	memcpy(&ts, buf + 16, sizeof(ts));
+	assert(be64toh(ts) > 0);
+
+	assert(get_be32(buf + HDR_LEN) == (0xffdc0000 | FFDC_WORDS));
+	return get_be32(buf + HDR_LEN + 4);
+}
+
+/* Fills the pipe so the capture thread blocks writing to it */
+static size_t fill_pipe(int fd)
+{
+	uint8_t buf[4096];
+	size_t total = 0;
+	ssize_t n;
+
+	memset(buf, 0, sizeof(buf));
+	assert(fcntl(fd, F_SETFL, O_NONBLOCK) == 0);
+	while ((n = write(fd, buf, sizeof(buf))) > 0)
+		total += n;
+	while ((n = write(fd, buf, 1)) > 0)
+		total += n;
+	assert(errno == EAGAIN);
+	assert(fcntl(fd, F_SETFL, 0) == 0);
+
+	return total;
+}
+
+static void read_exact(int fd, uint8_t *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		n = read(fd, buf, len);
+		assert(n > 0);
+		buf += n;
+		len -= n;
+	}
+}
+
+static void drain(int fd, size_t len)
+{
+	uint8_t buf[4096];
+
+	while (len > 0) {
+		size_t n = len < sizeof(buf) ? len : sizeof(buf);
+
+		read_exact(fd, buf, n);
+		len -= n;
+	}
+}
+
+static size_t read_all(int fd, uint8_t *buf, size_t size)
+{
+	size_t total = 0;
+	ssize_t n;
+
+	while ((n = read(fd, buf + total, size - total)) > 0)
+		total += n;
+	assert(n == 0);
+
+	return total;
+}
+
+int main(void)
+{
+	struct sbefifo_context *sctx;
+	uint8_t buf[16 * RECORD_LEN];
+	struct pollfd pollfd;
+	uint32_t seq, dropped;
+	int pfd[2], i;
+	size_t junk;
+
+	assert(sbefifo_connect_transport(SBEFIFO_PROC_P10, test_transport, NULL, &sctx) == 0);
+
+	/* The ring has to hold more than a header */
+	assert(pipe(pfd) == 0);
+	assert(sbefifo_ffdc_capture_start(sctx, pfd[1], HDR_LEN) == EINVAL);
+
+	/* Records wrap around the end of the ring */
+	assert(sbefifo_ffdc_capture_start(sctx, pfd[1], RING_SIZE) == 0);
+	assert(sbefifo_ffdc_capture_start(sctx, pfd[1], RING_SIZE) == EINVAL);
+	for (i = 0; i < 8; i++) {
+		run_op(sctx);
+		read_exact(pfd[0], buf, RECORD_LEN);
+		assert(check_record(buf, 0) == i);
+	}
+	sbefifo_ffdc_capture_stop(sctx);
+	assert(read_all(pfd[0], buf, sizeof(buf)) == 0);
+	close(pfd[0]);
+
+	/*
+	 * With the writer stuck on a full pipe the ring holds three
+	 * records, and the next two are dropped.
+	 */
+	assert(pipe(pfd) == 0);
+	junk = fill_pipe(pfd[1]);
+	assert(sbefifo_ffdc_capture_start(sctx, pfd[1], RING_SIZE) == 0);
+	for (i = 0; i < 5; i++)
+		run_op(sctx);
+	drain(pfd[0], junk);
+	read_exact(pfd[0], buf, 3 * RECORD_LEN);
+	assert(check_record(buf, 0) == 8);
+	assert(check_record(buf + RECORD_LEN, 0) == 9);
+	assert(check_record(buf + 2 * RECORD_LEN, 0) == 10);
+
+	/*
+	 * The writer may not have made room yet, so keep adding records
+	 * until one gets through. It counts everything dropped since 10.
+	 */
+	pollfd.fd = pfd[0];
+	pollfd.events = POLLIN;
+	do {
+		run_op(sctx);
+	} while (poll(&pollfd, 1, 1000) == 0);
+	read_exact(pfd[0], buf, RECORD_LEN);
+	seq = test_seq - 1;
+	dropped = seq - 11;
+	assert(dropped >= 2);
+	assert(check_record(buf, dropped) == seq);
+
+	/* Stopping writes out what is left in the ring and closes the fd */
+	run_op(sctx);
+	run_op(sctx);
+	sbefifo_ffdc_capture_stop(sctx);
+	assert(read_all(pfd[0], buf, sizeof(buf)) == 2 * RECORD_LEN);
+	assert(check_record(buf, 0) == seq + 1);
+	assert(check_record(buf + RECORD_LEN, 0) == seq + 2);
+	close(pfd[0]);
+
+	/*
+	 * Stopping while the last two records are dropped writes a
+	 * record without FFDC carrying the count.
+	 */
+	assert(pipe(pfd) == 0);
+	junk = fill_pipe(pfd[1]);
+	assert(sbefifo_ffdc_capture_start(sctx, pfd[1], RING_SIZE) == 0);
+	seq = test_seq;
+	for (i = 0; i < 5; i++)
+		run_op(sctx);
+	drain(pfd[0], junk);
+	sbefifo_ffdc_capture_stop(sctx);
+	assert(read_all(pfd[0], buf, sizeof(buf)) == 3 * RECORD_LEN + HDR_LEN);
+	assert(check_record(buf, 0) == seq);
+	assert(check_record(buf + RECORD_LEN, 0) == seq + 1);
+	assert(check_record(buf + 2 * RECORD_LEN, 0) == seq + 2);
+	assert(get_be32(buf + 3 * RECORD_LEN) == 0x46464443);
+	assert(get_be32(buf + 3 * RECORD_LEN + 4) == 0);
+	assert(get_be32(buf + 3 * RECORD_LEN + 8) == 0);
+	assert(get_be32(buf + 3 * RECORD_LEN + 12) == 2);
+	close(pfd[0]);
+
+	/* Disconnecting stops capture too, and flushes the ring */
+	assert(pipe(pfd) == 0);
+	assert(sbefifo_ffdc_capture_start(sctx, pfd[1], RING_SIZE) == 0);
+	run_op(sctx);
+	sbefifo_disconnect(sctx);
+	assert(read_all(pfd[0], buf, sizeof(buf)) == RECORD_LEN);
+	assert(check_record(buf, 0) == seq + 5);
+	close(pfd[0]);
+
+	return 0;
+}
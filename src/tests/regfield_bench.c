@@ -0,0 +1,191 @@
+/* Copyright 2024 IBM Corp.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+ * implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares the register field accessors from regfield.h with the same
+ * operations written out as shifts and masks by hand, and with the
+ * GETFIELD()/SETFIELD() macros. Fails if the results differ, and with
+ * -t if the accessors are noticeably slower than the hand written code.
+ * 'make check' only checks the results, timing is left to 'make bench'.
+ *
+ * Usage: regfield_bench [-t] [<iterations>]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bitutils.h"
+#include "regfield.h"
+
+#define NR_VALUES	4096
+#define NR_RUNS		5
+
+/* Similar to building an ADU command */
+#define TTYPE		REG_FIELD(25, 31)
+#define TSIZE		REG_FIELD(32, 39)
+#define SCOPE		REG_FIELD(16, 18)
+#define ADDRESS		REG_FIELD(8, 63)
+
+#define TTYPE_MASK	PPC_BITMASK(25, 31)
+#define TSIZE_MASK	PPC_BITMASK(32, 39)
+#define SCOPE_MASK	PPC_BITMASK(16, 18)
+#define ADDRESS_MASK	PPC_BITMASK(8, 63)
+
+static uint64_t values[NR_VALUES];
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static __attribute__((noinline)) uint64_t run_hand(void)
+{
+	uint64_t sum = 0, reg, v;
+	int i;
+
+	for (i = 0; i < NR_VALUES; i++) {
+		v = values[i];
+		reg = (v & ~(TTYPE_MASK | SCOPE_MASK)) | (0x36ULL << 32) | (3ULL << 45);
+		reg = (reg & ~TSIZE_MASK) | ((v << 24) & TSIZE_MASK);
+		sum += (reg >> 24) & 0xff;
+		sum += (reg & TTYPE_MASK) >> 32;
+		sum += v & ADDRESS_MASK;
+		sum ^= reg;
+	}
+
+	return sum;
+}
+
+static __attribute__((noinline)) uint64_t run_field(void)
+{
+	uint64_t sum = 0, reg, v;
+	int i;
+
+	for (i = 0; i < NR_VALUES; i++) {
+		v = values[i];
+		reg = field_set(TTYPE, v, 0x36);
+		reg = field_set(SCOPE, reg, 3);
+		reg = field_set(TSIZE, reg, v);
+		sum += field_get(TSIZE, reg);
+		sum += field_get(TTYPE, reg);
+		sum += field_prep(ADDRESS, field_get(ADDRESS, v));
+		sum ^= reg;
+	}
+
+	return sum;
+}
+
+static __attribute__((noinline)) uint64_t run_macro(void)
+{
+	uint64_t sum = 0, reg, v;
+	int i;
+
+	for (i = 0; i < NR_VALUES; i++) {
+		v = values[i];
+		reg = SETFIELD(TTYPE_MASK, v, 0x36);
+		reg = SETFIELD(SCOPE_MASK, reg, 3);
+		reg = SETFIELD(TSIZE_MASK, reg, v);
+		sum += GETFIELD(TSIZE_MASK, reg);
+		sum += GETFIELD(TTYPE_MASK, reg);
+		sum += SETFIELD(ADDRESS_MASK, 0ULL, GETFIELD(ADDRESS_MASK, v));
+		sum ^= reg;
+	}
+
+	return sum;
+}
+
+/* Best time of several runs, to be robust against noise */
+static uint64_t bench(uint64_t (*fn)(void), int iterations, uint64_t *result)
+{
+	uint64_t start, best = UINT64_MAX, sum;
+	int run, i;
+
+	for (run = 0; run < NR_RUNS; run++) {
+		sum = 0;
+		start = now_ns();
+		for (i = 0; i < iterations; i++)
+			sum += fn();
+		start = now_ns() - start;
+
+		if (start < best)
+			best = start;
+	}
+
+	*result = sum;
+	return best;
+}
+
+int main(int argc, char * const argv[])
+{
+	uint64_t hand, field, macro, r_hand, r_field, r_macro;
+	uint64_t x = 0x9e3779b97f4a7c15ULL;
+	int iterations = 200, timing = 0, opt, i;
+	double ops;
+
+	while ((opt = getopt(argc, argv, "t")) != -1) {
+		switch (opt) {
+		case 't':
+			timing = 1;
+			break;
+
+		default:
+			fprintf(stderr, "Usage: %s [-t] [<iterations>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind < argc)
+		iterations = atoi(argv[optind]);
+	assert(iterations > 0);
+
+	for (i = 0; i < NR_VALUES; i++) {
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		values[i] = x;
+	}
+
+	hand = bench(run_hand, iterations, &r_hand);
+	field = bench(run_field, iterations, &r_field);
+	macro = bench(run_macro, iterations, &r_macro);
+
+	ops = (double)iterations * NR_VALUES;
+	printf("hand written: %.2f ns per value\n", hand / ops);
+	printf("field_*():    %.2f ns per value\n", field / ops);
+	printf("*FIELD():     %.2f ns per value\n", macro / ops);
+
+	if (r_hand != r_field || r_hand != r_macro) {
+		printf("Results differ: 0x%016" PRIx64 " 0x%016" PRIx64 " 0x%016" PRIx64 "\n",
+		       r_hand, r_field, r_macro);
+		return 1;
+	}
+
+	/* Both compile to the same instructions, so allow for noise only */
+	if (timing && field > hand + hand / 2) {
+		printf("field_*() accessors are slower than hand written code\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -19,12 +19,17 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <endian.h>
+#include <stddef.h>
+
+#include <ccan/array_size/array_size.h>
 
 #include <libpdbg.h>
 
 #include "main.h"
 #include "optcmd.h"
+#include "output.h"
 #include "path.h"
+#include "sprs.h"
 
 static bool is_real_address(struct thread_regs *regs, uint64_t addr)
 {
@@ -263,12 +268,41 @@ static int print_one_thread(struct pdbg_target *thread)
 	return 1;
 }
 
+/* One record per thread rather than a table */
+static int thread_status_output(void)
+{
+	struct pdbg_target *thread;
+	struct thread_state tstate;
+	int count = 0;
+
+	for_each_path_target_class("thread", thread) {
+		struct output_record rec = {
+			.type = OUTPUT_THREAD,
+			.target = thread,
+			.index = pdbg_target_index(thread),
+			.thread = &tstate,
+		};
+
+		if (pdbg_target_status(thread) != PDBG_TARGET_ENABLED)
+			continue;
+
+		tstate = thread_status(thread);
+		output_record(&rec);
+		count++;
+	}
+
+	return count;
+}
+
 static int thread_status_print(void)
 {
 	struct pdbg_target *thread, *core, *pib;
 	int threads_per_core = 0;
 	int count = 0;
 
+	if (output_structured())
+		return thread_status_output();
+
 	for_each_path_target_class("thread", thread) {
 		core = pdbg_target_parent("core", thread);
 		assert(path_target_add(core));
@@ -344,13 +378,134 @@ struct reg_flags {
 
 #define REG_BACKTRACE_FLAG ("--backtrace", do_backtrace, parse_flag_noarg, false)
 
+#define THREAD_REG(spr, field) \
+	{ spr, offsetof(struct thread_regs, field), sizeof(((struct thread_regs *)NULL)->field) }
+
+/* Registers of struct thread_regs other than the GPRs */
+static const struct {
+	int spr;
+	size_t offset;
+	size_t size;
+} thread_regs_sprs[] = {
+	THREAD_REG(SPR_NIA, nia),
+	THREAD_REG(SPR_CFAR, cfar),
+	THREAD_REG(SPR_MSR, msr),
+	THREAD_REG(SPR_LR, lr),
+	THREAD_REG(SPR_CTR, ctr),
+	THREAD_REG(SPR_TAR, tar),
+	THREAD_REG(SPR_CR, cr),
+	THREAD_REG(SPR_XER, xer),
+	THREAD_REG(SPR_LPCR, lpcr),
+	THREAD_REG(SPR_PTCR, ptcr),
+	THREAD_REG(SPR_LPIDR, lpidr),
+	THREAD_REG(SPR_PIDR, pidr),
+	THREAD_REG(SPR_HFSCR, hfscr),
+	THREAD_REG(SPR_HDSISR, hdsisr),
+	THREAD_REG(SPR_HDAR, hdar),
+	THREAD_REG(SPR_HEIR, heir),
+	THREAD_REG(SPR_HID, hid),
+	THREAD_REG(SPR_HSRR0, hsrr0),
+	THREAD_REG(SPR_HSRR1, hsrr1),
+	THREAD_REG(SPR_HDEC, hdec),
+	THREAD_REG(SPR_HSPRG0, hsprg0),
+	THREAD_REG(SPR_HSPRG1, hsprg1),
+	THREAD_REG(SPR_FSCR, fscr),
+	THREAD_REG(SPR_DSISR, dsisr),
+	THREAD_REG(SPR_DAR, dar),
+	THREAD_REG(SPR_SRR0, srr0),
+	THREAD_REG(SPR_SRR1, srr1),
+	THREAD_REG(SPR_DEC, dec),
+	THREAD_REG(SPR_TB, tb),
+	THREAD_REG(SPR_SPRG0, sprg0),
+	THREAD_REG(SPR_SPRG1, sprg1),
+	THREAD_REG(SPR_SPRG2, sprg2),
+	THREAD_REG(SPR_SPRG3, sprg3),
+	THREAD_REG(SPR_PPR, ppr),
+};
+
+/* One record per register, named as getspr/getgpr name them, or a
+ * single failed "regs" record if the registers couldn't be read */
+static void thread_regs_output(struct pdbg_target *thread, struct thread_regs *regs, int rc)
+{
+	struct output_record rec = {
+		.type = OUTPUT_REG,
+		.target = thread,
+		.index = pdbg_target_index(thread),
+	};
+	char name[16];
+	int i;
+
+	if (rc) {
+		rec.failed = true;
+		rec.name = "regs";
+		output_record(&rec);
+		return;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(thread_regs_sprs); i++) {
+		const uint8_t *field = (const uint8_t *)regs + thread_regs_sprs[i].offset;
+
+		rec.addr = thread_regs_sprs[i].spr;
+		rec.name = pdbg_spr_by_id(rec.addr);
+		if (thread_regs_sprs[i].size == sizeof(uint32_t))
+			rec.value = *(const uint32_t *)field;
+		else
+			rec.value = *(const uint64_t *)field;
+
+		output_record(&rec);
+	}
+
+	rec.name = name;
+	for (i = 0; i < 32; i++) {
+		snprintf(name, sizeof(name), "gpr%02d", i);
+		rec.addr = i;
+		rec.value = regs->gprs[i];
+		output_record(&rec);
+	}
+}
+
 static int thread_regs_print(struct reg_flags flags)
 {
 	struct pdbg_target *pib, *core, *thread;
-	struct thread_regs regs;
-	int count = 0;
+	struct pdbg_target **threads;
+	struct thread_regs *regs;
+	int *rc;
+	int i, nthreads = 0, count = 0;
+
+	if (flags.do_backtrace && output_structured()) {
+		fprintf(stderr, "Can't use --backtrace with --format\n");
+		return 0;
+	}
+
+	for_each_path_target_class("thread", thread)
+		nthreads++;
+
+	if (!nthreads)
+		return 0;
+
+	threads = calloc(nthreads, sizeof(*threads));
+	regs = calloc(nthreads, sizeof(*regs));
+	rc = calloc(nthreads, sizeof(*rc));
+	assert(threads && regs && rc);
+
+	i = 0;
+	for_each_path_target_class("thread", thread)
+		threads[i++] = thread;
+
+	/* Read everything up front so backends can batch the reads */
+	if (thread_getregs_list(threads, nthreads, regs, rc))
+		pdbg_log(PDBG_ERROR, "Unable to read the registers of every thread\n");
+
+	for (i = 0; i < nthreads; i++) {
+		thread = threads[i];
+
+		if (output_structured()) {
+			thread_regs_output(thread, &regs[i], rc[i]);
+			if (!rc[i])
+				count++;
+			continue;
+		}
 
-	for_each_path_target_class("thread", thread) {
 		core = pdbg_target_parent("core", thread);
 		pib = pdbg_target_parent("pib", core);
 
@@ -359,17 +514,20 @@ static int thread_regs_print(struct reg_flags flags)
 		       pdbg_target_index(core),
 		       pdbg_target_index(thread));
 
-		if (thread_getregs(thread, &regs))
+		if (rc[i])
 			continue;
 
-		thread_print_regs(&regs);
+		thread_print_regs(&regs[i]);
 
 		if (flags.do_backtrace) {
 			struct pdbg_target *adu;
 
 			pdbg_for_each_class_target("mem", adu) {
 				if (pdbg_target_probe(adu) == PDBG_TARGET_ENABLED) {
-					dump_stack(&regs, adu);
+					/* Unwinding reads each frame in small pieces */
+					mem_cache_enable(adu, true);
+					dump_stack(&regs[i], adu);
+					mem_cache_enable(adu, false);
 					break;
 				}
 			}
@@ -378,6 +536,10 @@ static int thread_regs_print(struct reg_flags flags)
 		count++;
 	}
 
+	free(threads);
+	free(regs);
+	free(rc);
+
 	return count;
 }
 OPTCMD_DEFINE_CMD_ONLY_FLAGS(regs, thread_regs_print, reg_flags, (REG_BACKTRACE_FLAG));
@@ -96,8 +96,40 @@ bool parse_list(const char *arg, int max, int *list, int *count)
 	return true;
 }
 
+static const char hex_digits[] = "0123456789abcdef";
+
+char *hex_format(char *p, uint64_t value, int digits)
+{
+	int i;
+
+	for (i = digits - 1; i >= 0; i--) {
+		p[i] = hex_digits[value & 0xf];
+		value >>= 4;
+	}
+
+	return p + digits;
+}
+
+char *hex_format_bytes(char *p, const uint8_t *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		*p++ = hex_digits[buf[i] >> 4];
+		*p++ = hex_digits[buf[i] & 0xf];
+	}
+
+	return p;
+}
+
+/* Longest hexdump line is the prefix, 32 digits, 16 spaces and a newline */
+#define HEXDUMP_LINE	(2 + 16 + 2 + 32 + 16 + 1)
+#define HEXDUMP_BUF	(256 * HEXDUMP_LINE)
+
 void hexdump(uint64_t addr, uint8_t *buf, uint64_t size, uint8_t group_size)
 {
+	char out[HEXDUMP_BUF];
+	char *p = out;
 	uint64_t start_addr, offset, i;
 	int j, k;
 
@@ -109,32 +141,47 @@ void hexdump(uint64_t addr, uint8_t *buf, uint64_t size, uint8_t group_size)
 
 	assert(group_size == 1 || group_size == 2 || group_size == 4 || group_size == 8);
 
+	/* Lines are formatted into a buffer and written out in bulk */
 	for (i = 0; i < size + 15; i += 16) {
 		bool do_prefix = true;
 
 		if (start_addr + i >= addr + size)
 			break;
 
+		if (p - out > HEXDUMP_BUF - HEXDUMP_LINE) {
+			fwrite(out, 1, p - out, stdout);
+			p = out;
+		}
+
 		for (j = 0; j < 16; j += group_size) {
 			for (k = j; k < j + group_size; k++) {
 				uint64_t cur_addr = start_addr + i + k;
 
 				if (cur_addr >= addr + size) {
-					printf("\n");
+					*p++ = '\n';
+					fwrite(out, 1, p - out, stdout);
 					return;
 				}
 
 				if (do_prefix) {
-					printf("0x%016" PRIx64 ": ", start_addr + i);
+					*p++ = '0';
+					*p++ = 'x';
+					p = hex_format(p, start_addr + i, 16);
+					*p++ = ':';
+					*p++ = ' ';
 					do_prefix = false;
 				}
-				if (i+k >= offset && i+k <= offset + size)
-					printf("%02x", buf[i+k - offset]);
-				else
-					printf("  ");
+				if (i+k >= offset && i+k <= offset + size) {
+					p = hex_format_bytes(p, &buf[i+k - offset], 1);
+				} else {
+					*p++ = ' ';
+					*p++ = ' ';
+				}
 			}
-			printf(" ");
+			*p++ = ' ';
 		}
-		printf("\n");
+		*p++ = '\n';
 	}
+
+	fwrite(out, 1, p - out, stdout);
 }
@@ -17,6 +17,7 @@
 #define __UTIL_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /**
@@ -47,4 +48,24 @@ bool parse_list(const char *arg, int max, int *list, int *count);
  */
 void hexdump(uint64_t addr, uint8_t *buf, uint64_t size, uint8_t group_size);
 
+/**
+ * @brief Format a number in hex without going through printf
+ *
+ * @param[out] p Buffer to format into, no terminating NUL is added
+ * @param[in]  value The number to format
+ * @param[in]  digits Number of digits, with leading zeroes
+ * @return the end of the formatted digits in p
+ */
+char *hex_format(char *p, uint64_t value, int digits);
+
+/**
+ * @brief Format bytes as a string of hex digits
+ *
+ * @param[out] p Buffer for 2 * len characters, no terminating NUL is added
+ * @param[in]  buf Bytes to format
+ * @param[in]  len Number of bytes
+ * @return the end of the formatted digits in p
+ */
+char *hex_format_bytes(char *p, const uint8_t *buf, size_t len);
+
 #endif
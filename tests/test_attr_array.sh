@@ -131,3 +131,18 @@ test_result 0 <<EOF
 0x1234567890abcdef 
 EOF
 test_run libpdbg_attr_test / read ATTR8 array 8 1
+
+test_result 0 <<EOF
+0x70 0x72 0x6f 0x63 0x65 0x73 0x73 0x6f 0x72 0x30 0x00 
+0x70 0x72 0x6f 0x63 0x65 0x73 0x73 0x6f 0x72 0x31 0x00 
+0x70 0x72 0x6f 0x63 0x65 0x73 0x73 0x6f 0x72 0x32 0x00 
+0x70 0x72 0x6f 0x63 0x65 0x73 0x73 0x6f 0x72 0x33 0x00 
+0x70 0x72 0x6f 0x63 0x65 0x73 0x73 0x6f 0x72 0x34 0x00 
+0x70 0x72 0x6f 0x63 0x65 0x73 0x73 0x6f 0x72 0x35 0x00 
+0x70 0x72 0x6f 0x63 0x65 0x73 0x73 0x6f 0x72 0x36 0x00 
+0x70 0x72 0x6f 0x63 0x65 0x73 0x73 0x6f 0x72 0x37 0x00 
+EOF
+test_run libpdbg_attr_test pib readclass ATTR2 1 11
+
+test_result 88 --
+test_run libpdbg_attr_test pib readclass ATTR2 1 10
@@ -0,0 +1,53 @@
+#!/bin/sh
+
+. $(dirname "$0")/driver.sh
+
+test_group "daemon tests"
+
+socket=$(mktemp -u)
+
+# The simulated backend has memory behind its ADUs
+PDBG_BACKEND_DTB=fake-sim-backend.dtb pdbg -b fake -a daemon "$socket" &
+daemon_pid=$!
+trap 'kill -INT $daemon_pid 2>/dev/null; wait $daemon_pid' EXIT
+
+for i in 1 2 3 4 5 6 7 8 9 10 ; do
+	[ -S "$socket" ] && break
+	sleep 0.1
+done
+
+test_result 0 <<EOF
+600
+EOF
+test_run stat -c %a "$socket"
+
+test_result 0 <<EOF
+p0: 0x00000000000f000f = 0x00000000deadbeef (/proc0/pib)
+p1: 0x00000000000f000f = 0x00000000deadbeef (/proc1/pib)
+EOF
+test_run pdbg --connect="$socket" -p0,1 getscom 0xf000f
+
+test_result 0 <<EOF
+p0: 0x1000 = 0xfeed0cfa
+EOF
+test_run pdbg --connect="$socket" -p0 getcfam 0x1000
+
+test_result 0 --
+test_run pdbg --connect="$socket" -p0 putscom 0x1000 0x1234
+
+test_result 1 --
+test_run pdbg --connect="$socket" -p0 threadstatus
+
+test_result 1 --
+test_run pdbg --connect="$socket" -p0 -c0 -t0 regs
+
+# Memory accesses larger than a request are split up
+test_result 0 --
+head -c 300000 /dev/zero | tr '\0' '\1' | test_run pdbg --connect="$socket" -p0 putmem 0x2000
+
+test_result 0 <<EOF
+0x0000000000041ff0: 01 01 01 01 01 01 01 01 01 01 01 01 01 01 01 01
+0x0000000000042000: 01 01 01 01 01 01 01 01 01 01 01 01 01 01 01 01
+0x000000000004b3d0: 01 01 01 01 01 01 01 01 01 01 01 01 01 01 01 01
+EOF
+test_run sh -c "pdbg --connect='$socket' -p0 getmem 0x2000 300000 | grep -E '^0x0000000000041ff0|^0x0000000000042000|^0x000000000004b3d0' | sed 's/ *$//'"
@@ -0,0 +1,40 @@
+#!/bin/sh
+
+. $(dirname "$0")/driver.sh
+
+test_group "istep tests"
+
+# The fake SBE FIFOs are in the simulation backend tree
+BACKEND="env PDBG_BACKEND_DTB=fake-sim-backend.dtb PDBG_FAKE_LATENCY=istep=1000"
+
+result_filter ()
+{
+	sed -E -e 's/[0-9]+\.[0-9]{3} ms/N ms/' -e 's/ +$//'
+}
+
+test_result 0 <<EOF
+Running istep 2.2 on 2 processors
+p0: istep 2.2 done in N ms
+p1: istep 2.2 done in N ms
+istep 2.2 took N ms
+EOF
+test_run $BACKEND pdbg -b fake -p0,1 istep 2 2 --parallel
+
+# Every processor runs the failing istep, and no istep after it
+test_result 1 <<EOF
+Running istep 2.2 on 2 processors
+p0: istep 2.2 done in N ms
+p1: istep 2.2 done in N ms
+istep 2.2 took N ms
+Running istep 2.3 on 2 processors
+0x0000000000000000: ffdc0002 0000a101
+0x0000000000000000: ffdc0002 0000a101
+istep 2.3 took N ms
+EOF
+test_run $BACKEND PDBG_FAKE_ISTEP_FAIL=2.3 pdbg -b fake -p0,1 istep 2 0 --parallel
+
+test_result 1 <<EOF
+Running istep 2.2
+Running istep 2.3
+EOF
+test_run $BACKEND PDBG_FAKE_ISTEP_FAIL=2.3 pdbg -b fake -p0 istep 2 0
@@ -0,0 +1,59 @@
+#!/bin/sh
+
+. $(dirname "$0")/driver.sh
+
+test_group "structured output tests"
+
+test_result 0 <<EOF
+{"type":"scom","target":"/proc0/pib","index":0,"addr":"0x00000000000f000f","value":"0x00000000deadbeef","status":"ok"}
+{"type":"scom","target":"/proc1/pib","index":1,"addr":"0x00000000000f000f","value":"0x00000000deadbeef","status":"ok"}
+EOF
+test_run pdbg -b fake -p0,1 --format=json getscom 0xf000f
+
+# The index is the processor, as in the text output, not the core
+test_result 0 <<EOF
+{"type":"scom","target":"/proc1/pib","index":1,"addr":"0x00000000000f000f","value":"0x00000000deadbeef","status":"ok"}
+{"type":"scom","target":"/proc1/pib/core@10010","index":1,"addr":"0x000000000010001f","value":"0x00000000deadbeef","status":"ok"}
+EOF
+test_run pdbg -b fake -p1 -c0 --format=json getscom 0xf000f
+
+test_result 0 <<EOF
+{"type":"cfam","target":"/proc0/fsi","index":0,"addr":"0x00001000","value":"0xfeed0cfa","status":"ok"}
+EOF
+test_run pdbg -b fake -p0 --format=json getcfam 0x1000
+
+test_result 0 <<EOF
+{"type":"thread","target":"/proc0/pib/core@10010/thread@1","index":1,"active":true,"quiesced":false,"sleep":"run","status":"ok"}
+EOF
+test_run pdbg -b fake -p0 -c0 -t1 --format=json threadstatus
+
+# Running threads can't be rammed
+test_result 1 <<EOF
+{"type":"reg","target":"/proc0/pib/core@10010/thread@0","index":0,"reg":"regs","status":"failed"}
+EOF
+test_run pdbg -b fake -p0 -c0 -t0 --format=json regs
+
+test_result 1 --
+test_run pdbg -b fake -p0 -c0 -t0 --format=json regs --backtrace
+
+test_result 1 --
+test_run pdbg -b fake -p0 --format=json probe
+
+test_result 1 --
+test_run pdbg -b fake -p0 --format=xml getscom 0xf000f
+
+binary_dump ()
+{
+	"$@" | od -An -tx1
+}
+
+test_wrapper binary_dump
+
+test_result 0 <<EOF
+ 01 00 00 0a 00 00 00 00 00 00 00 00 00 00 00 00
+ 00 00 00 00 00 0f 00 0f 00 00 00 00 de ad be ef
+ 2f 70 72 6f 63 30 2f 70 69 62
+EOF
+test_run pdbg -b fake -p0 --format=binary getscom 0xf000f
+
+test_wrapper
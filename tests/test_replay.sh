@@ -0,0 +1,54 @@
+#!/bin/sh
+
+. $(dirname "$0")/driver.sh
+
+TRACE=fake-replay.trace
+WRITE_TRACE=fake-replay-write.trace
+SCRIPT_TRACE=fake-replay-script.trace
+SCRIPT=fake-replay.script
+
+test_setup "pdbg -b fake --record=$TRACE -p0,1 getscom 0xf000f >/dev/null"
+test_setup "pdbg -b fake --record=$WRITE_TRACE -p0 putscom 0xf000f 0x1234 >/dev/null"
+test_setup "printf 'getscom 0xf000f\\ngetscom 0xf0010\\n' > $SCRIPT"
+test_setup "pdbg -b fake --record=$SCRIPT_TRACE -p0 script $SCRIPT >/dev/null"
+test_cleanup rm -f $TRACE $WRITE_TRACE $SCRIPT_TRACE $SCRIPT
+
+test_group "record and replay tests"
+
+test_result 0 <<EOF
+p0: 0x00000000000f000f = 0x00000000deadbeef (/proc0/pib)
+p1: 0x00000000000f000f = 0x00000000deadbeef (/proc1/pib)
+EOF
+test_run pdbg -b replay -d $TRACE -p0,1 getscom 0xf000f
+
+test_result 0 <<EOF
+p0: 0x00000000000f000f = 0x00000000deadbeef (/proc0/pib)
+p1: 0x00000000000f000f = 0x00000000deadbeef (/proc1/pib)
+EOF
+test_run env PDBG_REPLAY_LATENCY=1 pdbg -b replay -d $TRACE -p0,1 getscom 0xf000f
+
+# Anything not in the trace fails
+test_result 1 <<EOF
+p0: 0x00000000000f0010 failed (/proc0/pib)
+p1: 0x00000000000f0010 failed (/proc1/pib)
+EOF
+test_run pdbg -b replay -d $TRACE -p0,1 getscom 0xf0010
+
+# Writes have to match the trace, data included
+test_result 0 --
+test_run pdbg -b replay -d $WRITE_TRACE -p0 putscom 0xf000f 0x1234
+
+test_result 1 <<EOF
+p0: 0x00000000000f000f failed (/proc0/pib)
+EOF
+test_run pdbg -b replay -d $WRITE_TRACE -p0 putscom 0xf000f 0x5678
+
+# Reads batched by the script command are recorded as single reads
+test_result 0 <<EOF
+p0: 0x00000000000f000f = 0x00000000deadbeef (/proc0/pib)
+p0: 0x00000000000f0010 = 0x00000000deadbeef (/proc0/pib)
+EOF
+test_run pdbg -b replay -d $SCRIPT_TRACE -p0 script $SCRIPT
+
+test_result 1 --
+test_run pdbg -b replay -d /nonexistent -p0 getscom 0xf000f
@@ -0,0 +1,58 @@
+#!/bin/sh
+
+. $(dirname "$0")/driver.sh
+
+test_group "script tests"
+
+script_file=$(mktemp)
+trap 'rm -f "$script_file"' EXIT
+
+cat > "$script_file" <<EOF
+# Reads of the same register are only done once
+getscom 0xf000f
+getcfam 0x1000
+getscom 0xf000f
+putscom 0x1000 0x1234
+EOF
+
+test_result 0 <<EOF
+p0: 0x00000000000f000f = 0x00000000deadbeef (/proc0/pib)
+p1: 0x00000000000f000f = 0x00000000deadbeef (/proc1/pib)
+p0: 0x1000 = 0xfeed0cfa
+p1: 0x1000 = 0xfeed0cfa
+p0: 0x00000000000f000f = 0x00000000deadbeef (/proc0/pib)
+p1: 0x00000000000f000f = 0x00000000deadbeef (/proc1/pib)
+EOF
+test_run pdbg -b fake -p0,1 script "$script_file"
+
+cat > "$script_file" <<EOF
+# Reads aren't moved across writes, whichever register they go to
+getscom 0x10014
+putscom 0x10010 0x8000000000000000
+getscom 0x10014
+getcfam 0x1000
+putcfam 0x1000 0x1234
+getscom 0x10014
+getcfam 0x1000
+EOF
+
+test_result 0 <<EOF
+p0: 0x0000000000010014 = 0x4000000000000000 (/proc0/pib)
+p0: 0x0000000000010014 = 0xc000000000000000 (/proc0/pib)
+p0: 0x1000 = 0xfeed0cfa
+p0: 0x0000000000010014 = 0xc000000000000000 (/proc0/pib)
+p0: 0x1000 = 0x00001234
+EOF
+test_run pdbg -b fake -p0 script "$script_file"
+
+echo "getscom 0xf000f" > "$script_file"
+
+test_result 0 <<EOF
+{"type":"scom","target":"/proc0/pib","index":0,"addr":"0x00000000000f000f","value":"0x00000000deadbeef","status":"ok"}
+EOF
+test_run pdbg -b fake -p0 --format=json script "$script_file"
+
+echo "getscom 0xf000f 0x10" > "$script_file"
+
+test_result 1 --
+test_run pdbg -b fake -p0 script "$script_file"
@@ -486,6 +486,42 @@ do_skip
 test_run pdbg -b fake -p1,3,5,7,9 -c1,3,5 -t0,2 probe
 
 
+# Creating targets on demand gives the same result
+test_result 0 <<EOF
+proc1: Fake Processor
+    fsi1: Fake FSI (*)
+    pib1: Fake PIB (*)
+        core1: Fake Core (*)
+            thread0: Fake Thread (*)
+        core3: Fake Core (*)
+            thread0: Fake Thread (*)
+proc3: Fake Processor
+    fsi3: Fake FSI (*)
+    pib3: Fake PIB (*)
+        core1: Fake Core (*)
+            thread0: Fake Thread (*)
+        core3: Fake Core (*)
+            thread0: Fake Thread (*)
+proc5: Fake Processor
+    fsi5: Fake FSI (*)
+    pib5: Fake PIB (*)
+        core1: Fake Core (*)
+            thread0: Fake Thread (*)
+        core3: Fake Core (*)
+            thread0: Fake Thread (*)
+proc7: Fake Processor
+    fsi7: Fake FSI (*)
+    pib7: Fake PIB (*)
+        core1: Fake Core (*)
+            thread0: Fake Thread (*)
+        core3: Fake Core (*)
+            thread0: Fake Thread (*)
+EOF
+
+do_skip
+test_run pdbg -b fake --lazy -p1,3,5,7,9 -c1,3,5 -t0,2 probe
+
+
 test_result 0 <<EOF
 proc1: Fake Processor
     fsi1: Fake FSI (*)